@@ -11,8 +11,10 @@
 */
 
 #include <iostream>
+#include <algorithm>
 #include "ColdetModel.h"
 #include "ColdetModelSharedDataSet.h"
+#include "ConvexDecomposition.h"
 
 #include "Opcode/Opcode.h"
 
@@ -25,6 +27,7 @@ ColdetModel::ColdetModel()
 {
     dataSet = new ColdetModelSharedDataSet();
     isValid_ = false;
+    isConvexHullEnabled_ = false;
     initialize();
     dataSet->neighbor.clear();
     vertex2TriangleMap.clear();
@@ -33,7 +36,8 @@ ColdetModel::ColdetModel()
 
 ColdetModel::ColdetModel(const ColdetModel& org)
     : name_(org.name_),
-      isValid_(org.isValid_)
+      isValid_(org.isValid_),
+      isConvexHullEnabled_(org.isConvexHullEnabled_)
 {
     dataSet = org.dataSet;
     initialize();
@@ -255,6 +259,84 @@ int ColdetModelSharedDataSet::computeDepth(const Opcode::AABBCollisionNode* node
     return max;
 }
 
+int ColdetModel::buildConvexHulls(const ConvexDecomposition& decomposition, const std::string& cacheDirectory)
+{
+    const int numVertices = dataSet->vertices.size();
+    const int numTriangles = dataSet->triangles.size();
+
+    std::vector<Vector3> vertices(numVertices);
+    for(int i=0; i < numVertices; ++i){
+        const Point& v = dataSet->vertices[i];
+        vertices[i] = Vector3(v.x, v.y, v.z);
+    }
+    std::vector<int> triangles(numTriangles * 3);
+    for(int i=0; i < numTriangles; ++i){
+        const udword* mVRef = dataSet->triangles[i].mVRef;
+        for(int j=0; j < 3; ++j){
+            triangles[i * 3 + j] = mVRef[j];
+        }
+    }
+
+    std::vector< std::vector<Vector3> > hulls;
+    std::string filename;
+    if(!cacheDirectory.empty()){
+        filename = cacheDirectory + "/" + decomposition.cacheFileName(vertices, triangles);
+    }
+    if(filename.empty() || !ConvexDecomposition::loadHulls(filename, hulls)){
+        decomposition.apply(vertices, triangles, hulls);
+        if(!filename.empty() && !ConvexDecomposition::saveHulls(filename, hulls)){
+            cerr << "ColdetModel: the convex hulls of " << name_ << " cannot be saved to " << filename << endl;
+        }
+    }
+    setConvexHulls(hulls);
+
+    return hulls.size();
+}
+
+
+void ColdetModel::setConvexHulls(const std::vector< std::vector<Vector3> >& hulls)
+{
+    dataSet->convexHulls = hulls;
+    dataSet->convexHullCenters.resize(hulls.size());
+    dataSet->convexHullRadii.resize(hulls.size());
+
+    for(size_t i=0; i < hulls.size(); ++i){
+        const std::vector<Vector3>& hull = hulls[i];
+        Vector3 center(Vector3::Zero());
+        for(size_t j=0; j < hull.size(); ++j){
+            center += hull[j];
+        }
+        if(!hull.empty()){
+            center /= hull.size();
+        }
+        double radius = 0.0;
+        for(size_t j=0; j < hull.size(); ++j){
+            radius = std::max(radius, (hull[j] - center).norm());
+        }
+        dataSet->convexHullCenters[i] = center;
+        dataSet->convexHullRadii[i] = radius;
+    }
+}
+
+
+int ColdetModel::getNumConvexHulls() const
+{
+    return dataSet->convexHulls.size();
+}
+
+
+const std::vector<Vector3>& ColdetModel::convexHull(int index) const
+{
+    return dataSet->convexHulls[index];
+}
+
+
+bool ColdetModel::isConvexHullEnabled() const
+{
+    return isConvexHullEnabled_ && !dataSet->convexHulls.empty();
+}
+
+
 void ColdetModel::setPosition(const Matrix33& R, const Vector3& p)
 {
     transform->Set((float)R(0,0), (float)R(1,0), (float)R(2,0), 0.0f,
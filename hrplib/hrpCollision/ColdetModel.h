@@ -28,6 +28,7 @@ namespace IceMaths {
 namespace hrp {
 
     class ColdetModelSharedDataSet;
+    class ConvexDecomposition;
     class VertexIndexPair
     {
     public :
@@ -229,6 +230,41 @@ namespace hrp {
         bool checkCollisionWithPointCloud(const std::vector<Vector3> &i_cloud,
                                           double i_radius);
 
+        /**
+         * @brief approximate the mesh by a small set of convex hulls
+         *
+         * The hulls are shared with the copies of this model, and they are used
+         * for the collision check with the models whose hulls are also enabled.
+         * @param decomposition parameters of the decomposition
+         * @param cacheDirectory an existing directory where the hulls are saved and loaded
+         * @return the number of the hulls
+         */
+        int buildConvexHulls(const ConvexDecomposition& decomposition,
+                             const std::string& cacheDirectory = std::string());
+
+        /**
+         * @brief set the convex hulls which approximate the mesh
+         * @param hulls vertices of each hull in the local coordinates
+         */
+        void setConvexHulls(const std::vector< std::vector<Vector3> >& hulls);
+
+        int getNumConvexHulls() const;
+
+        const std::vector<Vector3>& convexHull(int index) const;
+
+        /**
+         * @brief use the convex hulls instead of the mesh for the collision check
+         *
+         * This is set for each model, and it has no effect until the hulls are given.
+         */
+        void enableConvexHulls(bool on) { isConvexHullEnabled_ = on; }
+
+        /**
+         * @brief check if the convex hulls are used for the collision check
+         * @return true if they are enabled and exist
+         */
+        bool isConvexHullEnabled() const;
+
         void getBoundingBoxData(const int depth, std::vector<Vector3>& out_boxes);
         
         int getAABBTreeDepth();
@@ -250,6 +286,7 @@ namespace hrp {
         IceMaths::Matrix4x4* pTransform; ///< transform of primitive
         std::string name_;
         bool isValid_;
+        bool isConvexHullEnabled_;
         std::map<VertexIndexPair, int> vertex2TriangleMap;
 
         void setNeighborTriangleSub(int triangle, int vertex0, int vertex1);
@@ -18,6 +18,7 @@
 #include "CollisionPairInserter.h"
 #include "Opcode/Opcode.h"
 #include "SSVTreeCollider.h"
+#include "ConvexHullCollider.h"
 
 using namespace hrp;
 
@@ -85,6 +86,9 @@ std::vector<collision_data>& ColdetModelPair::detectCollisionsSub(bool detectAll
     else if (pt0 == ColdetModel::SP_SPHERE || pt1 == ColdetModel::SP_SPHERE) {
         detected = detectSphereMeshCollisions(detectAllContacts);
     }
+    else if (models[0]->isConvexHullEnabled() && models[1]->isConvexHullEnabled()) {
+        detected = detectConvexHullCollisions(detectAllContacts);
+    }
     else {
         detected = detectMeshMeshCollisions(detectAllContacts);
     }
@@ -247,6 +251,64 @@ bool ColdetModelPair::detectSphereSphereCollisions(bool detectAllContacts) {
 	return result;
 }
 
+bool ColdetModelPair::detectConvexHullCollisions(bool detectAllContacts)
+{
+    Matrix33 R[2];
+    Vector3 p[2];
+    for(int k=0; k < 2; ++k){
+        const IceMaths::Matrix4x4& m = *(models[k]->transform);
+        for(int i=0; i < 3; ++i){
+            for(int j=0; j < 3; ++j){
+                R[k](i, j) = m[j][i];
+            }
+            p[k][i] = m[3][i];
+        }
+    }
+
+    const ColdetModelSharedDataSet* dataSet0 = models[0]->dataSet;
+    const ColdetModelSharedDataSet* dataSet1 = models[1]->dataSet;
+    const int numHulls0 = dataSet0->convexHulls.size();
+    const int numHulls1 = dataSet1->convexHulls.size();
+
+    std::vector<collision_data>& cdata = collisionPairInserter->collisions();
+    cdata.clear();
+
+    for(int i=0; i < numHulls0; ++i){
+        const Vector3 center0(R[0] * dataSet0->convexHullCenters[i] + p[0]);
+        for(int j=0; j < numHulls1; ++j){
+            // the bounding spheres of the hulls are checked first
+            const Vector3 center1(R[1] * dataSet1->convexHullCenters[j] + p[1]);
+            const double r = dataSet0->convexHullRadii[i] + dataSet1->convexHullRadii[j];
+            if((center1 - center0).squaredNorm() > r * r){
+                continue;
+            }
+            Vector3 normal, point;
+            double depth;
+            if(collideConvexHulls(dataSet0->convexHulls[i], R[0], p[0],
+                                  dataSet1->convexHulls[j], R[1], p[1], normal, depth, point)){
+                collision_data col;
+                col.id1 = i;
+                col.id2 = j;
+                col.depth = depth;
+                col.num_of_i_points = 1;
+                col.i_point_new[0] = 1;
+                col.i_point_new[1] = 0;
+                col.i_point_new[2] = 0;
+                col.i_point_new[3] = 0;
+                col.n_vector = normal;
+                col.i_points[0] = point;
+                cdata.push_back(col);
+                if(!detectAllContacts){
+                    return true;
+                }
+            }
+        }
+    }
+
+    return !cdata.empty();
+}
+
+
 bool ColdetModelPair::detectSphereMeshCollisions(bool detectAllContacts) {
 	
 	bool result = false;
@@ -91,6 +91,7 @@ namespace hrp {
 		bool detectSphereMeshCollisions(bool detectAllContacts);
         bool detectPlaneCylinderCollisions(bool detectAllContacts);
         bool detectPlaneMeshCollisions(bool detectAllContacts);
+        bool detectConvexHullCollisions(bool detectAllContacts);
 
         ColdetModelPtr models[2];
         double tolerance_;
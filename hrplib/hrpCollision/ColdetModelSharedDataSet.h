@@ -46,6 +46,11 @@ namespace hrp {
 
         std::vector<triangle3> neighbor;
 
+        // the convex hulls approximating the mesh and their bounding spheres
+        std::vector< std::vector<Vector3> > convexHulls;
+        std::vector<Vector3> convexHullCenters;
+        std::vector<double> convexHullRadii;
+
         int getAABBTreeDepth() {
             return AABBTreeMaxDepth;
         };
@@ -0,0 +1,735 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ConvexDecomposition.cpp
+*/
+
+#include "ConvexDecomposition.h"
+
+#include <map>
+#include <set>
+#include <queue>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace hrp;
+
+
+namespace {
+
+    const char hullFileMagic[4] = { 'C', 'V', 'X', 'H' };
+    const boost::int32_t hullFileVersion = 1;
+
+    // FNV-1a
+    void hashBytes(boost::uint64_t& io_hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            io_hash ^= bytes[i];
+            io_hash *= 1099511628211ULL;
+        }
+    }
+
+    struct ConvexHull
+    {
+        std::vector<Vector3> vertices;
+        // the outward normals and the offsets of the faces, which are empty if the hull is flat
+        std::vector<Vector3> normals;
+        std::vector<double> offsets;
+    };
+
+    struct HullFace
+    {
+        int v[3];
+        Vector3 normal;
+        double offset;
+        bool isAlive;
+    };
+
+    void setHullFace(const std::vector<Vector3>& points, int a, int b, int c, HullFace& out_face)
+    {
+        out_face.v[0] = a;
+        out_face.v[1] = b;
+        out_face.v[2] = c;
+        Vector3 n((points[b] - points[a]).cross(points[c] - points[a]));
+        const double len = n.norm();
+        if(len > 0.0){
+            n /= len;
+        }
+        out_face.normal = n;
+        out_face.offset = n.dot(points[a]);
+        out_face.isAlive = true;
+    }
+
+
+    inline double cross2(const Vector3& o, const Vector3& a, const Vector3& b)
+    {
+        return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+    }
+
+    struct Less2
+    {
+        bool operator()(const Vector3& a, const Vector3& b) const {
+            return (a.x() < b.x()) || (a.x() == b.x() && a.y() < b.y());
+        }
+    };
+
+    /**
+       the hull of the points on the plane spanned by u and v (Andrew's monotone chain)
+    */
+    void computePlanarHull(const std::vector<Vector3>& points, const Vector3& origin,
+                           const Vector3& u, const Vector3& v, std::vector<Vector3>& out_vertices)
+    {
+        const int n = points.size();
+        std::vector<Vector3> q(n);
+        for(int i=0; i < n; ++i){
+            const Vector3 r(points[i] - origin);
+            // the index is kept in the z element
+            q[i] = Vector3(u.dot(r), v.dot(r), i);
+        }
+        std::sort(q.begin(), q.end(), Less2());
+
+        std::vector<int> hull(2 * n);
+        int k = 0;
+        for(int i=0; i < n; ++i){
+            while(k >= 2 && cross2(q[hull[k-2]], q[hull[k-1]], q[i]) <= 0.0){
+                --k;
+            }
+            hull[k++] = i;
+        }
+        for(int i = n - 2, t = k + 1; i >= 0; --i){
+            while(k >= t && cross2(q[hull[k-2]], q[hull[k-1]], q[i]) <= 0.0){
+                --k;
+            }
+            hull[k++] = i;
+        }
+        out_vertices.clear();
+        for(int i=0; i < k - 1; ++i){
+            out_vertices.push_back(points[(int)q[hull[i]].z()]);
+        }
+    }
+
+
+    /**
+       incremental construction of the convex hull
+       @param eps the points closer than this distance to the hull are regarded as inside
+    */
+    void computeConvexHull(const std::vector<Vector3>& points, double eps, ConvexHull& out_hull)
+    {
+        out_hull.vertices.clear();
+        out_hull.normals.clear();
+        out_hull.offsets.clear();
+
+        const int n = points.size();
+        if(n == 0){
+            return;
+        }
+
+        int i0 = 0;
+        for(int i=1; i < n; ++i){
+            if(points[i].x() < points[i0].x()){
+                i0 = i;
+            }
+        }
+        int i1 = i0;
+        double maxd = 0.0;
+        for(int i=0; i < n; ++i){
+            const double d = (points[i] - points[i0]).norm();
+            if(d > maxd){
+                maxd = d;
+                i1 = i;
+            }
+        }
+        if(maxd <= eps){
+            out_hull.vertices.push_back(points[i0]);
+            return;
+        }
+        const Vector3 e((points[i1] - points[i0]) / maxd);
+        int i2 = i0;
+        maxd = 0.0;
+        for(int i=0; i < n; ++i){
+            const Vector3 r(points[i] - points[i0]);
+            const double d = (r - e.dot(r) * e).norm();
+            if(d > maxd){
+                maxd = d;
+                i2 = i;
+            }
+        }
+        if(maxd <= eps){
+            out_hull.vertices.push_back(points[i0]);
+            out_hull.vertices.push_back(points[i1]);
+            return;
+        }
+        const Vector3 pn(e.cross(points[i2] - points[i0]).normalized());
+        int i3 = i0;
+        maxd = 0.0;
+        for(int i=0; i < n; ++i){
+            const double d = fabs(pn.dot(points[i] - points[i0]));
+            if(d > maxd){
+                maxd = d;
+                i3 = i;
+            }
+        }
+        if(maxd <= eps){
+            computePlanarHull(points, points[i0], e, pn.cross(e), out_hull.vertices);
+            return;
+        }
+
+        std::vector<HullFace> faces(4);
+        const int tetra[4] = { i0, i1, i2, i3 };
+        const int tetraFaces[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+        const Vector3 center((points[i0] + points[i1] + points[i2] + points[i3]) / 4.0);
+        for(int i=0; i < 4; ++i){
+            const int* f = tetraFaces[i];
+            setHullFace(points, tetra[f[0]], tetra[f[1]], tetra[f[2]], faces[i]);
+            if(faces[i].normal.dot(center) > faces[i].offset){
+                setHullFace(points, tetra[f[0]], tetra[f[2]], tetra[f[1]], faces[i]);
+            }
+        }
+
+        std::set< std::pair<int, int> > edges;
+        int numDeadFaces = 0;
+
+        for(int i=0; i < n; ++i){
+            if(i == i0 || i == i1 || i == i2 || i == i3){
+                continue;
+            }
+            const Vector3& p = points[i];
+            edges.clear();
+            const int numFaces = faces.size();
+            for(int j=0; j < numFaces; ++j){
+                HullFace& face = faces[j];
+                if(face.isAlive && face.normal.dot(p) - face.offset > eps){
+                    face.isAlive = false;
+                    ++numDeadFaces;
+                    for(int k=0; k < 3; ++k){
+                        edges.insert(std::make_pair(face.v[k], face.v[(k + 1) % 3]));
+                    }
+                }
+            }
+            if(edges.empty()){
+                continue;
+            }
+            // the edges whose opposite edges are not removed form the horizon
+            for(std::set< std::pair<int, int> >::iterator it = edges.begin(); it != edges.end(); ++it){
+                if(edges.find(std::make_pair(it->second, it->first)) == edges.end()){
+                    HullFace face;
+                    setHullFace(points, it->first, it->second, i, face);
+                    faces.push_back(face);
+                }
+            }
+            if(numDeadFaces > (int)faces.size() / 2){
+                std::vector<HullFace> aliveFaces;
+                aliveFaces.reserve(faces.size() - numDeadFaces);
+                for(size_t j=0; j < faces.size(); ++j){
+                    if(faces[j].isAlive){
+                        aliveFaces.push_back(faces[j]);
+                    }
+                }
+                faces.swap(aliveFaces);
+                numDeadFaces = 0;
+            }
+        }
+
+        std::vector<char> isHullVertex(n, 0);
+        for(size_t i=0; i < faces.size(); ++i){
+            const HullFace& face = faces[i];
+            if(face.isAlive){
+                for(int k=0; k < 3; ++k){
+                    isHullVertex[face.v[k]] = 1;
+                }
+                if(face.normal.squaredNorm() > 0.0){
+                    out_hull.normals.push_back(face.normal);
+                    out_hull.offsets.push_back(face.offset);
+                }
+            }
+        }
+        for(int i=0; i < n; ++i){
+            if(isHullVertex[i]){
+                out_hull.vertices.push_back(points[i]);
+            }
+        }
+    }
+
+
+    /**
+       the distance from the point to the boundary of the hull along the direction
+    */
+    double calcDistanceToHullBoundary(const ConvexHull& hull, const Vector3& p, const Vector3& dir)
+    {
+        double minDistance = std::numeric_limits<double>::max();
+        for(size_t i=0; i < hull.normals.size(); ++i){
+            const double c = hull.normals[i].dot(dir);
+            if(c > 1.0e-12){
+                const double d = (hull.offsets[i] - hull.normals[i].dot(p)) / c;
+                if(d < minDistance){
+                    minDistance = d;
+                }
+            }
+        }
+        return std::max(minDistance, 0.0);
+    }
+
+
+    void reduceHullVertices(std::vector<Vector3>& io_vertices, int maxNumVertices)
+    {
+        const int n = io_vertices.size();
+        if(maxNumVertices <= 0 || n <= maxNumVertices){
+            return;
+        }
+        std::vector<char> isSelected(n, 0);
+        // the golden angle, pi * (3 - sqrt(5))
+        const double goldenAngle = 2.39996322972865332;
+        for(int k=0; k < maxNumVertices; ++k){
+            // directions on a Fibonacci sphere
+            const double z = 1.0 - (2.0 * k + 1.0) / maxNumVertices;
+            const double r = sqrt(std::max(0.0, 1.0 - z * z));
+            const double phi = goldenAngle * k;
+            const Vector3 dir(r * cos(phi), r * sin(phi), z);
+            int best = 0;
+            double maxDot = -std::numeric_limits<double>::max();
+            for(int i=0; i < n; ++i){
+                const double d = dir.dot(io_vertices[i]);
+                if(d > maxDot){
+                    maxDot = d;
+                    best = i;
+                }
+            }
+            isSelected[best] = 1;
+        }
+        std::vector<Vector3> selected;
+        for(int i=0; i < n; ++i){
+            if(isSelected[i]){
+                selected.push_back(io_vertices[i]);
+            }
+        }
+        io_vertices.swap(selected);
+    }
+
+
+    struct PositionLess
+    {
+        bool operator()(const Vector3& a, const Vector3& b) const {
+            if(a.x() != b.x()) return a.x() < b.x();
+            if(a.y() != b.y()) return a.y() < b.y();
+            return a.z() < b.z();
+        }
+    };
+
+
+    struct Cluster
+    {
+        std::vector<int> triangles;
+        std::vector<Vector3> hullVertices;
+        std::set<int> neighbors;
+        double concavity;
+        double area;
+        int stamp;
+        bool isAlive;
+    };
+
+
+    struct MergeCandidate
+    {
+        double cost;
+        double concavity;
+        int cluster[2];
+        int stamp[2];
+        bool operator>(const MergeCandidate& rhs) const { return cost > rhs.cost; }
+    };
+
+
+    class Decomposer
+    {
+    public:
+        Decomposer(const std::vector<Vector3>& vertices, const std::vector<int>& triangles)
+            : vertices(vertices), triangles(triangles) { }
+
+        const std::vector<Vector3>& vertices;
+        const std::vector<int>& triangles;
+        std::vector<Vector3> normals;
+        std::vector<Cluster> clusters;
+        double eps;
+        int maxNumHullVertices;
+        double totalArea;
+        double diagonal;
+        ConvexHull hull;
+
+        double calcConcavity(const Cluster& a, const Cluster& b, const ConvexHull& mergedHull){
+            if(mergedHull.normals.empty()){
+                return 0.0;
+            }
+            double concavity = 0.0;
+            const Cluster* c[2] = { &a, &b };
+            for(int i=0; i < 2; ++i){
+                const std::vector<int>& tris = c[i]->triangles;
+                for(size_t j=0; j < tris.size(); ++j){
+                    const int t = tris[j];
+                    const Vector3& n = normals[t];
+                    if(n.squaredNorm() == 0.0){
+                        continue;
+                    }
+                    const int* v = &triangles[t * 3];
+                    Vector3 samples[4];
+                    samples[3].setZero();
+                    for(int k=0; k < 3; ++k){
+                        samples[k] = vertices[v[k]];
+                        samples[3] += samples[k];
+                    }
+                    samples[3] /= 3.0;
+                    for(int k=0; k < 4; ++k){
+                        // the orientation of the triangle is not assumed
+                        const double d = std::min(calcDistanceToHullBoundary(mergedHull, samples[k], n),
+                                                  calcDistanceToHullBoundary(mergedHull, samples[k], -n));
+                        if(d > concavity){
+                            concavity = d;
+                        }
+                    }
+                }
+            }
+            return concavity;
+        }
+
+        void computeMergedHull(const Cluster& a, const Cluster& b){
+            std::vector<Vector3> points(a.hullVertices);
+            points.insert(points.end(), b.hullVertices.begin(), b.hullVertices.end());
+            computeConvexHull(points, eps, hull);
+        }
+
+        MergeCandidate evaluate(int ia, int ib){
+            const Cluster& a = clusters[ia];
+            const Cluster& b = clusters[ib];
+            computeMergedHull(a, b);
+            MergeCandidate candidate;
+            candidate.concavity = calcConcavity(a, b, hull);
+            // the small clusters are preferred among the candidates of the same concavity
+            candidate.cost = candidate.concavity + 1.0e-3 * diagonal * (a.area + b.area) / totalArea;
+            candidate.cluster[0] = ia;
+            candidate.cluster[1] = ib;
+            candidate.stamp[0] = a.stamp;
+            candidate.stamp[1] = b.stamp;
+            return candidate;
+        }
+
+        // the merged hull must be computed in advance
+        void merge(int ia, int ib, double concavity){
+            Cluster& a = clusters[ia];
+            Cluster& b = clusters[ib];
+            a.triangles.insert(a.triangles.end(), b.triangles.begin(), b.triangles.end());
+            // the reduced vertices are used in the following merges to limit the cost
+            a.hullVertices = hull.vertices;
+            reduceHullVertices(a.hullVertices, maxNumHullVertices);
+            a.concavity = concavity;
+            a.area += b.area;
+            for(std::set<int>::iterator p = b.neighbors.begin(); p != b.neighbors.end(); ++p){
+                if(*p != ia){
+                    Cluster& c = clusters[*p];
+                    c.neighbors.erase(ib);
+                    c.neighbors.insert(ia);
+                    a.neighbors.insert(*p);
+                }
+            }
+            a.neighbors.erase(ib);
+            a.stamp++;
+            b.isAlive = false;
+            std::vector<int>().swap(b.triangles);
+            std::vector<Vector3>().swap(b.hullVertices);
+            std::set<int>().swap(b.neighbors);
+        }
+    };
+}
+
+
+ConvexDecomposition::ConvexDecomposition()
+{
+    maxNumHulls = 16;
+    maxConcavity = 0.03;
+    maxNumHullVertices = 64;
+}
+
+
+void ConvexDecomposition::apply
+(const std::vector<Vector3>& vertices, const std::vector<int>& triangles, std::vector< std::vector<Vector3> >& out_hulls) const
+{
+    out_hulls.clear();
+
+    const int numTriangles = triangles.size() / 3;
+    if(numTriangles == 0 || vertices.empty()){
+        return;
+    }
+
+    Decomposer d(vertices, triangles);
+
+    Vector3 minPosition(vertices[0]);
+    Vector3 maxPosition(vertices[0]);
+    for(size_t i=1; i < vertices.size(); ++i){
+        minPosition = minPosition.cwiseMin(vertices[i]);
+        maxPosition = maxPosition.cwiseMax(vertices[i]);
+    }
+    d.diagonal = (maxPosition - minPosition).norm();
+    if(d.diagonal <= 0.0){
+        out_hulls.push_back(std::vector<Vector3>(1, vertices[0]));
+        return;
+    }
+    d.eps = d.diagonal * 1.0e-6;
+    d.maxNumHullVertices = maxNumHullVertices;
+
+    // the vertices at the same position are identified to connect the triangles
+    std::vector<int> vertexIds(vertices.size());
+    std::map<Vector3, int, PositionLess> positionToId;
+    for(size_t i=0; i < vertices.size(); ++i){
+        vertexIds[i] = positionToId.insert(std::make_pair(vertices[i], (int)i)).first->second;
+    }
+
+    d.normals.resize(numTriangles);
+    d.clusters.resize(numTriangles);
+    d.totalArea = 0.0;
+    std::map<std::pair<int, int>, int> edgeToTriangle;
+
+    for(int i=0; i < numTriangles; ++i){
+        const int* v = &triangles[i * 3];
+        Vector3 n((vertices[v[1]] - vertices[v[0]]).cross(vertices[v[2]] - vertices[v[0]]));
+        const double len = n.norm();
+        Cluster& cluster = d.clusters[i];
+        cluster.area = len / 2.0;
+        d.totalArea += cluster.area;
+        d.normals[i] = (len > 0.0) ? Vector3(n / len) : Vector3(Vector3::Zero());
+        cluster.triangles.push_back(i);
+        for(int k=0; k < 3; ++k){
+            cluster.hullVertices.push_back(vertices[v[k]]);
+        }
+        cluster.concavity = 0.0;
+        cluster.stamp = 0;
+        cluster.isAlive = true;
+
+        for(int k=0; k < 3; ++k){
+            int id0 = vertexIds[v[k]];
+            int id1 = vertexIds[v[(k + 1) % 3]];
+            if(id0 == id1){
+                continue;
+            }
+            if(id0 > id1){
+                std::swap(id0, id1);
+            }
+            std::pair<std::map<std::pair<int, int>, int>::iterator, bool> inserted =
+                edgeToTriangle.insert(std::make_pair(std::make_pair(id0, id1), i));
+            const int other = inserted.first->second;
+            if(!inserted.second && other != i){
+                cluster.neighbors.insert(other);
+                d.clusters[other].neighbors.insert(i);
+            }
+        }
+    }
+    if(d.totalArea <= 0.0){
+        d.totalArea = 1.0;
+    }
+
+    std::priority_queue<MergeCandidate, std::vector<MergeCandidate>, std::greater<MergeCandidate> > queue;
+    for(int i=0; i < numTriangles; ++i){
+        const std::set<int>& neighbors = d.clusters[i].neighbors;
+        for(std::set<int>::const_iterator p = neighbors.begin(); p != neighbors.end(); ++p){
+            if(i < *p){
+                queue.push(d.evaluate(i, *p));
+            }
+        }
+    }
+
+    const double concavityLimit = maxConcavity * d.diagonal;
+    int numClusters = numTriangles;
+
+    while(!queue.empty()){
+        const MergeCandidate candidate = queue.top();
+        queue.pop();
+        const int ia = candidate.cluster[0];
+        const int ib = candidate.cluster[1];
+        const Cluster& a = d.clusters[ia];
+        const Cluster& b = d.clusters[ib];
+        if(!a.isAlive || !b.isAlive || a.stamp != candidate.stamp[0] || b.stamp != candidate.stamp[1]){
+            continue;
+        }
+        if(candidate.concavity > concavityLimit && (maxNumHulls <= 0 || numClusters <= maxNumHulls)){
+            break;
+        }
+        d.computeMergedHull(a, b);
+        d.merge(ia, ib, candidate.concavity);
+        --numClusters;
+
+        const std::set<int> neighbors(d.clusters[ia].neighbors);
+        for(std::set<int>::const_iterator p = neighbors.begin(); p != neighbors.end(); ++p){
+            queue.push(d.evaluate(ia, *p));
+        }
+    }
+
+    // the disconnected parts are merged into the nearest ones from the smallest one
+    while(maxNumHulls > 0 && numClusters > maxNumHulls){
+        int smallest = -1;
+        for(int i=0; i < numTriangles; ++i){
+            if(d.clusters[i].isAlive && (smallest < 0 || d.clusters[i].area < d.clusters[smallest].area)){
+                smallest = i;
+            }
+        }
+        std::vector<Vector3> centers(numTriangles);
+        for(int i=0; i < numTriangles; ++i){
+            const Cluster& c = d.clusters[i];
+            if(c.isAlive){
+                centers[i].setZero();
+                for(size_t j=0; j < c.hullVertices.size(); ++j){
+                    centers[i] += c.hullVertices[j];
+                }
+                centers[i] /= c.hullVertices.size();
+            }
+        }
+        int nearest = -1;
+        double minDistance = std::numeric_limits<double>::max();
+        for(int i=0; i < numTriangles; ++i){
+            if(i != smallest && d.clusters[i].isAlive){
+                const double distance = (centers[i] - centers[smallest]).squaredNorm();
+                if(distance < minDistance){
+                    minDistance = distance;
+                    nearest = i;
+                }
+            }
+        }
+        d.computeMergedHull(d.clusters[nearest], d.clusters[smallest]);
+        d.merge(nearest, smallest, std::max(d.clusters[nearest].concavity, d.clusters[smallest].concavity));
+        --numClusters;
+    }
+
+    for(int i=0; i < numTriangles; ++i){
+        Cluster& c = d.clusters[i];
+        if(c.isAlive){
+            if(c.triangles.size() == 1){
+                // the hull vertices of a single triangle may be duplicated
+                computeConvexHull(c.hullVertices, d.eps, d.hull);
+                c.hullVertices = d.hull.vertices;
+            }
+            out_hulls.push_back(std::vector<Vector3>());
+            out_hulls.back().swap(c.hullVertices);
+            reduceHullVertices(out_hulls.back(), maxNumHullVertices);
+        }
+    }
+}
+
+
+std::string ConvexDecomposition::cacheFileName(const std::vector<Vector3>& vertices, const std::vector<int>& triangles) const
+{
+    boost::uint64_t h = 14695981039346656037ULL;
+    for(size_t i=0; i < vertices.size(); ++i){
+        const double v[3] = { vertices[i].x(), vertices[i].y(), vertices[i].z() };
+        hashBytes(h, v, sizeof(v));
+    }
+    if(!triangles.empty()){
+        hashBytes(h, &triangles[0], triangles.size() * sizeof(int));
+    }
+    hashBytes(h, &maxNumHulls, sizeof(maxNumHulls));
+    hashBytes(h, &maxConcavity, sizeof(maxConcavity));
+    hashBytes(h, &maxNumHullVertices, sizeof(maxNumHullVertices));
+    hashBytes(h, &hullFileVersion, sizeof(hullFileVersion));
+
+    char name[32];
+    sprintf(name, "%016llx.hull", (unsigned long long)h);
+    return name;
+}
+
+
+/**
+   The hulls are written to a temporary file and renamed so that another process
+   sharing the cache directory does not read a file being written.
+*/
+bool ConvexDecomposition::saveHulls(const std::string& filename, const std::vector< std::vector<Vector3> >& hulls)
+{
+    std::ostringstream tmp;
+    tmp << filename << ".tmp" << getpid();
+    const std::string tmpFilename = tmp.str();
+
+    std::ofstream ofs(tmpFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!ofs){
+        return false;
+    }
+    ofs.write(hullFileMagic, sizeof(hullFileMagic));
+    ofs.write(reinterpret_cast<const char*>(&hullFileVersion), sizeof(hullFileVersion));
+    const boost::int32_t numHulls = hulls.size();
+    ofs.write(reinterpret_cast<const char*>(&numHulls), sizeof(numHulls));
+    for(size_t i=0; i < hulls.size(); ++i){
+        const std::vector<Vector3>& hull = hulls[i];
+        const boost::int32_t numVertices = hull.size();
+        ofs.write(reinterpret_cast<const char*>(&numVertices), sizeof(numVertices));
+        for(size_t j=0; j < hull.size(); ++j){
+            const double v[3] = { hull[j].x(), hull[j].y(), hull[j].z() };
+            ofs.write(reinterpret_cast<const char*>(v), sizeof(v));
+        }
+    }
+    ofs.close();
+    if(ofs.fail()){
+        remove(tmpFilename.c_str());
+        return false;
+    }
+    try {
+        boost::filesystem::rename(tmpFilename, filename);
+    } catch(const boost::filesystem::filesystem_error&){
+        remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+bool ConvexDecomposition::loadHulls(const std::string& filename, std::vector< std::vector<Vector3> >& out_hulls)
+{
+    out_hulls.clear();
+
+    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+    if(!ifs){
+        return false;
+    }
+    char magic[4];
+    boost::int32_t version, numHulls;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    ifs.read(reinterpret_cast<char*>(&numHulls), sizeof(numHulls));
+    if(!ifs || !std::equal(magic, magic + 4, hullFileMagic) || version != hullFileVersion || numHulls < 0){
+        return false;
+    }
+    out_hulls.resize(numHulls);
+    for(int i=0; i < numHulls; ++i){
+        boost::int32_t numVertices;
+        ifs.read(reinterpret_cast<char*>(&numVertices), sizeof(numVertices));
+        if(!ifs || numVertices <= 0){
+            out_hulls.clear();
+            return false;
+        }
+        std::vector<double> data(numVertices * 3);
+        ifs.read(reinterpret_cast<char*>(&data[0]), data.size() * sizeof(double));
+        if(!ifs){
+            out_hulls.clear();
+            return false;
+        }
+        std::vector<Vector3>& hull = out_hulls[i];
+        hull.resize(numVertices);
+        for(int j=0; j < numVertices; ++j){
+            hull[j] = Vector3(data[j * 3], data[j * 3 + 1], data[j * 3 + 2]);
+        }
+    }
+    return true;
+}
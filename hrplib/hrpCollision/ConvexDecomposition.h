@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ConvexDecomposition.h
+  @brief Approximate convex decomposition of the triangle meshes for the collision detection
+
+  The decomposition follows the hierarchical approach of HACD (Mamou and Ghorbel).
+  Each triangle is a cluster at first, and the pair of the adjacent clusters whose
+  merged cluster has the smallest concavity is merged repeatedly. The concavity of a
+  cluster is the largest distance from a point of its surface to the boundary of its
+  convex hull along the normal of the surface. The merge stops when the concavity
+  exceeds the limit and the number of the clusters is within the limit.
+*/
+
+#ifndef HRPCOLLISION_CONVEX_DECOMPOSITION_H_INCLUDED
+#define HRPCOLLISION_CONVEX_DECOMPOSITION_H_INCLUDED
+
+#include "config.h"
+#include <vector>
+#include <string>
+#include <hrpUtil/Eigen3d.h>
+
+namespace hrp
+{
+    class HRP_COLLISION_EXPORT ConvexDecomposition
+    {
+      public:
+        ConvexDecomposition();
+
+        /**
+           The clusters are merged until the number of them is reduced to this value
+           even if the concavity exceeds the limit. The disconnected parts of the mesh
+           are also merged into one hull in that case.
+        */
+        void setMaxNumHulls(int n) { maxNumHulls = n; }
+
+        /**
+           The limit of the concavity, which is the ratio to the diagonal of the bounding box
+           of the mesh.
+        */
+        void setMaxConcavity(double ratio) { maxConcavity = ratio; }
+
+        /**
+           The vertices of a hull are reduced to this number by keeping the extreme points
+           in the directions distributed uniformly. The reduction is also applied to the
+           clusters during the merges, so zero, which means no limit, makes the decomposition
+           of a large mesh very slow.
+        */
+        void setMaxNumHullVertices(int n) { maxNumHullVertices = n; }
+
+        /**
+           @param vertices the vertices of the mesh
+           @param triangles the three vertex indices of each triangle
+           @param out_hulls the vertices of the convex hulls
+        */
+        void apply(const std::vector<Vector3>& vertices, const std::vector<int>& triangles,
+                   std::vector< std::vector<Vector3> >& out_hulls) const;
+
+        /**
+           @return the name of the cache file of the hulls, which is the hash of the mesh
+           and the parameters in hexadecimal
+        */
+        std::string cacheFileName(const std::vector<Vector3>& vertices, const std::vector<int>& triangles) const;
+
+        static bool saveHulls(const std::string& filename, const std::vector< std::vector<Vector3> >& hulls);
+
+        /**
+           @return false if the file does not exist or it is broken
+        */
+        static bool loadHulls(const std::string& filename, std::vector< std::vector<Vector3> >& out_hulls);
+
+      private:
+        int maxNumHulls;
+        double maxConcavity;
+        int maxNumHullVertices;
+    };
+};
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ConvexHullCollider.cpp
+*/
+
+#include "ConvexHullCollider.h"
+
+#include <set>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace hrp;
+
+
+namespace {
+
+    const int maxNumGjkIterations = 64;
+    const int maxNumEpaIterations = 64;
+
+    // the tolerance of the distances in meters
+    const double tolerance = 1.0e-9;
+    const double epaTolerance = 1.0e-6;
+
+    class PlacedHull
+    {
+    public:
+        PlacedHull(const std::vector<Vector3>& vertices, const Matrix33& R, const Vector3& p)
+            : vertices(vertices), R(R), p(p) { }
+
+        Vector3 support(const Vector3& dir) const {
+            const Vector3 localDir(R.transpose() * dir);
+            int best = 0;
+            double maxDot = -std::numeric_limits<double>::max();
+            for(size_t i=0; i < vertices.size(); ++i){
+                const double d = localDir.dot(vertices[i]);
+                if(d > maxDot){
+                    maxDot = d;
+                    best = i;
+                }
+            }
+            return R * vertices[best] + p;
+        }
+
+    private:
+        const std::vector<Vector3>& vertices;
+        const Matrix33& R;
+        const Vector3& p;
+    };
+
+
+    /// a point of the Minkowski difference hull0 - hull1
+    struct SupportPoint
+    {
+        Vector3 w;
+        Vector3 a;
+        Vector3 b;
+    };
+
+    inline void calcSupport(const PlacedHull& hull0, const PlacedHull& hull1, const Vector3& dir, SupportPoint& out_s)
+    {
+        out_s.a = hull0.support(dir);
+        out_s.b = hull1.support(-dir);
+        out_s.w = out_s.a - out_s.b;
+    }
+
+
+    /**
+       the closest point of the triangle to the origin (Ericson, Real-Time Collision Detection 5.1.5).
+       The triangle is reduced to the vertices of the feature which has the closest point.
+    */
+    Vector3 closestPointOfTriangle(SupportPoint* s, int& io_n)
+    {
+        const Vector3 a(s[0].w), b(s[1].w), c(s[2].w);
+        const Vector3 ab(b - a), ac(c - a);
+
+        const double d1 = ab.dot(-a);
+        const double d2 = ac.dot(-a);
+        if(d1 <= 0.0 && d2 <= 0.0){
+            io_n = 1;
+            return a;
+        }
+        const double d3 = ab.dot(-b);
+        const double d4 = ac.dot(-b);
+        if(d3 >= 0.0 && d4 <= d3){
+            s[0] = s[1];
+            io_n = 1;
+            return b;
+        }
+        const double vc = d1 * d4 - d3 * d2;
+        if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+            io_n = 2;
+            return a + (d1 / (d1 - d3)) * ab;
+        }
+        const double d5 = ab.dot(-c);
+        const double d6 = ac.dot(-c);
+        if(d6 >= 0.0 && d5 <= d6){
+            s[0] = s[2];
+            io_n = 1;
+            return c;
+        }
+        const double vb = d5 * d2 - d1 * d6;
+        if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+            s[1] = s[2];
+            io_n = 2;
+            return a + (d2 / (d2 - d6)) * ac;
+        }
+        const double va = d3 * d6 - d5 * d4;
+        if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+            s[0] = s[2];
+            io_n = 2;
+            return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+        }
+        const double denom = va + vb + vc;
+        if(fabs(denom) < std::numeric_limits<double>::min()){
+            io_n = 1;
+            return a;
+        }
+        io_n = 3;
+        return a + (vb / denom) * ab + (vc / denom) * ac;
+    }
+
+
+    /**
+       the closest point of the simplex to the origin.
+       The simplex is reduced to the vertices of the feature which has the closest point.
+    */
+    Vector3 closestPointOfSimplex(SupportPoint* s, int& io_n)
+    {
+        if(io_n == 1){
+            return s[0].w;
+
+        } else if(io_n == 2){
+            const Vector3 ab(s[1].w - s[0].w);
+            const double len2 = ab.squaredNorm();
+            const double t = (len2 > 0.0) ? (-s[0].w.dot(ab) / len2) : 0.0;
+            if(t <= 0.0){
+                io_n = 1;
+                return s[0].w;
+            } else if(t >= 1.0){
+                s[0] = s[1];
+                io_n = 1;
+                return s[0].w;
+            }
+            return s[0].w + t * ab;
+
+        } else if(io_n == 3){
+            return closestPointOfTriangle(s, io_n);
+        }
+
+        // tetrahedron
+        static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+        bool isInside = true;
+        double minDistance = std::numeric_limits<double>::max();
+        Vector3 closest(Vector3::Zero());
+        SupportPoint best[3];
+        int bestN = 0;
+
+        for(int i=0; i < 4; ++i){
+            const int* f = faces[i];
+            const Vector3& a = s[f[0]].w;
+            const Vector3 n((s[f[1]].w - a).cross(s[f[2]].w - a));
+            const double sideOfOrigin = n.dot(-a);
+            const double sideOfOpposite = n.dot(s[f[3]].w - a);
+            // the face is checked if the origin is outside of it or the tetrahedron is degenerate
+            if(sideOfOrigin * sideOfOpposite < 0.0 || fabs(sideOfOpposite) < std::numeric_limits<double>::min()){
+                isInside = false;
+                SupportPoint t[3] = { s[f[0]], s[f[1]], s[f[2]] };
+                int m = 3;
+                const Vector3 q(closestPointOfTriangle(t, m));
+                const double distance = q.squaredNorm();
+                if(distance < minDistance){
+                    minDistance = distance;
+                    closest = q;
+                    for(int k=0; k < m; ++k){
+                        best[k] = t[k];
+                    }
+                    bestN = m;
+                }
+            }
+        }
+        if(isInside){
+            return Vector3::Zero();
+        }
+        for(int k=0; k < bestN; ++k){
+            s[k] = best[k];
+        }
+        io_n = bestN;
+        return closest;
+    }
+
+
+    /**
+       @return true if the origin is in the Minkowski difference, where
+       the simplex which contains the origin is given by io_simplex
+    */
+    bool gjk(const PlacedHull& hull0, const PlacedHull& hull1, const Vector3& initialDirection,
+             SupportPoint* io_simplex, int& out_n)
+    {
+        SupportPoint* s = io_simplex;
+        calcSupport(hull0, hull1, initialDirection, s[0]);
+        int n = 1;
+        Vector3 v(s[0].w);
+
+        for(int i=0; i < maxNumGjkIterations; ++i){
+            const double vv = v.squaredNorm();
+            if(vv <= tolerance * tolerance){
+                out_n = n;
+                return true;
+            }
+            SupportPoint w;
+            calcSupport(hull0, hull1, -v, w);
+            // a separating plane is found, or the distance does not decrease any more
+            if(v.dot(w.w) > 0.0 || vv - v.dot(w.w) <= 1.0e-12 * vv){
+                return false;
+            }
+            for(int k=0; k < n; ++k){
+                if((s[k].w - w.w).squaredNorm() <= tolerance * tolerance){
+                    return false;
+                }
+            }
+            s[n++] = w;
+            v = closestPointOfSimplex(s, n);
+        }
+        out_n = n;
+        return v.squaredNorm() <= epaTolerance * epaTolerance;
+    }
+
+
+    /**
+       extends the simplex given by GJK to a tetrahedron
+    */
+    bool makeTetrahedron(const PlacedHull& hull0, const PlacedHull& hull1, SupportPoint* io_simplex, int& io_n)
+    {
+        SupportPoint* s = io_simplex;
+
+        if(io_n == 1){
+            static const double axes[6][3] = {
+                { 1.0, 0.0, 0.0 }, { -1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 },
+                { 0.0, -1.0, 0.0 }, { 0.0, 0.0, 1.0 }, { 0.0, 0.0, -1.0 } };
+            for(int i=0; i < 6 && io_n == 1; ++i){
+                calcSupport(hull0, hull1, Vector3(axes[i][0], axes[i][1], axes[i][2]), s[1]);
+                if((s[1].w - s[0].w).norm() > epaTolerance){
+                    io_n = 2;
+                }
+            }
+            if(io_n == 1) return false;
+        }
+
+        if(io_n == 2){
+            const Vector3 d((s[1].w - s[0].w).normalized());
+            // a vector perpendicular to d
+            Vector3 u(d.cross(Vector3(1.0, 0.0, 0.0)));
+            if(u.squaredNorm() < 1.0e-6){
+                u = d.cross(Vector3(0.0, 1.0, 0.0));
+            }
+            u.normalize();
+            const Vector3 v(d.cross(u));
+            for(int i=0; i < 6 && io_n == 2; ++i){
+                const double angle = i * (2.0 * 3.14159265358979323846 / 6.0);
+                calcSupport(hull0, hull1, cos(angle) * u + sin(angle) * v, s[2]);
+                const Vector3 r(s[2].w - s[0].w);
+                if((r - r.dot(d) * d).norm() > epaTolerance){
+                    io_n = 3;
+                }
+            }
+            if(io_n == 2) return false;
+        }
+
+        if(io_n == 3){
+            const Vector3 n((s[1].w - s[0].w).cross(s[2].w - s[0].w).normalized());
+            calcSupport(hull0, hull1, n, s[3]);
+            if(fabs(n.dot(s[3].w - s[0].w)) <= epaTolerance){
+                calcSupport(hull0, hull1, -n, s[3]);
+                if(fabs(n.dot(s[3].w - s[0].w)) <= epaTolerance){
+                    return false;
+                }
+            }
+            io_n = 4;
+        }
+
+        return true;
+    }
+
+
+    struct EpaFace
+    {
+        int v[3];
+        Vector3 normal;
+        double distance;
+        bool isAlive;
+    };
+
+    void setEpaFace(const std::vector<SupportPoint>& points, int a, int b, int c, EpaFace& out_face)
+    {
+        out_face.v[0] = a;
+        out_face.v[1] = b;
+        out_face.v[2] = c;
+        Vector3 n((points[b].w - points[a].w).cross(points[c].w - points[a].w));
+        const double len = n.norm();
+        if(len > std::numeric_limits<double>::min()){
+            out_face.normal = n / len;
+            out_face.distance = out_face.normal.dot(points[a].w);
+        } else {
+            // a degenerate face is never selected as the closest one
+            out_face.normal.setZero();
+            out_face.distance = std::numeric_limits<double>::max();
+        }
+        out_face.isAlive = true;
+    }
+
+
+    /**
+       expands the polytope in the Minkowski difference until its closest face to the origin
+       reaches the boundary
+    */
+    bool epa(const PlacedHull& hull0, const PlacedHull& hull1, const SupportPoint* simplex,
+             Vector3& out_normal, double& out_depth, Vector3& out_point)
+    {
+        std::vector<SupportPoint> points(simplex, simplex + 4);
+        std::vector<EpaFace> faces(4);
+        const int tetraFaces[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+        const Vector3 center((points[0].w + points[1].w + points[2].w + points[3].w) / 4.0);
+        for(int i=0; i < 4; ++i){
+            const int* f = tetraFaces[i];
+            setEpaFace(points, f[0], f[1], f[2], faces[i]);
+            if(faces[i].normal.dot(center - points[f[0]].w) > 0.0){
+                setEpaFace(points, f[0], f[2], f[1], faces[i]);
+            }
+        }
+
+        int closest = -1;
+        std::set< std::pair<int, int> > edges;
+
+        for(int i=0; i < maxNumEpaIterations; ++i){
+            closest = -1;
+            for(size_t j=0; j < faces.size(); ++j){
+                if(faces[j].isAlive && (closest < 0 || faces[j].distance < faces[closest].distance)){
+                    closest = j;
+                }
+            }
+            if(closest < 0 || faces[closest].distance == std::numeric_limits<double>::max()){
+                return false;
+            }
+            const Vector3 normal(faces[closest].normal);
+            SupportPoint s;
+            calcSupport(hull0, hull1, normal, s);
+            if(s.w.dot(normal) - faces[closest].distance <= epaTolerance){
+                break;
+            }
+            const int index = points.size();
+            points.push_back(s);
+
+            edges.clear();
+            for(size_t j=0; j < faces.size(); ++j){
+                EpaFace& face = faces[j];
+                if(face.isAlive && face.normal.dot(s.w - points[face.v[0]].w) > 0.0){
+                    face.isAlive = false;
+                    for(int k=0; k < 3; ++k){
+                        edges.insert(std::make_pair(face.v[k], face.v[(k + 1) % 3]));
+                    }
+                }
+            }
+            if(edges.empty()){
+                break;
+            }
+            for(std::set< std::pair<int, int> >::iterator it = edges.begin(); it != edges.end(); ++it){
+                if(edges.find(std::make_pair(it->second, it->first)) == edges.end()){
+                    EpaFace face;
+                    setEpaFace(points, it->first, it->second, index, face);
+                    faces.push_back(face);
+                }
+            }
+        }
+
+        const EpaFace& face = faces[closest];
+        out_normal = face.normal;
+        out_depth = face.distance;
+        if(!(out_depth > 0.0)){
+            return false;
+        }
+
+        // the barycentric coordinates of the projection of the origin on the face
+        const SupportPoint& a = points[face.v[0]];
+        const SupportPoint& b = points[face.v[1]];
+        const SupportPoint& c = points[face.v[2]];
+        const Vector3 q(out_depth * out_normal);
+        const Vector3 e0(b.w - a.w), e1(c.w - a.w), e2(q - a.w);
+        const double d00 = e0.dot(e0), d01 = e0.dot(e1), d11 = e1.dot(e1);
+        const double d20 = e2.dot(e0), d21 = e2.dot(e1);
+        const double denom = d00 * d11 - d01 * d01;
+        double u, v, w;
+        if(fabs(denom) > std::numeric_limits<double>::min()){
+            v = (d11 * d20 - d01 * d21) / denom;
+            w = (d00 * d21 - d01 * d20) / denom;
+            u = 1.0 - v - w;
+        } else {
+            u = v = w = 1.0 / 3.0;
+        }
+        const Vector3 pointA(u * a.a + v * b.a + w * c.a);
+        const Vector3 pointB(u * a.b + v * b.b + w * c.b);
+        out_point = (pointA + pointB) / 2.0;
+
+        return true;
+    }
+}
+
+
+bool hrp::collideConvexHulls(const std::vector<Vector3>& hull0, const Matrix33& R0, const Vector3& p0,
+                             const std::vector<Vector3>& hull1, const Matrix33& R1, const Vector3& p1,
+                             Vector3& out_normal, double& out_depth, Vector3& out_point)
+{
+    if(hull0.empty() || hull1.empty()){
+        return false;
+    }
+
+    const PlacedHull placedHull0(hull0, R0, p0);
+    const PlacedHull placedHull1(hull1, R1, p1);
+
+    Vector3 direction(R0 * hull0[0] + p0 - R1 * hull1[0] - p1);
+    if(direction.squaredNorm() <= tolerance * tolerance){
+        direction = Vector3(1.0, 0.0, 0.0);
+    }
+
+    SupportPoint simplex[4];
+    int n;
+    if(!gjk(placedHull0, placedHull1, direction, simplex, n)){
+        return false;
+    }
+    // the hulls which just touch each other are not regarded as penetrating
+    if(!makeTetrahedron(placedHull0, placedHull1, simplex, n)){
+        return false;
+    }
+    return epa(placedHull0, placedHull1, simplex, out_normal, out_depth, out_point);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ConvexHullCollider.h
+  @brief Collision detection between convex hulls by GJK and EPA
+*/
+
+#ifndef HRPCOLLISION_CONVEX_HULL_COLLIDER_H_INCLUDED
+#define HRPCOLLISION_CONVEX_HULL_COLLIDER_H_INCLUDED
+
+#include <vector>
+#include <hrpUtil/Eigen3d.h>
+
+namespace hrp
+{
+    /**
+       checks the intersection of two convex hulls placed at (R0, p0) and (R1, p1) by GJK,
+       and computes the penetration by EPA if they intersect.
+       @param hull0, hull1 the vertices of the hulls
+       @param out_normal the unit vector from hull0 to hull1, along which hull1 must be moved
+       by out_depth to separate them
+       @param out_point the middle of the deepest points of the hulls
+       @return true if the hulls penetrate each other
+    */
+    bool collideConvexHulls(const std::vector<Vector3>& hull0, const Matrix33& R0, const Vector3& p0,
+                            const std::vector<Vector3>& hull1, const Matrix33& R1, const Vector3& p1,
+                            Vector3& out_normal, double& out_depth, Vector3& out_point);
+};
+
+#endif
@@ -0,0 +1,857 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+#include "BinaryModelFile.h"
+#include "ModelLoaderUtil.h"
+#include "Link.h"
+#include <hrpCollision/ColdetModel.h>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <boost/cstdint.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace hrp;
+using namespace OpenHRP;
+
+
+namespace {
+
+    const char magic[8] = { 'H', 'R', 'P', 'B', 'M', 'D', 'L', '\0' };
+    const boost::uint32_t fileVersion = 2;
+
+    enum { HAS_COLLISION_MESHES = 1, HAS_SCENE_SHAPE_INDICES = 2, HAS_USER_DATA = 4 };
+
+    struct FileHeader
+    {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t flags;
+    };
+
+    struct FormatError { };
+
+
+    class Writer
+    {
+    public:
+        std::vector<char> buf;
+
+        void putBytes(const void* p, size_t size) {
+            const char* c = static_cast<const char*>(p);
+            buf.insert(buf.end(), c, c + size);
+        }
+
+        template <class T> void put(const T& value) { putBytes(&value, sizeof(T)); }
+
+        void putCount(size_t n) { put(static_cast<boost::uint32_t>(n)); }
+
+        void align() { buf.resize((buf.size() + 7) & ~static_cast<size_t>(7), 0); }
+
+        void putString(const char* s) {
+            size_t n = s ? strlen(s) : 0;
+            putCount(n);
+            putBytes(s, n);
+        }
+
+        template <class T> void putArray(const T* values, size_t n) {
+            putCount(n);
+            align();
+            putBytes(values, n * sizeof(T));
+        }
+
+        /// for the sequences of numbers
+        template <class Seq> void putValues(const Seq& seq) {
+            CORBA::ULong n = seq.length();
+            putCount(n);
+            align();
+            if(n > 0){
+                putBytes(&seq[0], n * sizeof(seq[0]));
+            }
+        }
+
+        /// the elements of an array sequence are accessed by the slices
+        void putMatrices(const DblArray12Sequence& seq) {
+            CORBA::ULong n = seq.length();
+            putCount(n);
+            align();
+            for(CORBA::ULong i=0; i < n; ++i){
+                putBytes(seq[i], sizeof(DblArray12));
+            }
+        }
+
+        /// for the sequences of structures
+        template <class Seq> void putElements(const Seq& seq) {
+            CORBA::ULong n = seq.length();
+            putCount(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                putElement(seq[i]);
+            }
+        }
+
+        void putElement(const TransformedShapeIndex& tsi);
+        void putElement(const TransformedShapeIndexSequence& seq) { putElements(seq); }
+        void putElement(const SensorInfo& info);
+        void putElement(const HwcInfo& info);
+        void putElement(const LightInfo& info);
+        void putElement(const SegmentInfo& info);
+        void putElement(const LinkInfo& info);
+        void putElement(const ExtraJointInfo& info);
+        void putElement(const ShapeInfo& info);
+        void putElement(const AppearanceInfo& info);
+        void putElement(const MaterialInfo& info);
+        void putElement(const TextureInfo& info);
+
+        void putStrings(const StringSequence& seq) {
+            putCount(seq.length());
+            for(CORBA::ULong i=0; i < seq.length(); ++i){
+                putString(seq[i]);
+            }
+        }
+    };
+
+
+    class Reader
+    {
+    public:
+        Reader(const char* data, size_t size) : top(data), pos(data), end(data + size) { }
+
+        void getBytes(void* p, size_t size) {
+            if(static_cast<size_t>(end - pos) < size){
+                throw FormatError();
+            }
+            memcpy(p, pos, size);
+            pos += size;
+        }
+
+        template <class T> void get(T& out_value) { getBytes(&out_value, sizeof(T)); }
+
+        CORBA::ULong getCount() {
+            boost::uint32_t n;
+            get(n);
+            return n;
+        }
+
+        void align() {
+            size_t offset = pos - top;
+            size_t aligned = (offset + 7) & ~static_cast<size_t>(7);
+            if(aligned > static_cast<size_t>(end - top)){
+                throw FormatError();
+            }
+            pos = top + aligned;
+        }
+
+        char* getString() {
+            CORBA::ULong n = getCount();
+            if(static_cast<size_t>(end - pos) < n){
+                throw FormatError();
+            }
+            char* s = CORBA::string_alloc(n);
+            memcpy(s, pos, n);
+            s[n] = '\0';
+            pos += n;
+            return s;
+        }
+
+        std::string getStdString() {
+            CORBA::String_var s = getString();
+            return std::string(s.in());
+        }
+
+        template <class T> void getArray(std::vector<T>& out_values) {
+            CORBA::ULong n = getCount();
+            align();
+            checkSize(n, sizeof(T));
+            out_values.resize(n);
+            if(n > 0){
+                getBytes(&out_values[0], n * sizeof(T));
+            }
+        }
+
+        template <class Seq> void getValues(Seq& seq) {
+            CORBA::ULong n = getCount();
+            align();
+            checkSize(n, sizeof(seq[0]));
+            seq.length(n);
+            if(n > 0){
+                getBytes(&seq[0], n * sizeof(seq[0]));
+            }
+        }
+
+        void getMatrices(DblArray12Sequence& seq) {
+            CORBA::ULong n = getCount();
+            align();
+            checkSize(n, sizeof(DblArray12));
+            seq.length(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                getBytes(seq[i], sizeof(DblArray12));
+            }
+        }
+
+        template <class Seq> void getElements(Seq& seq) {
+            CORBA::ULong n = getCount();
+            checkSize(n, 1);
+            seq.length(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                getElement(seq[i]);
+            }
+        }
+
+        void getElement(TransformedShapeIndex& tsi);
+        void getElement(TransformedShapeIndexSequence& seq) { getElements(seq); }
+        void getElement(SensorInfo& info);
+        void getElement(HwcInfo& info);
+        void getElement(LightInfo& info);
+        void getElement(SegmentInfo& info);
+        void getElement(LinkInfo& info);
+        void getElement(ExtraJointInfo& info);
+        void getElement(ShapeInfo& info);
+        void getElement(AppearanceInfo& info);
+        void getElement(MaterialInfo& info);
+        void getElement(TextureInfo& info);
+
+        void getStrings(StringSequence& seq) {
+            CORBA::ULong n = getCount();
+            checkSize(n, sizeof(boost::uint32_t));
+            seq.length(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                seq[i] = getString();
+            }
+        }
+
+    private:
+        const char* top;
+        const char* pos;
+        const char* end;
+
+        // prevents huge allocations for broken files
+        void checkSize(CORBA::ULong n, size_t elementSize) {
+            if(static_cast<size_t>(end - pos) / elementSize < n){
+                throw FormatError();
+            }
+        }
+    };
+
+
+    void Writer::putElement(const TransformedShapeIndex& tsi)
+    {
+        putBytes(tsi.transformMatrix, sizeof(DblArray12));
+        put(static_cast<boost::int16_t>(tsi.inlinedShapeTransformMatrixIndex));
+        put(static_cast<boost::int16_t>(tsi.shapeIndex));
+    }
+
+
+    void Reader::getElement(TransformedShapeIndex& tsi)
+    {
+        boost::int16_t value;
+        getBytes(tsi.transformMatrix, sizeof(DblArray12));
+        get(value); tsi.inlinedShapeTransformMatrixIndex = value;
+        get(value); tsi.shapeIndex = value;
+    }
+
+
+    void Writer::putElement(const SensorInfo& info)
+    {
+        putString(info.type);
+        putString(info.name);
+        put(static_cast<boost::int32_t>(info.id));
+        putBytes(info.translation, sizeof(DblArray3));
+        putBytes(info.rotation, sizeof(DblArray4));
+        putValues(info.specValues);
+        putString(info.specFile);
+        putElements(info.shapeIndices);
+        putMatrices(info.inlinedShapeTransformMatrices);
+    }
+
+
+    void Reader::getElement(SensorInfo& info)
+    {
+        boost::int32_t id;
+        info.type = getString();
+        info.name = getString();
+        get(id); info.id = id;
+        getBytes(info.translation, sizeof(DblArray3));
+        getBytes(info.rotation, sizeof(DblArray4));
+        getValues(info.specValues);
+        info.specFile = getString();
+        getElements(info.shapeIndices);
+        getMatrices(info.inlinedShapeTransformMatrices);
+    }
+
+
+    void Writer::putElement(const HwcInfo& info)
+    {
+        putString(info.name);
+        put(static_cast<boost::int32_t>(info.id));
+        putBytes(info.translation, sizeof(DblArray3));
+        putBytes(info.rotation, sizeof(DblArray4));
+        putString(info.url);
+        putElements(info.shapeIndices);
+        putMatrices(info.inlinedShapeTransformMatrices);
+    }
+
+
+    void Reader::getElement(HwcInfo& info)
+    {
+        boost::int32_t id;
+        info.name = getString();
+        get(id); info.id = id;
+        getBytes(info.translation, sizeof(DblArray3));
+        getBytes(info.rotation, sizeof(DblArray4));
+        info.url = getString();
+        getElements(info.shapeIndices);
+        getMatrices(info.inlinedShapeTransformMatrices);
+    }
+
+
+    void Writer::putElement(const LightInfo& info)
+    {
+        putString(info.name);
+        put(static_cast<boost::int32_t>(info.type));
+        putBytes(info.transformMatrix, sizeof(DblArray12));
+        put(static_cast<double>(info.ambientIntensity));
+        putBytes(info.attenuation, sizeof(DblArray3));
+        putBytes(info.color, sizeof(DblArray3));
+        put(static_cast<double>(info.intensity));
+        putBytes(info.location, sizeof(DblArray3));
+        put(static_cast<boost::uint8_t>(info.on ? 1 : 0));
+        put(static_cast<double>(info.radius));
+        putBytes(info.direction, sizeof(DblArray3));
+        put(static_cast<double>(info.beamWidth));
+        put(static_cast<double>(info.cutOffAngle));
+    }
+
+
+    void Reader::getElement(LightInfo& info)
+    {
+        boost::int32_t type;
+        boost::uint8_t on;
+        info.name = getString();
+        get(type); info.type = static_cast<LightType>(type);
+        getBytes(info.transformMatrix, sizeof(DblArray12));
+        get(info.ambientIntensity);
+        getBytes(info.attenuation, sizeof(DblArray3));
+        getBytes(info.color, sizeof(DblArray3));
+        get(info.intensity);
+        getBytes(info.location, sizeof(DblArray3));
+        get(on); info.on = (on != 0);
+        get(info.radius);
+        getBytes(info.direction, sizeof(DblArray3));
+        get(info.beamWidth);
+        get(info.cutOffAngle);
+    }
+
+
+    void Writer::putElement(const SegmentInfo& info)
+    {
+        putString(info.name);
+        put(static_cast<double>(info.mass));
+        putBytes(info.centerOfMass, sizeof(DblArray3));
+        putBytes(info.inertia, sizeof(DblArray9));
+        putBytes(info.transformMatrix, sizeof(DblArray12));
+        putValues(info.shapeIndices);
+    }
+
+
+    void Reader::getElement(SegmentInfo& info)
+    {
+        info.name = getString();
+        get(info.mass);
+        getBytes(info.centerOfMass, sizeof(DblArray3));
+        getBytes(info.inertia, sizeof(DblArray9));
+        getBytes(info.transformMatrix, sizeof(DblArray12));
+        getValues(info.shapeIndices);
+    }
+
+
+    void Writer::putElement(const LinkInfo& info)
+    {
+        putString(info.name);
+        put(static_cast<boost::int16_t>(info.jointId));
+        putString(info.jointType);
+        put(static_cast<double>(info.jointValue));
+        putBytes(info.jointAxis, sizeof(DblArray3));
+        putValues(info.ulimit);
+        putValues(info.llimit);
+        putValues(info.uvlimit);
+        putValues(info.lvlimit);
+        putValues(info.climit);
+        putBytes(info.translation, sizeof(DblArray3));
+        putBytes(info.rotation, sizeof(DblArray4));
+        put(static_cast<double>(info.mass));
+        putBytes(info.centerOfMass, sizeof(DblArray3));
+        putBytes(info.inertia, sizeof(DblArray9));
+        put(static_cast<double>(info.rotorInertia));
+        put(static_cast<double>(info.rotorResistor));
+        put(static_cast<double>(info.gearRatio));
+        put(static_cast<double>(info.torqueConst));
+        put(static_cast<double>(info.encoderPulse));
+        put(static_cast<boost::int16_t>(info.parentIndex));
+        putValues(info.childIndices);
+        putElements(info.shapeIndices);
+        putElements(info.collisionShapeIndices);
+        put(static_cast<boost::int16_t>(info.AABBmaxDepth));
+        put(static_cast<boost::int16_t>(info.AABBmaxNum));
+        putMatrices(info.inlinedShapeTransformMatrices);
+        putElements(info.sensors);
+        putElements(info.hwcs);
+        putElements(info.segments);
+        putElements(info.lights);
+        putStrings(info.specFiles);
+    }
+
+
+    void Reader::getElement(LinkInfo& info)
+    {
+        boost::int16_t value;
+        info.name = getString();
+        get(value); info.jointId = value;
+        info.jointType = getString();
+        get(info.jointValue);
+        getBytes(info.jointAxis, sizeof(DblArray3));
+        getValues(info.ulimit);
+        getValues(info.llimit);
+        getValues(info.uvlimit);
+        getValues(info.lvlimit);
+        getValues(info.climit);
+        getBytes(info.translation, sizeof(DblArray3));
+        getBytes(info.rotation, sizeof(DblArray4));
+        get(info.mass);
+        getBytes(info.centerOfMass, sizeof(DblArray3));
+        getBytes(info.inertia, sizeof(DblArray9));
+        get(info.rotorInertia);
+        get(info.rotorResistor);
+        get(info.gearRatio);
+        get(info.torqueConst);
+        get(info.encoderPulse);
+        get(value); info.parentIndex = value;
+        getValues(info.childIndices);
+        getElements(info.shapeIndices);
+        getElements(info.collisionShapeIndices);
+        get(value); info.AABBmaxDepth = value;
+        get(value); info.AABBmaxNum = value;
+        getMatrices(info.inlinedShapeTransformMatrices);
+        getElements(info.sensors);
+        getElements(info.hwcs);
+        getElements(info.segments);
+        getElements(info.lights);
+        getStrings(info.specFiles);
+    }
+
+
+    void Writer::putElement(const ExtraJointInfo& info)
+    {
+        putString(info.name);
+        put(static_cast<boost::int32_t>(info.jointType));
+        putBytes(info.axis, sizeof(DblArray3));
+        putString(info.link[0]);
+        putString(info.link[1]);
+        putBytes(info.point, sizeof(DblArray3) * 2);
+    }
+
+
+    void Reader::getElement(ExtraJointInfo& info)
+    {
+        boost::int32_t type;
+        info.name = getString();
+        get(type); info.jointType = static_cast<ExtraJointType>(type);
+        getBytes(info.axis, sizeof(DblArray3));
+        info.link[0] = getString();
+        info.link[1] = getString();
+        getBytes(info.point, sizeof(DblArray3) * 2);
+    }
+
+
+    void Writer::putElement(const ShapeInfo& info)
+    {
+        putString(info.url);
+        put(static_cast<boost::int32_t>(info.primitiveType));
+        putValues(info.primitiveParameters);
+        putValues(info.vertices);
+        putValues(info.triangles);
+        put(static_cast<boost::int32_t>(info.appearanceIndex));
+    }
+
+
+    void Reader::getElement(ShapeInfo& info)
+    {
+        boost::int32_t value;
+        info.url = getString();
+        get(value); info.primitiveType = static_cast<ShapePrimitiveType>(value);
+        getValues(info.primitiveParameters);
+        getValues(info.vertices);
+        getValues(info.triangles);
+        get(value); info.appearanceIndex = value;
+    }
+
+
+    void Writer::putElement(const AppearanceInfo& info)
+    {
+        put(static_cast<boost::int32_t>(info.materialIndex));
+        putValues(info.normals);
+        putValues(info.normalIndices);
+        put(static_cast<boost::uint8_t>(info.normalPerVertex ? 1 : 0));
+        put(static_cast<boost::uint8_t>(info.solid ? 1 : 0));
+        put(static_cast<float>(info.creaseAngle));
+        putValues(info.colors);
+        putValues(info.colorIndices);
+        put(static_cast<boost::uint8_t>(info.colorPerVertex ? 1 : 0));
+        put(static_cast<boost::int32_t>(info.textureIndex));
+        putValues(info.textureCoordinate);
+        putValues(info.textureCoordIndices);
+        putBytes(info.textransformMatrix, sizeof(DblArray9));
+    }
+
+
+    void Reader::getElement(AppearanceInfo& info)
+    {
+        boost::int32_t index;
+        boost::uint8_t flag;
+        get(index); info.materialIndex = index;
+        getValues(info.normals);
+        getValues(info.normalIndices);
+        get(flag); info.normalPerVertex = (flag != 0);
+        get(flag); info.solid = (flag != 0);
+        get(info.creaseAngle);
+        getValues(info.colors);
+        getValues(info.colorIndices);
+        get(flag); info.colorPerVertex = (flag != 0);
+        get(index); info.textureIndex = index;
+        getValues(info.textureCoordinate);
+        getValues(info.textureCoordIndices);
+        getBytes(info.textransformMatrix, sizeof(DblArray9));
+    }
+
+
+    void Writer::putElement(const MaterialInfo& info)
+    {
+        put(static_cast<float>(info.ambientIntensity));
+        putBytes(info.diffuseColor, sizeof(FloatArray3));
+        putBytes(info.emissiveColor, sizeof(FloatArray3));
+        put(static_cast<float>(info.shininess));
+        putBytes(info.specularColor, sizeof(FloatArray3));
+        put(static_cast<float>(info.transparency));
+    }
+
+
+    void Reader::getElement(MaterialInfo& info)
+    {
+        get(info.ambientIntensity);
+        getBytes(info.diffuseColor, sizeof(FloatArray3));
+        getBytes(info.emissiveColor, sizeof(FloatArray3));
+        get(info.shininess);
+        getBytes(info.specularColor, sizeof(FloatArray3));
+        get(info.transparency);
+    }
+
+
+    void Writer::putElement(const TextureInfo& info)
+    {
+        putValues(info.image);
+        put(static_cast<boost::int16_t>(info.numComponents));
+        put(static_cast<boost::int16_t>(info.width));
+        put(static_cast<boost::int16_t>(info.height));
+        put(static_cast<boost::uint8_t>(info.repeatS ? 1 : 0));
+        put(static_cast<boost::uint8_t>(info.repeatT ? 1 : 0));
+        putString(info.url);
+    }
+
+
+    void Reader::getElement(TextureInfo& info)
+    {
+        boost::int16_t value;
+        boost::uint8_t flag;
+        getValues(info.image);
+        get(value); info.numComponents = value;
+        get(value); info.width = value;
+        get(value); info.height = value;
+        get(flag); info.repeatS = (flag != 0);
+        get(flag); info.repeatT = (flag != 0);
+        info.url = getString();
+    }
+
+
+    /**
+       The collision detection models are created by the same code as loadBodyFromBodyInfo()
+       and their vertices and triangles are taken out.
+    */
+    void getCollisionMeshes(BodyInfo_ptr bodyInfo, const LinkInfoSequence& links, vector<BinaryModelCollisionMesh>& out_meshes)
+    {
+        BodyPtr body(new Body());
+        bool loaded = loadBodyFromBodyInfo(body, bodyInfo, true);
+
+        out_meshes.resize(links.length());
+        for(CORBA::ULong i=0; i < links.length(); ++i){
+            ColdetModelPtr model;
+            if(loaded){
+                Link* link = body->link(string(links[i].name));
+                if(link){
+                    model = link->coldetModel;
+                }
+            }
+            int numVertices = model ? model->getNumVertices() : 0;
+            int numTriangles = (numVertices > 0) ? model->getNumTriangles() : 0;
+
+            BinaryModelCollisionMesh& mesh = out_meshes[i];
+            mesh.vertices.resize(numVertices * 3);
+            for(int j=0; j < numVertices; ++j){
+                model->getVertex(j, mesh.vertices[j*3], mesh.vertices[j*3+1], mesh.vertices[j*3+2]);
+            }
+            mesh.triangles.resize(numTriangles * 3);
+            for(int j=0; j < numTriangles; ++j){
+                model->getTriangle(j, mesh.triangles[j*3], mesh.triangles[j*3+1], mesh.triangles[j*3+2]);
+            }
+        }
+    }
+
+
+    /**
+       The file is memory-mapped while the contents are copied.
+    */
+    class MappedFile
+    {
+    public:
+        MappedFile(const std::string& filename) : data(0), size(0) {
+#ifdef _WIN32
+            HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if(file == INVALID_HANDLE_VALUE){
+                return;
+            }
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(file, &fileSize);
+            size = static_cast<size_t>(fileSize.QuadPart);
+            HANDLE mapping = (size > 0) ? CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+            CloseHandle(file);
+            if(mapping){
+                data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping);
+            }
+#else
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if(fd < 0){
+                return;
+            }
+            struct stat st;
+            if(fstat(fd, &st) == 0 && st.st_size > 0){
+                size = st.st_size;
+                void* p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                data = (p != MAP_FAILED) ? static_cast<const char*>(p) : 0;
+            }
+            ::close(fd);
+#endif
+            if(!data){
+                size = 0;
+            }
+        }
+
+        ~MappedFile() {
+            if(data){
+#ifdef _WIN32
+                UnmapViewOfFile(data);
+#else
+                munmap(const_cast<char*>(data), size);
+#endif
+            }
+        }
+
+        const char* data;
+        size_t size;
+    };
+
+
+    bool readHeader(const char* data, size_t size, FileHeader& out_header)
+    {
+        if(!data || size < sizeof(FileHeader)){
+            return false;
+        }
+        memcpy(&out_header, data, sizeof(FileHeader));
+        return (memcmp(out_header.magic, magic, sizeof(magic)) == 0);
+    }
+}
+
+
+bool hrp::writeBinaryModelFile(const std::string& filename, BodyInfo_ptr bodyInfo, bool storeCollisionMeshes)
+{
+    if(CORBA::is_nil(bodyInfo)){
+        return false;
+    }
+
+    BinaryModelData data;
+    CORBA::String_var name = bodyInfo->name();
+    CORBA::String_var url = bodyInfo->url();
+    data.name = name.in();
+    data.url = url.in();
+    data.info = bodyInfo->info();
+    data.links = bodyInfo->links();
+    data.linkShapeIndices = bodyInfo->linkShapeIndices();
+    data.extraJoints = bodyInfo->extraJoints();
+    data.shapes = bodyInfo->shapes();
+    data.appearances = bodyInfo->appearances();
+    data.materials = bodyInfo->materials();
+    data.textures = bodyInfo->textures();
+
+    if(storeCollisionMeshes){
+        getCollisionMeshes(bodyInfo, data.links.in(), data.collisionMeshes);
+    }
+
+    return writeBinaryModelFile(filename, data);
+}
+
+
+bool hrp::writeBinaryModelFile(const std::string& filename, const BinaryModelData& data)
+{
+    Writer writer;
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = fileVersion;
+    header.flags = 0;
+    if(!data.collisionMeshes.empty()){
+        header.flags |= HAS_COLLISION_MESHES;
+    }
+    if(data.isScene){
+        header.flags |= HAS_SCENE_SHAPE_INDICES;
+    }
+    if(!data.userData.empty()){
+        header.flags |= HAS_USER_DATA;
+    }
+    writer.put(header);
+
+    writer.putString(data.name.c_str());
+    writer.putString(data.url.c_str());
+    writer.putStrings(data.info.in());
+    writer.putElements(data.links.in());
+    writer.putElements(data.linkShapeIndices.in());
+    writer.putElements(data.extraJoints.in());
+
+    writer.putElements(data.shapes.in());
+    writer.putElements(data.appearances.in());
+    writer.putElements(data.materials.in());
+    writer.putElements(data.textures.in());
+
+    if(!data.collisionMeshes.empty()){
+        writer.putCount(data.collisionMeshes.size());
+        for(size_t i=0; i < data.collisionMeshes.size(); ++i){
+            const BinaryModelCollisionMesh& mesh = data.collisionMeshes[i];
+            writer.putArray(mesh.vertices.empty() ? 0 : &mesh.vertices[0], mesh.vertices.size());
+            writer.putArray(mesh.triangles.empty() ? 0 : &mesh.triangles[0], mesh.triangles.size());
+        }
+    }
+
+    if(data.isScene){
+        writer.putElements(data.sceneShapeIndices.in());
+    }
+
+    if(!data.userData.empty()){
+        writer.putString(data.userData.c_str());
+    }
+
+    ofstream file(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!file){
+        cerr << "cannot open " << filename << endl;
+        return false;
+    }
+    file.write(&writer.buf[0], writer.buf.size());
+
+    return !file.fail();
+}
+
+
+bool hrp::readBinaryModelFile(const std::string& filename, BinaryModelData& out_data)
+{
+    MappedFile file(filename);
+
+    FileHeader header;
+    if(!readHeader(file.data, file.size, header)){
+        cerr << filename << " is not a binary model file" << endl;
+        return false;
+    }
+    if(header.version != fileVersion){
+        cerr << "The version of " << filename << " is not supported" << endl;
+        return false;
+    }
+
+    Reader reader(file.data, file.size);
+    try {
+        reader.getBytes(&header, sizeof(header));
+
+        out_data.name = reader.getStdString();
+        out_data.url = reader.getStdString();
+        out_data.info = new StringSequence();
+        reader.getStrings(out_data.info.inout());
+        out_data.links = new LinkInfoSequence();
+        reader.getElements(out_data.links.inout());
+        out_data.linkShapeIndices = new AllLinkShapeIndexSequence();
+        reader.getElements(out_data.linkShapeIndices.inout());
+        out_data.extraJoints = new ExtraJointInfoSequence();
+        reader.getElements(out_data.extraJoints.inout());
+
+        out_data.shapes = new ShapeInfoSequence();
+        reader.getElements(out_data.shapes.inout());
+        out_data.appearances = new AppearanceInfoSequence();
+        reader.getElements(out_data.appearances.inout());
+        out_data.materials = new MaterialInfoSequence();
+        reader.getElements(out_data.materials.inout());
+        out_data.textures = new TextureInfoSequence();
+        reader.getElements(out_data.textures.inout());
+
+        out_data.collisionMeshes.clear();
+        if(header.flags & HAS_COLLISION_MESHES){
+            CORBA::ULong n = reader.getCount();
+            if(n != out_data.links->length()){
+                throw FormatError();
+            }
+            out_data.collisionMeshes.resize(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                BinaryModelCollisionMesh& mesh = out_data.collisionMeshes[i];
+                reader.getArray(mesh.vertices);
+                reader.getArray(mesh.triangles);
+            }
+        }
+
+        out_data.isScene = (header.flags & HAS_SCENE_SHAPE_INDICES) != 0;
+        if(out_data.isScene){
+            out_data.sceneShapeIndices = new TransformedShapeIndexSequence();
+            reader.getElements(out_data.sceneShapeIndices.inout());
+        }
+
+        out_data.userData.clear();
+        if(header.flags & HAS_USER_DATA){
+            out_data.userData = reader.getStdString();
+        }
+    } catch(const FormatError&){
+        cerr << filename << " is broken" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool hrp::isBinaryModelFile(const std::string& filename)
+{
+    char buf[sizeof(magic)];
+    ifstream file(filename.c_str(), ios::in | ios::binary);
+    if(!file.read(buf, sizeof(buf))){
+        return false;
+    }
+    return (memcmp(buf, magic, sizeof(magic)) == 0);
+}
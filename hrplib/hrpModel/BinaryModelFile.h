@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief Binary body model file (".hrpb") which can be loaded without parsing and triangulation
+
+   The file holds the whole contents of BodyInfo, that is, the link tree with the inertias,
+   sensors, hwcs, segments and lights, the triangulated shapes, appearances with normals,
+   colors and texture coordinates, materials, textures and extra joints.
+   The collision detection meshes of the links, whose vertices are already transformed into the
+   link local coordinates, can be stored optionally.
+
+   - Header: magic "HRPBMDL", version, flags
+   - Body: name, url, info, links, linkShapeIndices, extraJoints
+   - Shape set: shapes, appearances, materials, textures
+   - Collision meshes (if the flag is set): for each link, vertices and triangles
+   - Scene shape indices (if the flag is set): shapeIndices of SceneInfo
+   - User data (if the flag is set): a string stored by the application which writes the file
+
+   All the values are native-endian. The number of elements precedes each array and
+   the elements of an array of numbers are aligned to 8 bytes, so that the file
+   can be memory-mapped and the arrays can be copied in a block.
+*/
+
+#ifndef HRPMODEL_BINARY_MODEL_FILE_H_INCLUDED
+#define HRPMODEL_BINARY_MODEL_FILE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <hrpCorba/ORBwrap.h>
+#include <hrpCorba/ModelLoader.hh>
+#include "Body.h"
+#include "Config.h"
+
+namespace hrp {
+
+    /**
+       Triangle mesh of a link for the collision detection.
+       The vertices are represented in the link local coordinate.
+    */
+    struct BinaryModelCollisionMesh
+    {
+        std::vector<float> vertices;
+        std::vector<int> triangles;
+    };
+
+    /**
+       Contents of a binary model file
+    */
+    struct BinaryModelData
+    {
+        BinaryModelData() : isScene(false) { }
+
+        std::string name;
+        std::string url;
+        OpenHRP::StringSequence_var info;
+        OpenHRP::LinkInfoSequence_var links;
+        OpenHRP::AllLinkShapeIndexSequence_var linkShapeIndices;
+        OpenHRP::ExtraJointInfoSequence_var extraJoints;
+        OpenHRP::ShapeInfoSequence_var shapes;
+        OpenHRP::AppearanceInfoSequence_var appearances;
+        OpenHRP::MaterialInfoSequence_var materials;
+        OpenHRP::TextureInfoSequence_var textures;
+
+        /// empty if the file does not have collision meshes. Otherwise one mesh per link.
+        std::vector<BinaryModelCollisionMesh> collisionMeshes;
+
+        /// true if the data is the contents of SceneInfo
+        bool isScene;
+        /// shapeIndices of SceneInfo. This is valid only when isScene is true.
+        OpenHRP::TransformedShapeIndexSequence_var sceneShapeIndices;
+
+        /**
+           empty if the file does not have the user data. The model cache stores the validity
+           of the entry here so that the entry is a single file.
+        */
+        std::string userData;
+    };
+
+    /**
+       @param storeCollisionMeshes the collision detection meshes of the links are also written
+       when this is true
+    */
+    HRPMODEL_API bool writeBinaryModelFile(const std::string& filename, OpenHRP::BodyInfo_ptr bodyInfo,
+                                           bool storeCollisionMeshes = false);
+
+    /**
+       writes the data which is not obtained from BodyInfo, such as the contents of SceneInfo.
+       All the sequences must not be null except sceneShapeIndices of the data which is not a scene.
+    */
+    HRPMODEL_API bool writeBinaryModelFile(const std::string& filename, const BinaryModelData& data);
+
+    HRPMODEL_API bool readBinaryModelFile(const std::string& filename, BinaryModelData& out_data);
+
+    HRPMODEL_API bool isBinaryModelFile(const std::string& filename);
+};
+
+#endif
@@ -628,13 +628,28 @@ void Body::clearExternalForces()
 }
 
 
+/**
+   The positions are compared with the ones set in the previous call and
+   only the models of the moved links are updated. The result of the comparison
+   is stored in Link::isColdetModelPositionUpdated.
+   Note that the comparison is done on Link::p and Link::R themselves
+   because they are written directly by various code such as controllers,
+   body customizers and the simulator servers.
+*/
 void Body::updateLinkColdetModelPositions()
 {
     const int n = linkTraverse_.numLinks();
     for(int i=0; i < n; ++i){
         Link* link = linkTraverse_[i];
-        if(link->coldetModel){
+        if(!link->coldetModel){
+            link->isColdetModelPositionUpdated = false;
+        } else if(link->p == link->coldetModelP && link->R == link->coldetModelR){
+            link->isColdetModelPositionUpdated = false;
+        } else {
             link->coldetModel->setPosition(link->segmentAttitude(), link->p);
+            link->coldetModelP = link->p;
+            link->coldetModelR = link->R;
+            link->isColdetModelPositionUpdated = true;
         }
     }
 }
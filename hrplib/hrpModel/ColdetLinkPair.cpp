@@ -28,8 +28,8 @@ namespace hrp {
     ColdetLinkPair::~ColdetLinkPair() { }
         
     void ColdetLinkPair::updatePositions() {
-        model(0)->setPosition(links[0]->R, links[0]->p);
-        model(1)->setPosition(links[1]->R, links[1]->p);
+        links[0]->updateColdetModelPosition();
+        links[1]->updateColdetModelPosition();
     }
         
     hrp::Link* ColdetLinkPair::link(int index) { return links[index]; }
@@ -42,6 +42,7 @@
 
 #include "Link.h"
 #include <stack>
+#include <limits>
 
 using namespace std;
 using namespace hrp;
@@ -61,6 +62,8 @@ Link::Link()
     isCrawler = false;
 
     defaultJointValue = 0.0;
+
+    invalidateColdetModelPosition();
 }
 
 
@@ -116,6 +119,7 @@ Link::Link(const Link& org)
     if(org.coldetModel){
         coldetModel = new ColdetModel(*org.coldetModel);
     }
+    invalidateColdetModelPosition();
 
     parent = child = sibling = 0;
 
@@ -133,6 +137,18 @@ Link::Link(const Link& org)
 }
 
 
+/**
+   The next call of Body::updateLinkColdetModelPositions() always updates
+   the position of coldetModel.
+*/
+void Link::invalidateColdetModelPosition()
+{
+    coldetModelP.fill(std::numeric_limits<double>::quiet_NaN());
+    coldetModelR.fill(std::numeric_limits<double>::quiet_NaN());
+    isColdetModelPositionUpdated = true;
+}
+
+
 Link::~Link()
 {
     Link* link = child;
@@ -72,6 +72,7 @@ namespace hrp {
 
         void updateColdetModelPosition() {
             coldetModel->setPosition(R, p);
+            invalidateColdetModelPosition();
         }
 
         Body* body;
@@ -179,6 +180,14 @@ namespace hrp {
 
         ColdetModelPtr coldetModel;
 
+        /**
+           true when the position of coldetModel has been changed by the last
+           Body::updateLinkColdetModelPositions() call.
+           Caches of collision detection results can be kept for the links
+           whose flags are false.
+        */
+        bool isColdetModelPositionUpdated;
+
         struct ConstraintForce {
             Vector3 point;
             Vector3 force;
@@ -193,10 +202,16 @@ namespace hrp {
         std::vector<Light *>  lights;   ///< lights attached to this link
       private:
 
+        // the position and the internal attitude last set to coldetModel
+        Vector3 coldetModelP;
+        Matrix33 coldetModelR;
+
         Link& operator=(const Link& link); // no implementation is given to disable the copy operator
+        void invalidateColdetModelPosition();
         void setBodyIter(Body* body);
         friend std::ostream& ::operator<<(std::ostream &out, hrp::Link& link);
         void putInformation(std::ostream& out); // for the iostream output
+        friend class Body;
     };
 
 };
@@ -0,0 +1,711 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/**
+   @file
+   The conversion was moved from BodyInfo_impl of the ModelLoader server.
+*/
+
+#include "LinkInfoBuilder.h"
+#include <map>
+#include <vector>
+#include <iostream>
+#include <boost/format.hpp>
+#include <hrpCorba/ViewSimulator.hh>
+#include <hrpUtil/Eigen3d.h>
+
+using namespace std;
+using namespace boost;
+using namespace hrp;
+using namespace OpenHRP;
+
+
+namespace {
+
+    typedef map<string, string> SensorTypeMap;
+    SensorTypeMap sensorTypeMap;
+
+    void throwException(const std::string& fieldName, const std::string& expectedFieldType)
+    {
+        string error;
+        error += "The node must have a field \"" + fieldName + "\" of " + expectedFieldType + " type";
+        throw ModelLoader::ModelLoaderException(error.c_str());
+    }
+
+    void copyVrmlField(TProtoFieldMap& fmap, const std::string& name, std::string& out_s)
+    {
+        VrmlVariantField& f = fmap[name];
+        switch(f.typeId()){
+        case SFSTRING:
+            out_s = f.sfString();
+            break;
+        case MFSTRING:
+        {
+            MFString& strings = f.mfString();
+            out_s = "";
+            for(size_t i=0; i < strings.size(); i++){
+                out_s += strings[i] + "\n";
+            }
+        }
+        break;
+        default:
+            throwException(name, "SFString or MFString");
+        }
+    }
+
+    void copyVrmlField(TProtoFieldMap& fmap, const std::string& name, DblSequence& out_v)
+    {
+        VrmlVariantField& f = fmap[name];
+        switch(f.typeId()){
+        case MFFLOAT:
+        {
+            MFFloat& mf = f.mfFloat();
+            CORBA::ULong n = mf.size();
+            out_v.length(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                out_v[i] = mf[i];
+            }
+        }
+        break;
+        default:
+            throwException(name, "MFFloat");
+        }
+    }
+
+    void copyVrmlField(TProtoFieldMap& fmap, const std::string& name, DblArray3& out_v)
+    {
+        VrmlVariantField& f = fmap[name];
+        switch(f.typeId()){
+        case SFVEC3F:
+        case SFCOLOR:
+        {
+            SFVec3f& v = f.sfVec3f();
+            for(int i = 0; i < 3; ++i){
+                out_v[i] = v[i];
+            }
+        }
+        break;
+        default:
+            throwException(name, "SFVec3f or SFColor");
+        }
+    }
+
+    void copyVrmlField(TProtoFieldMap& fmap, const std::string& name, DblArray9& out_m)
+    {
+        VrmlVariantField& f = fmap[name];
+        switch(f.typeId()){
+        case MFFLOAT:
+        {
+            MFFloat& mf = f.mfFloat();
+            if(mf.size() == 9){
+                for(int i=0; i < 9; ++i){
+                    out_m[i] = mf[i];
+                }
+            } else {
+                throw ModelLoader::ModelLoaderException("illegal size of a matrix field");
+            }
+        }
+        break;
+        default:
+            throwException(name, "MFFloat");
+        }
+    }
+
+    void copyVrmlField(TProtoFieldMap& fmap, const std::string& name, CORBA::Double& out_v)
+    {
+        VrmlVariantField& f = fmap[name];
+        switch(f.typeId()){
+        case SFFLOAT:
+            out_v = f.sfFloat();
+            break;
+        default:
+            throwException(name, "SFFloat");
+        }
+    }
+
+    void copyVrmlField(TProtoFieldMap& fmap, const std::string& name, CORBA::Long& out_v)
+    {
+        VrmlVariantField& f = fmap[name];
+        switch(f.typeId()){
+        case SFINT32:
+            out_v = f.sfInt32();
+            break;
+        default:
+            throwException(name, "SFInt32");
+        }
+    }
+
+    void copyVrmlRotationFieldToDblArray4(TProtoFieldMap& fieldMap, const std::string name, DblArray4& out_R)
+    {
+        VrmlVariantField& rotationField = fieldMap[name];
+
+        if(rotationField.typeId() != SFROTATION){
+            throwException(name, "SFRotation");
+        }
+
+        SFRotation& r = rotationField.sfRotation();
+
+        for(int i = 0 ; i < 4 ; i++){
+            out_R[i] = r[i];
+        }
+    }
+}
+
+
+LinkInfoBuilder::~LinkInfoBuilder()
+{
+
+}
+
+
+void LinkInfoBuilder::readModelNodeSet
+(ModelNodeSet& modelNodeSet, std::string& out_name, StringSequence& out_info,
+ LinkInfoSequence& out_links, ExtraJointInfoSequence& out_extraJoints)
+{
+    modelName = modelNodeSet.humanoidNode()->defName;
+    out_name = modelName;
+    const MFString& info = modelNodeSet.humanoidNode()->fields["info"].mfString();
+    out_info.length(info.size());
+    for (unsigned int i=0; i<out_info.length(); i++){
+        out_info[i] = CORBA::string_dup(info[i].c_str());
+    }
+
+    int numJointNodes = modelNodeSet.numJointNodes();
+
+    out_links.length(numJointNodes);
+    if( 0 < numJointNodes ) {
+        int currentIndex = 0;
+        JointNodeSetPtr rootJointNodeSet = modelNodeSet.rootJointNodeSet();
+        readJointNodeSet(rootJointNodeSet, currentIndex, -1, out_links);
+    }
+
+    setExtraJoints(modelNodeSet, out_extraJoints);
+}
+
+
+void LinkInfoBuilder::setRootLinkInfo(LinkInfo& linfo)
+{
+    linfo.name = CORBA::string_dup("root");
+    linfo.parentIndex = -1;
+    linfo.jointId = -1;
+    linfo.jointType = CORBA::string_dup("fixed");
+    linfo.jointValue = 0;
+    for (int i=0; i<3; i++){
+        linfo.jointAxis[i] = 0;
+        linfo.translation[i] = 0;
+        linfo.rotation[i] = 0;
+    }
+    linfo.jointAxis[2] = 1;
+    linfo.rotation[2] = 1; linfo.rotation[3] = 0;
+
+    linfo.mass = 0.0;
+    for (int i=0; i<3; i++){
+        linfo.centerOfMass[i] = 0.0;
+    }
+    for (int i=0; i<9; i++){
+        linfo.inertia[i] = 0.0;
+    }
+    linfo.rotorInertia = 0.0;
+    linfo.gearRatio = 1.0;
+    linfo.rotorResistor = 0.0;
+    linfo.torqueConst = 1.0;
+    linfo.encoderPulse = 1.0;
+}
+
+
+int LinkInfoBuilder::readJointNodeSet(JointNodeSetPtr jointNodeSet, int& currentIndex, int parentIndex, LinkInfoSequence& links)
+{
+    int index = currentIndex;
+    currentIndex++;
+
+    LinkInfo_var linkInfo(new LinkInfo());
+    linkInfo->parentIndex = parentIndex;
+
+    size_t numChildren = jointNodeSet->childJointNodeSets.size();
+
+    for( size_t i = 0 ; i < numChildren ; ++i ){
+        JointNodeSetPtr childJointNodeSet = jointNodeSet->childJointNodeSets[i];
+        int childIndex = readJointNodeSet(childJointNodeSet, currentIndex, index, links);
+
+        long childIndicesLength = linkInfo->childIndices.length();
+        linkInfo->childIndices.length( childIndicesLength + 1 );
+        linkInfo->childIndices[childIndicesLength] = childIndex;
+    }
+
+    links[index] = linkInfo;
+    LinkInfo& link = links[index];
+    try	{
+        vector<VrmlProtoInstancePtr>& segmentNodes = jointNodeSet->segmentNodes;
+        int numSegment = segmentNodes.size();
+        link.segments.length(numSegment);
+        for(int i = 0 ; i < numSegment ; ++i){
+            SegmentInfo_var segmentInfo(new SegmentInfo());
+            Matrix44 T = jointNodeSet->transforms.at(i);
+            long s = link.shapeIndices.length();
+            int p = 0;
+            for(int row=0; row < 3; ++row){
+                for(int col=0; col < 4; ++col){
+                    segmentInfo->transformMatrix[p++] = T(row, col);
+                }
+            }
+            readShapeNodes(segmentNodes[i].get(), T, link.shapeIndices, link.inlinedShapeTransformMatrices);
+            long e = link.shapeIndices.length();
+            segmentInfo->shapeIndices.length(e-s);
+            for(int j=0, k=s; k<e; k++)
+                segmentInfo->shapeIndices[j++] = k;
+            link.segments[i] = segmentInfo;
+        }
+        setJointParameters(link, jointNodeSet->jointNode);
+        setSegmentParameters(link, jointNodeSet);
+        setSensors(link, jointNodeSet);
+        setHwcs(link, jointNodeSet);
+        setLights(link, jointNodeSet);
+    }
+    catch( ModelLoader::ModelLoaderException& ex ) {
+        string name(link.name);
+        string error = name.empty() ? "Unnamed JointNode" : name;
+        error += ": ";
+        error += ex.description;
+        throw ModelLoader::ModelLoaderException( error.c_str() );
+    }
+
+    return index;
+}
+
+
+void LinkInfoBuilder::setJointParameters(LinkInfo& linkInfo, VrmlProtoInstancePtr jointNode)
+{
+    linkInfo.name =  CORBA::string_dup( jointNode->defName.c_str() );
+
+    TProtoFieldMap& fmap = jointNode->fields;
+
+    CORBA::Long jointId;
+    copyVrmlField( fmap, "jointId", jointId );
+    linkInfo.jointId = (CORBA::Short)jointId;
+
+    linkInfo.jointAxis[0] = 0.0;
+    linkInfo.jointAxis[1] = 0.0;
+    linkInfo.jointAxis[2] = 0.0;
+
+    VrmlVariantField& fJointAxis = fmap["jointAxis"];
+
+    switch( fJointAxis.typeId() ) {
+
+    case SFSTRING:
+    {
+        SFString& axisLabel = fJointAxis.sfString();
+            if( axisLabel == "X" )		{ linkInfo.jointAxis[0] = 1.0; }
+            else if( axisLabel == "Y" )	{ linkInfo.jointAxis[1] = 1.0; }
+            else if( axisLabel == "Z" ) { linkInfo.jointAxis[2] = 1.0; }
+    }
+    break;
+
+    case SFVEC3F:
+        copyVrmlField( fmap, "jointAxis", linkInfo.jointAxis );
+        break;
+
+    default:
+        break;
+    }
+
+    std::string jointType;
+    copyVrmlField( fmap, "jointType", jointType );
+    linkInfo.jointType = CORBA::string_dup( jointType.c_str() );
+
+    copyVrmlField( fmap, "translation", linkInfo.translation );
+    copyVrmlRotationFieldToDblArray4( fmap, "rotation", linkInfo.rotation );
+
+    copyVrmlField( fmap, "ulimit",  linkInfo.ulimit );
+    copyVrmlField( fmap, "llimit",  linkInfo.llimit );
+    copyVrmlField( fmap, "uvlimit", linkInfo.uvlimit );
+    copyVrmlField( fmap, "lvlimit", linkInfo.lvlimit );
+
+    if(fmap["climit"].typeId() != UNDETERMINED_FIELD_TYPE){
+        copyVrmlField( fmap, "climit", linkInfo.climit );
+    }else{
+        //std::cout << "No climit type. climit was ignored." << std::endl;
+        linkInfo.climit.length((CORBA::ULong)0); // dummy
+    }
+
+    copyVrmlField( fmap, "gearRatio",     linkInfo.gearRatio );
+    copyVrmlField( fmap, "rotorInertia",  linkInfo.rotorInertia );
+    copyVrmlField( fmap, "rotorResistor", linkInfo.rotorResistor );
+    copyVrmlField( fmap, "torqueConst",   linkInfo.torqueConst );
+    copyVrmlField( fmap, "encoderPulse",  linkInfo.encoderPulse );
+    copyVrmlField( fmap, "jointValue",    linkInfo.jointValue );
+}
+
+
+void LinkInfoBuilder::setSegmentParameters(LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet)
+{
+    vector<VrmlProtoInstancePtr>& segmentNodes = jointNodeSet->segmentNodes;
+    int numSegment = segmentNodes.size();
+
+    linkInfo.mass = 0.0;
+    for( int i = 0 ; i < 3 ; ++i ) {
+        linkInfo.centerOfMass[i] = 0.0;
+        for( int j = 0 ; j < 3 ; ++j ) {
+            linkInfo.inertia[i*3 + j] = 0.0;
+        }
+    }
+
+    //  Mass = Σmass                 //
+    //  C = (Σmass * T * c) / Mass   //
+    //  I = Σ(R * I * Rt + G)       //
+    //  R = Tの回転行列               //
+    //  G = y*y+z*z, -x*y, -x*z, -y*x, z*z+x*x, -y*z, -z*x, -z*y, x*x+y*y    //
+    //  (x, y, z ) = T * c - C        //
+    std::vector<Vector4, Eigen::aligned_allocator<Vector4> > centerOfMassArray;
+    std::vector<double> massArray;
+    for(int i = 0 ; i < numSegment ; ++i){
+        SegmentInfo& segmentInfo = linkInfo.segments[i];
+        Matrix44 T = jointNodeSet->transforms.at(i);
+        DblArray3& centerOfMass = segmentInfo.centerOfMass;
+        CORBA::Double& mass =segmentInfo.mass;
+        DblArray9& inertia = segmentInfo.inertia;
+        TProtoFieldMap& fmap = segmentNodes[i]->fields;
+        copyVrmlField( fmap, "centerOfMass",     centerOfMass );
+        copyVrmlField( fmap, "mass",             mass );
+        copyVrmlField( fmap, "momentsOfInertia", inertia );
+        Vector4 c0(centerOfMass[0], centerOfMass[1], centerOfMass[2], 1.0);
+        Vector4 c1(T * c0);
+        centerOfMassArray.push_back(c1);
+        massArray.push_back(mass);
+        for(int j=0; j<3; j++){
+            linkInfo.centerOfMass[j] = c1(j) * mass + linkInfo.centerOfMass[j] * linkInfo.mass;
+        }
+        linkInfo.mass += mass;
+        if(linkInfo.mass > 0.0){
+            for(int j=0; j<3; j++){
+                linkInfo.centerOfMass[j] /= linkInfo.mass;
+            }
+        }
+        Matrix33 I;
+        I << inertia[0], inertia[1], inertia[2], inertia[3], inertia[4], inertia[5], inertia[6], inertia[7], inertia[8];
+        Matrix33 R;
+        R << T(0,0), T(0,1), T(0,2), T(1,0), T(1,1), T(1,2), T(2,0), T(2,1), T(2,2);
+        Matrix33 I1(R * I * R.transpose());
+        for(int j=0; j<3; j++){
+            for(int k=0; k<3; k++)
+                linkInfo.inertia[j*3+k] += I1(j,k);
+        }
+        segmentInfo.name = CORBA::string_dup( segmentNodes[i]->defName.c_str() );
+    }
+    if(linkInfo.mass <=0.0 )
+        std::cerr << "Warning: Mass is zero. <Model>" << modelName << " <Link>" << linkInfo.name << std::endl;
+
+    for(int i = 0 ; i < numSegment ; ++i){
+        Vector4 c( centerOfMassArray.at(i) );
+        double x = c(0) - linkInfo.centerOfMass[0];
+        double y = c(1) - linkInfo.centerOfMass[1];
+        double z = c(2) - linkInfo.centerOfMass[2];
+        double m = massArray.at(i);
+
+        linkInfo.inertia[0] += m * (y*y + z*z);
+        linkInfo.inertia[1] += -m * x * y;
+        linkInfo.inertia[2] += -m * x * z;
+        linkInfo.inertia[3] += -m * y * x;
+        linkInfo.inertia[4] += m * (z*z + x*x);
+        linkInfo.inertia[5] += -m * y * z;
+        linkInfo.inertia[6] += -m * z * x;
+        linkInfo.inertia[7] += -m * z * y;
+        linkInfo.inertia[8] += m * (x*x + y*y);
+    }
+}
+
+
+void LinkInfoBuilder::setSensors(LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet)
+{
+    vector<VrmlProtoInstancePtr>& sensorNodes = jointNodeSet->sensorNodes;
+
+    int numSensors = sensorNodes.size();
+    linkInfo.sensors.length(numSensors);
+
+    for(int i = 0 ; i < numSensors ; ++i) {
+        SensorInfo_var sensorInfo( new SensorInfo() );
+        readSensorNode( sensorInfo, sensorNodes[i] );
+        linkInfo.sensors[i] = sensorInfo;
+    }
+}
+
+
+void LinkInfoBuilder::setHwcs(LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet)
+{
+    vector<VrmlProtoInstancePtr>& hwcNodes = jointNodeSet->hwcNodes;
+
+    int numHwcs = hwcNodes.size();
+    linkInfo.hwcs.length(numHwcs);
+
+    for(int i = 0 ; i < numHwcs ; ++i) {
+        HwcInfo_var hwcInfo( new HwcInfo() );
+        readHwcNode( hwcInfo, hwcNodes[i] );
+        linkInfo.hwcs[i] = hwcInfo;
+    }
+}
+
+
+void LinkInfoBuilder::setLights(LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet)
+{
+    vector<pair<Matrix44, VrmlNodePtr> >& lightNodes = jointNodeSet->lightNodes;
+
+    int numLights = lightNodes.size();
+    linkInfo.lights.length(numLights);
+
+    for(int i = 0 ; i < numLights ; ++i) {
+        LightInfo_var lightInfo( new LightInfo() );
+        readLightNode( lightInfo, lightNodes[i] );
+        linkInfo.lights[i] = lightInfo;
+    }
+}
+
+
+void LinkInfoBuilder::readSensorNode(SensorInfo& sensorInfo, VrmlProtoInstancePtr sensorNode)
+{
+    if(sensorTypeMap.empty()) {
+        sensorTypeMap["ForceSensor"]        = "Force";
+        sensorTypeMap["Gyro"]               = "RateGyro";
+        sensorTypeMap["AccelerationSensor"] = "Acceleration";
+        sensorTypeMap["PressureSensor"]     = "";
+        sensorTypeMap["PhotoInterrupter"]   = "";
+        sensorTypeMap["VisionSensor"]       = "Vision";
+        sensorTypeMap["TorqueSensor"]       = "";
+        sensorTypeMap["RangeSensor"]	    = "Range";
+    }
+
+    try	{
+        sensorInfo.name = CORBA::string_dup( sensorNode->defName.c_str() );
+
+        TProtoFieldMap& fmap = sensorNode->fields;
+
+        copyVrmlField(fmap, "sensorId", sensorInfo.id );
+        copyVrmlField(fmap, "translation", sensorInfo.translation );
+        copyVrmlRotationFieldToDblArray4( fmap, "rotation", sensorInfo.rotation );
+
+        SensorTypeMap::iterator p = sensorTypeMap.find( sensorNode->proto->protoName );
+        std::string sensorType;
+        if(p != sensorTypeMap.end()){
+            sensorType = p->second;
+            sensorInfo.type = CORBA::string_dup( sensorType.c_str() );
+        } else {
+            throw ModelLoader::ModelLoaderException("Unknown Sensor Node");
+        }
+
+        if(sensorType == "Force") {
+            sensorInfo.specValues.length( CORBA::ULong(6) );
+            DblArray3 maxForce, maxTorque;
+            copyVrmlField(fmap, "maxForce", maxForce );
+            copyVrmlField(fmap, "maxTorque", maxTorque );
+            sensorInfo.specValues[0] = maxForce[0];
+            sensorInfo.specValues[1] = maxForce[1];
+            sensorInfo.specValues[2] = maxForce[2];
+            sensorInfo.specValues[3] = maxTorque[0];
+            sensorInfo.specValues[4] = maxTorque[1];
+            sensorInfo.specValues[5] = maxTorque[2];
+
+        } else if(sensorType == "RateGyro") {
+            sensorInfo.specValues.length( CORBA::ULong(3) );
+            DblArray3 maxAngularVelocity;
+            copyVrmlField(fmap, "maxAngularVelocity", maxAngularVelocity);
+            sensorInfo.specValues[0] = maxAngularVelocity[0];
+            sensorInfo.specValues[1] = maxAngularVelocity[1];
+            sensorInfo.specValues[2] = maxAngularVelocity[2];
+
+        } else if( sensorType == "Acceleration" ){
+            sensorInfo.specValues.length( CORBA::ULong(3) );
+            DblArray3 maxAcceleration;
+            copyVrmlField(fmap, "maxAcceleration", maxAcceleration);
+            sensorInfo.specValues[0] = maxAcceleration[0];
+            sensorInfo.specValues[1] = maxAcceleration[1];
+            sensorInfo.specValues[2] = maxAcceleration[2];
+
+        } else if( sensorType == "Vision" ){
+            sensorInfo.specValues.length( CORBA::ULong(7) );
+
+            CORBA::Double specValues[3];
+            copyVrmlField(fmap, "frontClipDistance", specValues[0] );
+            copyVrmlField(fmap, "backClipDistance", specValues[1] );
+            copyVrmlField(fmap, "fieldOfView", specValues[2] );
+            sensorInfo.specValues[0] = specValues[0];
+            sensorInfo.specValues[1] = specValues[1];
+            sensorInfo.specValues[2] = specValues[2];
+
+            std::string sensorTypeString;
+            copyVrmlField(fmap, "type", sensorTypeString );
+
+            if(sensorTypeString=="NONE" ) {
+                sensorInfo.specValues[3] = Camera::NONE;
+            } else if(sensorTypeString=="COLOR") {
+                sensorInfo.specValues[3] = Camera::COLOR;
+            } else if(sensorTypeString=="MONO") {
+                sensorInfo.specValues[3] = Camera::MONO;
+            } else if(sensorTypeString=="DEPTH") {
+                sensorInfo.specValues[3] = Camera::DEPTH;
+            } else if(sensorTypeString=="COLOR_DEPTH") {
+                sensorInfo.specValues[3] = Camera::COLOR_DEPTH;
+            } else if(sensorTypeString=="MONO_DEPTH") {
+                sensorInfo.specValues[3] = Camera::MONO_DEPTH;
+            } else {
+                throw ModelLoader::ModelLoaderException("Sensor node has unkown type string");
+            }
+
+            CORBA::Long width, height;
+            copyVrmlField(fmap, "width", width);
+            copyVrmlField(fmap, "height", height);
+
+            sensorInfo.specValues[4] = static_cast<CORBA::Double>(width);
+            sensorInfo.specValues[5] = static_cast<CORBA::Double>(height);
+
+	    double frameRate;
+            copyVrmlField(fmap, "frameRate", frameRate);
+            sensorInfo.specValues[6] = frameRate;
+        } else if( sensorType == "Range" ){
+            sensorInfo.specValues.length( CORBA::ULong(4) );
+            CORBA::Double v;
+            copyVrmlField(fmap, "scanAngle", v);
+            sensorInfo.specValues[0] = v;
+            copyVrmlField(fmap, "scanStep", v);
+            sensorInfo.specValues[1] = v;
+            copyVrmlField(fmap, "scanRate", v);
+            sensorInfo.specValues[2] = v;
+            copyVrmlField(fmap, "maxDistance", v);
+            sensorInfo.specValues[3] = v;
+        }
+
+        readChildShapeNodes(sensorNode, sensorInfo.shapeIndices, sensorInfo.inlinedShapeTransformMatrices);
+
+    } catch(ModelLoader::ModelLoaderException& ex) {
+        string error = modelName.empty() ? "Unnamed sensor node" : modelName;
+        error += ": ";
+        error += ex.description;
+        throw ModelLoader::ModelLoaderException( error.c_str() );
+    }
+}
+
+
+void LinkInfoBuilder::readHwcNode(HwcInfo& hwcInfo, VrmlProtoInstancePtr hwcNode )
+{
+    hwcInfo.name = CORBA::string_dup( hwcNode->defName.c_str() );
+
+    TProtoFieldMap& fmap = hwcNode->fields;
+
+    copyVrmlField(fmap, "id", hwcInfo.id );
+    copyVrmlField(fmap, "translation", hwcInfo.translation );
+    copyVrmlRotationFieldToDblArray4( fmap, "rotation", hwcInfo.rotation );
+    std::string url;
+    copyVrmlField( fmap, "url", url );
+    hwcInfo.url = CORBA::string_dup( url.c_str() );
+
+    readChildShapeNodes(hwcNode, hwcInfo.shapeIndices, hwcInfo.inlinedShapeTransformMatrices);
+}
+
+
+void LinkInfoBuilder::readLightNode(LightInfo& lightInfo, std::pair<Matrix44, VrmlNodePtr>& transformedLight)
+{
+    VrmlNode *lightNode = transformedLight.second.get();
+    Matrix44 &T = transformedLight.first;
+    for (int i=0; i<3; i++){
+        for (int j=0; j<4; j++){
+            lightInfo.transformMatrix[i*4+j] =  T(i,j);
+        }
+    }
+    lightInfo.name = CORBA::string_dup( lightNode->defName.c_str() );
+    VrmlPointLight *plight = dynamic_cast<VrmlPointLight *>(lightNode);
+    VrmlDirectionalLight *dlight = dynamic_cast<VrmlDirectionalLight *>(lightNode);
+    VrmlSpotLight *slight = dynamic_cast<VrmlSpotLight *>(lightNode);
+    if (plight){
+        lightInfo.type = OpenHRP::POINT;
+        lightInfo.ambientIntensity = plight->ambientIntensity;
+        lightInfo.intensity = plight->intensity;
+        lightInfo.on = plight->on;
+        lightInfo.radius = plight->radius;
+        for (int i=0; i<3; i++){
+            lightInfo.attenuation[i] = plight->attenuation[i];
+            lightInfo.color[i] = plight->color[i];
+            lightInfo.location[i] = plight->location[i];
+        }
+    }else if(dlight){
+        lightInfo.type = OpenHRP::DIRECTIONAL;
+        lightInfo.ambientIntensity = dlight->ambientIntensity;
+        lightInfo.intensity = dlight->intensity;
+        lightInfo.on = dlight->on;
+        for (int i=0; i<3; i++){
+            lightInfo.color[i] = dlight->color[i];
+            lightInfo.direction[i] = dlight->direction[i];
+        }
+    }else if(slight){
+        lightInfo.type = OpenHRP::SPOT;
+        lightInfo.ambientIntensity = slight->ambientIntensity;
+        lightInfo.intensity = slight->intensity;
+        lightInfo.on = slight->on;
+        lightInfo.radius = slight->radius;
+        lightInfo.beamWidth = slight->beamWidth;
+        lightInfo.cutOffAngle = slight->cutOffAngle;
+        for (int i=0; i<3; i++){
+            lightInfo.attenuation[i] = slight->attenuation[i];
+            lightInfo.color[i] = slight->color[i];
+            lightInfo.location[i] = slight->location[i];
+            lightInfo.direction[i] = slight->direction[i];
+        }
+    }else{
+        throw ModelLoader::ModelLoaderException("unknown light type");
+    }
+}
+
+
+/**
+   The shapes of a sensor or a hwc are represented in the coordinate of the node
+*/
+void LinkInfoBuilder::readChildShapeNodes
+(VrmlProtoInstancePtr node, TransformedShapeIndexSequence& io_shapeIndices, DblArray12Sequence& io_inlinedShapeTransformMatrices)
+{
+    Matrix44 E(Matrix44::Identity());
+    VrmlVariantField *field = node->getField("children");
+    if (field){
+        MFNode &children = field->mfNode();
+        for (unsigned int i=0; i<children.size(); i++){
+            readShapeNodes(children[i].get(), E, io_shapeIndices, io_inlinedShapeTransformMatrices);
+        }
+    }
+}
+
+
+void LinkInfoBuilder::setExtraJoints(ModelNodeSet& modelNodeSet, ExtraJointInfoSequence& out_extraJoints)
+{
+    int n = modelNodeSet.numExtraJointNodes();
+    out_extraJoints.length(n);
+    for(int i=0; i < n; ++i){
+
+        TProtoFieldMap& f = modelNodeSet.extraJointNode(i)->fields;
+        ExtraJointInfo_var extraJointInfo(new ExtraJointInfo());
+        extraJointInfo->name =  CORBA::string_dup( modelNodeSet.extraJointNode(i)->defName.c_str() );
+
+        string link1Name, link2Name;
+        copyVrmlField( f, "link1Name", link1Name );
+        copyVrmlField( f, "link2Name", link2Name );
+        extraJointInfo->link[0] = CORBA::string_dup(link1Name.c_str());
+        extraJointInfo->link[1] = CORBA::string_dup(link2Name.c_str());
+
+        string jointType;
+        copyVrmlField( f, "jointType", jointType);
+        if(jointType == "xy"){
+            extraJointInfo->jointType = EJ_XY;
+        } else if(jointType == "xyz"){
+            extraJointInfo->jointType = EJ_XYZ;
+        } else if(jointType == "z"){
+            extraJointInfo->jointType = EJ_Z;
+        }else {
+            throw ModelNodeSet::Exception(str(format("JointType \"%1%\" is not supported.") % jointType));
+        }
+        copyVrmlField( f, "jointAxis", extraJointInfo->axis );
+        copyVrmlField( f, "link1LocalPos", extraJointInfo->point[0] );
+        copyVrmlField( f, "link2LocalPos", extraJointInfo->point[1] );
+
+        out_extraJoints[i] = extraJointInfo;
+    }
+}
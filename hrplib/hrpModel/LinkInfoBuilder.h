@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/**
+   @file
+   @brief Conversion of the nodes of a model file into the link information of BodyInfo
+*/
+
+#ifndef HRPMODEL_LINK_INFO_BUILDER_H_INCLUDED
+#define HRPMODEL_LINK_INFO_BUILDER_H_INCLUDED
+
+#include <string>
+#include <hrpCorba/ORBwrap.h>
+#include <hrpCorba/ModelLoader.hh>
+#include <hrpUtil/VrmlNodes.h>
+#include <hrpUtil/Eigen4d.h>
+#include "ModelNodeSet.h"
+#include "Config.h"
+
+namespace hrp
+{
+    /**
+       @if jp
+       ModelNodeSet に読み込まれたノードから LinkInfo, ExtraJointInfo を構築する.
+       ModelLoader サーバの BodyInfo と loadBodyFromModelFile() はこの変換を共有する.
+       @else
+       Builds LinkInfo and ExtraJointInfo from the nodes of a model loaded into a ModelNodeSet.
+       The BodyInfo of the ModelLoader server and loadBodyFromModelFile() share this conversion,
+       and each of them converts the shape nodes by overriding readShapeNodes().
+       ModelLoader::ModelLoaderException or ModelNodeSet::Exception is thrown for an invalid node.
+       @endif
+    */
+    class HRPMODEL_API LinkInfoBuilder
+    {
+    public:
+        virtual ~LinkInfoBuilder();
+
+        /**
+           reads the name, info, links and extra joints of the humanoid
+        */
+        void readModelNodeSet(ModelNodeSet& modelNodeSet, std::string& out_name, OpenHRP::StringSequence& out_info,
+                              OpenHRP::LinkInfoSequence& out_links, OpenHRP::ExtraJointInfoSequence& out_extraJoints);
+
+        /**
+           sets a fixed link named "root", which is the only link of a model without the Humanoid node
+        */
+        static void setRootLinkInfo(OpenHRP::LinkInfo& out_linkInfo);
+
+    protected:
+        /**
+           @if jp
+           node 以下の Shape ノードを io_shapeIndices に追加する.
+           @else
+           adds the shape nodes under the node to io_shapeIndices.
+           @param T the transform from the coordinate of the link or the sensor to the node
+           @endif
+        */
+        virtual void readShapeNodes(VrmlNode* node, const Matrix44& T,
+                                    OpenHRP::TransformedShapeIndexSequence& io_shapeIndices,
+                                    OpenHRP::DblArray12Sequence& io_inlinedShapeTransformMatrices) = 0;
+
+    private:
+        std::string modelName;
+
+        int readJointNodeSet(JointNodeSetPtr jointNodeSet, int& currentIndex, int parentIndex, OpenHRP::LinkInfoSequence& links);
+        void setJointParameters(OpenHRP::LinkInfo& linkInfo, VrmlProtoInstancePtr jointNode);
+        void setSegmentParameters(OpenHRP::LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet);
+        void setSensors(OpenHRP::LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet);
+        void setHwcs(OpenHRP::LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet);
+        void setLights(OpenHRP::LinkInfo& linkInfo, JointNodeSetPtr jointNodeSet);
+        void readSensorNode(OpenHRP::SensorInfo& sensorInfo, VrmlProtoInstancePtr sensorNode);
+        void readHwcNode(OpenHRP::HwcInfo& hwcInfo, VrmlProtoInstancePtr hwcNode);
+        void readLightNode(OpenHRP::LightInfo& lightInfo, std::pair<Matrix44, VrmlNodePtr>& transformedLight);
+        void readChildShapeNodes(VrmlProtoInstancePtr node, OpenHRP::TransformedShapeIndexSequence& io_shapeIndices,
+                                 OpenHRP::DblArray12Sequence& io_inlinedShapeTransformMatrices);
+        void setExtraJoints(ModelNodeSet& modelNodeSet, OpenHRP::ExtraJointInfoSequence& out_extraJoints);
+    };
+};
+
+#endif
@@ -13,15 +13,19 @@
 */
 
 #include "ModelLoaderUtil.h"
+#include "BinaryModelFile.h"
 #include "Link.h"
 #include "Sensor.h"
 #include "Light.h"
 #include <hrpUtil/Eigen3d.h>
 #include <hrpUtil/Eigen4d.h>
+#include <hrpUtil/ShapeChunk.h>
 #include <hrpCorba/OpenHRPCommon.hh>
 #include <hrpCorba/ViewSimulator.hh>
 #include <hrpCollision/ColdetModel.h>
+#include <hrpCollision/ConvexDecomposition.h>
 #include <stack>
+#include <algorithm>
 
 using namespace std;
 using namespace hrp;
@@ -122,6 +126,23 @@ namespace {
     {
         return (limitseq.length() == 0) ? defaultValue : limitseq[0];
     }
+
+    /**
+       checks a mesh read from a file, whose indices are used without the range checks
+    */
+    bool isValidCollisionMesh(const BinaryModelCollisionMesh& mesh)
+    {
+        if(mesh.vertices.size() % 3 != 0 || mesh.triangles.size() % 3 != 0){
+            return false;
+        }
+        const int numVertices = mesh.vertices.size() / 3;
+        for(size_t i=0; i < mesh.triangles.size(); ++i){
+            if(mesh.triangles[i] < 0 || mesh.triangles[i] >= numVertices){
+                return false;
+            }
+        }
+        return true;
+    }
     
     static Link *createNewLink() { return new Link(); }
     class ModelLoaderHelper
@@ -130,6 +151,7 @@ namespace {
         ModelLoaderHelper() {
             collisionDetectionModelLoading = false;
             createLinkFunc = createNewLink;
+            collisionMeshes = 0;
         }
 
         void enableCollisionDetectionModelLoading(bool isEnabled) {
@@ -138,6 +160,7 @@ namespace {
         void setLinkFactory(Link *(*f)()) { createLinkFunc = f; }
 
         bool createBody(BodyPtr& body,  BodyInfo_ptr bodyInfo);
+        bool createBody(BodyPtr& body, BinaryModelData& data);
         
     private:
         BodyPtr body;
@@ -146,11 +169,14 @@ namespace {
         ExtraJointInfoSequence_var extraJointInfoSeq;
         bool collisionDetectionModelLoading;
         Link *(*createLinkFunc)();
+        const std::vector<BinaryModelCollisionMesh>* collisionMeshes;
 
+        bool createLinkTree();
         Link* createLink(int index, const Matrix33& parentRs);
         void createSensors(Link* link, const SensorInfoSequence& sensorInfoSeq, const Matrix33& Rs);
         void createLights(Link* link, const LightInfoSequence& lightInfoSeq, const Matrix33& Rs);
         void createColdetModel(Link* link, const LinkInfo& linkInfo);
+        void createColdetModel(Link* link, const LinkInfo& linkInfo, const BinaryModelCollisionMesh& mesh);
         void addLinkPrimitiveInfo(ColdetModelPtr& coldetModel, 
                                   const double *R, const double *p,
                                   const ShapeInfo& shapeInfo);
@@ -169,11 +195,46 @@ bool ModelLoaderHelper::createBody(BodyPtr& body, BodyInfo_ptr bodyInfo)
     body->setModelName(name);
     body->setName(name);
 
-    int n = bodyInfo->links()->length();
     linkInfoSeq = bodyInfo->links();
-    shapeInfoSeq = bodyInfo->shapes();
+    shapeInfoSeq = getShapesByChunks(bodyInfo, defaultShapeChunkOption());
 	extraJointInfoSeq = bodyInfo->extraJoints();
 
+    return createLinkTree();
+}
+
+
+/**
+   The sequences are taken from the data
+*/
+bool ModelLoaderHelper::createBody(BodyPtr& body, BinaryModelData& data)
+{
+    this->body = body;
+
+    for(size_t i=0; i < data.collisionMeshes.size(); ++i){
+        if(!isValidCollisionMesh(data.collisionMeshes[i])){
+            std::cerr << "The collision mesh of link " << i << " of model " << data.name << " is broken." << std::endl;
+            return false;
+        }
+    }
+
+    body->setModelName(data.name);
+    body->setName(data.name);
+
+    linkInfoSeq = data.links._retn();
+    shapeInfoSeq = data.shapes._retn();
+    extraJointInfoSeq = data.extraJoints._retn();
+
+    if(!data.collisionMeshes.empty()){
+        collisionMeshes = &data.collisionMeshes;
+    }
+
+    return createLinkTree();
+}
+
+
+bool ModelLoaderHelper::createLinkTree()
+{
+    int n = linkInfoSeq->length();
     int rootIndex = -1;
 
     for(int i=0; i < n; ++i){
@@ -313,7 +374,11 @@ Link* ModelLoaderHelper::createLink(int index, const Matrix33& parentRs)
     createLights(link, linkInfo.lights, Rs);
 
     if(collisionDetectionModelLoading){
-        createColdetModel(link, linkInfo);
+        if(collisionMeshes && !(*collisionMeshes)[index].triangles.empty()){
+            createColdetModel(link, linkInfo, (*collisionMeshes)[index]);
+        } else {
+            createColdetModel(link, linkInfo);
+        }
     }
 
     return link;
@@ -452,7 +517,10 @@ void ModelLoaderHelper::createColdetModel(Link* link, const LinkInfo& linkInfo)
 {
     int totalNumVertices = 0;
     int totalNumTriangles = 0;
-    const TransformedShapeIndexSequence& shapeIndices = linkInfo.shapeIndices;
+    // the simplified collision shapes include the shapes of the sensors
+    const bool hasCollisionShapes = (linkInfo.collisionShapeIndices.length() > 0);
+    const TransformedShapeIndexSequence& shapeIndices =
+        hasCollisionShapes ? linkInfo.collisionShapeIndices : linkInfo.shapeIndices;
     unsigned int nshape = shapeIndices.length();
     short shapeIndex;
     double R[9], p[3];
@@ -468,7 +536,7 @@ void ModelLoaderHelper::createColdetModel(Link* link, const LinkInfo& linkInfo)
     }
 
     const SensorInfoSequence& sensors = linkInfo.sensors;
-    for (unsigned int i=0; i<sensors.length(); i++){
+    for (unsigned int i=0; i<sensors.length() && !hasCollisionShapes; i++){
         const SensorInfo &sinfo = sensors[i];
         const TransformedShapeIndexSequence tsis = sinfo.shapeIndices;
         nshape += tsis.length();
@@ -494,6 +562,43 @@ void ModelLoaderHelper::createColdetModel(Link* link, const LinkInfo& linkInfo)
     link->coldetModel = coldetModel;
 }
 
+/**
+   The mesh is already transformed into the link local coordinate, so only the tree is built.
+*/
+void ModelLoaderHelper::createColdetModel(Link* link, const LinkInfo& linkInfo, const BinaryModelCollisionMesh& mesh)
+{
+    ColdetModelPtr coldetModel(new ColdetModel());
+    coldetModel->setName(std::string(linkInfo.name));
+
+    const int numVertices = mesh.vertices.size() / 3;
+    coldetModel->setNumVertices(numVertices);
+    for(int i=0; i < numVertices; ++i){
+        coldetModel->setVertex(i, mesh.vertices[i*3], mesh.vertices[i*3+1], mesh.vertices[i*3+2]);
+    }
+    const int numTriangles = mesh.triangles.size() / 3;
+    coldetModel->setNumTriangles(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        coldetModel->setTriangle(i, mesh.triangles[i*3], mesh.triangles[i*3+1], mesh.triangles[i*3+2]);
+    }
+
+    const TransformedShapeIndexSequence& shapeIndices = linkInfo.shapeIndices;
+    bool hasSensorShapes = false;
+    for(CORBA::ULong i=0; i < linkInfo.sensors.length(); ++i){
+        if(linkInfo.sensors[i].shapeIndices.length() > 0){
+            hasSensorShapes = true;
+        }
+    }
+    if(shapeIndices.length() == 1 && !hasSensorShapes){
+        const DblArray12& tform = shapeIndices[0].transformMatrix;
+        double R[9] = { tform[0], tform[1], tform[2], tform[4], tform[5], tform[6], tform[8], tform[9], tform[10] };
+        double p[3] = { tform[3], tform[7], tform[11] };
+        addLinkPrimitiveInfo(coldetModel, R, p, shapeInfoSeq[shapeIndices[0].shapeIndex]);
+    }
+
+    coldetModel->build();
+    link->coldetModel = coldetModel;
+}
+
 void ModelLoaderHelper::addLinkVerticesAndTriangles
 (ColdetModelPtr& coldetModel, const TransformedShapeIndex& tsi, const Matrix44& Tparent, ShapeInfoSequence_var& shapes, int& vertexIndex, int& triangleIndex)
 {
@@ -532,9 +637,19 @@ void ModelLoaderHelper::addLinkVerticesAndTriangles(ColdetModelPtr& coldetModel,
     int vertexIndex = 0;
     int triangleIndex = 0;
 
+    Matrix44 E(Matrix44::Identity());
+
+    const TransformedShapeIndexSequence& collisionShapeIndices = linkInfo.collisionShapeIndices;
+    if(collisionShapeIndices.length() > 0){
+        for(unsigned int i=0; i < collisionShapeIndices.length(); i++){
+            addLinkVerticesAndTriangles(coldetModel, collisionShapeIndices[i], E, shapeInfoSeq,
+                                        vertexIndex, triangleIndex);
+        }
+        return;
+    }
+
     const TransformedShapeIndexSequence& shapeIndices = linkInfo.shapeIndices;
     
-    Matrix44 E(Matrix44::Identity());
     for(unsigned int i=0; i < shapeIndices.length(); i++){
         addLinkVerticesAndTriangles(coldetModel, shapeIndices[i], E, shapeInfoSeq,
                                     vertexIndex, triangleIndex);
@@ -630,6 +745,47 @@ bool hrp::loadBodyFromBodyInfo(BodyPtr body, OpenHRP::BodyInfo_ptr bodyInfo, boo
     return false;
 }
 
+bool hrp::loadBodyFromBinaryModelFile(BodyPtr body, const std::string& filename, bool loadGeometryForCollisionDetection, Link *(*f)())
+{
+    BinaryModelData data;
+    if(!readBinaryModelFile(filename, data)){
+        return false;
+    }
+    return loadBodyFromBinaryModelData(body, data, loadGeometryForCollisionDetection, f);
+}
+
+
+bool hrp::loadBodyFromBinaryModelData(BodyPtr body, BinaryModelData& data, bool loadGeometryForCollisionDetection, Link *(*f)())
+{
+    ModelLoaderHelper helper;
+    if (f) helper.setLinkFactory(f);
+    if(loadGeometryForCollisionDetection){
+        helper.enableCollisionDetectionModelLoading(true);
+    }
+    return helper.createBody(body, data);
+}
+
+int hrp::buildConvexHullsOfLinks
+(BodyPtr body, const std::vector<std::string>& linkNames, const ConvexDecomposition& decomposition, const std::string& cacheDirectory)
+{
+    int numEnabledLinks = 0;
+    for(int i=0; i < body->numLinks(); ++i){
+        Link* link = body->link(i);
+        if(!link->coldetModel || link->coldetModel->getNumTriangles() == 0){
+            continue;
+        }
+        if(!linkNames.empty() && std::find(linkNames.begin(), linkNames.end(), link->name) == linkNames.end()){
+            continue;
+        }
+        if(link->coldetModel->buildConvexHulls(decomposition, cacheDirectory) > 0){
+            link->coldetModel->enableConvexHulls(true);
+            ++numEnabledLinks;
+        }
+    }
+    return numEnabledLinks;
+}
+
+
 BodyInfo_var hrp::loadBodyInfo(const char* url, int& argc, char* argv[])
 {
     CORBA::ORB_var orb = CORBA::ORB_init(argc, argv);
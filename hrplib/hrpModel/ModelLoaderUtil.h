@@ -23,10 +23,33 @@
 #include <hrpCorba/ModelLoader.hh>
 #include <string>
 #include <sstream>
+#include <vector>
 
 namespace hrp
 {
+    class ConvexDecomposition;
+    struct BinaryModelData;
+
     HRPMODEL_API bool loadBodyFromBodyInfo(BodyPtr body, OpenHRP::BodyInfo_ptr bodyInfo, bool loadGeometryForCollisionDetection = false, Link *(*f)()=NULL);
+    /**
+       loads a body from a binary model file written by writeBinaryModelFile() without the model loader server
+    */
+    HRPMODEL_API bool loadBodyFromBinaryModelFile(BodyPtr body, const std::string& filename, bool loadGeometryForCollisionDetection = false, Link *(*f)()=NULL);
+    /**
+       loads a body from the contents of a binary model file or the sequences of BodyInfo built in the
+       current process. The name, links, shapes and extraJoints of the data are used and the sequences are taken.
+    */
+    HRPMODEL_API bool loadBodyFromBinaryModelData(BodyPtr body, BinaryModelData& data, bool loadGeometryForCollisionDetection = false, Link *(*f)()=NULL);
+    /**
+       approximates the collision meshes of the links by convex hulls, which are used for the
+       collision detection between the links which both have them
+       @param linkNames the names of the links to which the hulls are applied, or empty for all the links
+       @param cacheDirectory an existing directory where the hulls are cached, or empty for no cache
+       @return the number of the links whose hulls are enabled
+    */
+    HRPMODEL_API int buildConvexHullsOfLinks(BodyPtr body, const std::vector<std::string>& linkNames,
+                                             const ConvexDecomposition& decomposition,
+                                             const std::string& cacheDirectory = std::string());
     HRPMODEL_API OpenHRP::BodyInfo_var loadBodyInfo(const char* url, int& argc, char* argv[]);
     HRPMODEL_API OpenHRP::BodyInfo_var loadBodyInfo(const char* url, CORBA_ORB_var orb);
     HRPMODEL_API OpenHRP::BodyInfo_var loadBodyInfo(const char* url, CosNaming::NamingContext_var cxt);
@@ -194,6 +194,7 @@ bool ModelNodeSetImpl::loadModelFile(const std::string& filename)
 
     try {
 	VrmlParser parser;
+	parser.setParallelInlineLoadingMode(true);
 	parser.load(filename);
 	extractHumanoidNode(parser);
 
@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/**
+   @file
+   The links are built by LinkInfoBuilder, which BodyInfo_impl of the ModelLoader server also uses,
+   and the body is constructed from them by loadBodyFromBinaryModelData() in the same way as
+   loadBodyFromBodyInfo(). Only the geometries used for the collision detection are converted
+   into ShapeInfo here, following ShapeSetInfo_impl of the server.
+*/
+
+#include "ModelNodeSetUtil.h"
+#include "ModelLoaderUtil.h"
+#include "LinkInfoBuilder.h"
+#include "BinaryModelFile.h"
+#include <hrpUtil/VrmlNodes.h>
+#include <hrpUtil/VrmlParser.h>
+#include <hrpUtil/EasyScanner.h>
+#include <hrpUtil/TriangleMeshShaper.h>
+#include <iostream>
+#include <map>
+
+using namespace std;
+using namespace hrp;
+using namespace OpenHRP;
+
+
+namespace {
+
+    class ModelNodeSetHelper : public LinkInfoBuilder
+    {
+    public:
+        ModelNodeSetHelper(bool loadGeometry) : isGeometryLoaded(loadGeometry), shapes(0) { }
+
+        void createData(ModelNodeSet& modelNodeSet, BinaryModelData& out_data);
+        void createData(VrmlParser& parser, BinaryModelData& out_data);
+
+    protected:
+        virtual void readShapeNodes(VrmlNode* node, const Matrix44& T,
+                                    TransformedShapeIndexSequence& io_shapeIndices,
+                                    DblArray12Sequence& io_inlinedShapeTransformMatrices);
+
+    private:
+        typedef std::map<VrmlShape*, int> ShapeNodeToShapeInfoIndexMap;
+
+        bool isGeometryLoaded;
+        TriangleMeshShaper triangleMeshShaper;
+        ShapeInfoSequence* shapes;
+        ShapeNodeToShapeInfoIndexMap shapeInfoIndexMap;
+
+        void initData(BinaryModelData& out_data);
+        int createShapeInfo(VrmlShape* shapeNode);
+        void setPrimitiveProperties(ShapeInfo& shapeInfo, VrmlShape* shapeNode);
+    };
+}
+
+
+void ModelNodeSetHelper::initData(BinaryModelData& out_data)
+{
+    out_data.info = new StringSequence();
+    out_data.links = new LinkInfoSequence();
+    out_data.extraJoints = new ExtraJointInfoSequence();
+    out_data.shapes = new ShapeInfoSequence();
+    shapes = &out_data.shapes.inout();
+    shapeInfoIndexMap.clear();
+}
+
+
+void ModelNodeSetHelper::createData(ModelNodeSet& modelNodeSet, BinaryModelData& out_data)
+{
+    initData(out_data);
+
+    if(isGeometryLoaded){
+        triangleMeshShaper.apply(modelNodeSet.humanoidNode());
+    }
+
+    try {
+        readModelNodeSet(modelNodeSet, out_data.name, out_data.info.inout(),
+                         out_data.links.inout(), out_data.extraJoints.inout());
+    } catch(ModelLoader::ModelLoaderException& ex){
+        throw ModelNodeSet::Exception(string(ex.description));
+    }
+}
+
+
+/**
+   A file without the Humanoid node is loaded as a body of a single fixed link
+   in the same way as BodyInfo_impl::loadModelFile.
+*/
+void ModelNodeSetHelper::createData(VrmlParser& parser, BinaryModelData& out_data)
+{
+    initData(out_data);
+
+    out_data.links->length(1);
+    LinkInfo& linkInfo = out_data.links[0];
+    setRootLinkInfo(linkInfo);
+
+    Matrix44 E(Matrix44::Identity());
+    while(VrmlNodePtr node = parser.readNode()){
+        if(!node->isCategoryOf(PROTO_DEF_NODE) && isGeometryLoaded){
+            triangleMeshShaper.apply(node);
+            readShapeNodes(node.get(), E, linkInfo.shapeIndices, linkInfo.inlinedShapeTransformMatrices);
+        }
+    }
+}
+
+
+/**
+   The shapes are not read when the geometry is not loaded because they are only used
+   for the collision detection
+*/
+void ModelNodeSetHelper::readShapeNodes
+(VrmlNode* node, const Matrix44& T, TransformedShapeIndexSequence& io_shapeIndices, DblArray12Sequence& io_inlinedShapeTransformMatrices)
+{
+    if(!isGeometryLoaded){
+        return;
+    }
+
+    if(node->isCategoryOf(PROTO_INSTANCE_NODE)){
+        VrmlProtoInstance* protoInstance = static_cast<VrmlProtoInstance*>(node);
+        if(protoInstance->actualNode){
+            readShapeNodes(protoInstance->actualNode.get(), T, io_shapeIndices, io_inlinedShapeTransformMatrices);
+        }
+
+    } else if(node->isCategoryOf(GROUPING_NODE)){
+        VrmlGroup* groupNode = static_cast<VrmlGroup*>(node);
+        VrmlTransform* transformNode = dynamic_cast<VrmlTransform*>(groupNode);
+        Matrix44 T2;
+        const Matrix44* pT = &T;
+        if(transformNode){
+            Matrix44 Tlocal;
+            calcTransformMatrix(transformNode, Tlocal);
+            T2 = T * Tlocal;
+            pT = &T2;
+        }
+        VrmlSwitch* switchNode = dynamic_cast<VrmlSwitch*>(node);
+        if(switchNode){
+            int whichChoice = switchNode->whichChoice;
+            if(whichChoice >= 0 && whichChoice < switchNode->countChildren()){
+                readShapeNodes(switchNode->getChild(whichChoice), *pT, io_shapeIndices, io_inlinedShapeTransformMatrices);
+            }
+        } else {
+            for(int i=0; i < groupNode->countChildren(); ++i){
+                readShapeNodes(groupNode->getChild(i), *pT, io_shapeIndices, io_inlinedShapeTransformMatrices);
+            }
+        }
+
+    } else if(node->isCategoryOf(SHAPE_NODE)){
+        VrmlShape* shapeNode = static_cast<VrmlShape*>(node);
+        int shapeInfoIndex;
+
+        ShapeNodeToShapeInfoIndexMap::iterator p = shapeInfoIndexMap.find(shapeNode);
+        if(p != shapeInfoIndexMap.end()){
+            shapeInfoIndex = p->second;
+        } else {
+            shapeInfoIndex = createShapeInfo(shapeNode);
+        }
+
+        if(shapeInfoIndex >= 0){
+            long length = io_shapeIndices.length();
+            io_shapeIndices.length(length + 1);
+            TransformedShapeIndex& tsi = io_shapeIndices[length];
+            tsi.shapeIndex = shapeInfoIndex;
+            int p = 0;
+            for(int row=0; row < 3; ++row){
+                for(int col=0; col < 4; ++col){
+                    tsi.transformMatrix[p++] = T(row, col);
+                }
+            }
+            tsi.inlinedShapeTransformMatrixIndex = -1;
+        }
+    }
+}
+
+
+/**
+   @return the index of a created ShapeInfo object. The return value is -1 if the creation fails.
+*/
+int ModelNodeSetHelper::createShapeInfo(VrmlShape* shapeNode)
+{
+    VrmlIndexedFaceSet* triangleMesh = dynamic_node_cast<VrmlIndexedFaceSet>(shapeNode->geometry).get();
+    if(!triangleMesh){
+        return -1;
+    }
+
+    int shapeInfoIndex = shapes->length();
+    shapes->length(shapeInfoIndex + 1);
+    ShapeInfo& shapeInfo = (*shapes)[shapeInfoIndex];
+
+    const MFVec3f& vertices = triangleMesh->coord->point;
+    size_t numVertices = vertices.size();
+    shapeInfo.vertices.length(numVertices * 3);
+    size_t pos = 0;
+    for(size_t i=0; i < numVertices; ++i){
+        const SFVec3f& v = vertices[i];
+        shapeInfo.vertices[pos++] = v[0];
+        shapeInfo.vertices[pos++] = v[1];
+        shapeInfo.vertices[pos++] = v[2];
+    }
+
+    // coordIndex has been converted to triangles terminated by -1 by TriangleMeshShaper
+    const MFInt32& indices = triangleMesh->coordIndex;
+    const size_t numTriangles = indices.size() / 4;
+    shapeInfo.triangles.length(numTriangles * 3);
+    int dpos = 0;
+    int spos = 0;
+    for(size_t i=0; i < numTriangles; ++i){
+        shapeInfo.triangles[dpos++] = indices[spos++];
+        shapeInfo.triangles[dpos++] = indices[spos++];
+        shapeInfo.triangles[dpos++] = indices[spos++];
+        spos++;
+    }
+
+    setPrimitiveProperties(shapeInfo, shapeNode);
+    shapeInfo.appearanceIndex = -1;
+    shapeInfoIndexMap.insert(make_pair(shapeNode, shapeInfoIndex));
+
+    return shapeInfoIndex;
+}
+
+
+void ModelNodeSetHelper::setPrimitiveProperties(ShapeInfo& shapeInfo, VrmlShape* shapeNode)
+{
+    shapeInfo.primitiveType = SP_MESH;
+    FloatSequence& param = shapeInfo.primitiveParameters;
+
+    VrmlNode* node = triangleMeshShaper.getOriginalGeometry(shapeNode).get();
+
+    if(VrmlBox* box = dynamic_cast<VrmlBox*>(node)){
+        shapeInfo.primitiveType = SP_BOX;
+        param.length(3);
+        for(int i=0; i < 3; ++i){
+            param[i] = box->size[i];
+        }
+    } else if(VrmlCone* cone = dynamic_cast<VrmlCone*>(node)){
+        shapeInfo.primitiveType = SP_CONE;
+        param.length(4);
+        param[0] = cone->bottomRadius;
+        param[1] = cone->height;
+        param[2] = cone->bottom ? 1.0 : 0.0;
+        param[3] = cone->side ? 1.0 : 0.0;
+    } else if(VrmlCylinder* cylinder = dynamic_cast<VrmlCylinder*>(node)){
+        shapeInfo.primitiveType = SP_CYLINDER;
+        param.length(5);
+        param[0] = cylinder->radius;
+        param[1] = cylinder->height;
+        param[2] = cylinder->top    ? 1.0 : 0.0;
+        param[3] = cylinder->bottom ? 1.0 : 0.0;
+        param[4] = cylinder->side   ? 1.0 : 0.0;
+    } else if(VrmlSphere* sphere = dynamic_cast<VrmlSphere*>(node)){
+        shapeInfo.primitiveType = SP_SPHERE;
+        param.length(1);
+        param[0] = sphere->radius;
+    } else if(VrmlProtoInstance* protoInstance = dynamic_cast<VrmlProtoInstance*>(node)){
+        if(protoInstance->proto->protoName == "Plane"){
+            if(VrmlBox* box = dynamic_cast<VrmlBox*>(protoInstance->actualNode.get())){
+                shapeInfo.primitiveType = SP_PLANE;
+                param.length(3);
+                for(int i=0; i < 3; ++i){
+                    param[i] = box->size[i];
+                }
+            }
+        }
+    }
+}
+
+
+bool hrp::loadBodyFromModelNodeSet(BodyPtr body, ModelNodeSet& modelNodeSet, bool loadGeometryForCollisionDetection, Link *(*f)())
+{
+    if(!modelNodeSet.humanoidNode() || !modelNodeSet.rootJointNodeSet()){
+        return false;
+    }
+    BinaryModelData data;
+    ModelNodeSetHelper helper(loadGeometryForCollisionDetection);
+    helper.createData(modelNodeSet, data);
+    return loadBodyFromBinaryModelData(body, data, loadGeometryForCollisionDetection, f);
+}
+
+
+bool hrp::loadBodyFromModelFile(BodyPtr body, const std::string& filename, bool loadGeometryForCollisionDetection, Link *(*f)())
+{
+    if(isBinaryModelFile(filename)){
+        return loadBodyFromBinaryModelFile(body, filename, loadGeometryForCollisionDetection, f);
+    }
+
+    ModelNodeSet modelNodeSet;
+    bool loaded = false;
+
+    try {
+        loaded = modelNodeSet.loadModelFile(filename);
+    } catch(const ModelNodeSet::Exception& ex){
+        cerr << ex.what() << endl;
+        cerr << "Retrying to load the file as a standard VRML file" << endl;
+        try {
+            VrmlParser parser;
+            parser.load(filename);
+            BinaryModelData data;
+            ModelNodeSetHelper helper(loadGeometryForCollisionDetection);
+            helper.createData(parser, data);
+            return loadBodyFromBinaryModelData(body, data, loadGeometryForCollisionDetection, f);
+        } catch(EasyScanner::Exception& ex){
+            cerr << ex.getFullMessage() << endl;
+            return false;
+        }
+    }
+
+    if(!loaded){
+        cerr << "The model file \"" << filename << "\" cannot be loaded." << endl;
+        return false;
+    }
+
+    try {
+        return loadBodyFromModelNodeSet(body, modelNodeSet, loadGeometryForCollisionDetection, f);
+    } catch(const ModelNodeSet::Exception& ex){
+        cerr << filename << ": " << ex.what() << endl;
+    }
+    return false;
+}
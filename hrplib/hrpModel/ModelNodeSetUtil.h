@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/**
+   @file
+   @brief Functions to construct a Body object directly from a VRML model file
+   without going through the ModelLoader server.
+*/
+
+#ifndef HRPMODEL_MODEL_NODE_SET_UTIL_H_INCLUDED
+#define HRPMODEL_MODEL_NODE_SET_UTIL_H_INCLUDED
+
+#include "Body.h"
+#include "ModelNodeSet.h"
+#include <string>
+
+namespace hrp
+{
+    /**
+       @if jp
+       ModelNodeSet に読み込まれたモデルから Body を構築する.
+       @else
+       Constructs a body from the nodes of a model which has been loaded into a ModelNodeSet.
+       The result is equivalent to the one of loadBodyFromBodyInfo() for a BodyInfo that the
+       ModelLoader server creates from the same file because both are built by LinkInfoBuilder.
+       @endif
+    */
+    HRPMODEL_API bool loadBodyFromModelNodeSet(BodyPtr body, ModelNodeSet& modelNodeSet, bool loadGeometryForCollisionDetection = false, Link *(*f)()=NULL);
+
+    /**
+       @if jp
+       VRML モデルファイルを読み込み Body を構築する. CORBA のサーバは使用しない.
+       @else
+       Loads a VRML model file and constructs a body in the current process.
+       A file which does not have the Humanoid node is loaded as a body which consists of a single fixed link.
+       A binary model file (see BinaryModelFile.h) is also accepted.
+       @endif
+    */
+    HRPMODEL_API bool loadBodyFromModelFile(BodyPtr body, const std::string& filename, bool loadGeometryForCollisionDetection = false, Link *(*f)()=NULL);
+};
+
+
+#endif
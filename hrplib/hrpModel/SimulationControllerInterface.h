@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief The definitions of the interface of controllers which are loaded as shared libraries
+   by the in-process simulation runner (openhrp-simulation-runner)
+
+   A controller library must export the following function.
+   \code
+   extern "C" hrp::SimulationControllerInterface* getHrpSimulationControllerInterface();
+   \endcode
+*/
+
+#ifndef HRPMODEL_SIMULATION_CONTROLLER_INTERFACE_H_INCLUDED
+#define HRPMODEL_SIMULATION_CONTROLLER_INTERFACE_H_INCLUDED
+
+namespace hrp {
+
+    class Body;
+
+    typedef void* SimulationControllerHandle;
+
+    /**
+       The controller is created for a body which has been registered to the world.
+       The controller reads the state and the sensor values of the body and writes joint torques (Link::u)
+       or, for joints in the high gain mode, joint values (Link::q, dq, ddq) directly.
+    */
+    typedef SimulationControllerHandle (*SimulationControllerCreateFunc)(Body* body, const char* modelName, double controlTimeStep);
+    typedef void (*SimulationControllerDestroyFunc)   (SimulationControllerHandle controllerHandle);
+    typedef void (*SimulationControllerInitializeFunc)(SimulationControllerHandle controllerHandle);
+    typedef void (*SimulationControllerControlFunc)   (SimulationControllerHandle controllerHandle, double time);
+
+    static const int SIMULATION_CONTROLLER_INTERFACE_VERSION = 1;
+
+    struct SimulationControllerInterface
+    {
+        int version;
+
+        SimulationControllerCreateFunc create;
+        SimulationControllerDestroyFunc destroy;
+        SimulationControllerInitializeFunc initialize; ///< can be null
+        SimulationControllerControlFunc control;
+    };
+
+    typedef SimulationControllerInterface* (*GetSimulationControllerInterfaceFunc)();
+}
+
+#endif
@@ -0,0 +1,701 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+#include "WorldStateLog.h"
+#include "Body.h"
+#include "Link.h"
+#include "Sensor.h"
+#include <hrpCorba/OpenHRPCommon.hh>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <boost/version.hpp>
+#include <boost/assert.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+
+#if BOOST_VERSION >= 105300
+#include <boost/lockfree/spsc_queue.hpp>
+#else
+#include <deque>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace hrp;
+
+
+namespace {
+
+    const char magic[8] = { 'H', 'R', 'P', 'W', 'S', 'L', 'O', 'G' };
+    const boost::uint32_t logVersion = 1;
+
+    struct LogHeader
+    {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t numBodies;
+        boost::uint64_t numFrames;
+        boost::uint64_t indexOffset;
+        double timeStep;
+        boost::uint64_t firstFrameOffset;
+    };
+
+    struct LogBodyHeader
+    {
+        boost::int32_t numLinks;
+        boost::int32_t numJoints;
+        boost::int32_t numSensorValues;
+        boost::int32_t nameLength;
+    };
+
+    /// the number of frame buffers which can be queued at the same time
+    const size_t maxQueuedFrames = 1024;
+
+    inline size_t align8(size_t size)
+    {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    int numSensorValues(Body* body)
+    {
+        return body->numSensors(Sensor::FORCE) * 6 +
+            body->numSensors(Sensor::RATE_GYRO) * 3 +
+            body->numSensors(Sensor::ACCELERATION) * 3;
+    }
+
+    typedef std::vector<char> FrameBuffer;
+
+#if BOOST_VERSION >= 105300
+
+    /**
+       single producer / single consumer queue of frame buffers
+    */
+    class FrameQueue
+    {
+    public:
+        FrameQueue() : queue(maxQueuedFrames) { }
+        bool push(FrameBuffer* buf) { return queue.push(buf); }
+        bool pop(FrameBuffer*& buf) { return queue.pop(buf); }
+    private:
+        boost::lockfree::spsc_queue<FrameBuffer*> queue;
+    };
+
+#else
+
+    class FrameQueue
+    {
+    public:
+        bool push(FrameBuffer* buf) {
+            boost::mutex::scoped_lock lock(mutex);
+            if(queue.size() >= maxQueuedFrames){
+                return false;
+            }
+            queue.push_back(buf);
+            return true;
+        }
+        bool pop(FrameBuffer*& buf) {
+            boost::mutex::scoped_lock lock(mutex);
+            if(queue.empty()){
+                return false;
+            }
+            buf = queue.front();
+            queue.pop_front();
+            return true;
+        }
+    private:
+        boost::mutex mutex;
+        std::deque<FrameBuffer*> queue;
+    };
+
+#endif
+}
+
+
+namespace hrp {
+
+    class WorldStateLogWriterImpl
+    {
+    public:
+        WorldStateLogWriterImpl();
+        ~WorldStateLogWriterImpl();
+
+        bool open(const std::string& filename, WorldBase& world, double logTimeStep);
+        void put(WorldBase& world, const OpenHRP::CollisionSequence* collisions);
+        void close();
+
+        std::ofstream file;
+        bool isOpen;
+        size_t fixedFrameSize;
+        int numDroppedFrames;
+
+        FrameQueue filledFrames;
+        FrameQueue freeFrames;
+        size_t numAllocatedFrames;
+
+        boost::thread* writerThread;
+        boost::mutex stopMutex;
+        bool isStopRequested;
+
+        // accessed only by the writer thread until it is joined
+        boost::uint64_t fileOffset;
+        std::vector<boost::uint64_t> frameOffsets;
+
+        struct PairIndices {
+            boost::int32_t bodyIndex[2];
+            boost::int32_t linkIndex[2];
+        };
+        std::vector<PairIndices> pairIndices;
+
+        FrameBuffer* getFrameBuffer();
+        void resolvePairIndices(WorldBase& world, const OpenHRP::CollisionSequence& collisions);
+        void writeFrames();
+        bool writeQueuedFrames();
+    };
+}
+
+
+WorldStateLogWriterImpl::WorldStateLogWriterImpl()
+{
+    isOpen = false;
+    fixedFrameSize = 0;
+    numDroppedFrames = 0;
+    numAllocatedFrames = 0;
+    writerThread = 0;
+    isStopRequested = false;
+    fileOffset = 0;
+}
+
+
+WorldStateLogWriterImpl::~WorldStateLogWriterImpl()
+{
+    close();
+}
+
+
+bool WorldStateLogWriterImpl::open(const std::string& filename, WorldBase& world, double logTimeStep)
+{
+    close();
+
+    file.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!file){
+        cerr << "cannot open the log file " << filename << endl;
+        return false;
+    }
+
+    vector<char> header(sizeof(LogHeader));
+    size_t frameSize = sizeof(double); // time
+
+    for(int i=0; i < world.numBodies(); ++i){
+        BodyPtr body = world.body(i);
+        LogBodyHeader bodyHeader;
+        bodyHeader.numLinks = body->numLinks();
+        bodyHeader.numJoints = body->numJoints();
+        bodyHeader.numSensorValues = numSensorValues(body.get());
+        const string& name = body->name();
+        bodyHeader.nameLength = name.size();
+
+        size_t pos = header.size();
+        header.resize(pos + sizeof(LogBodyHeader) + align8(name.size()), 0);
+        memcpy(&header[pos], &bodyHeader, sizeof(LogBodyHeader));
+        memcpy(&header[pos + sizeof(LogBodyHeader)], name.c_str(), name.size());
+
+        frameSize += sizeof(double) *
+            (bodyHeader.numLinks * 12 + bodyHeader.numJoints * 3 + bodyHeader.numSensorValues);
+    }
+    fixedFrameSize = frameSize + sizeof(boost::uint64_t); // the number of contacts
+
+    LogHeader logHeader;
+    memcpy(logHeader.magic, magic, sizeof(magic));
+    logHeader.version = logVersion;
+    logHeader.numBodies = world.numBodies();
+    logHeader.numFrames = 0;
+    logHeader.indexOffset = 0;
+    logHeader.timeStep = logTimeStep;
+    logHeader.firstFrameOffset = header.size();
+    memcpy(&header[0], &logHeader, sizeof(LogHeader));
+
+    file.write(&header[0], header.size());
+    fileOffset = header.size();
+    frameOffsets.clear();
+    pairIndices.clear();
+    numDroppedFrames = 0;
+
+    isStopRequested = false;
+    writerThread = new boost::thread(boost::bind(&WorldStateLogWriterImpl::writeFrames, this));
+    isOpen = true;
+
+    return true;
+}
+
+
+FrameBuffer* WorldStateLogWriterImpl::getFrameBuffer()
+{
+    FrameBuffer* buf;
+    if(freeFrames.pop(buf)){
+        return buf;
+    }
+    if(numAllocatedFrames < maxQueuedFrames){
+        ++numAllocatedFrames;
+        return new FrameBuffer();
+    }
+    return 0;
+}
+
+
+void WorldStateLogWriterImpl::resolvePairIndices(WorldBase& world, const OpenHRP::CollisionSequence& collisions)
+{
+    int n = collisions.length();
+    pairIndices.resize(n);
+    for(int i=0; i < n; ++i){
+        const OpenHRP::LinkPair& pair = collisions[i].pair;
+        const char* charNames[2] = { pair.charName1, pair.charName2 };
+        const char* linkNames[2] = { pair.linkName1, pair.linkName2 };
+        for(int j=0; j < 2; ++j){
+            PairIndices& indices = pairIndices[i];
+            indices.bodyIndex[j] = world.bodyIndex(charNames[j]);
+            indices.linkIndex[j] = -1;
+            if(indices.bodyIndex[j] >= 0){
+                Link* link = world.body(indices.bodyIndex[j])->link(linkNames[j]);
+                if(link){
+                    indices.linkIndex[j] = link->index;
+                }
+            }
+        }
+    }
+}
+
+
+void WorldStateLogWriterImpl::put(WorldBase& world, const OpenHRP::CollisionSequence* collisions)
+{
+    if(!isOpen){
+        return;
+    }
+
+    FrameBuffer* buf = getFrameBuffer();
+    if(!buf){
+        ++numDroppedFrames;
+        return;
+    }
+
+    size_t numContacts = 0;
+    if(collisions){
+        if(static_cast<int>(pairIndices.size()) != static_cast<int>(collisions->length())){
+            resolvePairIndices(world, *collisions);
+        }
+        for(unsigned int i=0; i < collisions->length(); ++i){
+            numContacts += (*collisions)[i].points.length();
+        }
+    }
+    buf->resize(fixedFrameSize + numContacts * sizeof(WorldStateLogContact));
+
+    double* v = reinterpret_cast<double*>(&(*buf)[0]);
+    *v++ = world.currentTime();
+
+    for(int i=0; i < world.numBodies(); ++i){
+        Body* body = world.body(i).get();
+        for(int j=0; j < body->numLinks(); ++j){
+            Link* link = body->link(j);
+            Matrix33 R(link->attitude());
+            *v++ = link->p(0); *v++ = link->p(1); *v++ = link->p(2);
+            for(int k=0; k < 3; ++k){
+                *v++ = R(k, 0); *v++ = R(k, 1); *v++ = R(k, 2);
+            }
+        }
+        for(int j=0; j < body->numJoints(); ++j){
+            Link* joint = body->joint(j);
+            if(joint){
+                *v++ = joint->q; *v++ = joint->dq; *v++ = joint->u;
+            } else {
+                *v++ = 0.0; *v++ = 0.0; *v++ = 0.0;
+            }
+        }
+        for(int j=0; j < body->numSensors(Sensor::FORCE); ++j){
+            ForceSensor* s = body->sensor<ForceSensor>(j);
+            for(int k=0; k < 3; ++k){ *v++ = s ? s->f(k) : 0.0; }
+            for(int k=0; k < 3; ++k){ *v++ = s ? s->tau(k) : 0.0; }
+        }
+        for(int j=0; j < body->numSensors(Sensor::RATE_GYRO); ++j){
+            RateGyroSensor* s = body->sensor<RateGyroSensor>(j);
+            for(int k=0; k < 3; ++k){ *v++ = s ? s->w(k) : 0.0; }
+        }
+        for(int j=0; j < body->numSensors(Sensor::ACCELERATION); ++j){
+            AccelSensor* s = body->sensor<AccelSensor>(j);
+            for(int k=0; k < 3; ++k){ *v++ = s ? s->dv(k) : 0.0; }
+        }
+    }
+
+    boost::uint64_t n = numContacts;
+    memcpy(v, &n, sizeof(n));
+
+    if(numContacts > 0){
+        WorldStateLogContact* contact =
+            reinterpret_cast<WorldStateLogContact*>(&(*buf)[fixedFrameSize]);
+        for(unsigned int i=0; i < collisions->length(); ++i){
+            const OpenHRP::Collision& collision = (*collisions)[i];
+            const PairIndices& indices = pairIndices[i];
+            for(unsigned int j=0; j < collision.points.length(); ++j){
+                const OpenHRP::CollisionPoint& point = collision.points[j];
+                for(int k=0; k < 2; ++k){
+                    contact->bodyIndex[k] = indices.bodyIndex[k];
+                    contact->linkIndex[k] = indices.linkIndex[k];
+                }
+                for(int k=0; k < 3; ++k){
+                    contact->position[k] = point.position[k];
+                    contact->normal[k] = point.normal[k];
+                }
+                contact->depth = point.idepth;
+                ++contact;
+            }
+        }
+    }
+
+    // the push never fails because the number of buffers is limited to the queue capacity
+    BOOST_VERIFY(filledFrames.push(buf));
+}
+
+
+bool WorldStateLogWriterImpl::writeQueuedFrames()
+{
+    bool written = false;
+    FrameBuffer* buf;
+    while(filledFrames.pop(buf)){
+        file.write(&(*buf)[0], buf->size());
+        frameOffsets.push_back(fileOffset);
+        fileOffset += buf->size();
+        freeFrames.push(buf);
+        written = true;
+    }
+    return written;
+}
+
+
+void WorldStateLogWriterImpl::writeFrames()
+{
+    while(true){
+        if(!writeQueuedFrames()){
+            {
+                boost::mutex::scoped_lock lock(stopMutex);
+                if(isStopRequested){
+                    break;
+                }
+            }
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+    }
+    writeQueuedFrames();
+}
+
+
+void WorldStateLogWriterImpl::close()
+{
+    if(!isOpen){
+        return;
+    }
+
+    {
+        boost::mutex::scoped_lock lock(stopMutex);
+        isStopRequested = true;
+    }
+    writerThread->join();
+    delete writerThread;
+    writerThread = 0;
+
+    boost::uint64_t indexOffset = fileOffset;
+    if(!frameOffsets.empty()){
+        file.write(reinterpret_cast<const char*>(&frameOffsets[0]),
+                   frameOffsets.size() * sizeof(boost::uint64_t));
+    }
+
+    // numFrames and indexOffset in the header
+    boost::uint64_t numFrames = frameOffsets.size();
+    file.seekp(offsetof(LogHeader, numFrames));
+    file.write(reinterpret_cast<const char*>(&numFrames), sizeof(numFrames));
+    file.write(reinterpret_cast<const char*>(&indexOffset), sizeof(indexOffset));
+    file.close();
+
+    FrameBuffer* buf;
+    while(freeFrames.pop(buf)){
+        delete buf;
+    }
+    numAllocatedFrames = 0;
+
+    if(numDroppedFrames > 0){
+        cerr << "WorldStateLogWriter: " << numDroppedFrames
+             << " frames were dropped because the log writing did not catch up" << endl;
+    }
+
+    isOpen = false;
+}
+
+
+WorldStateLogWriter::WorldStateLogWriter()
+{
+    impl = new WorldStateLogWriterImpl();
+}
+
+
+WorldStateLogWriter::~WorldStateLogWriter()
+{
+    delete impl;
+}
+
+
+bool WorldStateLogWriter::open(const std::string& filename, WorldBase& world, double logTimeStep)
+{
+    return impl->open(filename, world, logTimeStep);
+}
+
+
+bool WorldStateLogWriter::isOpen() const
+{
+    return impl->isOpen;
+}
+
+
+void WorldStateLogWriter::put(WorldBase& world)
+{
+    impl->put(world, 0);
+}
+
+
+void WorldStateLogWriter::put(WorldBase& world, const OpenHRP::CollisionSequence& collisions)
+{
+    impl->put(world, &collisions);
+}
+
+
+void WorldStateLogWriter::close()
+{
+    impl->close();
+}
+
+
+int WorldStateLogWriter::numDroppedFrames() const
+{
+    return impl->numDroppedFrames;
+}
+
+
+WorldStateLog::WorldStateLog()
+{
+    data = 0;
+    size = 0;
+    numFrames_ = 0;
+    timeStep_ = 0.0;
+    fixedFrameSize = 0;
+    frameOffsets = 0;
+}
+
+
+WorldStateLog::~WorldStateLog()
+{
+    close();
+}
+
+
+bool WorldStateLog::open(const std::string& filename)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE){
+        cerr << "cannot open the log file " << filename << endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<size_t>(fileSize.QuadPart);
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(!mapping){
+        cerr << "cannot map the log file " << filename << endl;
+        return false;
+    }
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0){
+        cerr << "cannot open the log file " << filename << endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0){
+        size = st.st_size;
+        void* p = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+        data = (p != MAP_FAILED) ? static_cast<const char*>(p) : 0;
+    }
+    ::close(fd);
+#endif
+
+    if(!data){
+        cerr << "cannot map the log file " << filename << endl;
+        size = 0;
+        return false;
+    }
+
+    if(!readHeader()){
+        cerr << filename << " is not a valid world state log" << endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void WorldStateLog::close()
+{
+    if(data){
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<char*>(data), size);
+#endif
+        data = 0;
+    }
+    size = 0;
+    bodies.clear();
+    numFrames_ = 0;
+    frameOffsets = 0;
+    scannedFrameOffsets.clear();
+}
+
+
+bool WorldStateLog::readHeader()
+{
+    if(size < sizeof(LogHeader)){
+        return false;
+    }
+    const LogHeader* header = reinterpret_cast<const LogHeader*>(data);
+    if(memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != logVersion){
+        return false;
+    }
+    timeStep_ = header->timeStep;
+
+    size_t pos = sizeof(LogHeader);
+    int offset = 1; // time
+    for(boost::uint32_t i=0; i < header->numBodies; ++i){
+        if(pos + sizeof(LogBodyHeader) > size){
+            return false;
+        }
+        const LogBodyHeader* bodyHeader = reinterpret_cast<const LogBodyHeader*>(data + pos);
+        pos += sizeof(LogBodyHeader);
+        if(pos + bodyHeader->nameLength > size){
+            return false;
+        }
+        BodyEntry entry;
+        entry.name.assign(data + pos, bodyHeader->nameLength);
+        entry.numLinks = bodyHeader->numLinks;
+        entry.numJoints = bodyHeader->numJoints;
+        entry.numSensorValues = bodyHeader->numSensorValues;
+        entry.offset = offset;
+        offset += entry.numLinks * 12 + entry.numJoints * 3 + entry.numSensorValues;
+        bodies.push_back(entry);
+        pos += align8(bodyHeader->nameLength);
+    }
+    fixedFrameSize = offset * sizeof(double) + sizeof(boost::uint64_t);
+
+    if(header->indexOffset > 0 &&
+       header->indexOffset + header->numFrames * sizeof(boost::uint64_t) <= size){
+        numFrames_ = header->numFrames;
+        frameOffsets = reinterpret_cast<const boost::uint64_t*>(data + header->indexOffset);
+    } else {
+        // the writer did not finish. the index is rebuilt from the frames.
+        scanFrames(header->firstFrameOffset);
+    }
+
+    return true;
+}
+
+
+void WorldStateLog::scanFrames(size_t firstFrameOffset)
+{
+    scannedFrameOffsets.clear();
+    boost::uint64_t pos = firstFrameOffset;
+    while(pos + fixedFrameSize <= size){
+        boost::uint64_t numContacts;
+        memcpy(&numContacts, data + pos + fixedFrameSize - sizeof(boost::uint64_t), sizeof(numContacts));
+        boost::uint64_t frameSize = fixedFrameSize + numContacts * sizeof(WorldStateLogContact);
+        if(pos + frameSize > size){
+            break;
+        }
+        scannedFrameOffsets.push_back(pos);
+        pos += frameSize;
+    }
+    numFrames_ = scannedFrameOffsets.size();
+    frameOffsets = scannedFrameOffsets.empty() ? 0 : &scannedFrameOffsets[0];
+}
+
+
+int WorldStateLog::frameIndex(double t) const
+{
+    if(numFrames_ == 0){
+        return -1;
+    }
+
+    int index;
+    if(timeStep_ > 0.0){
+        index = static_cast<int>(floor((t - time(0)) / timeStep_ + 0.5));
+        index = std::max(0, std::min(index, numFrames_ - 1));
+        // corrects the small deviation of the actual frame times
+        while(index + 1 < numFrames_ && fabs(time(index + 1) - t) < fabs(time(index) - t)){
+            ++index;
+        }
+        while(index > 0 && fabs(time(index - 1) - t) < fabs(time(index) - t)){
+            --index;
+        }
+    } else {
+        int lower = 0;
+        int upper = numFrames_ - 1;
+        while(lower < upper){
+            int middle = (lower + upper) / 2;
+            if(time(middle) < t){
+                lower = middle + 1;
+            } else {
+                upper = middle;
+            }
+        }
+        index = lower;
+        if(index > 0 && fabs(time(index - 1) - t) < fabs(time(index) - t)){
+            --index;
+        }
+    }
+    return index;
+}
+
+
+int WorldStateLog::numContacts(int frame) const
+{
+    boost::uint64_t n;
+    memcpy(&n, data + frameOffsets[frame] + fixedFrameSize - sizeof(boost::uint64_t), sizeof(n));
+    return static_cast<int>(n);
+}
+
+
+const WorldStateLogContact* WorldStateLog::contacts(int frame) const
+{
+    return reinterpret_cast<const WorldStateLogContact*>(data + frameOffsets[frame] + fixedFrameSize);
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief Binary log of world states which can be memory-mapped and accessed at random
+
+   A log file consists of the header, frames and the frame index.
+
+   - Header: magic "HRPWSLOG", version, the number of bodies, the number of frames,
+     the offset of the frame index, the log time step, the offset of the first frame
+     and, for each body, the number of links, joints and sensor values and the body name.
+   - Frame: time, and for each body the position p[3] and the attitude R[9] (row major) of each link,
+     q, dq and u of each joint and the values of force (f, tau), rate gyro (w) and acceleration (dv)
+     sensors ordered by sensor id. The part is followed by the number of contact points
+     and the contact points (WorldStateLogContact).
+   - Frame index: the file offsets of all the frames.
+
+   All the values are native-endian and aligned to 8 bytes.
+*/
+
+#ifndef HRPMODEL_WORLD_STATE_LOG_H_INCLUDED
+#define HRPMODEL_WORLD_STATE_LOG_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "World.h"
+#include "Config.h"
+
+namespace OpenHRP {
+    class CollisionSequence;
+}
+
+namespace hrp {
+
+    struct WorldStateLogContact
+    {
+        boost::int32_t bodyIndex[2];
+        boost::int32_t linkIndex[2];
+        double position[3];
+        double normal[3];
+        double depth;
+    };
+
+    class WorldStateLogWriterImpl;
+
+    /**
+       @brief Writer of the world state log.
+
+       put() only copies the state into a frame buffer and queues it.
+       The frame is written to the file by a background thread so that the simulation loop is not stalled by disk I/O.
+    */
+    class HRPMODEL_API WorldStateLogWriter
+    {
+    public:
+        WorldStateLogWriter();
+        ~WorldStateLogWriter();
+
+        /**
+           @param logTimeStep interval of frames. This is used to find a frame from time without search.
+           @note The bodies of the world must not be changed until close() is called.
+        */
+        bool open(const std::string& filename, WorldBase& world, double logTimeStep);
+        bool isOpen() const;
+
+        void put(WorldBase& world);
+
+        /**
+           @param collisions collisions which are given to World::calcNextState()
+        */
+        void put(WorldBase& world, const OpenHRP::CollisionSequence& collisions);
+
+        /**
+           writes the remaining frames and the frame index, and closes the file
+        */
+        void close();
+
+        /// the number of frames which were dropped because the writer thread did not catch up
+        int numDroppedFrames() const;
+
+    private:
+        WorldStateLogWriterImpl* impl;
+    };
+
+
+    /**
+       @brief Reader of the world state log. The file is memory-mapped.
+    */
+    class HRPMODEL_API WorldStateLog
+    {
+    public:
+        WorldStateLog();
+        ~WorldStateLog();
+
+        bool open(const std::string& filename);
+        void close();
+
+        int numBodies() const { return bodies.size(); }
+        const std::string& bodyName(int bodyIndex) const { return bodies[bodyIndex].name; }
+        int numLinks(int bodyIndex) const { return bodies[bodyIndex].numLinks; }
+        int numJoints(int bodyIndex) const { return bodies[bodyIndex].numJoints; }
+        int numSensorValues(int bodyIndex) const { return bodies[bodyIndex].numSensorValues; }
+
+        int numFrames() const { return numFrames_; }
+        double timeStep() const { return timeStep_; }
+
+        /**
+           @return the index of the frame whose time is the nearest to the given time.
+           The index is computed from the log time step, so the cost does not depend on the number of frames.
+        */
+        int frameIndex(double time) const;
+
+        double time(int frame) const { return frameData(frame)[0]; }
+
+        /// 12 values (p[3], R[9]) per link
+        const double* linkPositions(int frame, int bodyIndex) const {
+            return frameData(frame) + bodies[bodyIndex].offset;
+        }
+        /// 3 values (q, dq, u) per joint
+        const double* jointValues(int frame, int bodyIndex) const {
+            return linkPositions(frame, bodyIndex) + bodies[bodyIndex].numLinks * 12;
+        }
+        const double* sensorValues(int frame, int bodyIndex) const {
+            return jointValues(frame, bodyIndex) + bodies[bodyIndex].numJoints * 3;
+        }
+
+        int numContacts(int frame) const;
+        const WorldStateLogContact* contacts(int frame) const;
+
+    private:
+        struct BodyEntry {
+            std::string name;
+            int numLinks;
+            int numJoints;
+            int numSensorValues;
+            int offset; ///< offset from the top of a frame in doubles
+        };
+        std::vector<BodyEntry> bodies;
+
+        const char* data;
+        size_t size;
+
+        int numFrames_;
+        double timeStep_;
+        size_t fixedFrameSize;
+        const boost::uint64_t* frameOffsets;
+        std::vector<boost::uint64_t> scannedFrameOffsets;
+
+        const double* frameData(int frame) const {
+            return reinterpret_cast<const double*>(data + frameOffsets[frame]);
+        }
+        bool readHeader();
+        void scanFrames(size_t firstFrameOffset);
+    };
+}
+
+#endif
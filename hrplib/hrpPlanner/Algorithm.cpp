@@ -12,6 +12,7 @@ Algorithm::Algorithm(PathPlanner* planner)
     isRunning_(false), planner_(planner), verbose_(false)
 {
   properties_["interpolation-distance"] = "0.1"; 
+  properties_["edge-check"] = "bisection";
   roadmap_ = RoadmapPtr(new Roadmap(planner_));
 }
 
@@ -66,6 +67,13 @@ bool Algorithm::preparePlanning()
   isRunning_ = true;
 
   Mobility::interpolationDistance(atof(properties_["interpolation-distance"].c_str()));
+  if (properties_["edge-check"] == "uniform"){
+      Mobility::edgeCheckMode(Mobility::UniformCheck);
+  }else if (properties_["edge-check"] == "clearance"){
+      Mobility::edgeCheckMode(Mobility::ClearanceCheck);
+  }else{
+      Mobility::edgeCheckMode(Mobility::BisectionCheck);
+  }
 #if 1
   std::map<std::string, std::string>::iterator it;
   it = properties_.begin();
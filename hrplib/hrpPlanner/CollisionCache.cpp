@@ -0,0 +1,136 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*-
+#include "ConfigurationSpace.h"
+#include "CollisionCache.h"
+#define _USE_MATH_DEFINES // for MSVC
+#include <math.h>
+
+using namespace PathEngine;
+
+CollisionCache::CollisionCache(ConfigurationSpace *i_cspace, unsigned int i_capacity,
+                               double i_resolution)
+    : m_capacity(i_capacity), m_resolution(i_resolution), m_hits(0), m_misses(0)
+{
+    m_isCircular.resize(i_cspace->size());
+    for (unsigned int i=0; i<i_cspace->size(); i++){
+        m_isCircular[i] = i_cspace->unboundedRotation(i);
+    }
+}
+
+void CollisionCache::quantize(const Configuration& i_cfg, Key &o_key) const
+{
+    o_key.resize(i_cfg.size());
+    for (unsigned int i=0; i<i_cfg.size(); i++){
+        double v = i_cfg[i];
+        if (i < m_isCircular.size() && m_isCircular[i]){
+            v = fmod(v, 2*M_PI);
+            if (v < 0) v += 2*M_PI;
+        }
+        o_key[i] = (boost::int64_t)floor(v/m_resolution + 0.5);
+    }
+}
+
+CollisionCache::Entry *CollisionCache::find(const Key& i_key)
+{
+    EntryMap::iterator it = m_map.find(i_key);
+    if (it == m_map.end()) return NULL;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &m_entries.front();
+}
+
+CollisionCache::Entry *CollisionCache::add(const Key& i_key)
+{
+    Entry *entry = find(i_key);
+    if (entry) return entry;
+    if (m_capacity == 0) return NULL;
+
+    if (m_entries.size() >= m_capacity){
+        m_map.erase(m_entries.back().key);
+        m_entries.pop_back();
+    }
+    Entry e;
+    e.key = i_key;
+    e.isColliding = false;
+    e.hasClearance = false;
+    e.clearance = 0;
+    m_entries.push_front(e);
+    m_map[i_key] = m_entries.begin();
+    return &m_entries.front();
+}
+
+bool CollisionCache::findCollision(const Configuration& i_cfg, bool &o_isColliding)
+{
+    Key key;
+    quantize(i_cfg, key);
+    boost::mutex::scoped_lock lock(m_mutex);
+    Entry *entry = find(key);
+    if (!entry){
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    o_isColliding = entry->isColliding;
+    return true;
+}
+
+bool CollisionCache::findClearance(const Configuration& i_cfg, double &o_clearance)
+{
+    Key key;
+    quantize(i_cfg, key);
+    boost::mutex::scoped_lock lock(m_mutex);
+    Entry *entry = find(key);
+    // the clearance of a colliding configuration is known without computing
+    if (!entry || (!entry->hasClearance && !entry->isColliding)){
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    o_clearance = entry->isColliding ? -1 : entry->clearance;
+    return true;
+}
+
+void CollisionCache::addCollision(const Configuration& i_cfg, bool i_isColliding)
+{
+    Key key;
+    quantize(i_cfg, key);
+    boost::mutex::scoped_lock lock(m_mutex);
+    Entry *entry = add(key);
+    if (entry) entry->isColliding = i_isColliding;
+}
+
+void CollisionCache::addClearance(const Configuration& i_cfg, double i_clearance)
+{
+    Key key;
+    quantize(i_cfg, key);
+    boost::mutex::scoped_lock lock(m_mutex);
+    Entry *entry = add(key);
+    if (entry){
+        entry->isColliding = i_clearance < 0;
+        entry->hasClearance = true;
+        entry->clearance = i_clearance;
+    }
+}
+
+void CollisionCache::clear()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_entries.clear();
+    m_map.clear();
+}
+
+unsigned int CollisionCache::size()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_entries.size();
+}
+
+unsigned long CollisionCache::numHits()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_hits;
+}
+
+unsigned long CollisionCache::numMisses()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_misses;
+}
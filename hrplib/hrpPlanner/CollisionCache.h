@@ -0,0 +1,125 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*-
+#ifndef __COLLISION_CACHE_H__
+#define __COLLISION_CACHE_H__
+
+#include <vector>
+#include <list>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include "exportdef.h"
+#include "Configuration.h"
+
+namespace PathEngine {
+    class ConfigurationSpace;
+
+    /**
+       @brief cache of the results of collision checks
+
+       The configurations are quantized by a resolution, and the configurations
+       which are quantized to the same values share the result. The unbounded
+       rotations are taken modulo 2pi. The least recently used results are
+       removed when the number of results exceeds the capacity. The cache can be
+       shared by the planners of several threads.
+    */
+    class HRPPLANNER_API CollisionCache
+    {
+    public:
+        /**
+           @brief constructor
+           @param i_cspace configuration space whose unbounded rotations are used
+           @param i_capacity maximum number of results
+           @param i_resolution quantization step of each degree of freedom
+        */
+        CollisionCache(ConfigurationSpace *i_cspace, unsigned int i_capacity,
+                       double i_resolution);
+
+        /**
+           @brief find the result of a collision check
+           @param i_cfg configuration
+           @param o_isColliding true if the configuration collides
+           @return true if the result is found
+        */
+        bool findCollision(const Configuration& i_cfg, bool &o_isColliding);
+
+        /**
+           @brief find the clearance
+           @param i_cfg configuration
+           @param o_clearance clearance. negative if the configuration collides
+           @return true if the clearance is found
+        */
+        bool findClearance(const Configuration& i_cfg, double &o_clearance);
+
+        /**
+           @brief store the result of a collision check
+           @param i_cfg configuration
+           @param i_isColliding true if the configuration collides
+        */
+        void addCollision(const Configuration& i_cfg, bool i_isColliding);
+
+        /**
+           @brief store the clearance
+           @param i_cfg configuration
+           @param i_clearance clearance. negative if the configuration collides
+        */
+        void addClearance(const Configuration& i_cfg, double i_clearance);
+
+        /**
+           @brief get the quantization step
+           @return the quantization step of each degree of freedom
+        */
+        double resolution() const { return m_resolution; }
+
+        /**
+           @brief remove all the results. The statistics are kept
+        */
+        void clear();
+
+        /**
+           @brief get the number of the stored results
+           @return the number of the stored results
+        */
+        unsigned int size();
+
+        /**
+           @brief get the number of the queries whose results were found
+           @return the number of hits
+        */
+        unsigned long numHits();
+
+        /**
+           @brief get the number of the queries whose results were not found
+           @return the number of misses
+        */
+        unsigned long numMisses();
+
+    private:
+        typedef std::vector<boost::int64_t> Key;
+        struct Entry {
+            Key key;
+            bool isColliding;
+            bool hasClearance;
+            double clearance;
+        };
+        typedef std::list<Entry> EntryList;
+        typedef boost::unordered_map<Key, EntryList::iterator> EntryMap;
+
+        void quantize(const Configuration& i_cfg, Key &o_key) const;
+        Entry *find(const Key& i_key);
+        Entry *add(const Key& i_key);
+
+        unsigned int m_capacity;
+        double m_resolution;
+        std::vector<bool> m_isCircular;
+        boost::mutex m_mutex;
+        // the most recently used result comes first
+        EntryList m_entries;
+        EntryMap m_map;
+        unsigned long m_hits, m_misses;
+    };
+
+    typedef boost::shared_ptr<CollisionCache> CollisionCachePtr;
+};
+
+#endif
@@ -61,15 +61,25 @@ double& ConfigurationSpace::ubound(unsigned int i_rank)
     return m_ubounds[i_rank];
 }
 
+static double uniformRand()
+{
+    return rand()/(double)RAND_MAX;
+}
+
 Configuration ConfigurationSpace::random()
+{
+    return random(uniformRand);
+}
+
+Configuration ConfigurationSpace::random(const boost::function0<double>& i_uniform)
 {
     Configuration cfg(m_size);
     for (unsigned int i=0; i<m_size; i++){
         if (m_isUnboundedRotation[i]){
-            cfg.value(i) = (rand()/(double)RAND_MAX) * 2 * M_PI;
+            cfg.value(i) = i_uniform() * 2 * M_PI;
         }else{
             double delta = m_ubounds[i] - m_lbounds[i];
-            cfg.value(i) = (rand()/(double)RAND_MAX) * delta + m_lbounds[i];
+            cfg.value(i) = i_uniform() * delta + m_lbounds[i];
         }
     }
     return cfg;
@@ -5,6 +5,7 @@
 #include "exportdef.h"
 #include <vector>
 #include <iostream>
+#include <boost/function.hpp>
 
 namespace PathEngine {
     class Configuration;
@@ -73,6 +74,13 @@ namespace PathEngine {
          */
         Configuration random();
 
+        /**
+         * @brief generate random position from the given random numbers
+         * @param i_uniform function which returns a random number in [0, 1]
+         * @return generated position
+         */
+        Configuration random(const boost::function0<double>& i_uniform);
+
         /**
            @brief get the number of degrees of freedom
            @return the number of degrees of freedom
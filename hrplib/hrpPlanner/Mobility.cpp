@@ -1,13 +1,20 @@
+#include <algorithm>
+#include <math.h>
 #include "PathPlanner.h"
 #include "Mobility.h"
 
 using namespace PathEngine;
 
 double Mobility::interpolationDistance_ = 0.1;
+Mobility::EdgeCheckMode Mobility::edgeCheckMode_ = Mobility::BisectionCheck;
 
 bool Mobility::isReachable(Configuration& from, Configuration& to,
                            bool checkCollision) const
 {
+    if (checkCollision && edgeCheckMode_ != UniformCheck){
+        return isReachableByBisection(from, to);
+    }
+
     std::vector<Configuration> path;
     if (!getPath(from, to, path)) return false;
 #if 0
@@ -23,6 +30,58 @@ bool Mobility::isReachable(Configuration& from, Configuration& to,
     }
 }
 
+bool Mobility::isReachableByBisection(const Configuration& from,
+                                      const Configuration& to) const
+{
+    // getPath()と同じく、i/n (i=0,...,n)の位置を検査する
+    double d = distance(from, to);
+    unsigned int n = (unsigned int)(d/interpolationDistance())+1;
+    double step = d/n;
+    bool useClearance = edgeCheckMode_ == ClearanceCheck && isInterpolationBoundedByDistance();
+
+    // 両端から干渉しないことが保証された点は検査しない
+    unsigned int lo = 0, hi = n;
+    double k = checkPoint(to, step, useClearance);
+    if (k < 0) return false;
+    hi -= (unsigned int)std::min(k, (double)hi);
+    if (useClearance){
+        k = checkPoint(from, step, useClearance);
+        if (k < 0) return false;
+        lo += (unsigned int)std::min(k, (double)hi);
+    }
+
+    if (buffer_.size() != from.size()) buffer_ = Configuration(from.size());
+    // 幅優先で区間を二分していくと、中点はvan der Corput列の順に並ぶ
+    intervals_.clear();
+    if (hi > lo + 1) intervals_.push_back(std::make_pair(lo, hi));
+    for (unsigned int i=0; i<intervals_.size(); i++){
+        lo = intervals_[i].first;
+        hi = intervals_[i].second;
+        unsigned int mid = (lo + hi)/2;
+        interpolate(from, to, ((double)mid)/n, buffer_);
+        k = checkPoint(buffer_, step, useClearance);
+        if (k < 0) return false;
+        unsigned int l = mid - (unsigned int)std::min(k, (double)(mid - lo));
+        unsigned int h = mid + (unsigned int)std::min(k, (double)(hi - mid));
+        if (l - lo > 1) intervals_.push_back(std::make_pair(lo, l));
+        if (hi - h > 1) intervals_.push_back(std::make_pair(h, hi));
+    }
+
+    return useClearance || !planner_->checkCollision(from);
+}
+
+double Mobility::checkPoint(const Configuration& cfg, double step, bool useClearance) const
+{
+    if (!useClearance) return planner_->checkCollision(cfg) ? -1 : 0;
+
+    double r = planner_->computeFreeRadius(cfg);
+    if (r < 0) return -1;
+    if (r == 0) return 0;
+    if (step == 0) return HUGE_VAL;
+    // 半径ちょうどの点は保証されないので除く
+    return ceil(r/step) - 1;
+}
+
 bool Mobility::getPath(Configuration &from, Configuration &to,
                        std::vector<Configuration>& o_path) const
 {
@@ -4,6 +4,7 @@
 #define __MOBILITY_H__
 
 #include <vector>
+#include <utility>
 #include "Configuration.h"
 
 namespace PathEngine {
@@ -46,6 +47,15 @@ namespace PathEngine {
    *  - isReversible()
    */
   class Mobility {
+  public:
+    /**
+     * @brief isReachable()で干渉チェックを行う点の順序
+     */
+    enum EdgeCheckMode {
+      UniformCheck,  ///< getPath()で得た姿勢列をPathPlanner::checkCollision()に渡す
+      BisectionCheck, ///< 区間の中点を二分法の順に検査し、干渉が見つかった時点で終了する
+      ClearanceCheck  ///< BisectionCheckに加え、PathPlanner::computeFreeRadius()で干渉しないことが保証された点を省略する
+    };
   protected:
     /**
      * @brief 計画経路エンジン
@@ -59,7 +69,7 @@ namespace PathEngine {
      * @brief コンストラクタ
      * @param planner PathPlannerへのポインタ
      */
-    Mobility(PathPlanner* planner) {planner_ = planner;}
+    Mobility(PathPlanner* planner) : buffer_(0) {planner_ = planner;}
 
     /**
      * @brief デストラクタ
@@ -85,6 +95,10 @@ namespace PathEngine {
 
     /**
      * @brief fromからtoへ干渉なしに移動可能であるかどうか
+     *
+     * edgeCheckMode()がBisectionCheckの場合、getPath()と同じ点をinterpolate()で生成して検査する。
+     * getPath()を再定義する場合はUniformCheckを用いること。
+     * 作業用の姿勢を使いまわすため、同じインスタンスを複数のスレッドから同時に呼び出してはならない
      * @return 移動可能であればtrue、そうでなければfalse
      */
     bool isReachable(Configuration& from, Configuration& to, bool checkCollision=true) const;
@@ -98,6 +112,18 @@ namespace PathEngine {
      */
     virtual Configuration interpolate(const Configuration& from, const Configuration& to, double ratio) const = 0;
 
+    /**
+     * @brief 補間した姿勢を既存の姿勢に書き込む
+     *
+     * 再定義すると、isReachable()で姿勢の領域を確保しなくなる
+     * @param from 開始位置
+     * @param to 目標位置
+     * @param ratio 補間の割合
+     * @param o_cfg 補間した姿勢。fromと同じ自由度であること
+     */
+    virtual void interpolate(const Configuration& from, const Configuration& to, double ratio,
+                             Configuration& o_cfg) const { o_cfg = interpolate(from, to, ratio); }
+
     /**
      * @brief
      * @param from
@@ -105,6 +131,23 @@ namespace PathEngine {
      * @return
      */
     virtual double distance(const Configuration& from, const Configuration& to) const = 0;
+
+    /**
+     * @brief distance()が重み付きユークリッド距離を下回らないかどうか
+     *
+     * 重み付きユークリッド距離では、無限回転の自由度の差は円周上で小さい方をとる。
+     * trueを返す場合、Roadmapは近傍探索にkd-treeを用いる
+     * @return 下回らない場合true、そうでなければfalse
+     */
+    virtual bool isDistanceBoundedByWeights() const { return false; }
+
+    /**
+     * @brief 補間した2点の重み付きユークリッド距離が、補間の割合の差とdistance()の積を超えないかどうか
+     *
+     * trueを返す場合、ClearanceCheckやRRTでPathPlanner::computeFreeRadius()の半径を利用する
+     * @return 超えない場合true、そうでなければfalse
+     */
+    virtual bool isInterpolationBoundedByDistance() const { return false; }
     /**
      * @brief 補間時の隣接する2点間の最大距離を設定する
      * @param d 隣接する2点間の最大距離
@@ -116,11 +159,53 @@ namespace PathEngine {
      * @return 隣接する2点間の最大距離
      */
     static double interpolationDistance() { return interpolationDistance_;}
+
+    /**
+     * @brief isReachable()で干渉チェックを行う点の順序を設定する
+     * @param mode 点の順序
+     */
+    static void edgeCheckMode(EdgeCheckMode mode) { edgeCheckMode_ = mode; }
+
+    /**
+     * @brief isReachable()で干渉チェックを行う点の順序を取得する
+     * @return 点の順序
+     */
+    static EdgeCheckMode edgeCheckMode() { return edgeCheckMode_; }
   private:
+    /**
+     * @brief 二分法の順にfromからtoまでの干渉チェックを行う
+     * @return 干渉がなければtrue
+     */
+    bool isReachableByBisection(const Configuration& from, const Configuration& to) const;
+
+    /**
+     * @brief 補間した1点の干渉チェックを行う
+     * @param cfg 姿勢
+     * @param step 隣接する2点間の距離
+     * @param useClearance 干渉しないことが保証された点の数を求めるか否か
+     * @return 干渉する場合は負の値、それ以外はcfgの前後で干渉しないことが保証された点の数
+     */
+    double checkPoint(const Configuration& cfg, double step, bool useClearance) const;
+
     /**
      * @brief 補間時の隣接する2点間の最大距離
      */
     static double interpolationDistance_;
+
+    /**
+     * @brief isReachable()で干渉チェックを行う点の順序
+     */
+    static EdgeCheckMode edgeCheckMode_;
+
+    /**
+     * @brief 二分法で用いる作業用の姿勢
+     */
+    mutable Configuration buffer_;
+
+    /**
+     * @brief 二分法で検査する区間の待ち行列。補間の添字の組で表す
+     */
+    mutable std::vector<std::pair<unsigned int, unsigned int> > intervals_;
   };
 };
 #endif // __MOBILITY_H__
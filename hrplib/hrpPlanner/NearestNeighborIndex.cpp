@@ -0,0 +1,304 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*-
+#include <algorithm>
+#include "ConfigurationSpace.h"
+#include "Mobility.h"
+#include "NearestNeighborIndex.h"
+#define _USE_MATH_DEFINES // for MSVC
+#include <math.h>
+
+using namespace PathEngine;
+
+namespace {
+    // the number of nodes which are added before they are merged into the trees
+    const unsigned int bufferSize = 16;
+    // the maximum number of nodes in a leaf of the trees
+    const unsigned int leafSize = 8;
+    // the lower bounds are shrunk slightly so that rounding errors never prune the nearest node
+    const double lowerBoundMargin = 1.0 - 1e-9;
+
+    inline double circularDiff(double a, double b)
+    {
+        double d = fabs(a - b);
+        return d > M_PI ? 2*M_PI - d : d;
+    }
+
+    struct CoordLess {
+        CoordLess(const std::vector<double>& coords, unsigned int stride, unsigned int dim)
+            : coords_(coords), stride_(stride), dim_(dim) {}
+        bool operator()(unsigned int a, unsigned int b) const {
+            return coords_[a*stride_ + dim_] < coords_[b*stride_ + dim_];
+        }
+        const std::vector<double>& coords_;
+        unsigned int stride_, dim_;
+    };
+}
+
+/**
+   @brief collects the results of a query. k nearest nodes are collected if
+   k is positive, otherwise all the nodes within the radius are collected.
+*/
+class NearestNeighborIndex::Search
+{
+public:
+    typedef std::pair<double, unsigned int> Result;
+
+    Search(unsigned int k, double radius) : m_k(k), m_radius(radius) {}
+
+    double bound() const {
+        if (m_k && m_results.size() >= m_k) return m_results.front().first;
+        return m_radius;
+    }
+
+    void add(double d, unsigned int item) {
+        if (d > m_radius) return;
+        Result r(d, item);
+        if (!m_k){
+            m_results.push_back(r);
+        }else if (m_results.size() < m_k){
+            m_results.push_back(r);
+            std::push_heap(m_results.begin(), m_results.end());
+        }else if (r < m_results.front()){
+            std::pop_heap(m_results.begin(), m_results.end());
+            m_results.back() = r;
+            std::push_heap(m_results.begin(), m_results.end());
+        }
+    }
+
+    std::vector<Result> m_results;
+private:
+    unsigned int m_k;
+    double m_radius;
+};
+
+NearestNeighborIndex::NearestNeighborIndex(ConfigurationSpace *i_cspace, Mobility *i_mobility)
+    : m_size(i_cspace->size()), m_mobility(i_mobility)
+{
+    m_weights.resize(m_size);
+    m_isCircular.resize(m_size);
+    for (unsigned int i=0; i<m_size; i++){
+        m_weights[i] = fabs(i_cspace->weight(i));
+        m_isCircular[i] = i_cspace->unboundedRotation(i);
+    }
+}
+
+bool NearestNeighborIndex::isCompatible(ConfigurationSpace *i_cspace, Mobility *i_mobility) const
+{
+    if (i_mobility != m_mobility || i_cspace->size() != m_size) return false;
+    for (unsigned int i=0; i<m_size; i++){
+        if (fabs(i_cspace->weight(i)) != m_weights[i]
+            || i_cspace->unboundedRotation(i) != m_isCircular[i]) return false;
+    }
+    return true;
+}
+
+void NearestNeighborIndex::clear()
+{
+    m_nodes.clear();
+    m_coords.clear();
+    m_buffer.clear();
+    m_levels.clear();
+}
+
+void NearestNeighborIndex::normalize(const Configuration& i_cfg,
+                                     std::vector<double> &o_coords) const
+{
+    o_coords.resize(m_size);
+    for (unsigned int i=0; i<m_size; i++){
+        double v = i_cfg[i];
+        if (m_isCircular[i]){
+            v = fmod(v, 2*M_PI);
+            if (v < 0) v += 2*M_PI;
+            if (v >= 2*M_PI) v = 0;
+        }
+        o_coords[i] = v;
+    }
+}
+
+void NearestNeighborIndex::addNode(RoadmapNodePtr i_node)
+{
+    unsigned int item = m_nodes.size();
+    m_nodes.push_back(i_node);
+    std::vector<double> coords;
+    normalize(i_node->position(), coords);
+    m_coords.insert(m_coords.end(), coords.begin(), coords.end());
+    m_buffer.push_back(item);
+    if (m_buffer.size() < bufferSize) return;
+
+    // merge the buffer and the full levels into the first empty level
+    std::vector<unsigned int> items;
+    items.swap(m_buffer);
+    unsigned int level = 0;
+    while (level < m_levels.size() && !m_levels[level].items.empty()){
+        items.insert(items.end(), m_levels[level].items.begin(), m_levels[level].items.end());
+        m_levels[level] = Tree();
+        level++;
+    }
+    if (level == m_levels.size()) m_levels.push_back(Tree());
+    Tree &tree = m_levels[level];
+    tree.items.swap(items);
+    buildTree(tree, 0, tree.items.size());
+}
+
+int NearestNeighborIndex::buildTree(Tree &io_tree, unsigned int i_begin, unsigned int i_end)
+{
+    int index = io_tree.nodes.size();
+    TreeNode node;
+    node.begin = i_begin;
+    node.end = i_end;
+    node.left = node.right = -1;
+    io_tree.nodes.push_back(node);
+
+    io_tree.bounds.resize(io_tree.bounds.size() + 2*m_size);
+    double *lo = &io_tree.bounds[index*2*m_size];
+    double *hi = lo + m_size;
+    for (unsigned int i=0; i<m_size; i++){
+        lo[i] = hi[i] = m_coords[io_tree.items[i_begin]*m_size + i];
+    }
+    for (unsigned int j=i_begin+1; j<i_end; j++){
+        const double *c = &m_coords[io_tree.items[j]*m_size];
+        for (unsigned int i=0; i<m_size; i++){
+            if (c[i] < lo[i]) lo[i] = c[i];
+            if (c[i] > hi[i]) hi[i] = c[i];
+        }
+    }
+    if (i_end - i_begin <= leafSize) return index;
+
+    unsigned int dim = 0;
+    double maxSpread = 0;
+    for (unsigned int i=0; i<m_size; i++){
+        double spread = m_weights[i]*(hi[i] - lo[i]);
+        if (spread > maxSpread){
+            maxSpread = spread;
+            dim = i;
+        }
+    }
+    // all the nodes are at the same position
+    if (maxSpread == 0) return index;
+
+    unsigned int mid = (i_begin + i_end)/2;
+    std::nth_element(io_tree.items.begin() + i_begin, io_tree.items.begin() + mid,
+                     io_tree.items.begin() + i_end, CoordLess(m_coords, m_size, dim));
+    int left = buildTree(io_tree, i_begin, mid);
+    int right = buildTree(io_tree, mid, i_end);
+    io_tree.nodes[index].left = left;
+    io_tree.nodes[index].right = right;
+    return index;
+}
+
+double NearestNeighborIndex::pointLowerBound(const double *i_query, unsigned int i_item) const
+{
+    const double *c = &m_coords[i_item*m_size];
+    double v = 0;
+    for (unsigned int i=0; i<m_size; i++){
+        double d = m_isCircular[i] ? circularDiff(i_query[i], c[i]) : i_query[i] - c[i];
+        d *= m_weights[i];
+        v += d*d;
+    }
+    return sqrt(v)*lowerBoundMargin;
+}
+
+double NearestNeighborIndex::boxLowerBound(const double *i_query, const double *i_bounds) const
+{
+    const double *lo = i_bounds;
+    const double *hi = i_bounds + m_size;
+    double v = 0;
+    for (unsigned int i=0; i<m_size; i++){
+        double q = i_query[i];
+        if (q >= lo[i] && q <= hi[i]) continue;
+        double d;
+        if (m_isCircular[i]){
+            d = std::min(circularDiff(q, lo[i]), circularDiff(q, hi[i]));
+        }else{
+            d = q < lo[i] ? lo[i] - q : q - hi[i];
+        }
+        d *= m_weights[i];
+        v += d*d;
+    }
+    return sqrt(v)*lowerBoundMargin;
+}
+
+void NearestNeighborIndex::search(const Configuration& i_cfg, Search &io_search) const
+{
+    std::vector<double> query;
+    normalize(i_cfg, query);
+    const double *q = &query[0];
+
+    for (unsigned int i=0; i<m_buffer.size(); i++){
+        unsigned int item = m_buffer[i];
+        if (pointLowerBound(q, item) > io_search.bound()) continue;
+        io_search.add(m_mobility->distance(m_nodes[item]->position(), i_cfg), item);
+    }
+
+    std::vector<std::pair<double, int> > stack;
+    for (unsigned int l=0; l<m_levels.size(); l++){
+        const Tree &tree = m_levels[l];
+        if (tree.items.empty()) continue;
+        stack.push_back(std::make_pair(boxLowerBound(q, &tree.bounds[0]), 0));
+        while (!stack.empty()){
+            double lb = stack.back().first;
+            const TreeNode &node = tree.nodes[stack.back().second];
+            stack.pop_back();
+            if (lb > io_search.bound()) continue;
+            if (node.left < 0){
+                for (unsigned int j=node.begin; j<node.end; j++){
+                    unsigned int item = tree.items[j];
+                    if (pointLowerBound(q, item) > io_search.bound()) continue;
+                    io_search.add(m_mobility->distance(m_nodes[item]->position(), i_cfg), item);
+                }
+            }else{
+                // the nearer child is visited first
+                double lbLeft = boxLowerBound(q, &tree.bounds[node.left*2*m_size]);
+                double lbRight = boxLowerBound(q, &tree.bounds[node.right*2*m_size]);
+                if (lbLeft < lbRight){
+                    stack.push_back(std::make_pair(lbRight, node.right));
+                    stack.push_back(std::make_pair(lbLeft, node.left));
+                }else{
+                    stack.push_back(std::make_pair(lbLeft, node.left));
+                    stack.push_back(std::make_pair(lbRight, node.right));
+                }
+            }
+        }
+    }
+}
+
+RoadmapNodePtr NearestNeighborIndex::nearest(const Configuration& i_cfg, double &o_distance) const
+{
+    Search s(1, HUGE_VAL);
+    search(i_cfg, s);
+    if (s.m_results.empty()) return RoadmapNodePtr();
+    o_distance = s.m_results[0].first;
+    return m_nodes[s.m_results[0].second];
+}
+
+void NearestNeighborIndex::nearest(const Configuration& i_cfg, unsigned int i_k,
+                                   std::vector<RoadmapNodePtr> &o_nodes,
+                                   std::vector<double> &o_distances) const
+{
+    o_nodes.clear();
+    o_distances.clear();
+    if (!i_k) return;
+
+    Search s(i_k, HUGE_VAL);
+    search(i_cfg, s);
+    std::sort(s.m_results.begin(), s.m_results.end());
+    for (unsigned int i=0; i<s.m_results.size(); i++){
+        o_distances.push_back(s.m_results[i].first);
+        o_nodes.push_back(m_nodes[s.m_results[i].second]);
+    }
+}
+
+void NearestNeighborIndex::neighbors(const Configuration& i_cfg, double i_radius,
+                                     std::vector<RoadmapNodePtr> &o_nodes,
+                                     std::vector<double> &o_distances) const
+{
+    o_nodes.clear();
+    o_distances.clear();
+
+    Search s(0, i_radius);
+    search(i_cfg, s);
+    std::sort(s.m_results.begin(), s.m_results.end());
+    for (unsigned int i=0; i<s.m_results.size(); i++){
+        o_distances.push_back(s.m_results[i].first);
+        o_nodes.push_back(m_nodes[s.m_results[i].second]);
+    }
+}
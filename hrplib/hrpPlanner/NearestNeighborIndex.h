@@ -0,0 +1,124 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*-
+#ifndef __NEAREST_NEIGHBOR_INDEX_H__
+#define __NEAREST_NEIGHBOR_INDEX_H__
+
+#include <vector>
+#include "exportdef.h"
+#include "Configuration.h"
+#include "RoadmapNode.h"
+
+namespace PathEngine {
+    class ConfigurationSpace;
+    class Mobility;
+
+    /**
+       @brief index of roadmap nodes for nearest neighbor queries
+
+       The nodes are kept in kd-trees of the weighted coordinates, where the
+       coordinates of the unbounded rotations are taken on the circle. The
+       weighted Euclidean distance between the boxes of the trees and a query
+       is used to prune the search, and the distances of the remaining nodes
+       are computed by Mobility::distance(). The results are exact when the
+       mobility satisfies Mobility::isDistanceBoundedByWeights().
+
+       The trees are built by the logarithmic method, that is, the tree of
+       the \e i th level holds 2^i buckets of nodes and the trees are merged
+       like a binary counter when the nodes are added. This keeps the trees
+       balanced regardless of the order of the nodes.
+    */
+    class HRPPLANNER_API NearestNeighborIndex
+    {
+    public:
+        /**
+           @brief constructor
+           @param i_cspace configuration space whose weights and unbounded rotations are used
+           @param i_mobility mobility whose distance is used
+        */
+        NearestNeighborIndex(ConfigurationSpace *i_cspace, Mobility *i_mobility);
+
+        /**
+           @brief check whether the configuration space and the mobility are the same as
+           those when the index was created
+           @param i_cspace configuration space
+           @param i_mobility mobility
+           @return true if the index can be used with them
+        */
+        bool isCompatible(ConfigurationSpace *i_cspace, Mobility *i_mobility) const;
+
+        /**
+           @brief add a node
+           @param i_node node
+        */
+        void addNode(RoadmapNodePtr i_node);
+
+        /**
+           @brief get the number of indexed nodes
+           @return the number of indexed nodes
+        */
+        unsigned int size() const { return m_nodes.size(); }
+
+        /**
+           @brief remove all the nodes
+        */
+        void clear();
+
+        /**
+           @brief find the nearest node
+           @param i_cfg query configuration
+           @param o_distance distance to the nearest node
+           @return the nearest node. NULL if there is no node
+        */
+        RoadmapNodePtr nearest(const Configuration& i_cfg, double &o_distance) const;
+
+        /**
+           @brief find the \e i_k nearest nodes
+           @param i_cfg query configuration
+           @param i_k the number of nodes
+           @param o_nodes nodes sorted by the distance
+           @param o_distances distances of the nodes
+        */
+        void nearest(const Configuration& i_cfg, unsigned int i_k,
+                     std::vector<RoadmapNodePtr> &o_nodes,
+                     std::vector<double> &o_distances) const;
+
+        /**
+           @brief find the nodes within a distance
+           @param i_cfg query configuration
+           @param i_radius maximum distance
+           @param o_nodes nodes sorted by the distance
+           @param o_distances distances of the nodes
+        */
+        void neighbors(const Configuration& i_cfg, double i_radius,
+                       std::vector<RoadmapNodePtr> &o_nodes,
+                       std::vector<double> &o_distances) const;
+
+    private:
+        struct TreeNode {
+            unsigned int begin, end;
+            int left, right;
+        };
+        struct Tree {
+            std::vector<unsigned int> items;
+            std::vector<TreeNode> nodes;
+            std::vector<double> bounds;
+        };
+        class Search;
+
+        void normalize(const Configuration& i_cfg, std::vector<double> &o_coords) const;
+        double pointLowerBound(const double *i_query, unsigned int i_item) const;
+        double boxLowerBound(const double *i_query, const double *i_bounds) const;
+        int buildTree(Tree &io_tree, unsigned int i_begin, unsigned int i_end);
+        void search(const Configuration& i_cfg, Search &io_search) const;
+
+        unsigned int m_size;
+        Mobility *m_mobility;
+        std::vector<double> m_weights;
+        std::vector<bool> m_isCircular;
+        std::vector<RoadmapNodePtr> m_nodes;
+        std::vector<double> m_coords;
+        std::vector<unsigned int> m_buffer;
+        std::vector<Tree> m_levels;
+    };
+};
+
+#endif
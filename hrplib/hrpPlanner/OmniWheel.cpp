@@ -20,6 +20,15 @@ Configuration OmniWheel::interpolate(const Configuration& from,
 {
     ConfigurationSpace *cspace = planner_->getConfigurationSpace();
     Configuration cfg(cspace->size());
+    interpolate(from, to, ratio, cfg);
+    return cfg;
+}
+
+void OmniWheel::interpolate(const Configuration& from, 
+                            const Configuration& to,
+                            double ratio, Configuration& cfg) const
+{
+    ConfigurationSpace *cspace = planner_->getConfigurationSpace();
     for (unsigned int i=0; i<cfg.size(); i++){
         if (cspace->unboundedRotation(i)){
             double dth = to.value(i) - from.value(i);
@@ -32,8 +41,6 @@ Configuration OmniWheel::interpolate(const Configuration& from,
             cfg.value(i) = (1-ratio)*from.value(i) + ratio*to.value(i);
         }
     }
-    
-    return cfg;
 }
 
 double OmniWheel::distance(const Configuration& from, const Configuration& to) const
@@ -23,6 +23,12 @@ namespace PathEngine {
          * @brief 親クラスのドキュメントを参照
          */
         Configuration interpolate(const Configuration& from, const Configuration& to, double ratio) const;
+
+        /**
+         * @brief 親クラスのドキュメントを参照
+         */
+        void interpolate(const Configuration& from, const Configuration& to, double ratio,
+                         Configuration& o_cfg) const;
       
         /**
          * @brief 親クラスのドキュメントを参照
@@ -33,6 +39,16 @@ namespace PathEngine {
          * @brief 親クラスのドキュメントを参照
          */
         bool isReversible() const { return true; }
+
+        /**
+         * @brief 親クラスのドキュメントを参照
+         */
+        bool isDistanceBoundedByWeights() const { return true; }
+
+        /**
+         * @brief 親クラスのドキュメントを参照
+         */
+        bool isInterpolationBoundedByDistance() const { return true; }
     };
 };
 #endif
@@ -4,15 +4,178 @@
 #include "RoadmapNode.h"
 #include "ConfigurationSpace.h"
 #include "PRM.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/random.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 
 using namespace PathEngine;
 
+namespace {
+  // 連結成分を管理するためのunion-find
+  class ConnectedComponents {
+  public:
+    ConnectedComponents(unsigned int n) : parents_(n) {
+      for (unsigned int i=0; i<n; i++) parents_[i] = i;
+    }
+    unsigned int find(unsigned int i) {
+      while (parents_[i] != i) {
+        parents_[i] = parents_[parents_[i]];
+        i = parents_[i];
+      }
+      return i;
+    }
+    void unite(unsigned int i, unsigned int j) {
+      parents_[find(i)] = find(j);
+    }
+  private:
+    std::vector<unsigned int> parents_;
+  };
+
+  // 先頭のnNodes個のノードの間にある、干渉チェックされていないエッジの数
+  unsigned int countUncheckedEdges(RoadmapPtr roadmap, unsigned int nNodes,
+                                   RoadmapNodePtr startNode, RoadmapNodePtr goalNode) {
+    unsigned int n = 0;
+    for (unsigned int i=0; i<nNodes; i++) {
+      RoadmapNodePtr node = roadmap->node(i);
+      for (unsigned int j=0; j<node->nChildren(); j++) {
+        RoadmapNodePtr child = node->child(j);
+        if (child != startNode && child != goalNode
+            && node->edgeState(j) == RoadmapNode::Unchecked) n++;
+      }
+    }
+    return n;
+  }
+
+  // 並列に接続を試みるペアの数。結果がスレッド数によらないよう一定とする
+  const unsigned int connectionBatchSize = 1024;
+
+  // 各スレッドに添字を一つずつ割り当てる
+  class JobQueue {
+  public:
+    JobQueue(unsigned long size, const bool *isRunning)
+      : next_(0), size_(size), isRunning_(isRunning) {}
+    bool pop(unsigned long &index) {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (next_ >= size_ || !*isRunning_) return false;
+      index = next_++;
+      return true;
+    }
+  private:
+    boost::mutex mutex_;
+    unsigned long next_, size_;
+    const bool *isRunning_;
+  };
+
+  struct SamplingJob {
+    SamplingJob(unsigned long begin, unsigned long size, unsigned long seed,
+                unsigned int dim, const bool *isRunning)
+      : queue(size, isRunning), begin(begin), seed(seed),
+        positions(size, Configuration(dim)), isFree(size, 0) {}
+    JobQueue queue;
+    unsigned long begin, seed;
+    std::vector<Configuration> positions;
+    std::vector<char> isFree;
+  };
+
+  // 候補ごとに乱数の種を決めるので、結果はスレッドの割り当てによらない
+  void sampleNodes(PathPlanner *worker, SamplingJob *job)
+  {
+    ConfigurationSpace *cspace = worker->getConfigurationSpace();
+    unsigned long k;
+    while (job->queue.pop(k)) {
+      boost::mt19937 rng((boost::uint32_t)(job->seed * 2654435761u + job->begin + k));
+      boost::variate_generator<boost::mt19937&, boost::uniform_real<> >
+        uniform(rng, boost::uniform_real<>(0.0, 1.0));
+      job->positions[k] = cspace->random(boost::ref(uniform));
+      job->isFree[k] = !worker->checkCollision(job->positions[k]);
+    }
+  }
+
+  struct ConnectionJob {
+    ConnectionJob(RoadmapPtr roadmap,
+                  const std::vector<std::pair<unsigned int, unsigned int> > &pairs,
+                  const bool *isRunning)
+      : queue(pairs.size(), isRunning), roadmap(roadmap), pairs(pairs),
+        forward(pairs.size(), 0), backward(pairs.size(), 0) {}
+    JobQueue queue;
+    RoadmapPtr roadmap;
+    const std::vector<std::pair<unsigned int, unsigned int> > &pairs;
+    std::vector<char> forward, backward;
+  };
+
+  void checkConnections(PathPlanner *worker, ConnectionJob *job)
+  {
+    Mobility *mobility = worker->getMobility();
+    unsigned long k;
+    while (job->queue.pop(k)) {
+      Configuration from = job->roadmap->node(job->pairs[k].first)->position();
+      Configuration to = job->roadmap->node(job->pairs[k].second)->position();
+      job->forward[k] = mobility->isReachable(from, to);
+      if (!mobility->isReversible()) job->backward[k] = mobility->isReachable(to, from);
+    }
+  }
+
+  template <class Job>
+  void runWorkers(std::vector<PathPlannerPtr> &workers,
+                  void (*func)(PathPlanner *, Job *), Job *job)
+  {
+    boost::thread_group threads;
+    for (unsigned int i=0; i<workers.size(); i++) {
+      threads.create_thread(boost::bind(func, workers[i].get(), job));
+    }
+    threads.join_all();
+  }
+
+  /*
+   * ペアの接続を並列に検査し、結果を順番にロードマップに反映する
+   */
+  void connectInParallel(std::vector<PathPlannerPtr> &workers, RoadmapPtr roadmap,
+                         Mobility *mobility,
+                         const std::vector<std::pair<unsigned int, unsigned int> > &pairs,
+                         ConnectedComponents &components, bool skipConnected,
+                         const bool *isRunning)
+  {
+    ConnectionJob job(roadmap, pairs, isRunning);
+    runWorkers(workers, checkConnections, &job);
+    if (!*isRunning) return;
+
+    for (unsigned int k=0; k<pairs.size(); k++) {
+      unsigned int i = pairs[k].first, j = pairs[k].second;
+      // 同じバッチの前のペアで連結された場合
+      if (skipConnected && components.find(i) == components.find(j)) continue;
+      RoadmapNodePtr from = roadmap->node(i), to = roadmap->node(j);
+      unsigned int nEdges = roadmap->nEdges();
+      if (job.forward[k]) {
+        roadmap->addEdge(from, to);
+        if (mobility->isReversible()) roadmap->addEdge(to, from);
+      }
+      if (job.backward[k]) roadmap->addEdge(to, from);
+      if (roadmap->nEdges() != nEdges) components.unite(i, j);
+    }
+  }
+}
+
 PRM::PRM(PathPlanner* path)
   : Algorithm(path)
 {
   // デフォルト値セット
   properties_["max-dist"] = "1.0";
   properties_["max-points"] = "100";
+  properties_["max-neighbors"] = "0";
+  properties_["skip-connected"] = "0";
+  properties_["lazy"] = "0";
+  properties_["num-threads"] = "1";
+  properties_["seed"] = "0";
+  properties_["roadmap-file"] = "";
+
+  nRoadmapNodes_ = 0;
+  roadmapKey_ = 0;
 }
 
 PRM::~PRM() {
@@ -22,49 +185,126 @@ bool PRM::buildRoadmap()
 {
   std::cerr << "new Roadmap is created" << std::endl;
   
-  // 現在の点の数
-  unsigned long numPoints = 0, numTotalPoints = 0;
-  ConfigurationSpace *cspace = planner_->getConfigurationSpace();
-  
-  while (numPoints < maxPoints_) {
-    if (!isRunning_) {
-      return false;
+  // 並列に生成する場合は各スレッドの干渉チェック用のPathPlannerを用意する
+  std::vector<PathPlannerPtr> workers;
+  for (unsigned int i=0; numThreads_ > 1 && i<numThreads_; i++) {
+    PathPlannerPtr worker = planner_->createWorker();
+    if (!worker) {
+      std::cerr << "the roadmap is built serially because the collision checker cannot be copied" << std::endl;
+      workers.clear();
+      break;
     }
-    
-    // ランダムに与えた点
-    Configuration pos = cspace->random();
-    numTotalPoints++;
-    
-    // 干渉する位置でなければ追加
-    if (!planner_->checkCollision(pos)) {
-        RoadmapNodePtr node = RoadmapNodePtr(new RoadmapNode(pos));
-      roadmap_->addNode(node);
-      numPoints++;
-    }
-    printf("creating nodes, registered : %ld / tested : %ld\r", numPoints, numTotalPoints); 
+    workers.push_back(worker);
+  }
+
+  if (!generateNodes(workers)) {
+    return false;
   }
-  printf("\n");
   
   // エッジを作成
+  // 近傍のノードとのみ接続を試み、同じ組は一度だけ試す
   Mobility* mobility = planner_->getMobility();
-  RoadmapNodePtr from, to;
+  // 逆向きに移動できない場合は連結成分が対称でないので省略しない
+  // 遅延評価モードでは後でエッジが削除されうるので省略しない
+  bool skipConnected = skipConnected_ && mobility->isReversible() && !lazy_;
   unsigned int n = roadmap_->nNodes();
-  for (unsigned long i=0; i<n; i++) {
+  std::map<RoadmapNode*, unsigned int> indices;
+  for (unsigned int i=0; i<n; i++) {
+    indices[roadmap_->node(i).get()] = i;
+  }
+  ConnectedComponents components(n);
+  std::set<std::pair<unsigned int, unsigned int> > tried;
+  std::vector<RoadmapNodePtr> neighbors;
+  // 遅延評価モードでは干渉チェックを行わないので並列化しない
+  bool isParallel = !workers.empty() && !lazy_;
+  std::vector<std::pair<unsigned int, unsigned int> > batch;
+  for (unsigned int i=0; i<n; i++) {
     if (!isRunning_) {
       return false;
     }
-    from = roadmap_->node(i);
-    for (unsigned long j=i+1; j<n; j++) {
-      to = roadmap_->node(j);
-      if (mobility->distance(from->position(), to->position()) < maxDist_) {
-	roadmap_->tryConnection(from, to);
+    RoadmapNodePtr from = roadmap_->node(i);
+    findNeighbors(from, neighbors);
+    for (unsigned int k=0; k<neighbors.size(); k++) {
+      unsigned int j = indices[neighbors[k].get()];
+      if (j == i) continue;
+      if (!tried.insert(std::make_pair(std::min(i, j), std::max(i, j))).second) continue;
+      if (skipConnected && components.find(i) == components.find(j)) continue;
+      if (isParallel) {
+        batch.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+        if (batch.size() >= connectionBatchSize) {
+          connectInParallel(workers, roadmap_, mobility, batch, components, skipConnected, &isRunning_);
+          batch.clear();
+        }
+        continue;
+      }
+      unsigned int nEdges = roadmap_->nEdges();
+      // 添字の小さい方から接続する
+      if (i < j) {
+        roadmap_->tryConnection(from, neighbors[k]);
+      } else {
+        roadmap_->tryConnection(neighbors[k], from);
       }
+      if (roadmap_->nEdges() != nEdges) components.unite(i, j);
     }
   }
+  if (!batch.empty()) {
+    connectInParallel(workers, roadmap_, mobility, batch, components, skipConnected, &isRunning_);
+  }
+
+  return isRunning_;
+}
 
+bool PRM::generateNodes(std::vector<PathPlannerPtr> &workers)
+{
+  // 現在の点の数
+  unsigned long numPoints = 0, numTotalPoints = 0;
+  unsigned int dim = planner_->getConfigurationSpace()->size();
+  while (numPoints < maxPoints_) {
+    if (!isRunning_) {
+      return false;
+    }
+    // 並列に生成する場合は干渉しない候補が足りるように多めに生成し、候補の順に登録する
+    // 登録しなかった候補は次の回に同じ添字で生成し直すので、結果は候補の数によらない
+    unsigned long remaining = maxPoints_ - numPoints;
+    unsigned long size = workers.empty() ? remaining
+      : std::max(remaining + remaining/4, (unsigned long)(16*workers.size()));
+    SamplingJob job(numTotalPoints, size, seed_, dim, &isRunning_);
+    if (workers.empty()) {
+      sampleNodes(planner_, &job);
+    } else {
+      runWorkers(workers, sampleNodes, &job);
+    }
+    if (!isRunning_) {
+      return false;
+    }
+    for (unsigned long k=0; k<size && numPoints < maxPoints_; k++) {
+      numTotalPoints++;
+      if (job.isFree[k]) {
+        roadmap_->addNode(RoadmapNodePtr(new RoadmapNode(job.positions[k])));
+        numPoints++;
+      }
+    }
+    printf("creating nodes, registered : %ld / tested : %ld\r", numPoints, numTotalPoints); 
+  }
+  printf("\n");
   return true;
 }
 
+void PRM::findNeighbors(RoadmapNodePtr node, std::vector<RoadmapNodePtr> &neighbors)
+{
+  std::vector<double> distances;
+  if (maxNeighbors_ == 0) {
+    roadmap_->findNodesWithin(node->position(), maxDist_, neighbors, distances);
+  } else {
+    // 自身が含まれるので一つ多く取得する
+    roadmap_->findNearestNodes(node->position(), maxNeighbors_ + 1, neighbors, distances);
+  }
+  // maxDist_ちょうどの距離にあるノードは従来通り除外する
+  unsigned int n = 0;
+  while (n < distances.size() && distances[n] < maxDist_) n++;
+  neighbors.resize(n);
+}
+
 bool PRM::calcPath() 
 {
     std::cout << "PRM::calcPath()" << std::endl;
@@ -74,28 +314,58 @@ bool PRM::calcPath()
   // Max Points
   maxPoints_ = atoi(properties_["max-points"].c_str());
 
+  // Max Neighbors
+  maxNeighbors_ = atoi(properties_["max-neighbors"].c_str());
+
+  skipConnected_ = atoi(properties_["skip-connected"].c_str()) != 0;
+
+  lazy_ = atoi(properties_["lazy"].c_str()) != 0;
+  roadmap_->lazyMode(lazy_);
+
+  numThreads_ = atoi(properties_["num-threads"].c_str());
+  if (numThreads_ == 0) numThreads_ = boost::thread::hardware_concurrency();
+
+  seed_ = strtoul(properties_["seed"].c_str(), NULL, 10);
+
   std::cerr << "maxDist:" << maxDist_ << std::endl;
   std::cerr << "maxPoints:" << maxPoints_ << std::endl;
+  std::cerr << "maxNeighbors:" << maxNeighbors_ << std::endl;
 
-  if (roadmap_->nNodes() == 0) buildRoadmap();
+  if (roadmap_->nNodes() == 0) {
+    // ロードマップを生成した条件が一致すれば保存したものを用いる
+    std::ostringstream params;
+    params.precision(17);
+    params << "PRM " << maxPoints_ << " " << maxDist_ << " " << maxNeighbors_ << " "
+           << skipConnected_ << " " << lazy_ << " " << Mobility::interpolationDistance();
+    roadmapKey_ = planner_->roadmapKey(params.str());
+    roadmapFile_ = properties_["roadmap-file"];
+    if (!roadmapFile_.empty() && roadmap_->load(roadmapFile_, roadmapKey_)) {
+      std::cerr << "the roadmap is loaded from " << roadmapFile_ << std::endl;
+    } else if (buildRoadmap()) {
+      if (!roadmapFile_.empty() && !roadmap_->save(roadmapFile_, roadmapKey_)) {
+        std::cerr << "failed to save the roadmap to " << roadmapFile_ << std::endl;
+      }
+    } else {
+      // 中断されたロードマップは保存しない
+      roadmapFile_.clear();
+    }
+    nRoadmapNodes_ = roadmap_->nNodes();
+  }
 
   // スタートとゴールを追加
-  Mobility *mobility = planner_->getMobility();
   RoadmapNodePtr startNode = RoadmapNodePtr(new RoadmapNode(start_));
   RoadmapNodePtr goalNode = RoadmapNodePtr(new RoadmapNode(goal_));
   roadmap_->addNode(startNode);
   roadmap_->addNode(goalNode);
 
-  RoadmapNodePtr node;
-  for (unsigned long i=0; i<roadmap_->nNodes(); i++) {
-    node = roadmap_->node(i);
-    const Configuration& pos = node->position();
-    if (mobility->distance(start_, pos) < maxDist_) {
-      roadmap_->tryConnection(startNode, node);
-    }
-    if (mobility->distance(goal_, pos) < maxDist_) {
-      roadmap_->tryConnection(goalNode, node);
-    }
+  std::vector<RoadmapNodePtr> neighbors;
+  findNeighbors(startNode, neighbors);
+  for (unsigned int i=0; i<neighbors.size(); i++) {
+    if (neighbors[i] != startNode) roadmap_->tryConnection(startNode, neighbors[i]);
+  }
+  findNeighbors(goalNode, neighbors);
+  for (unsigned int i=0; i<neighbors.size(); i++) {
+    if (neighbors[i] != goalNode) roadmap_->tryConnection(goalNode, neighbors[i]);
   }
 
   std::cout << "start node has " << startNode->nChildren()
@@ -103,14 +373,28 @@ bool PRM::calcPath()
   std::cout << "goal node has " << goalNode->nParents()
 	    << " parents" << std::endl;
 
+  // 経路探索で検査したエッジがあれば保存し直す
+  bool isSaved = lazy_ && !roadmapFile_.empty();
+  unsigned int nUnchecked = 0;
+  if (isSaved) {
+    nUnchecked = countUncheckedEdges(roadmap_, nRoadmapNodes_, startNode, goalNode);
+  }
+
   std::vector<RoadmapNodePtr> nodePath;
-  nodePath = roadmap_->DFS(startNode, goalNode);
+  nodePath = roadmap_->findPath(startNode, goalNode);
   for (unsigned int i=0; i<nodePath.size(); i++){
     path_.push_back(nodePath[i]->position());
   }
 
   std::cout << "path_.size() = " << path_.size() << std::endl; 
 
+  // 遅延評価モードでは検査したエッジの状態を保存する。スタートとゴールは含めない
+  if (isSaved
+      && countUncheckedEdges(roadmap_, nRoadmapNodes_, startNode, goalNode) != nUnchecked
+      && !roadmap_->save(roadmapFile_, roadmapKey_, nRoadmapNodes_)) {
+    std::cerr << "failed to save the roadmap to " << roadmapFile_ << std::endl;
+  }
+
   return path_.size() != 0;
 }
 
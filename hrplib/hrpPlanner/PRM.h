@@ -18,9 +18,39 @@ namespace PathEngine {
    */
   class PRM : public Algorithm {
   private:
-    // 近傍ノードの上限
+    // 近傍ノードの上限。0の場合はmaxDist_以内の全てのノードと接続を試みる
     unsigned long maxNeighbors_;
 
+    // 同じ連結成分に属するノード間の接続を省略するか否か
+    bool skipConnected_;
+
+    // エッジの干渉チェックを経路探索まで遅延させるか否か
+    bool lazy_;
+
+    // ロードマップを生成するスレッドの数
+    unsigned int numThreads_;
+
+    // ノードを生成する際の乱数の種
+    unsigned long seed_;
+
+    // 生成または読み込んだロードマップのノード数。後から追加したスタートとゴールは含めない
+    unsigned int nRoadmapNodes_;
+
+    // ロードマップを保存するファイル名。空の場合は保存しない
+    std::string roadmapFile_;
+
+    // ロードマップを生成した条件を表すキー
+    boost::uint64_t roadmapKey_;
+
+    /**
+     * @brief ノードを生成する
+     *
+     * 候補ごとに乱数の種を決めるので、生成されるノードはスレッドの数によらない
+     * @param workers 各スレッドが干渉チェックに用いるPathPlanner。空の場合は単一のスレッドで生成する
+     * @return stopPlanning()によって中断された場合はfalse、それ以外はtrue
+     */
+    bool generateNodes(std::vector<PathPlannerPtr> &workers);
+
     // 最大の点数
     unsigned long maxPoints_;
 
@@ -32,6 +62,13 @@ namespace PathEngine {
      * @return stopPlanning()によって中断された場合はfalse、それ以外はtrue
      */
     bool buildRoadmap();
+
+    /**
+     * @brief ノードの近傍にあるノードを取得する
+     * @param node ノード
+     * @param neighbors maxNeighbors_個以下の、maxDist_以内にあるノード
+     */
+    void findNeighbors(RoadmapNodePtr node, std::vector<RoadmapNodePtr> &neighbors);
     
   public:
     /**
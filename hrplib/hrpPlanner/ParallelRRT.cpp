@@ -0,0 +1,132 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; tab-width: 4; -*-
+#include <cstdlib>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include "Roadmap.h"
+#include "RoadmapNode.h"
+#include "ParallelRRT.h"
+
+using namespace PathEngine;
+
+namespace {
+    // [0,1)の一様乱数。スレッドごとに独立した状態を持つ
+    class UniformRandom {
+    public:
+        UniformRandom(boost::uint32_t seed) : rng_(seed) {}
+        double operator()() { return rng_() / 4294967296.0; }
+    private:
+        boost::mt19937 rng_;
+    };
+
+    struct GrowingJob {
+        GrowingJob(int times, const bool *isRunning)
+            : times(times), isRunning(isRunning), winner(-1) {}
+        bool isSolved() {
+            boost::mutex::scoped_lock lock(mutex);
+            return winner >= 0;
+        }
+        int times;
+        const bool *isRunning;
+        boost::mutex mutex;
+        int winner;
+    };
+
+    void growTrees(RRT *rrt, int id, GrowingJob *job)
+    {
+        for (int i=0; i<job->times; i++) {
+            if (!*job->isRunning || job->isSolved()) return;
+            if (rrt->extendOneStep()) {
+                boost::mutex::scoped_lock lock(job->mutex);
+                if (job->winner < 0) job->winner = id;
+                return;
+            }
+        }
+    }
+}
+
+ParallelRRT::ParallelRRT(PathPlanner* plan) : Algorithm(plan)
+{
+    // set default properties
+    properties_["max-trials"] = "10000";
+    properties_["eps"] = "0.1";
+    properties_["clearance-step"] = "0";
+    properties_["num-threads"] = "0";
+    properties_["seed"] = "0";
+}
+
+ParallelRRT::~ParallelRRT()
+{
+}
+
+bool ParallelRRT::calcPath()
+{
+    if (verbose_) std::cout << "ParallelRRT::calcPath" << std::endl;
+
+    int times = atoi(properties_["max-trials"].c_str());
+    double eps = atof(properties_["eps"].c_str());
+    bool clearanceStep = atoi(properties_["clearance-step"].c_str()) != 0;
+    unsigned int numThreads = atoi(properties_["num-threads"].c_str());
+    if (numThreads == 0) numThreads = boost::thread::hardware_concurrency();
+    if (numThreads == 0) numThreads = 1;
+    unsigned long seed = strtoul(properties_["seed"].c_str(), NULL, 10);
+
+    // 各スレッドの干渉チェック用のPathPlanner
+    std::vector<PathPlannerPtr> workers;
+    for (unsigned int i=0; i<numThreads; i++) {
+        PathPlannerPtr worker = planner_->createWorker();
+        if (!worker) {
+            std::cerr << "the trees are grown by a single thread because the collision checker cannot be copied" << std::endl;
+            workers.clear();
+            break;
+        }
+        workers.push_back(worker);
+    }
+
+    std::vector<boost::shared_ptr<RRT> > rrts;
+    for (unsigned int i=0; i<std::max(workers.size(), (size_t)1); i++) {
+        boost::shared_ptr<RRT> rrt(new RRT(workers.empty() ? planner_ : workers[i].get()));
+        rrt->extendFromStart(true);
+        rrt->extendFromGoal(true);
+        rrt->epsilon(eps);
+        rrt->clearanceStep(clearanceStep);
+        rrt->randomGenerator(UniformRandom((boost::uint32_t)(seed * 2654435761u + i)));
+        rrt->getForwardTree()->addNode(RoadmapNodePtr(new RoadmapNode(start_)));
+        rrt->getBackwardTree()->addNode(RoadmapNodePtr(new RoadmapNode(goal_)));
+        rrts.push_back(rrt);
+    }
+
+    if (verbose_){
+        std::cout << "times:" << times << std::endl;
+        std::cout << "eps:" << eps << std::endl;
+        std::cout << "threads:" << rrts.size() << std::endl;
+    }
+
+    GrowingJob job(times, &isRunning_);
+    if (workers.empty()) {
+        growTrees(rrts[0].get(), 0, &job);
+    } else {
+        boost::thread_group threads;
+        for (unsigned int i=0; i<rrts.size(); i++) {
+            threads.create_thread(boost::bind(growTrees, rrts[i].get(), i, &job));
+        }
+        threads.join_all();
+    }
+
+    bool isSucceed = job.winner >= 0;
+    roadmap_->clear();
+    if (isSucceed) {
+        RRT *rrt = rrts[job.winner].get();
+        rrt->extractPath(path_);
+        rrt->getBackwardTree()->integrate(roadmap_);
+        rrt->getForwardTree()->integrate(roadmap_);
+    }
+
+    if (verbose_) {
+        std::cout << "fin.(calcPath), retval = " << isSucceed << std::endl;
+    }
+    return isSucceed;
+}
@@ -0,0 +1,40 @@
+// -*- C++ -*-
+#ifndef __PARALLEL_RRT_H__
+#define __PARALLEL_RRT_H__
+
+#include "PathPlanner.h"
+#include "Algorithm.h"
+#include "RRT.h"
+
+namespace PathEngine {
+
+  /**
+   * @brief 並列RRT-connectアルゴリズム実装クラス
+   *
+   * 異なる乱数の種を与えたRRT-connectのツリーの組を複数のスレッドで同時に伸ばし、
+   * いずれかのスレッドでツリーがつながった時点で全てのスレッドを停止する。
+   * 各スレッドはPathPlanner::createWorker()によって得られるPathPlannerで干渉チェックを行う。
+   */
+  class ParallelRRT
+    : public Algorithm {
+  public:
+    /**
+     * @brief コンストラクタ
+     * @param planner パスプランナー
+     */
+    ParallelRRT(PathPlanner* planner);
+
+    /**
+     * @brief デストラクタ
+     */
+    ~ParallelRRT();
+
+    /**
+     * @brief 親クラスのドキュメントを参照
+     */
+    bool calcPath();
+  };
+};
+
+
+#endif // __PARALLEL_RRT_H__
@@ -1,7 +1,9 @@
 #include <math.h>
+#include <set>
 #include <boost/bind.hpp>
 // planning algorithms
 #include "RRT.h"
+#include "ParallelRRT.h"
 #include "PRM.h"
 // mobilities
 #include "TGT.h"
@@ -17,6 +19,8 @@
 #include <hrpModel/Body.h>
 #include <hrpModel/Link.h>
 #include <hrpModel/ModelLoaderUtil.h>
+#include <hrpModel/ModelNodeSetUtil.h>
+#include <hrpUtil/UrlUtil.h>
 
 using namespace PathEngine;
 using namespace hrp;
@@ -58,6 +62,16 @@ X_ptr PathPlanner::checkCorbaServer(const std::string &n, CosNaming::NamingConte
     return srv;
 }
 
+bool setConfigurationToBaseXYTheta(PathPlanner *planner, const Configuration& cfg);
+
+// ロボットを剛体として動かす関数が設定されているか
+static bool isRigidMotion(const applyConfigFunc &func)
+{
+    typedef bool (*FuncPtr)(PathPlanner *, const Configuration &);
+    const FuncPtr *f = func.target<FuncPtr>();
+    return f && *f == setConfigurationToBaseXYTheta;
+}
+
 bool setConfigurationToBaseXYTheta(PathPlanner *planner, const Configuration& cfg)
 {
     Link *baseLink = planner->robot()->rootLink();
@@ -95,6 +109,7 @@ PathPlanner::PathPlanner(unsigned int dim,
     // planning algorithms
     registerAlgorithm("RRT", AlgorithmCreate<RRT>, AlgorithmDelete<RRT>);
     registerAlgorithm("PRM", AlgorithmCreate<PRM>, AlgorithmDelete<PRM>);
+    registerAlgorithm("ParallelRRT", AlgorithmCreate<ParallelRRT>, AlgorithmDelete<ParallelRRT>);
 
     // mobilities
     registerMobility("TurnGoTurn", MobilityCreate<TGT>, MobilityDelete<TGT>);
@@ -271,6 +286,21 @@ void PathPlanner::initPlanner(const std::string &nameServer) {
 
 }
 
+void PathPlanner::initPlanner() {
+
+    if (debug_) {
+        std::cerr << "PathPlanner::initPlanner()" << std::endl;
+    }
+
+    modelLoader_ = OpenHRP::ModelLoader::_nil();
+    onlineViewer_ = OpenHRP::OnlineViewer::_nil();
+
+    world_->clearBodies();
+    checkPairs_.clear();
+    lipschitzConstants_.clear();
+    clearCollisionCache();
+}
+
 void PathPlanner::setAlgorithmName(const std::string &algorithmName)
 {
     // アルゴリズム名とインスタンスをセット
@@ -294,9 +324,9 @@ BodyPtr PathPlanner::registerCharacterByURL(const char* name, const char* url){
         std::cerr << "PathPlanner::registerCharacterByURL(" << name << ", " << url << ")" << std::endl;
     }
 
+    // ModelLoaderに接続していなければプロセス内で読み込む
     if (CORBA::is_nil(modelLoader_)) {
-        std::cerr << "nil reference to servers" << std::endl;
-        return BodyPtr();
+        return registerCharacterByFile(name, url);
     }
 
     OpenHRP::BodyInfo_ptr cInfo = modelLoader_->getBodyInfo(url);
@@ -305,8 +335,9 @@ BodyPtr PathPlanner::registerCharacterByURL(const char* name, const char* url){
     if (debug_) {
         if (CORBA::is_nil(onlineViewer_)) {
             std::cerr << "nil reference to OnlineViewer" << std::endl;
+        }else{
+            onlineViewer_->load(name, url);
         }
-        onlineViewer_->load(name, url);
     }
     return body;
 }
@@ -332,6 +363,7 @@ void PathPlanner::setCharacterPosition(const char* character,
     Matrix33 R;
     getMatrix33FromRowMajorArray(R, pos.get_buffer(), 3);
     l->setSegmentAttitude(R);
+    clearCollisionCache();
 }
 
 void computeBoundingBox(BodyPtr body, double min[3], double max[3])
@@ -441,6 +473,38 @@ BodyPtr PathPlanner::registerCharacter(const char *name, BodyPtr i_body)
     return i_body;
 }
 
+// ----------------------------------------------
+// キャラクタをファイルから登録
+// ----------------------------------------------
+BodyPtr PathPlanner::registerCharacterByFile(const char* name, const std::string& filename){
+    if (debug_) {
+        std::cerr << "PathPlanner::registerCharacterByFile(" << name << ", " << filename << ")" << std::endl;
+    }
+
+    if (!USE_INTERNAL_COLLISION_DETECTOR) {
+        std::cerr << "the internal collision detector is required to load a model without ModelLoader" << std::endl;
+        return BodyPtr();
+    }
+
+    BodyPtr body(new Body());
+    if (!loadBodyFromModelFile(body, deleteURLScheme(filename), true)) {
+        std::cerr << "failed to load " << filename << std::endl;
+        return BodyPtr();
+    }
+    body->setName(name);
+
+    if (bboxMode_){
+        body = createBoundingBoxBody(body);
+        body->setName(name);
+    }
+    world_->addBody(body);
+
+    if (debug_ && !CORBA::is_nil(onlineViewer_)) {
+        onlineViewer_->load(name, filename.c_str());
+    }
+    return body;
+}
+
 
 
 
@@ -453,6 +517,8 @@ void PathPlanner::setRobotName(const std::string &name) {
     }
 
     model_ = world_->body(name);
+    lipschitzConstants_.clear();
+    clearCollisionCache();
     if (!model_) {
         std::cerr << "PathPlanner::setRobotName() : robot(" << name << ") not found" << std::endl;
         return;
@@ -500,6 +566,7 @@ void PathPlanner::registerIntersectionCheckPair(const char* charName1,
     }
     int bodyIndex1 = world_->bodyIndex(charName1);
     int bodyIndex2 = world_->bodyIndex(charName2);
+    clearCollisionCache();
 
     if(bodyIndex1 >= 0 && bodyIndex2 >= 0){
 
@@ -583,10 +650,14 @@ bool PathPlanner::checkCollision (const Configuration &pos) {
         std::cerr << "checkCollision(" << pos << ")" << std::endl;
     }
 #endif
+    bool ret;
+    if (collisionCache_ && collisionCache_->findCollision(pos, ret)) return ret;
+
     if (!setConfiguration(pos)) return true;
 
     // 干渉チェック
-    bool ret = checkCollision();
+    ret = checkCollision();
+    if (collisionCache_) collisionCache_->addCollision(pos, ret);
 
     if (debug_) {
         // 結果を得る
@@ -597,7 +668,7 @@ bool PathPlanner::checkCollision (const Configuration &pos) {
         state->time = nowTime;
         nowTime += dt_;
 
-        onlineViewer_->update(state);
+        if (!CORBA::is_nil(onlineViewer_)) onlineViewer_->update(state);
     }
     return ret;
 }
@@ -731,6 +802,110 @@ bool PathPlanner::checkCollision(const std::vector<Configuration> &path) {
     }
     return checkCollision(path[0]);
 }
+
+double PathPlanner::computeClearance(const Configuration &pos)
+{
+    bool isCached;
+    return computeClearance(pos, isCached);
+}
+
+double PathPlanner::computeClearance(const Configuration &pos, bool &isCached)
+{
+    double clearance;
+    isCached = collisionCache_ && collisionCache_->findClearance(pos, clearance);
+    if (isCached) return clearance;
+
+    clearance = computeClearanceWithoutCache(pos);
+    if (collisionCache_) collisionCache_->addClearance(pos, clearance);
+    return clearance;
+}
+
+double PathPlanner::computeClearanceWithoutCache(const Configuration &pos)
+{
+    if (!setConfiguration(pos) || checkCollision()) return -1;
+    if (customCollisionDetector_ || !USE_INTERNAL_COLLISION_DETECTOR 
+        || pointCloud_.size() > 0) return 0;
+
+    std::set<ColdetModel *> robotModels;
+    for (int i=0; i<model_->numLinks(); i++){
+        robotModels.insert(model_->link(i)->coldetModel.get());
+    }
+    bool isRigid = isRigidMotion(m_applyConfigFunc);
+
+    // 位置はcheckCollision()で更新されている
+    timeCollisionCheck_.begin();
+    double clearance = HUGE_VAL;
+    double p0[3], p1[3];
+    for (unsigned int i=0; i<checkPairs_.size(); i++){
+        int n = robotModels.count(checkPairs_[i].model(0)) 
+            + robotModels.count(checkPairs_[i].model(1));
+        if (n == 0 || (n == 2 && isRigid)) continue;
+        double d = checkPairs_[i].computeDistance(p0, p1);
+        if (d < 0) continue;
+        d -= checkPairs_[i].tolerance();
+        // ロボットのリンク同士は互いに近づくので半分とする
+        if (n == 2) d /= 2;
+        if (d < clearance) clearance = d;
+    }
+    timeCollisionCheck_.end();
+    return clearance < 0 ? 0 : clearance;
+}
+
+void PathPlanner::setupLipschitzConstants()
+{
+    if (!model_ || !isRigidMotion(m_applyConfigFunc)) return;
+
+    // x, yは1、thetaはベースの鉛直軸から最も遠い頂点までの距離
+    Link *root = model_->rootLink();
+    double r = 0;
+    for (int i=0; i<model_->numLinks(); i++){
+        Link *l = model_->link(i);
+        if (!l->coldetModel) continue;
+        for (int j=0; j<l->coldetModel->getNumVertices(); j++){
+            float x, y, z;
+            l->coldetModel->getVertex(j, x, y, z);
+            Vector3 v = l->R*Vector3(x, y, z) + l->p - root->p;
+            double d = sqrt(v(0)*v(0) + v(1)*v(1));
+            if (d > r) r = d;
+        }
+    }
+    lipschitzConstants_.resize(cspace_.size(), 0.0);
+    lipschitzConstants_[0] = lipschitzConstants_[1] = 1;
+    lipschitzConstants_[2] = r;
+}
+
+double PathPlanner::computeFreeRadius(const Configuration &pos)
+{
+    bool isCached;
+    double clearance = computeClearance(pos, isCached);
+    if (clearance <= 0) return clearance;
+
+    if (lipschitzConstants_.empty()) setupLipschitzConstants();
+    if (lipschitzConstants_.size() != cspace_.size()) return 0;
+
+    // キャッシュの距離は各自由度がresolution/2以内の別の姿勢のものなので、
+    // その間にロボット上の点が動く距離の上限を差し引く
+    if (isCached){
+        double margin = 0;
+        for (unsigned int i=0; i<cspace_.size(); i++){
+            margin += lipschitzConstants_[i]*collisionCache_->resolution()/2;
+        }
+        clearance -= margin;
+        if (clearance <= 0) return 0;
+    }
+
+    // sum(L_i*|dq_i|) <= sqrt(sum((L_i/w_i)^2)) * |w*dq| なので、
+    // 重み付き距離がclearance/sqrt(sum((L_i/w_i)^2))未満なら干渉しない
+    double v = 0;
+    for (unsigned int i=0; i<cspace_.size(); i++){
+        double l = lipschitzConstants_[i];
+        if (l == 0) continue;
+        double w = fabs(cspace_.weight(i));
+        if (w == 0) return 0;
+        v += (l/w)*(l/w);
+    }
+    return v == 0 ? HUGE_VAL : clearance/sqrt(v);
+}
 bool PathPlanner::calcPath()
 {
     path_.clear();
@@ -873,6 +1048,8 @@ double PathPlanner::timeForwardKinematics() const
 void PathPlanner::setApplyConfigFunc(applyConfigFunc i_func)
 {
     m_applyConfigFunc = i_func;
+    lipschitzConstants_.clear();
+    clearCollisionCache();
 }
 
 BodyPtr PathPlanner::robot()
@@ -885,9 +1062,152 @@ WorldPtr PathPlanner::world()
     return world_;
 }
 
+PathPlannerPtr PathPlanner::createWorker()
+{
+    if (customCollisionDetector_ || !USE_INTERNAL_COLLISION_DETECTOR || !model_){
+        return PathPlannerPtr();
+    }
+
+    PathPlannerPtr worker(new PathPlanner(cspace_.size(), world_, false));
+    worker->m_applyConfigFunc = m_applyConfigFunc;
+    worker->cspace_ = cspace_;
+    worker->mobilityFactory_ = mobilityFactory_;
+    if (mobility_ != NULL) worker->setMobilityName(mobilityName_);
+    worker->bboxMode_ = bboxMode_;
+    worker->pointCloud_ = pointCloud_;
+    worker->radius_ = radius_;
+    worker->lipschitzConstants_ = lipschitzConstants_;
+    worker->collisionCache_ = collisionCache_;
+
+    // the links of the robot are replaced with those of the copy
+    worker->model_ = BodyPtr(new Body(*model_));
+    std::map<ColdetModel*, ColdetModelPtr> models;
+    for (int i=0; i<model_->numLinks(); i++){
+        Link *l = model_->link(i);
+        if (l->coldetModel) models[l->coldetModel.get()] = worker->model_->link(i)->coldetModel;
+    }
+    for (unsigned int i=0; i<checkPairs_.size(); i++){
+        ColdetModelPtr pairModels[2];
+        for (int j=0; j<2; j++){
+            ColdetModel *m = checkPairs_[i].model(j);
+            std::map<ColdetModel*, ColdetModelPtr>::iterator it = models.find(m);
+            pairModels[j] = it != models.end() ? it->second : ColdetModelPtr(m);
+        }
+        worker->checkPairs_.push_back(ColdetModelPair(pairModels[0], pairModels[1],
+                                                      checkPairs_[i].tolerance()));
+    }
+    return worker;
+}
+
+namespace {
+    // FNV-1a
+    class Hash {
+    public:
+        Hash() : value_(14695981039346656037ULL) {}
+        void add(const void *data, size_t size) {
+            const unsigned char *p = (const unsigned char *)data;
+            for (size_t i=0; i<size; i++){
+                value_ = (value_ ^ p[i])*1099511628211ULL;
+            }
+        }
+        void add(double v) { add(&v, sizeof(v)); }
+        void add(int v) { add(&v, sizeof(v)); }
+        void add(const std::string &s) { add((int)s.size()); add(s.data(), s.size()); }
+        void add(const Vector3 &v) { for (int i=0; i<3; i++) add((double)v(i)); }
+        void add(const Matrix33 &m) { for (int i=0; i<3; i++) for (int j=0; j<3; j++) add((double)m(i,j)); }
+        void add(ColdetModel *m) {
+            if (!m) { add(-1); return; }
+            add(m->name());
+            add(m->getNumVertices());
+            for (int i=0; i<m->getNumVertices(); i++){
+                float x, y, z;
+                m->getVertex(i, x, y, z);
+                add((double)x); add((double)y); add((double)z);
+            }
+            add(m->getNumTriangles());
+            for (int i=0; i<m->getNumTriangles(); i++){
+                int v1, v2, v3;
+                m->getTriangle(i, v1, v2, v3);
+                add(v1); add(v2); add(v3);
+            }
+        }
+        boost::uint64_t value() const { return value_; }
+    private:
+        boost::uint64_t value_;
+    };
+}
+
+boost::uint64_t PathPlanner::roadmapKey(const std::string &params)
+{
+    Hash hash;
+    hash.add(params);
+    hash.add(mobilityName_);
+    hash.add((int)cspace_.size());
+    for (unsigned int i=0; i<cspace_.size(); i++){
+        hash.add(cspace_.lbound(i));
+        hash.add(cspace_.ubound(i));
+        hash.add(cspace_.weight(i));
+        hash.add((int)cspace_.unboundedRotation(i));
+    }
+    for (int i=0; i<world_->numBodies(); i++){
+        BodyPtr body = world_->body(i);
+        bool isRobot = body == model_;
+        hash.add(body->name());
+        hash.add((int)isRobot);
+        for (int j=0; j<body->numLinks(); j++){
+            Link *l = body->link(j);
+            hash.add(l->name);
+            hash.add(l->coldetModel.get());
+            // ロボットの位置はコンフィギュレーションで決まるので関節角のみ
+            if (isRobot){
+                hash.add(l->q);
+            }else{
+                hash.add(l->p);
+                hash.add(l->R);
+            }
+        }
+    }
+    for (unsigned int i=0; i<checkPairs_.size(); i++){
+        hash.add(checkPairs_[i].model(0)->name());
+        hash.add(checkPairs_[i].model(1)->name());
+        hash.add(checkPairs_[i].tolerance());
+    }
+    hash.add((int)pointCloud_.size());
+    for (unsigned int i=0; i<pointCloud_.size(); i++){
+        hash.add(pointCloud_[i]);
+    }
+    hash.add(radius_);
+    return hash.value();
+}
+
 void PathPlanner::setPointCloud(const std::vector<Vector3>& i_cloud, 
                                 double i_radius)
 {
     pointCloud_ = i_cloud;
     radius_ = i_radius;
+    clearCollisionCache();
+}
+
+void PathPlanner::enableCollisionCache(unsigned int capacity, double resolution)
+{
+    if (capacity == 0){
+        collisionCache_.reset();
+    }else{
+        collisionCache_ = CollisionCachePtr(new CollisionCache(&cspace_, capacity, resolution));
+    }
+}
+
+void PathPlanner::clearCollisionCache()
+{
+    if (collisionCache_) collisionCache_->clear();
+}
+
+unsigned long PathPlanner::countCollisionCacheHit() const
+{
+    return collisionCache_ ? collisionCache_->numHits() : 0;
+}
+
+unsigned long PathPlanner::countCollisionCacheMiss() const
+{
+    return collisionCache_ ? collisionCache_->numMisses() : 0;
 }
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <sstream>
 #include <boost/function.hpp>
+#include <boost/cstdint.hpp>
 #include "hrpUtil/TimeMeasure.h"
 
 #include "exportdef.h"
@@ -17,6 +18,7 @@
 #include "Mobility.h"
 #include "Optimizer.h"
 #include "CollisionDetector.h"
+#include "CollisionCache.h"
 #include "hrpCollision/ColdetModelPair.h"
 #undef random
 
@@ -35,6 +37,7 @@ namespace PathEngine {
     class PathPlanner;
 
     typedef boost::function2<bool, PathPlanner *, const Configuration &> applyConfigFunc;
+    typedef boost::shared_ptr<PathPlanner> PathPlannerPtr;
     typedef boost::shared_ptr<hrp::World<hrp::ConstraintForceSolver> > WorldPtr;
     /**
      * @brief 計画経路エンジン
@@ -162,7 +165,33 @@ namespace PathEngine {
 
         CollisionDetector *customCollisionDetector_;
 
+        /**
+         * @brief 各自由度を単位量動かした時にロボット上の点が動く距離の上限
+         */
+        std::vector<double> lipschitzConstants_;
+
+        /**
+         * @brief 干渉チェックの結果のキャッシュ。createWorker()で生成したPathPlannerと共有する
+         */
+        CollisionCachePtr collisionCache_;
+
         bool defaultCheckCollision();
+
+        /**
+         * @brief ロボットの姿勢をベースの位置と向きで与えている場合に、形状からlipschitzConstants_を求める
+         */
+        void setupLipschitzConstants();
+
+        /**
+         * @brief computeClearance()を計算する
+         * @param isCached 距離をキャッシュから得た場合にtrue
+         */
+        double computeClearance(const Configuration &pos, bool &isCached);
+
+        /**
+         * @brief キャッシュを用いずにcomputeClearance()を計算する
+         */
+        double computeClearanceWithoutCache(const Configuration &pos);
     public:
         /**
          * @brief 物理世界を取得する
@@ -249,6 +278,14 @@ namespace PathEngine {
          */
         void initPlanner(const std::string &nameServer);
 
+        /**
+         * @brief 初期化。CORBAサーバを使用せずにプロセス内で計画を行う。
+         *
+         * ORBを初期化せず、ネームサーバ、ModelLoader、OnlineViewerとの接続も行わない。
+         * モデルはregisterCharacterByFile()で読み込み、干渉チェックには内部の干渉チェッカを用いる。
+         */
+        void initPlanner();
+
         /**
          * @brief キャラクタを動力学シミュレータに登録する。
          * @param name モデル名
@@ -270,6 +307,16 @@ namespace PathEngine {
          */
         hrp::BodyPtr registerCharacterByURL(const char* name, const char* url);
 
+        /**
+         * @brief VRMLファイルからモデルを読み込み、キャラクタを動力学シミュレータに登録する。
+         *
+         * ModelLoaderを使用せず、プロセス内でモデルファイルを読み込む。
+         * @param name モデル名
+         * @param filename モデルファイル名またはURL
+         * @return 登録されたモデル。読み込みに失敗した場合は空
+         */
+        hrp::BodyPtr registerCharacterByFile(const char* name, const std::string& filename);
+
         /**
          * @brief 位置を設定する
          *
@@ -435,6 +482,38 @@ namespace PathEngine {
          */
         bool checkCollision(const std::vector<Configuration> &path);
 
+        /**
+         * @brief ロボットと環境の最短距離を計算する
+         *
+         * 距離は内部の干渉検出器で登録された干渉チェックペアについて計算し、
+         * toleranceを差し引く。ロボットのリンク同士のペアは、ロボットが剛体として
+         * 動く場合は含めず、そうでない場合は距離の半分とする。
+         * 距離を計算できない場合(独自の干渉検出器やポイントクラウドを用いている場合)は0を返す
+         * @param pos ロボットの位置
+         * @return 最短距離。干渉している場合は負の値
+         */
+        double computeClearance(const Configuration &pos);
+
+        /**
+         * @brief 干渉しないことが保証されるコンフィギュレーション空間の半径を計算する
+         *
+         * 各自由度の差に重みをかけたもののユークリッド距離が半径未満の姿勢は干渉しない。
+         * computeClearance()の距離を、setLipschitzConstants()で与えた定数を用いて換算する
+         * @param pos ロボットの位置
+         * @return 半径。干渉している場合は負の値
+         */
+        double computeFreeRadius(const Configuration &pos);
+
+        /**
+         * @brief 各自由度を単位量動かした時にロボット上の点が動く距離の上限を設定する
+         *
+         * 設定しない場合、コンフィギュレーションをベースの位置と向きとして用いている時は
+         * ロボットの形状から求め、それ以外の場合はcomputeFreeRadius()は0を返す。
+         * setRobotName()、setApplyConfigFunc()を呼ぶと設定は消去される
+         * @param i_constants 自由度ごとの上限
+         */
+        void setLipschitzConstants(const std::vector<double> &i_constants) { lipschitzConstants_ = i_constants; }
+
         /**
          * @brief デバッグモードの変更
          * @param debug デバッグモードのOn/Off
@@ -454,6 +533,37 @@ namespace PathEngine {
          */
         unsigned int countCollisionCheck() const { return timeCollisionCheck_.numCalls();}
 
+        /**
+         * @brief 干渉チェックの結果をキャッシュする
+         *
+         * 各自由度をresolutionで量子化した値が等しいコンフィギュレーションは同じ結果を共有する。
+         * 干渉チェックペアやロボットの設定を変更した場合、setCharacterPosition()で
+         * 物体を動かした場合はキャッシュは消去されるが、それ以外の方法で
+         * 環境の物体を動かした場合はclearCollisionCache()を呼ぶこと。
+         * キャッシュから得た距離はcomputeFreeRadius()で量子化の誤差を差し引いて用いる。
+         * キャッシュから結果を得た場合、ロボットの姿勢やcollidingPair()は更新されない
+         * @param capacity 保持する結果の数の上限。0の場合はキャッシュを用いない
+         * @param resolution 量子化の幅
+         */
+        void enableCollisionCache(unsigned int capacity, double resolution=1e-6);
+
+        /**
+         * @brief キャッシュした干渉チェックの結果を消去する
+         */
+        void clearCollisionCache();
+
+        /**
+         * @brief 干渉チェックの結果がキャッシュから得られた回数を取得する
+         * @return キャッシュから得られた回数
+         */
+        unsigned long countCollisionCacheHit() const;
+
+        /**
+         * @brief 干渉チェックの結果がキャッシュから得られなかった回数を取得する
+         * @return キャッシュから得られなかった回数
+         */
+        unsigned long countCollisionCacheMiss() const;
+
         /**
          * @brief 干渉チェックに使用した時間[s]を取得する
          * @return 干渉チェックに使用した時間[s]
@@ -468,7 +578,30 @@ namespace PathEngine {
 
         void setCollisionDetector(CollisionDetector *i_cd){
             customCollisionDetector_ = i_cd; 
+            clearCollisionCache();
         }
+
+        /**
+         * @brief 保存したロードマップを識別するためのキーを計算する
+         *
+         * ロボットと環境の形状・配置、干渉チェックペア、ポイントクラウド、
+         * 移動能力の名前、コンフィギュレーション空間の範囲・重みと、引数の文字列から計算する。
+         * setApplyConfigFunc()で設定した関数や独自の干渉検出器は含まれない
+         * @param params アルゴリズム固有のパラメータを並べた文字列
+         * @return キー
+         */
+        boost::uint64_t roadmapKey(const std::string &params);
+
+        /**
+         * @brief 並列に干渉チェックを行うためのPathPlannerを生成する
+         *
+         * ロボットのモデルと干渉チェックペアを複製し、環境のモデルは共有する。
+         * コンフィギュレーション空間、移動能力、ロボットの姿勢をセットする関数は同じものが使われる。
+         * ロボットの姿勢をセットする関数はrobot()のみを変更するものでなければならない。
+         * 生成したPathPlannerを使用している間は環境のモデルを動かしてはならない。
+         * @return 生成したPathPlanner。独自の干渉検出器が設定されている場合などはNULL
+         */
+        PathPlannerPtr createWorker();
     };
 };
 #endif // __PATH_PLANNER_H__
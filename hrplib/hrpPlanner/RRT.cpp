@@ -14,12 +14,14 @@ RRT::RRT(PathPlanner* plan) : Algorithm(plan)
     // set default properties
     properties_["max-trials"] = "10000";
     properties_["eps"] = "0.1";
+    properties_["clearance-step"] = "0";
 
     Tstart_ = Ta_ = roadmap_;
     Tgoal_  = Tb_ = RoadmapPtr(new Roadmap(planner_));
 
     extendFromStart_ = true;
     extendFromGoal_ = false;
+    clearanceStep_ = false;
 }
 
 RRT::~RRT() 
@@ -39,9 +41,16 @@ int RRT::extend(RoadmapPtr tree, Configuration& qRand, bool reverse) {
     if (minNode != NULL) {
         Mobility* mobility = planner_->getMobility();
 
-        if (min > eps_){
+        // 干渉しないことが保証された範囲までは大きくのばす
+        double eps = eps_;
+        if (clearanceStep_ && mobility->isInterpolationBoundedByDistance()){
+            double r = planner_->computeFreeRadius(minNode->position());
+            if (r > eps) eps = r;
+        }
+
+        if (min > eps){
             Configuration qRandOrg = qRand;
-            qRand = mobility->interpolate(minNode->position(), qRand, eps_/min);
+            qRand = mobility->interpolate(minNode->position(), qRand, eps/min);
             if (debug) std::cout << "qRand = (" << qRand << ")" << std::endl;
             if (mobility->distance(minNode->position(), qRand) > min){
                 std::cout << "distance didn't decrease" << std::endl;
@@ -59,7 +68,7 @@ int RRT::extend(RoadmapPtr tree, Configuration& qRand, bool reverse) {
                 RoadmapNodePtr newNode = RoadmapNodePtr(new RoadmapNode(qRand));
                 tree->addNode(newNode);
                 tree->addEdge(newNode, minNode);
-                if (min <= eps_) {
+                if (min <= eps) {
                     if (debug) std::cout << "reached(" << qRand << ")"<< std::endl;
                     return Reached;
                 }
@@ -76,7 +85,7 @@ int RRT::extend(RoadmapPtr tree, Configuration& qRand, bool reverse) {
                 RoadmapNodePtr newNode = RoadmapNodePtr(new RoadmapNode(qRand));
                 tree->addNode(newNode);
                 tree->addEdge(minNode, newNode);
-                if (min <= eps_) {
+                if (min <= eps) {
                     if (debug) std::cout << "reached(" << qRand << ")"<< std::endl;
                     return Reached;
                 }
@@ -144,7 +153,8 @@ void RRT::extractPath(std::vector<Configuration>& o_path) {
 
 bool RRT::extendOneStep()
 {
-    Configuration qNew = planner_->getConfigurationSpace()->random();
+    ConfigurationSpace *cspace = planner_->getConfigurationSpace();
+    Configuration qNew = uniform_ ? cspace->random(uniform_) : cspace->random();
     if (extendFromStart_ && extendFromGoal_){
         
         if (extend(Ta_, qNew, Tb_ == Tstart_) != Trapped) {
@@ -180,6 +190,8 @@ bool RRT::calcPath()
     // eps
     eps_ = atof(properties_["eps"].c_str());
 
+    clearanceStep_ = atoi(properties_["clearance-step"].c_str()) != 0;
+
     if (verbose_){
         std::cout << "times:" << times_ << std::endl;
         std::cout << "eps:" << eps_ << std::endl;
@@ -5,6 +5,7 @@
 #include <string>
 #include <iostream>
 #include <stdio.h>
+#include <boost/function.hpp>
 
 #include "PathPlanner.h"
 #include "Algorithm.h"
@@ -82,6 +83,16 @@ namespace PathEngine {
      */
     bool extendFromGoal_;
 
+    /**
+     * 干渉しないことが保証された範囲まではeps_を超えてのばすか否か
+     */
+    bool clearanceStep_;
+
+    /**
+     * [0,1)の一様乱数を返す関数。空の場合はConfigurationSpace::random()を用いる
+     */
+    boost::function0<double> uniform_;
+
   public:
     /**
      * @brief コンストラクタ
@@ -156,6 +167,18 @@ namespace PathEngine {
      * @param e サンプリングしたコンフィギュレーションに向かって伸ばす距離
      */
     void epsilon(double e) { eps_ = e; }
+
+    /**
+     * @brief PathPlanner::computeFreeRadius()の半径までeps_を超えてのばすか否かを設定
+     * @param b trueでのばす
+     */
+    void clearanceStep(bool b) { clearanceStep_ = b; }
+
+    /**
+     * @brief ランダムなコンフィギュレーションの生成に用いる乱数を設定
+     * @param uniform [0,1)の一様乱数を返す関数
+     */
+    void randomGenerator(const boost::function0<double>& uniform) { uniform_ = uniform; }
   };
 };
 
@@ -3,13 +3,176 @@
 #include "Mobility.h"
 #include "RoadmapNode.h"
 #include "Roadmap.h"
+#include "NearestNeighborIndex.h"
+#include <algorithm>
+#include <queue>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <boost/unordered_map.hpp>
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 using namespace PathEngine;
 
+namespace {
+    // search state of a node in Roadmap::shortestPath()
+    struct Label {
+        Label() : cost(0), closed(false), parent(NULL), index(0) {}
+        double cost;
+        bool closed;
+        // the node is the index th child of the parent
+        PathEngine::RoadmapNode *parent;
+        unsigned int index;
+    };
+}
+
 void Roadmap::clear()
 {
     nodes_.clear();
     m_nEdges = 0;
+    index_.reset();
+}
+
+namespace {
+    const char roadmapFileMagic[8] = "HRPRMAP";
+    const boost::uint32_t roadmapFileVersion = 1;
+
+    template <class T>
+    void writeValue(std::ostream &os, const T &v)
+    {
+        os.write((const char *)&v, sizeof(T));
+    }
+
+    template <class T>
+    bool readValue(std::istream &is, T &v)
+    {
+        is.read((char *)&v, sizeof(T));
+        return is.good();
+    }
+}
+
+bool Roadmap::save(const std::string &filename, boost::uint64_t key) const
+{
+    return save(filename, key, nodes_.size());
+}
+
+bool Roadmap::save(const std::string &filename, boost::uint64_t key, unsigned int nNodes) const
+{
+    // 書き込み途中のファイルを他のプロセスが読み込まないよう、一時ファイルに書いてから置き換える
+    std::ostringstream tmp;
+    tmp << filename << ".tmp" << getpid();
+    std::string tmpFilename = tmp.str();
+    if (!writeFile(tmpFilename, key, nNodes)){
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    try {
+        boost::filesystem::rename(tmpFilename, filename);
+    } catch (const boost::filesystem::filesystem_error &) {
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Roadmap::writeFile(const std::string &filename, boost::uint64_t key, unsigned int nNodes) const
+{
+    std::ofstream ofs(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs) return false;
+
+    if (nNodes > nodes_.size()) nNodes = nodes_.size();
+    boost::unordered_map<RoadmapNode *, boost::uint32_t> indices;
+    for (unsigned int i=0; i<nNodes; i++){
+        indices[nodes_[i].get()] = i;
+    }
+    boost::uint32_t dim = nNodes == 0 ? 0 : nodes_[0]->position().size();
+
+    ofs.write(roadmapFileMagic, sizeof(roadmapFileMagic));
+    writeValue(ofs, roadmapFileVersion);
+    writeValue(ofs, key);
+    writeValue(ofs, dim);
+    writeValue(ofs, (boost::uint32_t)nNodes);
+    for (unsigned int i=0; i<nNodes; i++){
+        const Configuration &pos = nodes_[i]->position();
+        for (unsigned int j=0; j<dim; j++) writeValue(ofs, pos[j]);
+    }
+    // 各ノードの子ノードの番号とエッジの状態。保存しないノードへのエッジは除く
+    for (unsigned int i=0; i<nNodes; i++){
+        RoadmapNodePtr node = nodes_[i];
+        boost::uint32_t n = 0;
+        for (unsigned int j=0; j<node->nChildren(); j++){
+            if (indices.count(node->child(j).get())) n++;
+        }
+        writeValue(ofs, n);
+        for (unsigned int j=0; j<node->nChildren(); j++){
+            boost::unordered_map<RoadmapNode *, boost::uint32_t>::iterator it
+                = indices.find(node->child(j).get());
+            if (it == indices.end()) continue;
+            writeValue(ofs, it->second);
+            writeValue(ofs, (boost::uint8_t)node->edgeState(j));
+        }
+    }
+    ofs.close();
+    return !ofs.fail();
+}
+
+bool Roadmap::load(const std::string &filename, boost::uint64_t key)
+{
+    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) return false;
+
+    char magic[sizeof(roadmapFileMagic)];
+    boost::uint32_t version, dim, nNodes;
+    boost::uint64_t fileKey;
+    ifs.read(magic, sizeof(magic));
+    if (!ifs.good() || memcmp(magic, roadmapFileMagic, sizeof(magic)) != 0) return false;
+    if (!readValue(ifs, version) || version != roadmapFileVersion) return false;
+    if (!readValue(ifs, fileKey) || fileKey != key) return false;
+    if (!readValue(ifs, dim) || !readValue(ifs, nNodes)) return false;
+    if (nNodes && dim != planner_->getConfigurationSpace()->size()) return false;
+
+    std::vector<RoadmapNodePtr> nodes;
+    nodes.reserve(nNodes);
+    Configuration pos(dim);
+    for (unsigned int i=0; i<nNodes; i++){
+        for (unsigned int j=0; j<dim; j++){
+            if (!readValue(ifs, pos[j])) return false;
+        }
+        nodes.push_back(RoadmapNodePtr(new RoadmapNode(pos)));
+    }
+    // エッジは全て読み込めてから追加する
+    std::vector<boost::uint32_t> froms, tos;
+    std::vector<boost::uint8_t> states;
+    for (unsigned int i=0; i<nNodes; i++){
+        boost::uint32_t n;
+        if (!readValue(ifs, n)) return false;
+        for (unsigned int j=0; j<n; j++){
+            boost::uint32_t to;
+            boost::uint8_t state;
+            if (!readValue(ifs, to) || !readValue(ifs, state)) return false;
+            if (to >= nNodes || state > RoadmapNode::Invalid) return false;
+            froms.push_back(i);
+            tos.push_back(to);
+            states.push_back(state);
+        }
+    }
+
+    clear();
+    for (unsigned int i=0; i<nodes.size(); i++){
+        addNode(nodes[i]);
+    }
+    for (unsigned int i=0; i<froms.size(); i++){
+        addEdge(nodes[froms[i]], nodes[tos[i]], (RoadmapNode::EdgeState)states[i]);
+    }
+    return true;
 }
 
 Roadmap::~Roadmap()
@@ -17,9 +180,10 @@ Roadmap::~Roadmap()
     clear();
 }
 
-void Roadmap::addEdge(RoadmapNodePtr from, RoadmapNodePtr to)
+void Roadmap::addEdge(RoadmapNodePtr from, RoadmapNodePtr to,
+                      RoadmapNode::EdgeState state)
 {
-    from->addChild(to);
+    from->addChild(to, state);
     to->addParent(from); 
     m_nEdges++;
 }
@@ -30,6 +194,7 @@ void Roadmap::integrate(RoadmapPtr rdmp)
         rdmp->addNode(nodes_[i]);
     }
     nodes_.clear();
+    index_.reset();
 }
 
 RoadmapNodePtr Roadmap::node(unsigned int index)
@@ -39,6 +204,24 @@ RoadmapNodePtr Roadmap::node(unsigned int index)
     return nodes_[index];
 }
 
+NearestNeighborIndex* Roadmap::updateIndex()
+{
+    Mobility *mobility = planner_->getMobility();
+    if (!mobility->isDistanceBoundedByWeights()){
+        index_.reset();
+        return NULL;
+    }
+
+    ConfigurationSpace *cspace = planner_->getConfigurationSpace();
+    if (!index_ || !index_->isCompatible(cspace, mobility)){
+        index_.reset(new NearestNeighborIndex(cspace, mobility));
+    }
+    for (unsigned int i=index_->size(); i<nodes_.size(); i++){
+        index_->addNode(nodes_[i]);
+    }
+    return index_.get();
+}
+
 void Roadmap::findNearestNode(const Configuration& pos,
                               RoadmapNodePtr & node, double &distance)
 {
@@ -47,6 +230,12 @@ void Roadmap::findNearestNode(const Configuration& pos,
         return;
     }
 
+    NearestNeighborIndex *index = updateIndex();
+    if (index){
+        node = index->nearest(pos, distance);
+        return;
+    }
+
     node = nodes_[0];
     Mobility *mobility = planner_->getMobility();
     distance = mobility->distance(node->position(), pos);
@@ -61,6 +250,56 @@ void Roadmap::findNearestNode(const Configuration& pos,
     }
 }
 
+void Roadmap::findNearestNodes(const Configuration& pos, unsigned int k,
+                               std::vector<RoadmapNodePtr> &nodes,
+                               std::vector<double> &distances)
+{
+    NearestNeighborIndex *index = updateIndex();
+    if (index){
+        index->nearest(pos, k, nodes, distances);
+        return;
+    }
+
+    Mobility *mobility = planner_->getMobility();
+    std::vector<std::pair<double, unsigned int> > candidates(nodes_.size());
+    for (unsigned int i=0; i<nodes_.size(); i++){
+        candidates[i] = std::make_pair(mobility->distance(nodes_[i]->position(), pos), i);
+    }
+    if (k > candidates.size()) k = candidates.size();
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+    nodes.resize(k);
+    distances.resize(k);
+    for (unsigned int i=0; i<k; i++){
+        distances[i] = candidates[i].first;
+        nodes[i] = nodes_[candidates[i].second];
+    }
+}
+
+void Roadmap::findNodesWithin(const Configuration& pos, double radius,
+                              std::vector<RoadmapNodePtr> &nodes,
+                              std::vector<double> &distances)
+{
+    NearestNeighborIndex *index = updateIndex();
+    if (index){
+        index->neighbors(pos, radius, nodes, distances);
+        return;
+    }
+
+    Mobility *mobility = planner_->getMobility();
+    std::vector<std::pair<double, unsigned int> > candidates;
+    for (unsigned int i=0; i<nodes_.size(); i++){
+        double d = mobility->distance(nodes_[i]->position(), pos);
+        if (d <= radius) candidates.push_back(std::make_pair(d, i));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    nodes.resize(candidates.size());
+    distances.resize(candidates.size());
+    for (unsigned int i=0; i<candidates.size(); i++){
+        distances[i] = candidates[i].first;
+        nodes[i] = nodes_[candidates[i].second];
+    }
+}
+
 RoadmapNodePtr Roadmap::lastAddedNode()
 {
     if (nodes_.size() == 0) return RoadmapNodePtr();
@@ -112,6 +351,20 @@ std::vector<RoadmapNodePtr > Roadmap::DFS(RoadmapNodePtr startNode, RoadmapNodeP
 void Roadmap::tryConnection(RoadmapNodePtr from, RoadmapNodePtr to, bool tryReverse)
 {
     Mobility *mobility = planner_->getMobility();
+    if (lazy_){
+        // only the edges which the mobility can follow are added
+        if (mobility->isReachable(from->position(), to->position(), false)){
+            addEdge(from, to, RoadmapNode::Unchecked);
+            if (tryReverse && mobility->isReversible()) addEdge(to, from, RoadmapNode::Unchecked);
+        }
+        if (tryReverse && !mobility->isReversible()){
+            if (mobility->isReachable(to->position(), from->position(), false)){
+                addEdge(to, from, RoadmapNode::Unchecked);
+            }
+        }
+        return;
+    }
+
     if (mobility->isReachable(from->position(), to->position())){
         addEdge(from, to);
         if (tryReverse && mobility->isReversible()) addEdge(to, from);
@@ -125,5 +378,93 @@ void Roadmap::tryConnection(RoadmapNodePtr from, RoadmapNodePtr to, bool tryReve
 
 bool Roadmap::removeEdge(RoadmapNodePtr from, RoadmapNodePtr to)
 {
-    return from->removeChild(to) && to->removeParent(from);
+    if (from->removeChild(to) && to->removeParent(from)){
+        m_nEdges--;
+        return true;
+    }
+    return false;
+}
+
+std::vector<RoadmapNodePtr > Roadmap::shortestPath(RoadmapNodePtr startNode, RoadmapNodePtr goalNode)
+{
+    typedef std::pair<double, RoadmapNode*> QueueEntry;
+
+    Mobility *mobility = planner_->getMobility();
+    boost::unordered_map<RoadmapNode*, Label> labels;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > queue;
+
+    labels[startNode.get()] = Label();
+    queue.push(QueueEntry(mobility->distance(startNode->position(), goalNode->position()),
+                          startNode.get()));
+    while (!queue.empty()){
+        RoadmapNode *node = queue.top().second;
+        queue.pop();
+        Label &label = labels[node];
+        if (label.closed) continue;
+        label.closed = true;
+        if (node == goalNode.get()) break;
+
+        double nodeCost = label.cost;
+        for (unsigned int i=0; i<node->nChildren(); i++){
+            if (node->edgeState(i) == RoadmapNode::Invalid) continue;
+            RoadmapNode *child = node->child(i).get();
+            double cost = nodeCost
+                + mobility->distance(node->position(), child->position());
+            Label &childLabel = labels[child];
+            if (childLabel.closed || (childLabel.parent && childLabel.cost <= cost)) continue;
+            childLabel.cost = cost;
+            childLabel.parent = node;
+            childLabel.index = i;
+            queue.push(QueueEntry(cost + mobility->distance(child->position(), goalNode->position()),
+                                  child));
+        }
+    }
+
+    std::vector<RoadmapNodePtr> path;
+    if (!labels[goalNode.get()].closed) return path;
+
+    RoadmapNode *node = goalNode.get();
+    while (node != startNode.get()){
+        const Label &label = labels[node];
+        path.push_back(label.parent->child(label.index));
+        node = label.parent;
+    }
+    path.push_back(startNode);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+bool Roadmap::validateEdge(RoadmapNodePtr from, unsigned int index)
+{
+    Mobility *mobility = planner_->getMobility();
+    RoadmapNodePtr to = from->child(index);
+    bool isValid = mobility->isReachable(from->position(), to->position());
+
+    int reverseIndex = mobility->isReversible() ? to->indexOfChild(from) : -1;
+    if (isValid){
+        from->edgeState(index, RoadmapNode::Valid);
+        if (reverseIndex >= 0) to->edgeState(reverseIndex, RoadmapNode::Valid);
+    }else{
+        removeEdge(from, to);
+        if (reverseIndex >= 0) removeEdge(to, from);
+    }
+    return isValid;
+}
+
+std::vector<RoadmapNodePtr > Roadmap::findPath(RoadmapNodePtr startNode, RoadmapNodePtr goalNode)
+{
+    while (true){
+        std::vector<RoadmapNodePtr> path = shortestPath(startNode, goalNode);
+
+        bool isValid = true;
+        for (unsigned int i=0; i+1<path.size(); i++){
+            int index = path[i]->indexOfChild(path[i+1]);
+            if (path[i]->edgeState(index) == RoadmapNode::Unchecked
+                && !validateEdge(path[i], index)){
+                isValid = false;
+                break;
+            }
+        }
+        if (isValid) return path;
+    }
 }
@@ -3,13 +3,16 @@
 #define __ROADMAP_H__
 
 #include <vector>
+#include <string>
 #include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
 #include "Configuration.h"
 #include "RoadmapNode.h"
 #include "exportdef.h"
 
 namespace PathEngine{
     class PathPlanner;
+    class NearestNeighborIndex;
     class Roadmap;
     typedef boost::shared_ptr<Roadmap> RoadmapPtr;
 
@@ -21,7 +24,7 @@ namespace PathEngine{
         /**
          * @brief コンストラクタ
          */
-        Roadmap(PathPlanner *planner) : planner_(planner), m_nEdges(0) {}
+        Roadmap(PathPlanner *planner) : planner_(planner), m_nEdges(0), lazy_(false) {}
 
         /**
          * @brief デストラクタ
@@ -40,8 +43,10 @@ namespace PathEngine{
          * @brief 有向エッジを追加する
          * @param from エッジの始点
          * @param to エッジの終点
+         * @param state エッジの干渉チェックの状態
          */
-        void addEdge(RoadmapNodePtr from, RoadmapNodePtr to);
+        void addEdge(RoadmapNodePtr from, RoadmapNodePtr to,
+                     RoadmapNode::EdgeState state=RoadmapNode::Valid);
 
         /**
          * @brief 有向エッジを削除する
@@ -82,6 +87,28 @@ namespace PathEngine{
          */
         void findNearestNode(const Configuration& cfg, RoadmapNodePtr &node, double &distance); 
 
+        /**
+         * @brief 距離の小さい順にk個のノードを返す
+         * @param cfg 距離計算を行う対象となる位置
+         * @param k ノードの数
+         * @param nodes 距離の小さい順に並べたノード
+         * @param distances 各ノードまでの距離
+         */
+        void findNearestNodes(const Configuration& cfg, unsigned int k,
+                              std::vector<RoadmapNodePtr> &nodes,
+                              std::vector<double> &distances);
+
+        /**
+         * @brief 距離が指定の値以下のノードを返す
+         * @param cfg 距離計算を行う対象となる位置
+         * @param radius 距離の上限
+         * @param nodes 距離の小さい順に並べたノード
+         * @param distances 各ノードまでの距離
+         */
+        void findNodesWithin(const Configuration& cfg, double radius,
+                             std::vector<RoadmapNodePtr> &nodes,
+                             std::vector<double> &distances);
+
         /**
          * @brief 最後に追加されたノードを取得する
          * @return 最後に追加されたノード。ノードが一つもない場合はNULL
@@ -103,6 +130,17 @@ namespace PathEngine{
          */
         std::vector<RoadmapNodePtr > DFS(RoadmapNodePtr startNode, RoadmapNodePtr goalNode);
 
+        /**
+         * @brief エッジの長さの和が最小となる経路をA*で探索する
+         *
+         * 経路上に干渉チェックされていないエッジがあればそれらを検査し、
+         * 干渉するエッジを削除して探索し直す。検査の結果はエッジに保存される。
+         * @param startNode 初期ノード
+         * @param goalNode 終了ノード
+         * @return 探索結果を納めたパス。経路がない場合は空
+         */
+        std::vector<RoadmapNodePtr > findPath(RoadmapNodePtr startNode, RoadmapNodePtr goalNode);
+
         /**
          * @brief 2つのノードの接続を試み、接続できた場合はエッジを追加する
          * @param from 接続元
@@ -111,17 +149,100 @@ namespace PathEngine{
          */
         void tryConnection(RoadmapNodePtr from,  RoadmapNodePtr to, bool tryReversed=true);
 
+        /**
+         * @brief 遅延評価モードを設定する
+         *
+         * 遅延評価モードではtryConnection()は干渉チェックを行わずにエッジを追加し、
+         * 干渉チェックはfindPath()で経路上のエッジに対してのみ行われる。
+         * @param flag 遅延評価モードにする場合true
+         */
+        void lazyMode(bool flag) { lazy_ = flag; }
+
+        /**
+         * @brief 遅延評価モードかどうか
+         * @return 遅延評価モードの場合true
+         */
+        bool lazyMode() const { return lazy_; }
+
         /**
          * @brief ロードマップをクリアする
          */
         void clear();
+
+        /**
+         * @brief ノード、エッジとエッジの干渉チェックの状態をバイナリファイルに保存する
+         *
+         * 数値はこの計算機のバイト順で保存される
+         * @param filename ファイル名
+         * @param key ロードマップを生成した条件を表すキー。PathPlanner::roadmapKey()を参照
+         * @return 保存できた場合true
+         */
+        bool save(const std::string &filename, boost::uint64_t key) const;
+
+        /**
+         * @brief 先頭のnNodes個のノードとその間のエッジのみを保存する
+         *
+         * 後から追加したスタートやゴールのノードを除いて保存する場合に用いる
+         * @param filename ファイル名
+         * @param key ロードマップを生成した条件を表すキー
+         * @param nNodes 保存するノードの数
+         * @return 保存できた場合true
+         */
+        bool save(const std::string &filename, boost::uint64_t key, unsigned int nNodes) const;
+
+        /**
+         * @brief save()で保存したロードマップを読み込む
+         *
+         * 読み込めた場合、このロードマップの内容は置き換えられる
+         * @param filename ファイル名
+         * @param key ロードマップを生成した条件を表すキー
+         * @return ファイルが存在し、キーと自由度が一致して読み込めた場合true
+         */
+        bool load(const std::string &filename, boost::uint64_t key);
     private:
+        /**
+         * @brief save()の内容をファイルに直接書き込む
+         * @return 書き込めた場合true
+         */
+        bool writeFile(const std::string &filename, boost::uint64_t key, unsigned int nNodes) const;
+
+        /**
+         * @brief 近傍探索用の索引を追加されたノードに合わせて更新する
+         * @return 索引。移動能力が索引に対応していない場合はNULL
+         */
+        NearestNeighborIndex* updateIndex();
+
+        /**
+         * @brief 干渉チェックを行わずにA*で最短経路を探索する
+         */
+        std::vector<RoadmapNodePtr > shortestPath(RoadmapNodePtr startNode, RoadmapNodePtr goalNode);
+
+        /**
+         * @brief 干渉チェックされていないエッジを検査する
+         *
+         * 干渉する場合はエッジを削除する。逆向きに移動可能な場合は逆向きのエッジにも結果を反映する。
+         * @param from エッジの始点
+         * @param index 子ノードのインデックス
+         * @return 干渉しない場合true
+         */
+        bool validateEdge(RoadmapNodePtr from, unsigned int index);
+
         /**
          * @brief ノードのリスト
          */
         std::vector<RoadmapNodePtr> nodes_;
         PathPlanner *planner_;
         unsigned int m_nEdges;
+
+        /**
+         * @brief 近傍探索用の索引。最初の探索の際に作成される
+         */
+        boost::shared_ptr<NearestNeighborIndex> index_;
+
+        /**
+         * @brief 遅延評価モード
+         */
+        bool lazy_;
     };
 };
 
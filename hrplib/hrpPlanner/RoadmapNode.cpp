@@ -31,6 +31,7 @@ bool RoadmapNode::removeChild(RoadmapNodePtr node)
     std::vector<RoadmapNodePtr>::iterator it
         = find(children_.begin(), children_.end(), node);
     if (it != children_.end()){
+        edgeStates_.erase(edgeStates_.begin() + (it - children_.begin()));
         children_.erase(it);
         return true;
     }else{
@@ -38,3 +39,14 @@ bool RoadmapNode::removeChild(RoadmapNodePtr node)
     }
 }
 
+int RoadmapNode::indexOfChild(RoadmapNodePtr node) const
+{
+    std::vector<RoadmapNodePtr>::const_iterator it
+        = find(children_.begin(), children_.end(), node);
+    if (it != children_.end()){
+        return it - children_.begin();
+    }else{
+        return -1;
+    }
+}
+
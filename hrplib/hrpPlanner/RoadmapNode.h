@@ -16,6 +16,15 @@ namespace PathEngine {
    */
   class HRPPLANNER_API RoadmapNode {
   public:
+    /**
+     * @brief 子ノードへのエッジの干渉チェックの状態
+     */
+    enum EdgeState {
+      Unchecked, ///< 干渉チェックが行われていない
+      Valid,     ///< 干渉なしに移動できる
+      Invalid    ///< 干渉のため移動できない
+    };
+
     /**
      * @brief コンストラクタ
      * @param pos このノードの座標
@@ -37,7 +46,10 @@ namespace PathEngine {
      * @brief 子ノードの追加
      * @param node 子ノード
      */
-    void addChild(RoadmapNodePtr node) { children_.push_back(node); }
+    void addChild(RoadmapNodePtr node, EdgeState state=Valid) {
+      children_.push_back(node);
+      edgeStates_.push_back(state);
+    }
 
     /**
      * @brief 親ノードの削除
@@ -85,6 +97,27 @@ namespace PathEngine {
      */
     unsigned int nChildren() const { return children_.size(); }
 
+    /**
+     * @brief 子ノードへのエッジの状態を取得する
+     * @param index 子ノードのインデックス
+     * @return エッジの状態
+     */
+    EdgeState edgeState(unsigned int index) const { return edgeStates_[index]; }
+
+    /**
+     * @brief 子ノードへのエッジの状態を設定する
+     * @param index 子ノードのインデックス
+     * @param state エッジの状態
+     */
+    void edgeState(unsigned int index, EdgeState state) { edgeStates_[index] = state; }
+
+    /**
+     * @brief 子ノードのインデックスを取得する
+     * @param node 子ノード
+     * @return 子ノードのインデックス。子ノードでない場合は-1
+     */
+    int indexOfChild(RoadmapNodePtr node) const;
+
     /**
      * @brief 探索用フラグを設定する
      * @param flag 探索済みがtrue、未探索がfalse
@@ -107,6 +140,11 @@ namespace PathEngine {
      */
     std::vector<RoadmapNodePtr> children_;
 
+    /**
+     * @brief 子ノードへのエッジの状態のリスト
+     */
+    std::vector<EdgeState> edgeStates_;
+
     /**
      * @brief このノードの座標
      */
@@ -158,3 +158,10 @@ double TGT::distance(const Configuration& from, const Configuration& to) const
     //std::cout << "d = " << sqrt(dx*dx + dy*dy) << " +  " << dth1 << " + " <<  dth2 << std::endl;
     return sqrt(dx*dx + dy*dy) + dth1 + dth2;
 }
+
+bool TGT::isDistanceBoundedByWeights() const
+{
+    // the turns are never shorter than the difference of the directions on the circle
+    ConfigurationSpace *cspace = planner_->getConfigurationSpace();
+    return cspace->size() == 3 && cspace->unboundedRotation(2);
+}
@@ -35,6 +35,13 @@ namespace PathEngine {
          * @brief 親クラスのドキュメントを参照
          */
         bool isReversible() const { return false; }
+
+        /**
+         * @brief 親クラスのドキュメントを参照
+         *
+         * 方向の自由度が無限回転として設定されている場合にtrueを返す
+         */
+        bool isDistanceBoundedByWeights() const;
     };
 };
 
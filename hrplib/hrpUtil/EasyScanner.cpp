@@ -10,8 +10,16 @@
 #include <cmath>
 #include <cstring>
 #include <boost/format.hpp>
+#include <boost/cstdint.hpp>
 #include <errno.h>
 
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "EasyScanner.h"
 
 using namespace std;
@@ -90,6 +98,136 @@ static inline double mystrtod(const char* nptr, char** endptr) {
 #endif
 
 
+namespace {
+
+    const double powersOf10[] = {
+        1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+        1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+        1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+    };
+
+    inline bool isDigit(char c)
+    {
+        return (c >= '0' && c <= '9');
+    }
+
+    /**
+       Conversion of a decimal number without calling strtod().
+       When the significand is at most 2^53 and the decimal exponent is at most 22,
+       both of them are exact doubles and the result is correctly rounded by one multiplication or division.
+       The other numbers (and hexadecimal, inf, nan) are converted by mystrtod().
+    */
+    double fastStrtod(const char* nptr, char** endptr)
+    {
+        const char* p = nptr;
+        bool isNegative = false;
+        if(*p == '+'){
+            p++;
+        } else if(*p == '-'){
+            isNegative = true;
+            p++;
+        }
+
+        boost::uint64_t significand = 0;
+        int numSignificantDigits = 0;
+        int numDigits = 0;
+        int exponent = 0;
+
+        while(isDigit(*p)){
+            if(significand || *p != '0'){
+                if(++numSignificantDigits > 19){
+                    return mystrtod(nptr, endptr);
+                }
+                significand = significand * 10 + (*p - '0');
+            }
+            numDigits++;
+            p++;
+        }
+        if(*p == '.'){
+            p++;
+            while(isDigit(*p)){
+                if(significand || *p != '0'){
+                    if(++numSignificantDigits > 19){
+                        return mystrtod(nptr, endptr);
+                    }
+                    significand = significand * 10 + (*p - '0');
+                }
+                exponent--;
+                numDigits++;
+                p++;
+            }
+        }
+        if(numDigits == 0 || *p == 'x' || *p == 'X'){
+            return mystrtod(nptr, endptr);
+        }
+        if(*p == 'e' || *p == 'E'){
+            const char* q = p + 1;
+            bool isExponentNegative = false;
+            if(*q == '+'){
+                q++;
+            } else if(*q == '-'){
+                isExponentNegative = true;
+                q++;
+            }
+            if(isDigit(*q)){
+                int e = 0;
+                while(isDigit(*q)){
+                    if(e < 10000){
+                        e = e * 10 + (*q - '0');
+                    }
+                    q++;
+                }
+                exponent += isExponentNegative ? -e : e;
+                p = q;
+            }
+        }
+
+        if(significand > (static_cast<boost::uint64_t>(1) << 53) || exponent > 22 || exponent < -22){
+            return mystrtod(nptr, endptr);
+        }
+
+        double value = static_cast<double>(significand);
+        if(exponent < 0){
+            value /= powersOf10[-exponent];
+        } else if(exponent > 0){
+            value *= powersOf10[exponent];
+        }
+        *endptr = const_cast<char*>(p);
+        return isNegative ? -value : value;
+    }
+
+    /**
+       Conversion of a decimal integer without calling strtol().
+       Octal and hexadecimal numbers and the values which may overflow are converted by strtol().
+    */
+    long fastStrtol(const char* nptr, char** endptr)
+    {
+        const char* p = nptr;
+        bool isNegative = false;
+        if(*p == '+'){
+            p++;
+        } else if(*p == '-'){
+            isNegative = true;
+            p++;
+        }
+        if(!isDigit(*p) || (*p == '0' && (isDigit(p[1]) || p[1] == 'x' || p[1] == 'X'))){
+            return strtol(nptr, endptr, 0);
+        }
+        long value = 0;
+        int numDigits = 0;
+        while(isDigit(*p)){
+            if(++numDigits > 9){
+                return strtol(nptr, endptr, 0);
+            }
+            value = value * 10 + (*p - '0');
+            p++;
+        }
+        *endptr = const_cast<char*>(p);
+        return isNegative ? -value : value;
+    }
+}
+
+
 std::string EasyScanner::Exception::getFullMessage()
 {
     string m(message);
@@ -126,6 +264,7 @@ void EasyScanner::init()
 {
     textBuf = 0;
     size = 0;
+    isTextMapped = false;
     textBufEnd = 0;
     lineNumberOffset = 1;
     
@@ -158,6 +297,7 @@ EasyScanner::EasyScanner(const EasyScanner& org, bool copyText) :
     lineNumberOffset = org.lineNumberOffset;
 
     symbols = org.symbols;
+    isTextMapped = false;
 
     if(copyText && org.textBuf){
         size = org.size;
@@ -176,7 +316,7 @@ EasyScanner::EasyScanner(const EasyScanner& org, bool copyText) :
 /*! This function directly sets a text in the main memory */
 void EasyScanner::setText(const char* text, int len)
 {
-    if(textBuf) delete[] textBuf;
+    releaseText();
 
     size = len;
     textBuf = new char[size+1];
@@ -191,7 +331,24 @@ void EasyScanner::setText(const char* text, int len)
 
 EasyScanner::~EasyScanner()
 {
-    if(textBuf) delete[] textBuf;
+    releaseText();
+}
+
+
+void EasyScanner::releaseText()
+{
+    if(textBuf){
+#ifndef _WIN32
+        if(isTextMapped){
+            munmap(textBuf, size);
+        } else
+#endif
+        {
+            delete[] textBuf;
+        }
+    }
+    textBuf = 0;
+    isTextMapped = false;
 }
 
 
@@ -296,10 +453,29 @@ void EasyScanner::loadFile(const string& filename)
     fseek(file, 0, SEEK_END);
     size = ftell(file);
     rewind(file);
-    if(textBuf) delete[] textBuf;
-    textBuf = new char[size+1];
-    size_t s = fread(textBuf, sizeof(char), size, file);
-    textBuf[size] = 0;
+    releaseText();
+
+#ifndef _WIN32
+    /*
+      The file is mapped instead of being copied when the mapped text is terminated by '\0',
+      which is the case if the file size is not a multiple of the page size because
+      the rest of the last page is filled with zeros. The mapping is private so that
+      the file is not modified even if the text is overwritten.
+    */
+    if(size > 0 && (size % sysconf(_SC_PAGESIZE)) != 0){
+        void* mapped = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+        if(mapped != MAP_FAILED){
+            textBuf = static_cast<char*>(mapped);
+            isTextMapped = true;
+        }
+    }
+#endif
+
+    if(!isTextMapped){
+        textBuf = new char[size+1];
+        size_t s = fread(textBuf, sizeof(char), size, file);
+        textBuf[size] = 0;
+    }
     fclose(file);
     text = textBuf;
     textBufEnd = textBuf + size;
@@ -391,12 +567,12 @@ int EasyScanner::readToken()
 
     if(isdigit((unsigned char)*text) || *text == '+' || *text == '-'){
         char* tail;
-        intValue = strtol(text, &tail, 0);
+        intValue = fastStrtol(text, &tail);
         if(tail != text){
             text = tail;
             return T_INTEGER;
         }
-        doubleValue = mystrtod(text, &tail);
+        doubleValue = fastStrtod(text, &tail);
         if(tail != text){
             text = tail;
             return T_DOUBLE;
@@ -488,7 +664,7 @@ bool EasyScanner::readDouble()
 
     if(checkLF()) return false;
 
-    doubleValue = mystrtod(text, &tail);
+    doubleValue = fastStrtod(text, &tail);
 
     if(tail != text){
         text = tail;
@@ -504,7 +680,7 @@ bool EasyScanner::readInt()
 
     if(checkLF()) return false;
 
-    intValue = strtol(text, &tail, 0);
+    intValue = fastStrtol(text, &tail);
     if(tail != text){
         text = tail;
         return true;
@@ -514,6 +690,28 @@ bool EasyScanner::readInt()
 }
 
 
+int EasyScanner::countNumbers(int endChar)
+{
+    int n = 0;
+    bool isInToken = false;
+    for(const char* p = text; *p != '\0' && *p != endChar; ++p){
+        if(*p == commentChar){
+            while(*p != '\r' && *p != '\n' && *p != '\0') ++p;
+            if(*p == '\0'){
+                break;
+            }
+        }
+        if(*p <= ' ' || *p == ','){
+            isInToken = false;
+        } else if(!isInToken){
+            isInToken = true;
+            n++;
+        }
+    }
+    return n;
+}
+
+
 bool EasyScanner::readChar()
 {
     skipSpace();
@@ -92,6 +92,14 @@ namespace hrp {
 
         bool readDouble();
         bool readInt();
+
+        /**
+           This function counts the number tokens between the current position and 'endChar'
+           without moving the position. It is used to reserve the capacity of a container
+           before reading a long sequence of numbers.
+        */
+        int countNumbers(int endChar);
+
         bool readChar();
         bool readChar(int chara);
         int  peekChar();
@@ -241,6 +249,7 @@ namespace hrp {
 
     private:
         void init();
+        void releaseText();
         int extractQuotedString();
 
         inline void skipToLineEnd();
@@ -250,6 +259,7 @@ namespace hrp {
     
         char* textBuf;
         int size;
+        bool isTextMapped;
         char* textBufEnd;
         int lineNumberOffset;
         int commentChar;
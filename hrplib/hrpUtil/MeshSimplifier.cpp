@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file MeshSimplifier.cpp
+*/
+
+#include "MeshSimplifier.h"
+
+#include <map>
+#include <set>
+#include <queue>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+
+using namespace std;
+using namespace hrp;
+
+
+namespace {
+
+    /// symmetric 4x4 matrix of the quadric error (a00 a01 a02 a03 a11 a12 a13 a22 a23 a33)
+    struct Quadric
+    {
+        double a[10];
+
+        Quadric() { std::fill(a, a + 10, 0.0); }
+
+        void addPlane(const Vector3& n, double d) {
+            a[0] += n[0] * n[0]; a[1] += n[0] * n[1]; a[2] += n[0] * n[2]; a[3] += n[0] * d;
+            a[4] += n[1] * n[1]; a[5] += n[1] * n[2]; a[6] += n[1] * d;
+            a[7] += n[2] * n[2]; a[8] += n[2] * d;
+            a[9] += d * d;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            for(int i=0; i < 10; ++i){
+                a[i] += q.a[i];
+            }
+            return *this;
+        }
+
+        double evaluate(const Vector3& v) const {
+            const double x = v[0], y = v[1], z = v[2];
+            return a[0]*x*x + 2.0*a[1]*x*y + 2.0*a[2]*x*z + 2.0*a[3]*x
+                + a[4]*y*y + 2.0*a[5]*y*z + 2.0*a[6]*y
+                + a[7]*z*z + 2.0*a[8]*z
+                + a[9];
+        }
+
+        /// @return false if the minimum is not unique
+        bool findMinimum(Vector3& out_v) const {
+            Matrix33 A;
+            A << a[0], a[1], a[2],
+                 a[1], a[4], a[5],
+                 a[2], a[5], a[7];
+            const double det = A.determinant();
+            if(fabs(det) < 1.0e-10){
+                return false;
+            }
+            out_v = A.inverse() * Vector3(-a[3], -a[6], -a[8]);
+            return true;
+        }
+    };
+
+    struct CellKey
+    {
+        boost::int64_t x, y, z;
+        CellKey(boost::int64_t x, boost::int64_t y, boost::int64_t z) : x(x), y(y), z(z) { }
+        bool operator<(const CellKey& k) const {
+            return (x != k.x) ? (x < k.x) : ((y != k.y) ? (y < k.y) : (z < k.z));
+        }
+    };
+
+    struct PositionKey
+    {
+        double x, y, z;
+        PositionKey(const Vector3& v) : x(v[0]), y(v[1]), z(v[2]) { }
+        bool operator<(const PositionKey& k) const {
+            return (x != k.x) ? (x < k.x) : ((y != k.y) ? (y < k.y) : (z < k.z));
+        }
+    };
+
+    struct TriangleKey
+    {
+        int v[3];
+        TriangleKey(int v0, int v1, int v2) {
+            v[0] = v0; v[1] = v1; v[2] = v2;
+            std::sort(v, v + 3);
+        }
+        bool operator<(const TriangleKey& k) const {
+            return (v[0] != k.v[0]) ? (v[0] < k.v[0]) : ((v[1] != k.v[1]) ? (v[1] < k.v[1]) : (v[2] < k.v[2]));
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        int v0, v1;
+        int stamp0, stamp1;
+        Vector3 position;
+
+        // the priority queue pops the minimum cost
+        bool operator<(const Collapse& c) const { return cost > c.cost; }
+    };
+
+    Vector3 calcNormal(const Vector3& v0, const Vector3& v1, const Vector3& v2)
+    {
+        return (v1 - v0).cross(v2 - v0);
+    }
+}
+
+
+MeshSimplifier::MeshSimplifier()
+{
+    weldDistance = 0.0;
+    maxNumTriangles = 0;
+    maxError = 0.0;
+}
+
+
+void MeshSimplifier::apply(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const
+{
+    weldVertices(io_vertices, io_triangles);
+    removeDegenerateTriangles(io_vertices, io_triangles);
+
+    if(isDecimationEnabled()){
+        decimate(io_vertices, io_triangles);
+        removeDegenerateTriangles(io_vertices, io_triangles);
+    }
+
+    removeUnusedVertices(io_vertices, io_triangles);
+}
+
+
+void MeshSimplifier::weldVertices(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const
+{
+    const int numVertices = io_vertices.size();
+    vector<int> indexMap(numVertices);
+    vector<Vector3> weldedVertices;
+    weldedVertices.reserve(numVertices);
+
+    if(weldDistance > 0.0){
+        // a vertex is compared with the welded vertices in the neighboring cells of the grid
+        typedef map<CellKey, vector<int> > CellMap;
+        CellMap cells;
+        const double d2 = weldDistance * weldDistance;
+        for(int i=0; i < numVertices; ++i){
+            const Vector3& v = io_vertices[i];
+            const CellKey key(static_cast<boost::int64_t>(floor(v[0] / weldDistance)),
+                              static_cast<boost::int64_t>(floor(v[1] / weldDistance)),
+                              static_cast<boost::int64_t>(floor(v[2] / weldDistance)));
+            int weldedIndex = -1;
+            for(int dx=-1; dx <= 1 && weldedIndex < 0; ++dx){
+                for(int dy=-1; dy <= 1 && weldedIndex < 0; ++dy){
+                    for(int dz=-1; dz <= 1 && weldedIndex < 0; ++dz){
+                        CellMap::iterator p = cells.find(CellKey(key.x + dx, key.y + dy, key.z + dz));
+                        if(p != cells.end()){
+                            const vector<int>& indices = p->second;
+                            for(size_t j=0; j < indices.size(); ++j){
+                                if((weldedVertices[indices[j]] - v).squaredNorm() <= d2){
+                                    weldedIndex = indices[j];
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            if(weldedIndex < 0){
+                weldedIndex = weldedVertices.size();
+                weldedVertices.push_back(v);
+                cells[key].push_back(weldedIndex);
+            }
+            indexMap[i] = weldedIndex;
+        }
+    } else {
+        map<PositionKey, int> positions;
+        for(int i=0; i < numVertices; ++i){
+            const Vector3& v = io_vertices[i];
+            pair<map<PositionKey, int>::iterator, bool> inserted =
+                positions.insert(make_pair(PositionKey(v), (int)weldedVertices.size()));
+            if(inserted.second){
+                weldedVertices.push_back(v);
+            }
+            indexMap[i] = inserted.first->second;
+        }
+    }
+
+    for(size_t i=0; i < io_triangles.size(); ++i){
+        io_triangles[i] = indexMap[io_triangles[i]];
+    }
+    io_vertices.swap(weldedVertices);
+}
+
+
+/**
+   The triangles which have the same vertices or whose angles are almost zero are removed.
+   The triangles which have the same set of the vertices as a preceding one are also removed.
+*/
+void MeshSimplifier::removeDegenerateTriangles(const std::vector<Vector3>& vertices, std::vector<int>& io_triangles) const
+{
+    const int numTriangles = io_triangles.size() / 3;
+    vector<int> triangles;
+    triangles.reserve(numTriangles * 3);
+    set<TriangleKey> triangleKeys;
+
+    for(int i=0; i < numTriangles; ++i){
+        const int v0 = io_triangles[i*3];
+        const int v1 = io_triangles[i*3+1];
+        const int v2 = io_triangles[i*3+2];
+        if(v0 == v1 || v1 == v2 || v2 == v0){
+            continue;
+        }
+        const Vector3 e1(vertices[v1] - vertices[v0]);
+        const Vector3 e2(vertices[v2] - vertices[v0]);
+        // the squared sine of the angle at v0
+        if(e1.cross(e2).squaredNorm() <= 1.0e-12 * e1.squaredNorm() * e2.squaredNorm()){
+            continue;
+        }
+        if(!triangleKeys.insert(TriangleKey(v0, v1, v2)).second){
+            continue;
+        }
+        triangles.push_back(v0);
+        triangles.push_back(v1);
+        triangles.push_back(v2);
+    }
+
+    io_triangles.swap(triangles);
+}
+
+
+void MeshSimplifier::decimate(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const
+{
+    vector<Vector3>& vertices = io_vertices;
+    vector<int>& triangles = io_triangles;
+    const int numVertices = vertices.size();
+    const int numTriangles = triangles.size() / 3;
+
+    if(maxNumTriangles > 0 && numTriangles <= maxNumTriangles){
+        return;
+    }
+
+    vector<Quadric> quadrics(numVertices);
+    vector< vector<int> > vertexTriangles(numVertices);
+
+    // the number of the triangles sharing an edge and one of them
+    typedef map< pair<int, int>, pair<int, int> > EdgeMap;
+    EdgeMap edges;
+
+    for(int i=0; i < numTriangles; ++i){
+        const int* t = &triangles[i*3];
+        Vector3 n(calcNormal(vertices[t[0]], vertices[t[1]], vertices[t[2]]));
+        n.normalize();
+        const double d = -n.dot(vertices[t[0]]);
+        for(int j=0; j < 3; ++j){
+            quadrics[t[j]].addPlane(n, d);
+            vertexTriangles[t[j]].push_back(i);
+            const int a = t[j];
+            const int b = t[(j + 1) % 3];
+            pair<EdgeMap::iterator, bool> inserted =
+                edges.insert(make_pair(make_pair(std::min(a, b), std::max(a, b)), make_pair(1, i)));
+            if(!inserted.second){
+                inserted.first->second.first++;
+            }
+        }
+    }
+
+    // the boundary edges are kept by the planes perpendicular to their triangles
+    for(EdgeMap::iterator p = edges.begin(); p != edges.end(); ++p){
+        if(p->second.first == 1){
+            const int* t = &triangles[p->second.second * 3];
+            const Vector3& v0 = vertices[p->first.first];
+            const Vector3& v1 = vertices[p->first.second];
+            Vector3 n((v1 - v0).cross(calcNormal(vertices[t[0]], vertices[t[1]], vertices[t[2]])));
+            if(n.squaredNorm() > 0.0){
+                n.normalize();
+                const double d = -n.dot(v0);
+                quadrics[p->first.first].addPlane(n, d);
+                quadrics[p->first.second].addPlane(n, d);
+            }
+        }
+    }
+
+    vector<int> stamps(numVertices, 0);
+    vector<bool> isRemovedVertex(numVertices, false);
+    vector<bool> isRemovedTriangle(numTriangles, false);
+    priority_queue<Collapse> collapses;
+
+    Collapse collapse;
+
+    struct Local {
+        static void push(int v0, int v1, const vector<Vector3>& vertices, const vector<Quadric>& quadrics,
+                         const vector<int>& stamps, Collapse& c, priority_queue<Collapse>& collapses) {
+            Quadric q = quadrics[v0];
+            q += quadrics[v1];
+            c.v0 = v0;
+            c.v1 = v1;
+            c.stamp0 = stamps[v0];
+            c.stamp1 = stamps[v1];
+            if(q.findMinimum(c.position)){
+                c.cost = q.evaluate(c.position);
+            } else {
+                const Vector3 candidates[3] = { vertices[v0], vertices[v1], (vertices[v0] + vertices[v1]) * 0.5 };
+                c.cost = numeric_limits<double>::max();
+                for(int i=0; i < 3; ++i){
+                    const double cost = q.evaluate(candidates[i]);
+                    if(cost < c.cost){
+                        c.cost = cost;
+                        c.position = candidates[i];
+                    }
+                }
+            }
+            c.cost = std::max(0.0, c.cost);
+            collapses.push(c);
+        }
+    };
+
+    for(EdgeMap::iterator p = edges.begin(); p != edges.end(); ++p){
+        Local::push(p->first.first, p->first.second, vertices, quadrics, stamps, collapse, collapses);
+    }
+    edges.clear();
+
+    const double maxCost = maxError * maxError;
+    int numRemainingTriangles = numTriangles;
+    vector<int> neighbors;
+
+    while(!collapses.empty()){
+
+        if(maxNumTriangles > 0 && numRemainingTriangles <= maxNumTriangles){
+            break;
+        }
+
+        collapse = collapses.top();
+        collapses.pop();
+
+        const int v0 = collapse.v0;
+        const int v1 = collapse.v1;
+        if(isRemovedVertex[v0] || isRemovedVertex[v1] ||
+           stamps[v0] != collapse.stamp0 || stamps[v1] != collapse.stamp1){
+            continue;
+        }
+        if(maxError > 0.0 && collapse.cost > maxCost){
+            break;
+        }
+
+        // the collapse which flips a triangle is rejected
+        bool isFlipped = false;
+        for(int i=0; i < 2 && !isFlipped; ++i){
+            const int v = (i == 0) ? v0 : v1;
+            const vector<int>& ts = vertexTriangles[v];
+            for(size_t j=0; j < ts.size(); ++j){
+                if(isRemovedTriangle[ts[j]]){
+                    continue;
+                }
+                const int* t = &triangles[ts[j] * 3];
+                if((t[0] == v0 || t[1] == v0 || t[2] == v0) && (t[0] == v1 || t[1] == v1 || t[2] == v1)){
+                    continue;
+                }
+                Vector3 p[3];
+                for(int k=0; k < 3; ++k){
+                    p[k] = (t[k] == v) ? collapse.position : vertices[t[k]];
+                }
+                const Vector3 n(calcNormal(vertices[t[0]], vertices[t[1]], vertices[t[2]]));
+                if(n.dot(calcNormal(p[0], p[1], p[2])) <= 0.0){
+                    isFlipped = true;
+                    break;
+                }
+            }
+        }
+        if(isFlipped){
+            continue;
+        }
+
+        // v1 is merged into v0
+        vertices[v0] = collapse.position;
+        quadrics[v0] += quadrics[v1];
+        isRemovedVertex[v1] = true;
+        ++stamps[v0];
+        ++stamps[v1];
+
+        vector<int>& ts0 = vertexTriangles[v0];
+        const vector<int>& ts1 = vertexTriangles[v1];
+        for(size_t i=0; i < ts1.size(); ++i){
+            const int ti = ts1[i];
+            if(isRemovedTriangle[ti]){
+                continue;
+            }
+            int* t = &triangles[ti * 3];
+            if(t[0] == v0 || t[1] == v0 || t[2] == v0){
+                isRemovedTriangle[ti] = true;
+                --numRemainingTriangles;
+            } else {
+                for(int k=0; k < 3; ++k){
+                    if(t[k] == v1){
+                        t[k] = v0;
+                    }
+                }
+                ts0.push_back(ti);
+            }
+        }
+        vertexTriangles[v1].clear();
+
+        neighbors.clear();
+        size_t numValidTriangles = 0;
+        for(size_t i=0; i < ts0.size(); ++i){
+            const int ti = ts0[i];
+            if(!isRemovedTriangle[ti]){
+                ts0[numValidTriangles++] = ti;
+                for(int k=0; k < 3; ++k){
+                    const int v = triangles[ti * 3 + k];
+                    if(v != v0){
+                        neighbors.push_back(v);
+                    }
+                }
+            }
+        }
+        ts0.resize(numValidTriangles);
+
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for(size_t i=0; i < neighbors.size(); ++i){
+            Local::push(v0, neighbors[i], vertices, quadrics, stamps, collapse, collapses);
+        }
+    }
+
+    vector<int> remainingTriangles;
+    remainingTriangles.reserve(numRemainingTriangles * 3);
+    for(int i=0; i < numTriangles; ++i){
+        if(!isRemovedTriangle[i]){
+            remainingTriangles.insert(remainingTriangles.end(), &triangles[i*3], &triangles[i*3] + 3);
+        }
+    }
+    io_triangles.swap(remainingTriangles);
+}
+
+
+void MeshSimplifier::removeUnusedVertices(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const
+{
+    vector<int> indexMap(io_vertices.size(), -1);
+    vector<Vector3> vertices;
+    vertices.reserve(io_vertices.size());
+
+    for(size_t i=0; i < io_triangles.size(); ++i){
+        int& index = indexMap[io_triangles[i]];
+        if(index < 0){
+            index = vertices.size();
+            vertices.push_back(io_vertices[io_triangles[i]]);
+        }
+        io_triangles[i] = index;
+    }
+    io_vertices.swap(vertices);
+}
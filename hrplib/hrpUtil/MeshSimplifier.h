@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file MeshSimplifier.h
+  @brief Simplification of the triangle meshes used for the collision detection
+
+  The vertices closer than the weld distance are welded, the degenerate and duplicated
+  triangles are removed, and then the mesh is decimated by the edge collapses ordered by
+  the quadric error metric (Garland and Heckbert). The appearance of the mesh is not
+  considered, so the result should not be used for rendering.
+*/
+
+#ifndef HRPUTIL_MESH_SIMPLIFIER_H_INCLUDED
+#define HRPUTIL_MESH_SIMPLIFIER_H_INCLUDED
+
+#include <vector>
+#include "config.h"
+#include "Eigen3d.h"
+
+namespace hrp
+{
+    class HRP_UTIL_EXPORT MeshSimplifier
+    {
+      public:
+        MeshSimplifier();
+
+        /**
+           The vertices closer than this distance are welded.
+           Only the vertices at the same position are welded if it is zero.
+        */
+        void setWeldDistance(double distance) { weldDistance = distance; }
+
+        /**
+           The decimation stops when the number of the triangles is reduced to this value.
+           Zero means no limit.
+        */
+        void setMaxNumTriangles(int n) { maxNumTriangles = n; }
+
+        /**
+           An edge is not collapsed if the square root of its quadric error, which is the sum
+           of the squared distances to the planes of the original triangles, exceeds this value.
+           Zero means no limit.
+        */
+        void setMaxError(double error) { maxError = error; }
+
+        /// The decimation is skipped if both of the limits are zero
+        bool isDecimationEnabled() const { return (maxNumTriangles > 0 || maxError > 0.0); }
+
+        /**
+           @param io_vertices the vertices, whose unused elements are removed
+           @param io_triangles the three vertex indices of each triangle
+        */
+        void apply(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const;
+
+      private:
+        double weldDistance;
+        int maxNumTriangles;
+        double maxError;
+
+        void weldVertices(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const;
+        void removeDegenerateTriangles(const std::vector<Vector3>& vertices, std::vector<int>& io_triangles) const;
+        void decimate(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const;
+        void removeUnusedVertices(std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles) const;
+    };
+};
+
+#endif
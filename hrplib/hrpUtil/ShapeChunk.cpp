@@ -0,0 +1,536 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+*/
+
+#include "ShapeChunk.h"
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <zlib.h>
+
+using namespace std;
+using namespace OpenHRP;
+
+namespace {
+
+    const CORBA::ULong DEFAULT_CHUNK_SIZE = 8 * 1024 * 1024;
+
+    struct FormatError { };
+
+    class Packer
+    {
+    public:
+        Packer(vector<unsigned char>& buf) : buf(buf) { }
+
+        void putUInt8(unsigned int v) {
+            buf.push_back(static_cast<unsigned char>(v));
+        }
+
+        void putUInt16(unsigned int v) {
+            buf.push_back(v & 0xff);
+            buf.push_back((v >> 8) & 0xff);
+        }
+
+        void putUInt32(boost::uint32_t v) {
+            for(int i=0; i < 4; ++i){
+                buf.push_back((v >> (i * 8)) & 0xff);
+            }
+        }
+
+        void putInt32(boost::int32_t v) {
+            putUInt32(static_cast<boost::uint32_t>(v));
+        }
+
+        void putFloat(float v) {
+            boost::uint32_t u;
+            memcpy(&u, &v, sizeof(u));
+            putUInt32(u);
+        }
+
+        void putDouble(double v) {
+            boost::uint64_t u;
+            memcpy(&u, &v, sizeof(u));
+            putUInt32(static_cast<boost::uint32_t>(u & 0xffffffff));
+            putUInt32(static_cast<boost::uint32_t>(u >> 32));
+        }
+
+        void putString(const char* s) {
+            size_t n = s ? strlen(s) : 0;
+            putInt32(n);
+            buf.insert(buf.end(), s, s + n);
+        }
+
+        void putFloats(const FloatSequence& seq) {
+            putInt32(seq.length());
+            for(CORBA::ULong i=0; i < seq.length(); ++i){
+                putFloat(seq[i]);
+            }
+        }
+
+        void putIndices(const LongSequence& seq) {
+            const CORBA::ULong n = seq.length();
+            putInt32(n);
+            bool isShort = true;
+            for(CORBA::ULong i=0; i < n; ++i){
+                if(seq[i] < 0 || seq[i] > 0xffff){
+                    isShort = false;
+                    break;
+                }
+            }
+            if(isShort){
+                putUInt8(2);
+                for(CORBA::ULong i=0; i < n; ++i){
+                    putUInt16(seq[i]);
+                }
+            } else {
+                putUInt8(4);
+                for(CORBA::ULong i=0; i < n; ++i){
+                    putInt32(seq[i]);
+                }
+            }
+        }
+
+        void putQuantizedVertices(const FloatSequence& seq) {
+            const CORBA::ULong n = seq.length();
+            putInt32(n);
+            float lower[3] = { 0.0f, 0.0f, 0.0f };
+            float upper[3] = { 0.0f, 0.0f, 0.0f };
+            for(CORBA::ULong i=0; i < n; ++i){
+                int k = i % 3;
+                if(i < 3 || seq[i] < lower[k]) lower[k] = seq[i];
+                if(i < 3 || seq[i] > upper[k]) upper[k] = seq[i];
+            }
+            for(int k=0; k < 3; ++k){
+                putFloat(lower[k]);
+                putFloat(upper[k]);
+            }
+            for(CORBA::ULong i=0; i < n; ++i){
+                int k = i % 3;
+                double range = upper[k] - lower[k];
+                double q = (range > 0.0) ? floor((seq[i] - lower[k]) / range * 65535.0 + 0.5) : 0.0;
+                putUInt16(static_cast<unsigned int>(std::max(0.0, std::min(65535.0, q))));
+            }
+        }
+
+        void putQuantizedNormals(const FloatSequence& seq) {
+            putInt32(seq.length());
+            for(CORBA::ULong i=0; i < seq.length(); ++i){
+                double q = floor(seq[i] * 32767.0 + 0.5);
+                int v = static_cast<int>(std::max(-32767.0, std::min(32767.0, q)));
+                putUInt16(static_cast<unsigned int>(v) & 0xffff);
+            }
+        }
+
+    private:
+        vector<unsigned char>& buf;
+    };
+
+
+    class Unpacker
+    {
+    public:
+        Unpacker(const unsigned char* data, size_t size) : pos(data), end(data + size) { }
+
+        unsigned int getUInt8() {
+            check(1);
+            return *pos++;
+        }
+
+        unsigned int getUInt16() {
+            check(2);
+            unsigned int v = pos[0] | (pos[1] << 8);
+            pos += 2;
+            return v;
+        }
+
+        boost::uint32_t getUInt32() {
+            check(4);
+            boost::uint32_t v = 0;
+            for(int i=0; i < 4; ++i){
+                v |= static_cast<boost::uint32_t>(pos[i]) << (i * 8);
+            }
+            pos += 4;
+            return v;
+        }
+
+        boost::int32_t getInt32() {
+            return static_cast<boost::int32_t>(getUInt32());
+        }
+
+        float getFloat() {
+            boost::uint32_t u = getUInt32();
+            float v;
+            memcpy(&v, &u, sizeof(v));
+            return v;
+        }
+
+        double getDouble() {
+            boost::uint64_t u = getUInt32();
+            u |= static_cast<boost::uint64_t>(getUInt32()) << 32;
+            double v;
+            memcpy(&v, &u, sizeof(v));
+            return v;
+        }
+
+        char* getString() {
+            CORBA::ULong n = getCount(1);
+            char* s = CORBA::string_alloc(n);
+            memcpy(s, pos, n);
+            s[n] = '\0';
+            pos += n;
+            return s;
+        }
+
+        void getFloats(FloatSequence& seq) {
+            CORBA::ULong n = getCount(4);
+            seq.length(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                seq[i] = getFloat();
+            }
+        }
+
+        void getIndices(LongSequence& seq) {
+            boost::int32_t n = getInt32();
+            unsigned int size = getUInt8();
+            if(n < 0 || (size != 2 && size != 4)){
+                throw FormatError();
+            }
+            check(static_cast<size_t>(n) * size);
+            seq.length(n);
+            for(boost::int32_t i=0; i < n; ++i){
+                seq[i] = (size == 2) ? static_cast<CORBA::Long>(getUInt16()) : getInt32();
+            }
+        }
+
+        void getQuantizedVertices(FloatSequence& seq) {
+            boost::int32_t n = getInt32();
+            if(n < 0){
+                throw FormatError();
+            }
+            check(24 + static_cast<size_t>(n) * 2);
+            float lower[3], scale[3];
+            for(int k=0; k < 3; ++k){
+                lower[k] = getFloat();
+                scale[k] = (getFloat() - lower[k]) / 65535.0f;
+            }
+            seq.length(n);
+            for(boost::int32_t i=0; i < n; ++i){
+                int k = i % 3;
+                seq[i] = lower[k] + getUInt16() * scale[k];
+            }
+        }
+
+        void getQuantizedNormals(FloatSequence& seq) {
+            CORBA::ULong n = getCount(2);
+            seq.length(n);
+            for(CORBA::ULong i=0; i < n; ++i){
+                boost::int16_t v = static_cast<boost::int16_t>(getUInt16());
+                seq[i] = v / 32767.0f;
+            }
+        }
+
+    private:
+        const unsigned char* pos;
+        const unsigned char* end;
+
+        void check(size_t size) {
+            if(static_cast<size_t>(end - pos) < size){
+                throw FormatError();
+            }
+        }
+
+        CORBA::ULong getCount(size_t elementSize) {
+            boost::int32_t n = getInt32();
+            if(n < 0){
+                throw FormatError();
+            }
+            check(static_cast<size_t>(n) * elementSize);
+            return n;
+        }
+    };
+
+
+    void putShape(Packer& packer, const ShapeInfo& shape, bool quantize)
+    {
+        packer.putString(shape.url);
+        packer.putInt32(shape.primitiveType);
+        packer.putFloats(shape.primitiveParameters);
+        packer.putInt32(shape.appearanceIndex);
+        if(quantize){
+            packer.putQuantizedVertices(shape.vertices);
+        } else {
+            packer.putFloats(shape.vertices);
+        }
+        packer.putIndices(shape.triangles);
+    }
+
+
+    void getShape(Unpacker& unpacker, ShapeInfo& shape, bool quantized)
+    {
+        shape.url = unpacker.getString();
+        shape.primitiveType = static_cast<ShapePrimitiveType>(unpacker.getInt32());
+        unpacker.getFloats(shape.primitiveParameters);
+        shape.appearanceIndex = unpacker.getInt32();
+        if(quantized){
+            unpacker.getQuantizedVertices(shape.vertices);
+        } else {
+            unpacker.getFloats(shape.vertices);
+        }
+        unpacker.getIndices(shape.triangles);
+    }
+
+
+    void putAppearance(Packer& packer, const AppearanceInfo& appearance, bool quantize)
+    {
+        packer.putInt32(appearance.materialIndex);
+        if(quantize){
+            packer.putQuantizedNormals(appearance.normals);
+        } else {
+            packer.putFloats(appearance.normals);
+        }
+        packer.putIndices(appearance.normalIndices);
+        packer.putUInt8(appearance.normalPerVertex);
+        packer.putUInt8(appearance.solid);
+        packer.putFloat(appearance.creaseAngle);
+        packer.putFloats(appearance.colors);
+        packer.putIndices(appearance.colorIndices);
+        packer.putUInt8(appearance.colorPerVertex);
+        packer.putInt32(appearance.textureIndex);
+        packer.putFloats(appearance.textureCoordinate);
+        packer.putIndices(appearance.textureCoordIndices);
+        for(int i=0; i < 9; ++i){
+            packer.putDouble(appearance.textransformMatrix[i]);
+        }
+    }
+
+
+    void getAppearance(Unpacker& unpacker, AppearanceInfo& appearance, bool quantized)
+    {
+        appearance.materialIndex = unpacker.getInt32();
+        if(quantized){
+            unpacker.getQuantizedNormals(appearance.normals);
+        } else {
+            unpacker.getFloats(appearance.normals);
+        }
+        unpacker.getIndices(appearance.normalIndices);
+        appearance.normalPerVertex = (unpacker.getUInt8() != 0);
+        appearance.solid = (unpacker.getUInt8() != 0);
+        appearance.creaseAngle = unpacker.getFloat();
+        unpacker.getFloats(appearance.colors);
+        unpacker.getIndices(appearance.colorIndices);
+        appearance.colorPerVertex = (unpacker.getUInt8() != 0);
+        appearance.textureIndex = unpacker.getInt32();
+        unpacker.getFloats(appearance.textureCoordinate);
+        unpacker.getIndices(appearance.textureCoordIndices);
+        for(int i=0; i < 9; ++i){
+            appearance.textransformMatrix[i] = unpacker.getDouble();
+        }
+    }
+
+
+    template <class Seq, class Element>
+    ShapeChunk* packChunk(const Seq& elements, int firstIndex, int maxCount, const ShapeChunkOption& option,
+                          void (*putElement)(Packer&, const Element&, bool))
+    {
+        ShapeChunk_var chunk = new ShapeChunk();
+        chunk->firstIndex = firstIndex;
+        chunk->count = 0;
+        chunk->quantized = option.quantize;
+        chunk->compressed = false;
+        chunk->rawSize = 0;
+
+        const int numElements = elements.length();
+        if(firstIndex < 0 || firstIndex >= numElements || maxCount <= 0){
+            return chunk._retn();
+        }
+        const int endIndex = (maxCount < numElements - firstIndex) ? (firstIndex + maxCount) : numElements;
+
+        vector<unsigned char> raw;
+        Packer packer(raw);
+        int count = 0;
+        for(int i=firstIndex; i < endIndex; ++i){
+            size_t size = raw.size();
+            putElement(packer, elements[i], option.quantize);
+            if(option.maxSize > 0 && raw.size() > option.maxSize && count > 0){
+                raw.resize(size);
+                break;
+            }
+            ++count;
+        }
+        chunk->count = count;
+        chunk->rawSize = raw.size();
+
+        if(option.compress){
+            uLongf compressedSize = compressBound(raw.size());
+            chunk->data.length(compressedSize);
+            if(compress2(chunk->data.get_buffer(), &compressedSize, &raw[0], raw.size(), Z_BEST_SPEED) == Z_OK &&
+               compressedSize < raw.size()){
+                chunk->data.length(compressedSize);
+                chunk->compressed = true;
+                return chunk._retn();
+            }
+        }
+
+        // the raw data is sent if the compression does not make it smaller
+        chunk->data.length(raw.size());
+        memcpy(chunk->data.get_buffer(), &raw[0], raw.size());
+        return chunk._retn();
+    }
+
+
+    template <class Seq, class Element>
+    bool unpackChunk(const ShapeChunk& chunk, Seq& io_elements, void (*getElement)(Unpacker&, Element&, bool))
+    {
+        if(chunk.firstIndex < 0 || chunk.count < 0){
+            return false;
+        }
+        if(chunk.count == 0){
+            return true;
+        }
+
+        const unsigned char* data = chunk.data.get_buffer();
+        size_t size = chunk.data.length();
+        vector<unsigned char> raw;
+        if(chunk.compressed){
+            raw.resize(chunk.rawSize);
+            uLongf rawSize = chunk.rawSize;
+            if(raw.empty() || uncompress(&raw[0], &rawSize, data, size) != Z_OK || rawSize != chunk.rawSize){
+                return false;
+            }
+            data = &raw[0];
+            size = rawSize;
+        }
+
+        const CORBA::ULong endIndex = chunk.firstIndex + chunk.count;
+        if(io_elements.length() < endIndex){
+            io_elements.length(endIndex);
+        }
+        try {
+            Unpacker unpacker(data, size);
+            for(CORBA::ULong i = chunk.firstIndex; i < endIndex; ++i){
+                getElement(unpacker, io_elements[i], chunk.quantized);
+            }
+        } catch(const FormatError&){
+            return false;
+        }
+        return true;
+    }
+
+
+    struct ShapeChunkSource
+    {
+        static CORBA::Long size(ShapeSetInfo_ptr shapeSetInfo) {
+            return shapeSetInfo->numShapes();
+        }
+        static ShapeChunk* get(ShapeSetInfo_ptr shapeSetInfo, CORBA::Long index, CORBA::Long count, const ShapeChunkOption& option) {
+            return shapeSetInfo->getShapeChunk(index, count, option);
+        }
+        static bool unpack(const ShapeChunk& chunk, ShapeInfoSequence& io_shapes) {
+            return hrp::unpackShapeChunk(chunk, io_shapes);
+        }
+    };
+
+    struct AppearanceChunkSource
+    {
+        static CORBA::Long size(ShapeSetInfo_ptr shapeSetInfo) {
+            return shapeSetInfo->numAppearances();
+        }
+        static ShapeChunk* get(ShapeSetInfo_ptr shapeSetInfo, CORBA::Long index, CORBA::Long count, const ShapeChunkOption& option) {
+            return shapeSetInfo->getAppearanceChunk(index, count, option);
+        }
+        static bool unpack(const ShapeChunk& chunk, AppearanceInfoSequence& io_appearances) {
+            return hrp::unpackAppearanceChunk(chunk, io_appearances);
+        }
+    };
+
+    /**
+       @return false if the server does not support the chunks or a chunk is broken
+    */
+    template <class Source, class Seq>
+    bool getByChunks(ShapeSetInfo_ptr shapeSetInfo, const ShapeChunkOption& option, Seq& out_elements)
+    {
+        CORBA::Long numElements;
+        try {
+            numElements = Source::size(shapeSetInfo);
+        } catch(const CORBA::BAD_OPERATION&){
+            // the server was built with the IDL which does not have the chunks
+            return false;
+        }
+        out_elements.length(numElements);
+        CORBA::Long index = 0;
+        while(index < numElements){
+            ShapeChunk_var chunk = Source::get(shapeSetInfo, index, numElements - index, option);
+            if(chunk->firstIndex != index || chunk->count <= 0 || !Source::unpack(chunk.in(), out_elements)){
+                return false;
+            }
+            index += chunk->count;
+        }
+        return true;
+    }
+}
+
+
+ShapeChunk* hrp::packShapeChunk
+(const ShapeInfoSequence& shapes, int firstIndex, int maxCount, const ShapeChunkOption& option)
+{
+    return packChunk(shapes, firstIndex, maxCount, option, putShape);
+}
+
+
+ShapeChunk* hrp::packAppearanceChunk
+(const AppearanceInfoSequence& appearances, int firstIndex, int maxCount, const ShapeChunkOption& option)
+{
+    return packChunk(appearances, firstIndex, maxCount, option, putAppearance);
+}
+
+
+bool hrp::unpackShapeChunk(const ShapeChunk& chunk, ShapeInfoSequence& io_shapes)
+{
+    return unpackChunk(chunk, io_shapes, getShape);
+}
+
+
+bool hrp::unpackAppearanceChunk(const ShapeChunk& chunk, AppearanceInfoSequence& io_appearances)
+{
+    return unpackChunk(chunk, io_appearances, getAppearance);
+}
+
+
+ShapeInfoSequence* hrp::getShapesByChunks(ShapeSetInfo_ptr shapeSetInfo, const ShapeChunkOption& option)
+{
+    ShapeInfoSequence_var shapes = new ShapeInfoSequence();
+    if(!getByChunks<ShapeChunkSource>(shapeSetInfo, option, shapes.inout())){
+        return shapeSetInfo->shapes();
+    }
+    return shapes._retn();
+}
+
+
+AppearanceInfoSequence* hrp::getAppearancesByChunks(ShapeSetInfo_ptr shapeSetInfo, const ShapeChunkOption& option)
+{
+    AppearanceInfoSequence_var appearances = new AppearanceInfoSequence();
+    if(!getByChunks<AppearanceChunkSource>(shapeSetInfo, option, appearances.inout())){
+        return shapeSetInfo->appearances();
+    }
+    return appearances._retn();
+}
+
+
+ShapeChunkOption hrp::defaultShapeChunkOption()
+{
+    ShapeChunkOption option;
+    option.quantize = false;
+    option.compress = false;
+    option.maxSize = DEFAULT_CHUNK_SIZE;
+    return option;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief Packing and unpacking of OpenHRP::ShapeChunk, which transfers shapes and appearances
+   of ShapeSetInfo in ranges
+
+   The data of a chunk is the sequence of the records of the elements, which may be compressed
+   with zlib as a whole. All the values are little-endian.
+
+   - Shape: url, primitiveType, primitiveParameters, appearanceIndex, vertices, triangles
+   - Appearance: materialIndex, normals, normalIndices, normalPerVertex, solid, creaseAngle,
+     colors, colorIndices, colorPerVertex, textureIndex, textureCoordinate, textureCoordIndices,
+     textransformMatrix
+
+   A string is the int32 length followed by the characters. An array of floats is the int32
+   number of the elements followed by the float32 values. An array of indices is the int32
+   number of the elements, the byte size (2 or 4) of an element and the uint16 or int32 values.
+   When the chunk is quantized, the vertices are the minimum and the maximum of the
+   coordinates as float32 values followed by the uint16 values scaled into the range,
+   and the normals are the int16 values of the components multiplied by 32767.
+*/
+
+#ifndef OPENHRP_UTIL_SHAPE_CHUNK_H_INCLUDED
+#define OPENHRP_UTIL_SHAPE_CHUNK_H_INCLUDED
+
+#include "config.h"
+#include <hrpCorba/ORBwrap.h>
+#include <hrpCorba/ModelLoader.hh>
+
+namespace hrp
+{
+    HRP_UTIL_EXPORT OpenHRP::ShapeChunk* packShapeChunk(
+        const OpenHRP::ShapeInfoSequence& shapes, int firstIndex, int maxCount, const OpenHRP::ShapeChunkOption& option);
+
+    HRP_UTIL_EXPORT OpenHRP::ShapeChunk* packAppearanceChunk(
+        const OpenHRP::AppearanceInfoSequence& appearances, int firstIndex, int maxCount, const OpenHRP::ShapeChunkOption& option);
+
+    /**
+       stores the elements of the chunk into io_shapes, whose length is extended if necessary.
+       @return false if the data is broken
+    */
+    HRP_UTIL_EXPORT bool unpackShapeChunk(const OpenHRP::ShapeChunk& chunk, OpenHRP::ShapeInfoSequence& io_shapes);
+
+    HRP_UTIL_EXPORT bool unpackAppearanceChunk(const OpenHRP::ShapeChunk& chunk, OpenHRP::AppearanceInfoSequence& io_appearances);
+
+    /**
+       gets all the shapes by ShapeSetInfo::getShapeChunk().
+       The shapes attribute is used instead if the server does not support the chunks.
+    */
+    HRP_UTIL_EXPORT OpenHRP::ShapeInfoSequence* getShapesByChunks(
+        OpenHRP::ShapeSetInfo_ptr shapeSetInfo, const OpenHRP::ShapeChunkOption& option);
+
+    HRP_UTIL_EXPORT OpenHRP::AppearanceInfoSequence* getAppearancesByChunks(
+        OpenHRP::ShapeSetInfo_ptr shapeSetInfo, const OpenHRP::ShapeChunkOption& option);
+
+    /// an option which gets the exact data in the chunks of 8MB without the compression
+    HRP_UTIL_EXPORT OpenHRP::ShapeChunkOption defaultShapeChunkOption();
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file TextureCache.cpp
+*/
+
+#include "TextureCache.h"
+#include "ImageConverter.h"
+
+#include <map>
+#include <deque>
+#include <sstream>
+#include <algorithm>
+#include <sys/stat.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+
+using namespace std;
+using namespace hrp;
+
+
+namespace {
+
+    const size_t defaultCapacity = 256 * 1024 * 1024;
+
+    time_t getModificationTime(const std::string& filename)
+    {
+        struct stat statbuff;
+        if(stat(filename.c_str(), &statbuff) == 0){
+            return statbuff.st_mtime;
+        }
+        return 0;
+    }
+
+    std::string entryKey(const std::string& filename, const TextureFormat& format)
+    {
+        ostringstream os;
+        os << format.maxSize << (format.isPowerOfTwo ? "p" : "-") << (format.hasMipmaps ? "m" : "-") << " " << filename;
+        return os.str();
+    }
+
+    int floorPowerOfTwo(int n)
+    {
+        int p = 1;
+        while(p * 2 <= n){
+            p *= 2;
+        }
+        return p;
+    }
+
+    /**
+       resizes the image by averaging the source pixels covered by each pixel
+    */
+    void resizeImage(const SFImage& src, int width, int height, SFImage& out_image)
+    {
+        const int nc = src.numComponents;
+        out_image.width = width;
+        out_image.height = height;
+        out_image.numComponents = nc;
+        out_image.pixels.resize(width * height * nc);
+
+        std::vector<unsigned int> sums(nc);
+
+        for(int y=0; y < height; ++y){
+            const int y0 = y * src.height / height;
+            const int y1 = std::max(y0 + 1, (y + 1) * src.height / height);
+            for(int x=0; x < width; ++x){
+                const int x0 = x * src.width / width;
+                const int x1 = std::max(x0 + 1, (x + 1) * src.width / width);
+                std::fill(sums.begin(), sums.end(), 0);
+                for(int sy = y0; sy < y1; ++sy){
+                    const unsigned char* p = &src.pixels[(sy * src.width + x0) * nc];
+                    for(int sx = x0; sx < x1; ++sx){
+                        for(int c=0; c < nc; ++c){
+                            sums[c] += *p++;
+                        }
+                    }
+                }
+                const unsigned int count = (y1 - y0) * (x1 - x0);
+                unsigned char* q = &out_image.pixels[(y * width + x) * nc];
+                for(int c=0; c < nc; ++c){
+                    q[c] = (sums[c] + count / 2) / count;
+                }
+            }
+        }
+    }
+
+    void createTextureImage(const std::string& filename, const TextureFormat& format, TextureImage& out_image)
+    {
+        out_image.levels.resize(1);
+        SFImage& base = out_image.levels[0];
+
+        ImageConverter converter;
+        try {
+            SFImage* decoded = converter.convert(filename);
+            base.width = decoded->width;
+            base.height = decoded->height;
+            base.numComponents = decoded->numComponents;
+            base.pixels.swap(decoded->pixels);
+        } catch(...){
+            base.pixels.clear();
+        }
+
+        if(base.width <= 0 || base.height <= 0 || base.numComponents <= 0 ||
+           (int)base.pixels.size() < base.width * base.height * base.numComponents){
+            base.width = 0;
+            base.height = 0;
+            base.numComponents = 0;
+            base.pixels.clear();
+            return;
+        }
+        // the padding of the rows is not used
+        base.pixels.resize(base.width * base.height * base.numComponents);
+
+        int width = base.width;
+        int height = base.height;
+        if(format.isPowerOfTwo){
+            width = floorPowerOfTwo(width);
+            height = floorPowerOfTwo(height);
+        }
+        if(format.maxSize > 0){
+            while(width > format.maxSize || height > format.maxSize){
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+        }
+        if(width != base.width || height != base.height){
+            SFImage resized;
+            resizeImage(base, width, height, resized);
+            base.pixels.swap(resized.pixels);
+            base.width = width;
+            base.height = height;
+        }
+
+        if(format.hasMipmaps){
+            while(width > 1 || height > 1){
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+                SFImage level;
+                resizeImage(out_image.levels.back(), width, height, level);
+                out_image.levels.push_back(SFImage());
+                out_image.levels.back().width = level.width;
+                out_image.levels.back().height = level.height;
+                out_image.levels.back().numComponents = level.numComponents;
+                out_image.levels.back().pixels.swap(level.pixels);
+            }
+        }
+    }
+}
+
+
+namespace hrp {
+
+    class TextureCacheImpl
+    {
+    public:
+        TextureCacheImpl();
+        ~TextureCacheImpl();
+
+        TextureImagePtr load(const std::string& filename, const TextureFormat& format, bool isPrefetch);
+        void prefetch(const std::string& filename, const TextureFormat& format);
+        void work();
+        void releaseOldImages();
+
+        struct Entry
+        {
+            Entry() : mtime(0), isReady(false), numBytes(0), lastUse(0) { }
+            time_t mtime;
+            bool isReady;
+            TextureImagePtr image;
+            size_t numBytes;
+            unsigned long lastUse;
+        };
+        typedef std::map<std::string, boost::shared_ptr<Entry> > EntryMap;
+
+        EntryMap entries;
+        boost::mutex mutex;
+        boost::condition_variable entryReady;
+        boost::condition_variable requestAdded;
+        std::deque< std::pair<std::string, TextureFormat> > requests;
+        boost::thread_group workers;
+        int numThreads;
+        bool isStarted;
+        bool isStopping;
+        size_t capacity;
+        size_t totalBytes;
+        unsigned long useCounter;
+    };
+}
+
+
+TextureCacheImpl::TextureCacheImpl()
+{
+    numThreads = 0;
+    isStarted = false;
+    isStopping = false;
+    capacity = defaultCapacity;
+    totalBytes = 0;
+    useCounter = 0;
+}
+
+
+TextureCacheImpl::~TextureCacheImpl()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        isStopping = true;
+    }
+    requestAdded.notify_all();
+    workers.join_all();
+}
+
+
+TextureImagePtr TextureCacheImpl::load(const std::string& filename, const TextureFormat& format, bool isPrefetch)
+{
+    const time_t mtime = getModificationTime(filename);
+    const std::string key = entryKey(filename, format);
+    boost::shared_ptr<Entry> entry;
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        EntryMap::iterator p = entries.find(key);
+        if(p != entries.end() && p->second->mtime == mtime){
+            if(isPrefetch){
+                return TextureImagePtr();
+            }
+            entry = p->second;
+            while(!entry->isReady){
+                entryReady.wait(lock);
+            }
+            entry->lastUse = ++useCounter;
+            return entry->image;
+        }
+        entry.reset(new Entry());
+        entry->mtime = mtime;
+        if(p != entries.end()){
+            // the image of the updated file is replaced
+            if(p->second->isReady){
+                totalBytes -= p->second->numBytes;
+            }
+            p->second = entry;
+        } else {
+            entries.insert(std::make_pair(key, entry));
+        }
+    }
+
+    boost::shared_ptr<TextureImage> image(new TextureImage());
+    createTextureImage(filename, format, *image);
+    size_t numBytes = 0;
+    for(size_t i=0; i < image->levels.size(); ++i){
+        numBytes += image->levels[i].pixels.size();
+    }
+
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        entry->image = image;
+        entry->numBytes = numBytes;
+        entry->lastUse = ++useCounter;
+        entry->isReady = true;
+        EntryMap::iterator p = entries.find(key);
+        if(p != entries.end() && p->second == entry){
+            totalBytes += numBytes;
+            releaseOldImages();
+        }
+    }
+    entryReady.notify_all();
+
+    return image;
+}
+
+
+/**
+   The mutex must be locked
+*/
+void TextureCacheImpl::releaseOldImages()
+{
+    while(totalBytes > capacity){
+        EntryMap::iterator oldest = entries.end();
+        for(EntryMap::iterator p = entries.begin(); p != entries.end(); ++p){
+            const Entry& entry = *p->second;
+            if(entry.isReady && entry.image.use_count() == 1 &&
+               (oldest == entries.end() || entry.lastUse < oldest->second->lastUse)){
+                oldest = p;
+            }
+        }
+        if(oldest == entries.end()){
+            break;
+        }
+        totalBytes -= oldest->second->numBytes;
+        entries.erase(oldest);
+    }
+}
+
+
+void TextureCacheImpl::prefetch(const std::string& filename, const TextureFormat& format)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        if(!isStarted){
+            int n = numThreads;
+            if(n <= 0){
+                n = std::max(1, (int)boost::thread::hardware_concurrency());
+            }
+            for(int i=0; i < n; ++i){
+                workers.create_thread(boost::bind(&TextureCacheImpl::work, this));
+            }
+            isStarted = true;
+        }
+        requests.push_back(std::make_pair(filename, format));
+    }
+    requestAdded.notify_one();
+}
+
+
+void TextureCacheImpl::work()
+{
+    while(true){
+        std::pair<std::string, TextureFormat> request;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(requests.empty() && !isStopping){
+                requestAdded.wait(lock);
+            }
+            if(isStopping){
+                return;
+            }
+            request = requests.front();
+            requests.pop_front();
+        }
+        load(request.first, request.second, true);
+    }
+}
+
+
+TextureCache* TextureCache::instance()
+{
+    static TextureCache cache;
+    return &cache;
+}
+
+
+TextureCache::TextureCache()
+{
+    impl = new TextureCacheImpl();
+}
+
+
+TextureCache::~TextureCache()
+{
+    delete impl;
+}
+
+
+void TextureCache::setNumThreads(int n)
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    impl->numThreads = n;
+}
+
+
+void TextureCache::setCapacity(size_t numBytes)
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    impl->capacity = numBytes;
+    impl->releaseOldImages();
+}
+
+
+void TextureCache::prefetch(const std::string& filename, const TextureFormat& format)
+{
+    impl->prefetch(filename, format);
+}
+
+
+TextureImagePtr TextureCache::get(const std::string& filename, const TextureFormat& format)
+{
+    return impl->load(filename, format, false);
+}
+
+
+void TextureCache::clear()
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    impl->entries.clear();
+    impl->totalBytes = 0;
+}
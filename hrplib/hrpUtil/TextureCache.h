@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file TextureCache.h
+  @brief Cache of the decoded texture images shared in the process
+
+  The images are decoded by ImageConverter and kept with the modification times of the files,
+  so a file is decoded again only when it is updated. The decoding can be started in advance
+  by the worker threads with prefetch().
+*/
+
+#ifndef OPENHRP_UTIL_TEXTURE_CACHE_H_INCLUDED
+#define OPENHRP_UTIL_TEXTURE_CACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "config.h"
+#include "VrmlNodes.h"
+
+namespace hrp
+{
+    struct TextureFormat
+    {
+        TextureFormat() : maxSize(0), isPowerOfTwo(false), hasMipmaps(false) { }
+
+        /// the image is halved until both the sides fit in this size. Zero means no limit.
+        int maxSize;
+        /// the sides are rounded down to powers of two
+        bool isPowerOfTwo;
+        /// the images halved successively down to 1x1 are generated
+        bool hasMipmaps;
+    };
+
+    struct TextureImage
+    {
+        /// the image of the format followed by the mipmaps. The size of the first image is zero if the file cannot be decoded.
+        std::vector<SFImage> levels;
+
+        const SFImage& image() const { return levels.front(); }
+    };
+
+    typedef boost::shared_ptr<const TextureImage> TextureImagePtr;
+
+    class TextureCacheImpl;
+
+    class HRP_UTIL_EXPORT TextureCache
+    {
+      public:
+        static TextureCache* instance();
+
+        ~TextureCache();
+
+        /**
+           The number of the worker threads, which is the number of the processors by default.
+           This must be set before the first prefetch().
+        */
+        void setNumThreads(int n);
+
+        /**
+           The least recently used images are released when the total size of the pixels
+           exceeds this value. The images being used are kept regardless of the limit.
+        */
+        void setCapacity(size_t numBytes);
+
+        /// requests the worker threads to decode the file
+        void prefetch(const std::string& filename, const TextureFormat& format = TextureFormat());
+
+        /// gets the image, which is decoded now if it is neither cached nor being decoded
+        TextureImagePtr get(const std::string& filename, const TextureFormat& format = TextureFormat());
+
+        void clear();
+
+      private:
+        TextureCache();
+        TextureCache(const TextureCache&);
+        TextureCacheImpl* impl;
+    };
+};
+
+#endif
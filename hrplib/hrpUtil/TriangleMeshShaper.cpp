@@ -18,6 +18,10 @@
 #include <cmath>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 #include <hrpUtil/Eigen3d.h>
 
 using namespace std;
@@ -40,6 +44,10 @@ namespace hrp {
         int divisionNumber;
         bool isNormalGenerationMode;
 
+        bool isParallelMode;
+        int numThreads;
+        boost::mutex* messageMutex;
+
         typedef std::map<VrmlShapePtr, SFNode> ShapeToGeometryMap;
         ShapeToGeometryMap shapeToOriginalGeometryMap;
 
@@ -51,14 +59,37 @@ namespace hrp {
 
         // for normal generation
         std::vector<Vector3> faceNormals;
-        std::vector< std::vector<int> > vertexIndexToFaceIndicesMap;
-        std::vector< std::vector<int> > vertexIndexToNormalIndicesMap;
+
+        /*
+          The faces and the normals of the vertex i are stored in
+          [vertexOffsets[i], vertexOffsets[i] + numFacesOfVertex[i]) of facesOfVertices and
+          [vertexOffsets[i], vertexOffsets[i] + numNormalsOfVertex[i]) of normalsOfVertices.
+          A vertex has at most as many of them as the triangles sharing it.
+        */
+        std::vector<int> vertexOffsets;
+        std::vector<int> facesOfVertices;
+        std::vector<int> numFacesOfVertex;
+        std::vector<int> normalsOfVertices;
+        std::vector<int> numNormalsOfVertex;
 
         enum RemapType { REMAP_COLOR, REMAP_NORMAL };
 
+        /// shape nodes which are converted in the parallel mode
+        struct ShapeEntry
+        {
+            VrmlShape* shapeNode;
+            std::vector< std::pair<AbstractVrmlGroup*, int> > places;
+            bool result;
+        };
+        std::vector<ShapeEntry> shapeEntries;
+        std::map<VrmlShape*, int> shapeEntryIndexMap;
 
         SFNode getOriginalGeometry(VrmlShapePtr shapeNode);
         bool traverseShapeNodes(VrmlNode* node, AbstractVrmlGroup* parentNode, int indexInParent);
+        void collectShapeNodes(VrmlNode* node, AbstractVrmlGroup* parentNode, int indexInParent);
+        void convertShapeNodesInParallel();
+        void convertShapeEntries(std::vector<ShapeEntry>* entries, const std::vector< std::vector<int> >* groups,
+                                 size_t* nextGroup, boost::mutex* groupMutex);
         bool convertShapeNode(VrmlShape* shapeNode);
         bool convertIndexedFaceSet(VrmlIndexedFaceSet* faceSet);
 
@@ -77,6 +108,7 @@ namespace hrp {
         bool convertElevationGrid(VrmlElevationGrid* grid, VrmlIndexedFaceSetPtr& triangleMesh);
         bool convertExtrusion(VrmlExtrusion* extrusion, VrmlIndexedFaceSetPtr& triangleMesh);
         void generateNormals(VrmlIndexedFaceSetPtr& triangleMesh);
+        void initVertexAdjacency(VrmlIndexedFaceSetPtr& triangleMesh);
         void calculateFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh);
         void setVertexNormals(VrmlIndexedFaceSetPtr& triangleMesh);
         void setFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh);
@@ -97,6 +129,9 @@ TMSImpl::TMSImpl(TriangleMeshShaper* self) : self(self)
 {
     divisionNumber = 20;
     isNormalGenerationMode = true;
+    isParallelMode = false;
+    numThreads = 0;
+    messageMutex = 0;
 }
 
 
@@ -130,6 +165,21 @@ void TriangleMeshShaper::setNormalGenerationMode(bool on)
 }
 
 
+/*!
+  If this mode is on, apply() converts the shape nodes by worker threads.
+  The shape nodes sharing a geometry node or its color or normal node are converted
+  by the same thread.
+
+  \param numThreads the number of worker threads.
+  The number of hardware threads is used if it is zero.
+*/
+void TriangleMeshShaper::setParallelMode(bool isOn, int numThreads)
+{
+    impl->isParallelMode = isOn;
+    impl->numThreads = numThreads;
+}
+
+
 /*!
   @if jp
   変換後のShapeノードに対して、変換前のノードが持っていたGeometryNodeを返す。
@@ -168,7 +218,20 @@ SFNode TMSImpl::getOriginalGeometry(VrmlShapePtr shapeNode)
 */
 VrmlNodePtr TriangleMeshShaper::apply(VrmlNodePtr topNode)
 {
-    bool resultOfTopNode = impl->traverseShapeNodes(topNode.get(), 0, 0);
+    bool resultOfTopNode;
+
+    if(impl->isParallelMode){
+        impl->collectShapeNodes(topNode.get(), 0, 0);
+        impl->convertShapeNodesInParallel();
+        std::map<VrmlShape*, int>::iterator p =
+            impl->shapeEntryIndexMap.find(dynamic_cast<VrmlShape*>(topNode.get()));
+        resultOfTopNode = (p == impl->shapeEntryIndexMap.end()) || impl->shapeEntries[p->second].result;
+        impl->shapeEntries.clear();
+        impl->shapeEntryIndexMap.clear();
+    } else {
+        resultOfTopNode = impl->traverseShapeNodes(topNode.get(), 0, 0);
+    }
+
     return resultOfTopNode ? topNode : VrmlNodePtr();
 }
 
@@ -205,6 +268,180 @@ bool TMSImpl::traverseShapeNodes(VrmlNode* node, AbstractVrmlGroup* parentNode,
 }
 
 
+void TMSImpl::collectShapeNodes(VrmlNode* node, AbstractVrmlGroup* parentNode, int indexInParent)
+{
+    if(node->isCategoryOf(PROTO_INSTANCE_NODE)){
+        VrmlProtoInstance* protoInstance = static_cast<VrmlProtoInstance*>(node);
+        if(protoInstance->actualNode){
+            collectShapeNodes(protoInstance->actualNode.get(), parentNode, indexInParent);
+        }
+
+    } else if(node->isCategoryOf(GROUPING_NODE)){
+        AbstractVrmlGroup* group = static_cast<AbstractVrmlGroup*>(node);
+        int numChildren = group->countChildren();
+        for(int i = 0; i < numChildren; i++){
+            collectShapeNodes(group->getChild(i), group, i);
+        }
+
+    } else if(node->isCategoryOf(SHAPE_NODE)){
+        VrmlShape* shapeNode = static_cast<VrmlShape*>(node);
+        std::map<VrmlShape*, int>::iterator p = shapeEntryIndexMap.find(shapeNode);
+        if(p == shapeEntryIndexMap.end()){
+            p = shapeEntryIndexMap.insert(make_pair(shapeNode, (int)shapeEntries.size())).first;
+            shapeEntries.push_back(ShapeEntry());
+            shapeEntries.back().shapeNode = shapeNode;
+            shapeEntries.back().result = false;
+        }
+        if(parentNode){
+            shapeEntries[p->second].places.push_back(make_pair(parentNode, indexInParent));
+        }
+    }
+}
+
+
+namespace {
+
+    VrmlGeometry* getGeometry(VrmlShape* shapeNode)
+    {
+        VrmlNode* node = shapeNode->geometry.get();
+        VrmlGeometry* geometry = dynamic_cast<VrmlGeometry*>(node);
+        if(!geometry){
+            VrmlProtoInstance* protoInstance = dynamic_cast<VrmlProtoInstance*>(node);
+            if(protoInstance){
+                geometry = dynamic_cast<VrmlGeometry*>(protoInstance->actualNode.get());
+            }
+        }
+        return geometry;
+    }
+
+    int findRoot(std::vector<int>& parents, int i)
+    {
+        while(parents[i] != i){
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    }
+
+    bool isUpperPlace(const std::pair<AbstractVrmlGroup*, int>& place1, const std::pair<AbstractVrmlGroup*, int>& place2)
+    {
+        return (place1.first != place2.first) ? (place1.first < place2.first) : (place1.second > place2.second);
+    }
+}
+
+
+/**
+   The nodes are modified in place and their reference counters are not atomic,
+   so the shape nodes which share any node modified by the conversion are put into the same group.
+*/
+void TMSImpl::convertShapeNodesInParallel()
+{
+    const int numShapes = shapeEntries.size();
+
+    std::vector<int> parents(numShapes);
+    std::map<VrmlNode*, int> nodeToShapeMap;
+    for(int i=0; i < numShapes; ++i){
+        parents[i] = i;
+        VrmlNode* nodes[5] = { 0, 0, 0, 0, 0 };
+        nodes[0] = shapeEntries[i].shapeNode->geometry.get();
+        VrmlGeometry* geometry = getGeometry(shapeEntries[i].shapeNode);
+        nodes[1] = geometry;
+        if(VrmlIndexedFaceSet* faceSet = dynamic_cast<VrmlIndexedFaceSet*>(geometry)){
+            nodes[2] = faceSet->coord.get();
+            nodes[3] = faceSet->color.get();
+            nodes[4] = faceSet->normal.get();
+        } else if(VrmlPointSet* pointSet = dynamic_cast<VrmlPointSet*>(geometry)){
+            nodes[2] = pointSet->coord.get();
+            nodes[3] = pointSet->color.get();
+        }
+        for(int j=0; j < 5; ++j){
+            if(nodes[j]){
+                std::map<VrmlNode*, int>::iterator p = nodeToShapeMap.insert(make_pair(nodes[j], i)).first;
+                int root1 = findRoot(parents, p->second);
+                int root2 = findRoot(parents, i);
+                if(root1 != root2){
+                    parents[root2] = root1;
+                }
+            }
+        }
+    }
+
+    std::map<int, int> rootToGroupMap;
+    std::vector< std::vector<int> > groups;
+    for(int i=0; i < numShapes; ++i){
+        int root = findRoot(parents, i);
+        std::map<int, int>::iterator p = rootToGroupMap.find(root);
+        if(p == rootToGroupMap.end()){
+            p = rootToGroupMap.insert(make_pair(root, (int)groups.size())).first;
+            groups.push_back(std::vector<int>());
+        }
+        groups[p->second].push_back(i);
+    }
+
+    size_t nextGroup = 0;
+    boost::mutex groupMutex;
+    const int n = std::min((int)groups.size(), numThreads > 0 ? numThreads : std::max(1, (int)boost::thread::hardware_concurrency()));
+
+    if(n <= 1){
+        convertShapeEntries(&shapeEntries, &groups, &nextGroup, &groupMutex);
+
+    } else {
+        boost::mutex messageMutex;
+        std::vector<TMSImpl*> workers(n);
+        boost::thread_group threads;
+        for(int i=0; i < n; ++i){
+            workers[i] = new TMSImpl(self);
+            workers[i]->divisionNumber = divisionNumber;
+            workers[i]->isNormalGenerationMode = isNormalGenerationMode;
+            workers[i]->messageMutex = &messageMutex;
+            threads.create_thread(
+                boost::bind(&TMSImpl::convertShapeEntries, workers[i], &shapeEntries, &groups, &nextGroup, &groupMutex));
+        }
+        threads.join_all();
+
+        for(int i=0; i < n; ++i){
+            shapeToOriginalGeometryMap.insert(
+                workers[i]->shapeToOriginalGeometryMap.begin(), workers[i]->shapeToOriginalGeometryMap.end());
+            delete workers[i];
+        }
+    }
+
+    // the inconvertible nodes are removed from the last child of each group
+    std::vector< std::pair<AbstractVrmlGroup*, int> > places;
+    for(int i=0; i < numShapes; ++i){
+        if(!shapeEntries[i].result){
+            places.insert(places.end(), shapeEntries[i].places.begin(), shapeEntries[i].places.end());
+        }
+    }
+    std::sort(places.begin(), places.end(), isUpperPlace);
+    for(size_t i=0; i < places.size(); ++i){
+        putMessage("Node is inconvertible and removed from the scene graph");
+        places[i].first->removeChild(places[i].second);
+    }
+}
+
+
+void TMSImpl::convertShapeEntries
+(std::vector<ShapeEntry>* entries, const std::vector< std::vector<int> >* groups, size_t* nextGroup, boost::mutex* groupMutex)
+{
+    while(true){
+        size_t groupIndex;
+        {
+            boost::mutex::scoped_lock lock(*groupMutex);
+            if(*nextGroup >= groups->size()){
+                break;
+            }
+            groupIndex = (*nextGroup)++;
+        }
+        const std::vector<int>& group = (*groups)[groupIndex];
+        for(size_t i=0; i < group.size(); ++i){
+            ShapeEntry& entry = (*entries)[group[i]];
+            entry.result = convertShapeNode(entry.shapeNode);
+        }
+    }
+}
+
+
 bool TMSImpl::convertShapeNode(VrmlShape* shapeNode)
 {
     bool result = false;
@@ -438,7 +675,8 @@ bool TMSImpl::checkAndRemapIndices
 bool TMSImpl::setTexCoordIndex(VrmlIndexedFaceSetPtr faseSet)
 {
     bool result = true;
-    VrmlTextureCoordinatePtr texCoord = faseSet->texCoord;
+    // a raw pointer does not touch the reference counter, which is not thread-safe
+    VrmlTextureCoordinate* texCoord = faseSet->texCoord.get();
     MFInt32& texCoordIndex = faseSet->texCoordIndex;
     MFInt32& coordIndex = faseSet->coordIndex;
 
@@ -949,6 +1187,7 @@ void TMSImpl::generateNormals(VrmlIndexedFaceSetPtr& triangleMesh)
     triangleMesh->normal = new VrmlNormal();
     triangleMesh->normalPerVertex = (triangleMesh->creaseAngle > 0.0) ? true : false;
 
+    initVertexAdjacency(triangleMesh);
     calculateFaceNormals(triangleMesh);
 
     if(triangleMesh->normalPerVertex){
@@ -959,19 +1198,37 @@ void TMSImpl::generateNormals(VrmlIndexedFaceSetPtr& triangleMesh)
 }
 
 
+void TMSImpl::initVertexAdjacency(VrmlIndexedFaceSetPtr& triangleMesh)
+{
+    const int numVertices = triangleMesh->coord->point.size();
+    const MFInt32& triangles = triangleMesh->coordIndex;
+    const int numFaces = triangles.size() / 4;
+
+    vertexOffsets.assign(numVertices + 1, 0);
+    for(int faceIndex=0; faceIndex < numFaces; ++faceIndex){
+        for(int i=0; i < 3; ++i){
+            ++vertexOffsets[triangles[faceIndex * 4 + i] + 1];
+        }
+    }
+    for(int i=0; i < numVertices; ++i){
+        vertexOffsets[i + 1] += vertexOffsets[i];
+    }
+
+    facesOfVertices.resize(vertexOffsets[numVertices]);
+    normalsOfVertices.resize(vertexOffsets[numVertices]);
+    numFacesOfVertex.assign(numVertices, 0);
+    numNormalsOfVertex.assign(numVertices, 0);
+}
+
+
 void TMSImpl::calculateFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
 {
     const MFVec3f& vertices = triangleMesh->coord->point;
-    const int numVertices = vertices.size();
     const MFInt32& triangles = triangleMesh->coordIndex;
     const int numFaces = triangles.size() / 4;
 
     faceNormals.clear();
-
-    if(triangleMesh->normalPerVertex){
-        vertexIndexToFaceIndicesMap.clear();
-        vertexIndexToFaceIndicesMap.resize(numVertices);
-    }
+    faceNormals.reserve(numFaces);
 
     for(int faceIndex=0; faceIndex < numFaces; ++faceIndex){
 
@@ -987,9 +1244,10 @@ void TMSImpl::calculateFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
         if(triangleMesh->normalPerVertex){
             for(int i=0; i < 3; ++i){
                 int vertexIndex = triangles[faceIndex * 4 + i];
-                vector<int>& facesOfVertex = vertexIndexToFaceIndicesMap[vertexIndex];
+                int* facesOfVertex = &facesOfVertices[vertexOffsets[vertexIndex]];
+                int& numAdjoiningFaces = numFacesOfVertex[vertexIndex];
                 bool isSameNormalFaceFound = false;
-                for(int j=0; j < facesOfVertex.size(); ++j){
+                for(int j=0; j < numAdjoiningFaces; ++j){
                     const Vector3& otherNormal = faceNormals[facesOfVertex[j]];
                     const Vector3 d(otherNormal - normal);
                     // the same face is not appended
@@ -999,7 +1257,7 @@ void TMSImpl::calculateFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
                     }
                 }
                 if(!isSameNormalFaceFound){
-                    facesOfVertex.push_back(faceIndex);
+                    facesOfVertex[numAdjoiningFaces++] = faceIndex;
                 }
             }
         }
@@ -1009,8 +1267,6 @@ void TMSImpl::calculateFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
 
 void TMSImpl::setVertexNormals(VrmlIndexedFaceSetPtr& triangleMesh)
 {
-    const MFVec3f& vertices = triangleMesh->coord->point;
-    const int numVertices = vertices.size();
     const MFInt32& triangles = triangleMesh->coordIndex;
     const int numFaces = triangles.size() / 4;
 
@@ -1019,9 +1275,6 @@ void TMSImpl::setVertexNormals(VrmlIndexedFaceSetPtr& triangleMesh)
     normalIndices.clear();
     normalIndices.reserve(triangles.size());
 
-    vertexIndexToNormalIndicesMap.clear();
-    vertexIndexToNormalIndicesMap.resize(numVertices);
-
     //const double cosCreaseAngle = cos(triangleMesh->creaseAngle);
 
     for(int faceIndex=0; faceIndex < numFaces; ++faceIndex){
@@ -1029,13 +1282,14 @@ void TMSImpl::setVertexNormals(VrmlIndexedFaceSetPtr& triangleMesh)
         for(int i=0; i < 3; ++i){
 
             int vertexIndex = triangles[faceIndex * 4 + i];
-            vector<int>& facesOfVertex = vertexIndexToFaceIndicesMap[vertexIndex];
+            const int* facesOfVertex = &facesOfVertices[vertexOffsets[vertexIndex]];
+            const int numAdjoiningFaces = numFacesOfVertex[vertexIndex];
             const Vector3& currentFaceNormal = faceNormals[faceIndex];
             Vector3 normal = currentFaceNormal;
             bool normalIsFaceNormal = true;
 
             // avarage normals of the faces whose crease angle is below the 'creaseAngle' variable
-            for(int j=0; j < facesOfVertex.size(); ++j){
+            for(int j=0; j < numAdjoiningFaces; ++j){
                 int adjoingFaceIndex = facesOfVertex[j];
                 const Vector3& adjoingFaceNormal = faceNormals[adjoingFaceIndex];
                 double angle = acos(currentFaceNormal.dot(adjoingFaceNormal)
@@ -1054,8 +1308,9 @@ void TMSImpl::setVertexNormals(VrmlIndexedFaceSetPtr& triangleMesh)
 
             for(int j=0; j < 3; ++j){
                 int vertexIndex2 = triangles[faceIndex * 4 + j];
-                vector<int>& normalIndicesOfVertex = vertexIndexToNormalIndicesMap[vertexIndex2];
-                for(int k=0; k < normalIndicesOfVertex.size(); ++k){
+                const int* normalIndicesOfVertex = &normalsOfVertices[vertexOffsets[vertexIndex2]];
+                const int numNormals = numNormalsOfVertex[vertexIndex2];
+                for(int k=0; k < numNormals; ++k){
                     int index = normalIndicesOfVertex[k];
                     const SFVec3f& norg = normals[index];
                     const Vector3 d(Vector3(norg[0], norg[1], norg[2]) - normal);
@@ -1070,7 +1325,7 @@ void TMSImpl::setVertexNormals(VrmlIndexedFaceSetPtr& triangleMesh)
                 n[0] = normal[0]; n[1] = normal[1]; n[2] = normal[2]; 
                 normalIndex = normals.size();
                 normals.push_back(n);
-                vertexIndexToNormalIndicesMap[vertexIndex].push_back(normalIndex);
+                normalsOfVertices[vertexOffsets[vertexIndex] + numNormalsOfVertex[vertexIndex]++] = normalIndex;
             }
             
           normalIndexFound:
@@ -1091,10 +1346,6 @@ void TMSImpl::setFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
     normalIndices.clear();
     normalIndices.reserve(numFaces);
 
-    const int numVertices = triangleMesh->coord->point.size();
-    vertexIndexToNormalIndicesMap.clear();
-    vertexIndexToNormalIndicesMap.resize(numVertices);
-
     for(int faceIndex=0; faceIndex < numFaces; ++faceIndex){
 
         const Vector3& normal = faceNormals[faceIndex];
@@ -1103,8 +1354,9 @@ void TMSImpl::setFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
         // find the same normal from the existing normals
         for(int i=0; i < 3; ++i){
             int vertexIndex = triangles[faceIndex * 4 + i];
-            vector<int>& normalIndicesOfVertex = vertexIndexToNormalIndicesMap[vertexIndex];
-            for(int j=0; j < normalIndicesOfVertex.size(); ++j){
+            const int* normalIndicesOfVertex = &normalsOfVertices[vertexOffsets[vertexIndex]];
+            const int numNormals = numNormalsOfVertex[vertexIndex];
+            for(int j=0; j < numNormals; ++j){
                 int index = normalIndicesOfVertex[j];
                 const SFVec3f& norg = normals[index];
                 const Vector3 n(norg[0], norg[1], norg[2]);
@@ -1121,7 +1373,7 @@ void TMSImpl::setFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
             normals.push_back(n);
             for(int i=0; i < 3; ++i){
                 int vertexIndex = triangles[faceIndex * 4 + i];
-                vertexIndexToNormalIndicesMap[vertexIndex].push_back(normalIndex);
+                normalsOfVertices[vertexOffsets[vertexIndex] + numNormalsOfVertex[vertexIndex]++] = normalIndex;
             }
         }
       normalIndexFound2:
@@ -1133,7 +1385,12 @@ void TMSImpl::setFaceNormals(VrmlIndexedFaceSetPtr& triangleMesh)
 void TMSImpl::putMessage(const std::string& message)
 {
     if(!self->sigMessage.empty()){
-        self->sigMessage(message + "\n" );
+        if(messageMutex){
+            boost::mutex::scoped_lock lock(*messageMutex);
+            self->sigMessage(message + "\n" );
+        } else {
+            self->sigMessage(message + "\n" );
+        }
     }
 }
 
@@ -17,6 +17,8 @@
 #include <cmath>
 #include <vector>
 #include <list>
+#include <deque>
+#include <algorithm>
 #include <iostream>
 #include <hrpUtil/EasyScanner.h>
 #include <hrpUtil/UrlUtil.h>
@@ -28,6 +30,10 @@
 #else
 #include <boost/filesystem.hpp>
 #endif
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
 
 using namespace std;
 using namespace boost;
@@ -299,6 +305,52 @@ namespace {
 }
 
 
+namespace {
+
+    /**
+       A file of Inline nodes which is parsed in the parallel inline loading mode
+    */
+    struct InlineSource
+    {
+        enum State { WAITING, LOADING, LOADED, FAILED };
+
+        std::string path;
+        list<string> ancestorPathsList;
+        State state;
+        VrmlNodePtr node;
+        EasyScanner::Exception exception;
+
+        /// the source which the parser of this source is waiting for
+        InlineSource* waitingSource;
+    };
+    typedef boost::shared_ptr<InlineSource> InlineSourcePtr;
+
+    class InlineLoader
+    {
+    public:
+        InlineLoader(VrmlParser* parser, int numThreads);
+        ~InlineLoader();
+
+        InlineSourcePtr request(const std::string& path, const list<string>& ancestorPathsList);
+        void get(InlineSource* currentSource, InlineSourcePtr source, VrmlNodePtr& out_node);
+
+    private:
+        VrmlParser* parser;
+        int numThreads;
+        boost::thread_group workers;
+        boost::mutex mutex;
+        boost::condition_variable queueCondition;
+        boost::condition_variable loadedCondition;
+        std::map<std::string, InlineSourcePtr> sources;
+        std::deque<InlineSourcePtr> queue;
+        bool isStopping;
+
+        void load(InlineSource* source);
+        void work();
+    };
+}
+
+
 namespace hrp {
 
     class VrmlParserImpl
@@ -312,6 +364,21 @@ namespace hrp {
 
         bool protoInstanceActualNodeExtractionMode;
 
+        bool isParallelInlineLoadingMode;
+        int numInlineLoadingThreads;
+
+        /// shared by all the parsers of a load. Only the top parser owns it.
+        boost::shared_ptr<InlineLoader> inlineLoaderOwner;
+        InlineLoader* inlineLoader;
+        InlineSource* currentInlineSource;
+
+        struct PendingInline {
+            VrmlInlinePtr node;
+            int index;
+            InlineSourcePtr source;
+        };
+        std::vector<PendingInline> pendingInlines;
+
         typedef map<VrmlProto*, EasyScannerPtr> ProtoToEntityScannerMap;
         ProtoToEntityScannerMap protoToEntityScannerMap;
 
@@ -327,6 +394,9 @@ namespace hrp {
         VrmlNodePtr readSpecificNode(VrmlNodeCategory nodeCategory, int symbol, const std::string& symbolString);
         VrmlNodePtr readInlineNode(VrmlNodeCategory nodeCategory);
         VrmlNodePtr newInlineSource(std::string& io_filename);
+        VrmlNodePtr readInlineSourceNodes();
+        void resolvePendingInlines();
+        static VrmlNodePtr loadInlineSource(VrmlParser* self, InlineLoader* loader, InlineSource* source);
         VrmlProtoPtr defineProto();
   
         VrmlNodePtr readNode(VrmlNodeCategory nodeCategory);
@@ -379,6 +449,14 @@ namespace hrp {
         VrmlNormalPtr readNormalNode();
   
         VrmlVariantField& readProtoField(VrmlFieldTypeId fieldTypeId);
+
+        /**
+           Only a word beginning with 'I' can be "IS".
+           The first character is checked so that a word is not read for every field value.
+        */
+        inline bool readIS() {
+            return (scanner->peekChar() == 'I') && scanner->readSymbol(F_IS);
+        }
   
         void readSFInt32(SFInt32& out_value);
         void readSFFloat(SFFloat& out_value);
@@ -456,12 +534,26 @@ void VrmlParser::setProtoInstanceActualNodeExtractionMode(bool isOn)
 }
 
 
+void VrmlParser::setParallelInlineLoadingMode(bool isOn, int numThreads)
+{
+    impl->isParallelInlineLoadingMode = isOn;
+    impl->numInlineLoadingThreads = numThreads;
+}
+
+
 
 /**
    This function throws EasyScanner::Exception when an error occurs.
 */
 void VrmlParser::load(const string& filename)
 {
+    impl->pendingInlines.clear();
+    impl->inlineLoaderOwner.reset();
+    impl->inlineLoader = 0;
+    if(impl->isParallelInlineLoadingMode){
+        impl->inlineLoaderOwner.reset(new InlineLoader(this, impl->numInlineLoadingThreads));
+        impl->inlineLoader = impl->inlineLoaderOwner.get();
+    }
     impl->load(filename);
 }
 
@@ -495,7 +587,9 @@ void VrmlParserImpl::load(const string& filename)
 
 VrmlNodePtr VrmlParser::readNode()
 {
-    return impl->readNode(TOP_NODE);
+    VrmlNodePtr node = impl->readNode(TOP_NODE);
+    impl->resolvePendingInlines();
+    return node;
 }
 
 
@@ -753,7 +847,13 @@ VrmlNodePtr VrmlParserImpl::readInlineNode(VrmlNodeCategory nodeCategory)
 
         VrmlInlinePtr inlineNode = new VrmlInline();
         for( MFString::iterator ite = inlineUrls.begin(); ite != inlineUrls.end(); ++ite ){
-            inlineNode->children.push_back( newInlineSource( *ite ) );
+            VrmlNodePtr child = newInlineSource( *ite );
+            if(inlineLoader){
+                // the source is being parsed by a worker and the child is set by resolvePendingInlines()
+                pendingInlines.back().node = inlineNode;
+                pendingInlines.back().index = inlineNode->children.size();
+            }
+            inlineNode->children.push_back( child );
             inlineNode->urls.push_back(*ite);
         }
         return inlineNode;
@@ -794,17 +894,33 @@ VrmlNodePtr VrmlParserImpl::newInlineSource(string& io_filename)
         }
     }
 
+    io_filename = chkFile;
+
+    if(inlineLoader){
+        PendingInline pending;
+        pending.index = 0;
+        pending.source = inlineLoader->request(chkFile, ancestorPathsList);
+        pendingInlines.push_back(pending);
+        return 0;
+    }
+
     VrmlParserImpl  inlineParser( *this, ancestorPathsList );
 
     inlineParser.load( chkFile );
-    io_filename = chkFile;
 
+    return inlineParser.readInlineSourceNodes();
+}
+
+
+VrmlNodePtr VrmlParserImpl::readInlineSourceNodes()
+{
     VrmlGroupPtr group = new VrmlGroup();
-    while(VrmlNodePtr node = inlineParser.readNode(TOP_NODE)){
+    while(VrmlNodePtr node = readNode(TOP_NODE)){
         if(node->isCategoryOf(CHILD_NODE)){
             group->children.push_back(node);
         }
     }
+    resolvePendingInlines();
 
     if(group->children.size() == 1){
         return group->children.front();
@@ -814,6 +930,182 @@ VrmlNodePtr VrmlParserImpl::newInlineSource(string& io_filename)
 }
 
 
+/**
+   This function waits for the sources requested by the Inline nodes read so far
+   and puts the parsed nodes into the Inline nodes in the order of the URLs.
+*/
+void VrmlParserImpl::resolvePendingInlines()
+{
+    for(size_t i=0; i < pendingInlines.size(); ++i){
+        PendingInline& pending = pendingInlines[i];
+        inlineLoader->get(currentInlineSource, pending.source, pending.node->children[pending.index]);
+    }
+    pendingInlines.clear();
+}
+
+
+VrmlNodePtr VrmlParserImpl::loadInlineSource(VrmlParser* self, InlineLoader* loader, InlineSource* source)
+{
+    VrmlParserImpl inlineParser(self);
+    inlineParser.ancestorPathsList = source->ancestorPathsList;
+    inlineParser.inlineLoader = loader;
+    inlineParser.currentInlineSource = source;
+
+    inlineParser.load(source->path);
+
+    return inlineParser.readInlineSourceNodes();
+}
+
+
+InlineLoader::InlineLoader(VrmlParser* parser, int numThreads)
+    : parser(parser),
+      numThreads(numThreads > 0 ? numThreads : std::max(1, (int)boost::thread::hardware_concurrency())),
+      isStopping(false)
+{
+
+}
+
+
+InlineLoader::~InlineLoader()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        isStopping = true;
+        queue.clear();
+    }
+    queueCondition.notify_all();
+    workers.join_all();
+}
+
+
+/**
+   This function returns the source of the path and schedules the parsing of it
+   if the path has not been requested in the load yet.
+*/
+InlineSourcePtr InlineLoader::request(const std::string& path, const list<string>& ancestorPathsList)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    std::map<std::string, InlineSourcePtr>::iterator p = sources.find(path);
+    if(p != sources.end()){
+        return p->second;
+    }
+
+    InlineSourcePtr source(new InlineSource());
+    source->path = path;
+    source->ancestorPathsList = ancestorPathsList;
+    source->state = InlineSource::WAITING;
+    source->waitingSource = 0;
+    sources[path] = source;
+
+    queue.push_back(source);
+    if((int)workers.size() < numThreads){
+        workers.create_thread(boost::bind(&InlineLoader::work, this));
+    }
+    queueCondition.notify_one();
+
+    return source;
+}
+
+
+void InlineLoader::load(InlineSource* source)
+{
+    InlineSource::State state = InlineSource::LOADED;
+    VrmlNodePtr node;
+    try {
+        node = VrmlParserImpl::loadInlineSource(parser, this, source);
+    } catch(EasyScanner::Exception& ex){
+        source->exception = ex;
+        state = InlineSource::FAILED;
+    } catch(std::exception& ex){
+        source->exception.message = ex.what();
+        source->exception.filename = source->path;
+        source->exception.lineNumber = -1;
+        state = InlineSource::FAILED;
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    source->node.swap(node);
+    source->state = state;
+    loadedCondition.notify_all();
+}
+
+
+void InlineLoader::work()
+{
+    while(true){
+        InlineSourcePtr source;
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            while(queue.empty() && !isStopping){
+                queueCondition.wait(lock);
+            }
+            if(queue.empty()){
+                break;
+            }
+            source = queue.front();
+            queue.pop_front();
+            if(source->state != InlineSource::WAITING){
+                // it has been loaded by the thread which needed it
+                continue;
+            }
+            source->state = InlineSource::LOADING;
+        }
+        load(source.get());
+    }
+}
+
+
+/**
+   This function sets the nodes of the source to out_node.
+   If no worker has started to parse the source, it is parsed by the calling thread
+   so that the parsers waiting for nested sources never use up the workers.
+
+   The node of a source may be shared by parsers running in different threads.
+   Its reference counter is not atomic, so it is only copied while the mutex is locked.
+*/
+void InlineLoader::get(InlineSource* currentSource, InlineSourcePtr source, VrmlNodePtr& out_node)
+{
+    boost::mutex::scoped_lock lock(mutex);
+
+    if(source->state == InlineSource::WAITING){
+        source->state = InlineSource::LOADING;
+        if(currentSource){
+            currentSource->waitingSource = source.get();
+        }
+        lock.unlock();
+        load(source.get());
+        lock.lock();
+
+    } else if(source->state == InlineSource::LOADING){
+        // A source shared by several Inline nodes may include the file which is waiting for it
+        for(InlineSource* s = source.get(); s; s = s->waitingSource){
+            if(s == currentSource){
+                EasyScanner::Exception ex;
+                ex.message = "Infinity loop ! " + source->path + " is included ancestor list";
+                ex.filename = currentSource->path;
+                ex.lineNumber = -1;
+                throw ex;
+            }
+        }
+        if(currentSource){
+            currentSource->waitingSource = source.get();
+        }
+        while(source->state == InlineSource::LOADING){
+            loadedCondition.wait(lock);
+        }
+    }
+
+    if(currentSource){
+        currentSource->waitingSource = 0;
+    }
+    if(source->state == InlineSource::FAILED){
+        throw source->exception;
+    }
+    out_node = source->node;
+}
+
+
 VrmlProtoPtr VrmlParserImpl::defineProto()
 {
     string proto_name = scanner->readWordEx("illegal PROTO name");
@@ -2138,7 +2430,7 @@ VrmlVariantField& VrmlParserImpl::readProtoField(VrmlFieldTypeId fieldTypeId)
 
 void VrmlParserImpl::readSFInt32(SFInt32& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFINT32);
         out_value = field.sfInt32();
     } else {
@@ -2149,7 +2441,7 @@ void VrmlParserImpl::readSFInt32(SFInt32& out_value)
 
 void VrmlParserImpl::readMFInt32(MFInt32& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFINT32);
         out_value = field.mfInt32();
     } else {
@@ -2159,9 +2451,9 @@ void VrmlParserImpl::readMFInt32(MFInt32& out_value)
             readSFInt32(v);
             out_value.push_back(v);
         } else {
+            out_value.reserve(scanner->countNumbers(']'));
             while(!scanner->readChar(']')){
-                readSFInt32(v);
-                out_value.push_back(v);
+                out_value.push_back(scanner->readIntEx("illegal int value"));
             }
         }
     }
@@ -2170,7 +2462,7 @@ void VrmlParserImpl::readMFInt32(MFInt32& out_value)
 
 void VrmlParserImpl::readSFFloat(SFFloat& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFFLOAT);
         out_value = field.sfFloat();
     } else {
@@ -2181,7 +2473,7 @@ void VrmlParserImpl::readSFFloat(SFFloat& out_value)
 
 void VrmlParserImpl::readMFFloat(MFFloat& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFFLOAT);
         out_value = field.mfFloat();
     } else {
@@ -2191,9 +2483,9 @@ void VrmlParserImpl::readMFFloat(MFFloat& out_value)
             readSFFloat(v);
             out_value.push_back(v);
         } else {
+            out_value.reserve(scanner->countNumbers(']'));
             while(!scanner->readChar(']')){
-                readSFFloat(v);
-                out_value.push_back(v);
+                out_value.push_back(scanner->readDoubleEx("illegal float value"));
             }
         }
     }
@@ -2202,7 +2494,7 @@ void VrmlParserImpl::readMFFloat(MFFloat& out_value)
 
 void VrmlParserImpl::readSFString(SFString& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFSTRING);
         out_value = field.sfString();
     } else {
@@ -2213,7 +2505,7 @@ void VrmlParserImpl::readSFString(SFString& out_value)
 
 void VrmlParserImpl::readMFString(MFString& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFSTRING);
         out_value = field.mfString();
     } else {
@@ -2234,7 +2526,7 @@ void VrmlParserImpl::readMFString(MFString& out_value)
 
 void VrmlParserImpl::readSFVec2f(SFVec2f& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFVEC2F);
         out_value = field.sfVec2f();
     } else {
@@ -2246,7 +2538,7 @@ void VrmlParserImpl::readSFVec2f(SFVec2f& out_value)
 
 void VrmlParserImpl::readMFVec2f(MFVec2f& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFVEC2F);
         out_value = field.mfVec2f();
     } else {
@@ -2256,8 +2548,10 @@ void VrmlParserImpl::readMFVec2f(MFVec2f& out_value)
             readSFVec2f(v);
             out_value.push_back(v);
         } else {
+            out_value.reserve(scanner->countNumbers(']') / 2);
             while(!scanner->readChar(']')){
-                readSFVec2f(v);
+                v[0] = scanner->readDoubleEx("illegal float value");
+                v[1] = scanner->readDoubleEx("illegal float value");
                 out_value.push_back(v);
             }
         }
@@ -2267,7 +2561,7 @@ void VrmlParserImpl::readMFVec2f(MFVec2f& out_value)
 
 void VrmlParserImpl::readSFVec3f(SFVec3f& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFVEC3F);
         out_value = field.sfVec3f();
     } else {
@@ -2280,7 +2574,7 @@ void VrmlParserImpl::readSFVec3f(SFVec3f& out_value)
 
 void VrmlParserImpl::readMFVec3f(MFVec3f& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFVEC3F);
         out_value = field.mfVec3f();
     } else {
@@ -2290,8 +2584,11 @@ void VrmlParserImpl::readMFVec3f(MFVec3f& out_value)
             readSFVec3f(v);
             out_value.push_back(v);
         } else {
+            out_value.reserve(scanner->countNumbers(']') / 3);
             while(!scanner->readChar(']')){
-                readSFVec3f(v);
+                v[0] = scanner->readDoubleEx("illegal float value");
+                v[1] = scanner->readDoubleEx("illegal float value");
+                v[2] = scanner->readDoubleEx("illegal float value");
                 out_value.push_back(v);
             }
         }
@@ -2301,7 +2598,7 @@ void VrmlParserImpl::readMFVec3f(MFVec3f& out_value)
 
 void VrmlParserImpl::readSFColor(SFColor& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFCOLOR);
         out_value = field.sfColor();
     } else {
@@ -2313,7 +2610,7 @@ void VrmlParserImpl::readSFColor(SFColor& out_value)
 
 void VrmlParserImpl::readMFColor(MFColor& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFCOLOR);
         out_value = field.mfColor();
     } else {
@@ -2324,7 +2621,7 @@ void VrmlParserImpl::readMFColor(MFColor& out_value)
 
 void VrmlParserImpl::readSFRotation(SFRotation& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFROTATION);
         out_value = field.sfRotation();
     } else {
@@ -2352,7 +2649,7 @@ void VrmlParserImpl::readSFRotation(SFRotation& out_value)
 
 void VrmlParserImpl::readMFRotation(MFRotation& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFROTATION);
         out_value = field.mfRotation();
     } else {
@@ -2362,6 +2659,7 @@ void VrmlParserImpl::readMFRotation(MFRotation& out_value)
             readSFRotation(r);
             out_value.push_back(r);
         } else {
+            out_value.reserve(scanner->countNumbers(']') / 4);
             while(!scanner->readChar(']')){
                 readSFRotation(r);
                 out_value.push_back(r);
@@ -2373,7 +2671,7 @@ void VrmlParserImpl::readMFRotation(MFRotation& out_value)
 
 void VrmlParserImpl::readSFBool(SFBool& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFBOOL);
         out_value = field.sfBool();
     } else {
@@ -2403,7 +2701,7 @@ void VrmlParserImpl::readSFBool(SFBool& out_value)
 void VrmlParserImpl::readSFImage(
     SFImage& out_image )		//!< to return read SFImage
 {
-    if( scanner->readSymbol( F_IS ) )
+    if( readIS() )
 	{
             VrmlVariantField& field = readProtoField( SFIMAGE );
             out_image = field.sfImage();	//##### 要チェック
@@ -2425,6 +2723,8 @@ void VrmlParserImpl::readSFImage(
             int	shift;
             const SFInt32	comps = out_image.numComponents;
 
+            out_image.pixels.reserve( out_image.width * out_image.height * comps );
+
             for( h=0; h<out_image.height; h++ )
 		{
                     for( w=0; w<out_image.width; w++ )
@@ -2444,7 +2744,7 @@ void VrmlParserImpl::readSFImage(
 
 void VrmlParserImpl::readSFTime(SFTime& out_value)
 {
-    if(scanner->readSymbol( F_IS )){
+    if(readIS()){
         VrmlVariantField& field = readProtoField( SFTIME );
         out_value = field.sfFloat();
     } else {
@@ -2455,7 +2755,7 @@ void VrmlParserImpl::readSFTime(SFTime& out_value)
 
 void VrmlParserImpl::readMFTime(MFTime& out_value)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField( MFTIME );
         out_value = field.mfFloat();
     } else {
@@ -2477,7 +2777,7 @@ void VrmlParserImpl::readMFTime(MFTime& out_value)
 // This API should be obsolete
 void VrmlParserImpl::readSFNode(SFNode& out_node, VrmlNodeCategory nodeCategory)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFNODE);
         out_node = field.sfNode();
     } else if(scanner->readSymbol(V_NULL)){
@@ -2490,7 +2790,7 @@ void VrmlParserImpl::readSFNode(SFNode& out_node, VrmlNodeCategory nodeCategory)
 
 SFNode VrmlParserImpl::readSFNode(VrmlNodeCategory nodeCategory)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(SFNODE);
         return field.sfNode();
     } else if(scanner->readSymbol(V_NULL)){
@@ -2503,7 +2803,7 @@ SFNode VrmlParserImpl::readSFNode(VrmlNodeCategory nodeCategory)
 
 void VrmlParserImpl::readMFNode(MFNode& out_nodes, VrmlNodeCategory nodeCategory)
 {
-    if(scanner->readSymbol(F_IS)){
+    if(readIS()){
         VrmlVariantField& field = readProtoField(MFNODE);
         out_nodes = field.mfNode();
     } else {
@@ -2534,6 +2834,10 @@ void VrmlParserImpl::init()
 {
     currentProtoInstance = 0;
     protoInstanceActualNodeExtractionMode = true;
+    isParallelInlineLoadingMode = false;
+    numInlineLoadingThreads = 0;
+    inlineLoader = 0;
+    currentInlineSource = 0;
 
     scanner = boost::shared_ptr<EasyScanner>( new EasyScanner() );
     setSymbols();
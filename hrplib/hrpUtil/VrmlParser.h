@@ -42,6 +42,18 @@ namespace hrp {
         ~VrmlParser();
 
         void setProtoInstanceActualNodeExtractionMode(bool isOn);
+
+        /**
+           If this mode is on, the files of Inline nodes are parsed by worker threads
+           while the parser continues to read the file which includes them.
+           The parsed nodes are put into the Inline nodes before readNode() returns,
+           and a file referenced by several Inline nodes is parsed only once in a load.
+
+           \param numThreads the number of worker threads.
+           The number of hardware threads is used if it is zero.
+        */
+        void setParallelInlineLoadingMode(bool isOn, int numThreads = 0);
+
         void load(const std::string& filename);
 
         /**
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ * General Robotix Inc.
+ */
+/*!
+ * @file  SamplePDInProcess.cpp
+ * @brief Sample PD controller for the in-process simulation runner
+ *
+ * This controller does the same PD control as the SamplePD component, but it is
+ * loaded as a shared library by openhrp-simulation-runner and reads and writes
+ * the joints of the body directly. The data files are read from the etc directory
+ * of the current directory as SamplePD does.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <hrpModel/Body.h>
+#include <hrpModel/Link.h>
+#include <hrpModel/SimulationControllerInterface.h>
+
+#define ANGLE_FILE "etc/angle.dat"
+#define VEL_FILE   "etc/vel.dat"
+
+#define GAIN_FILE  "etc/PDgain.dat"
+
+#if defined(_WIN32) || defined(_WIN64)
+#define SAMPLEPD_EXPORT __declspec(dllexport)
+#else
+#define SAMPLEPD_EXPORT
+#endif
+
+using namespace hrp;
+
+namespace {
+
+  struct SamplePD
+  {
+    Body* body;
+    double timeStep;
+    int dof;
+    std::vector<double> Pgain, Dgain;
+    std::vector<double> qold, q_ref, dq_ref;
+    std::ifstream angle, vel;
+  };
+
+  SimulationControllerHandle create(Body* body, const char* modelName, double controlTimeStep)
+  {
+    SamplePD* pd = new SamplePD;
+    pd->body = body;
+    pd->timeStep = controlTimeStep;
+    pd->dof = body->numJoints();
+    pd->Pgain.resize(pd->dof, 0.0);
+    pd->Dgain.resize(pd->dof, 0.0);
+    pd->qold.resize(pd->dof, 0.0);
+    pd->q_ref.resize(pd->dof, 0.0);
+    pd->dq_ref.resize(pd->dof, 0.0);
+
+    std::ifstream gain(GAIN_FILE);
+    if (gain.is_open()){
+      for (int i=0; i<pd->dof; i++){
+        gain >> pd->Pgain[i];
+        gain >> pd->Dgain[i];
+      }
+    }else{
+      std::cerr << GAIN_FILE << " not found" << std::endl;
+    }
+    return pd;
+  }
+
+  void destroy(SimulationControllerHandle handle)
+  {
+    delete static_cast<SamplePD*>(handle);
+  }
+
+  void initialize(SimulationControllerHandle handle)
+  {
+    SamplePD* pd = static_cast<SamplePD*>(handle);
+
+    pd->angle.open(ANGLE_FILE);
+    if(!pd->angle.is_open()){
+      std::cerr << ANGLE_FILE << " not opened" << std::endl;
+    }
+    pd->vel.open(VEL_FILE);
+    if (!pd->vel.is_open()){
+      std::cerr << VEL_FILE << " not opened" << std::endl;
+    }
+
+    for(int i=0; i < pd->dof; ++i){
+      Link* joint = pd->body->joint(i);
+      pd->qold[i] = joint ? joint->q : 0.0;
+      pd->q_ref[i] = pd->dq_ref[i] = 0.0;
+    }
+  }
+
+  void control(SimulationControllerHandle handle, double time)
+  {
+    SamplePD* pd = static_cast<SamplePD*>(handle);
+
+    if(pd->angle.is_open() && !pd->angle.eof()){
+      double t;
+      pd->angle >> t; pd->vel >> t; // skip time
+      for (int i=0; i<pd->dof; i++){
+        pd->angle >> pd->q_ref[i];
+        pd->vel >> pd->dq_ref[i];
+      }
+    }
+    for(int i=0; i<pd->dof; i++){
+      Link* joint = pd->body->joint(i);
+      if(!joint) continue;
+      double q = joint->q;
+      double dq = (q - pd->qold[i]) / pd->timeStep;
+      pd->qold[i] = q;
+
+      joint->u = -(q - pd->q_ref[i]) * pd->Pgain[i] - (dq - pd->dq_ref[i]) * pd->Dgain[i];
+    }
+  }
+
+  SimulationControllerInterface controllerInterface = {
+    SIMULATION_CONTROLLER_INTERFACE_VERSION,
+    create,
+    destroy,
+    initialize,
+    control
+  };
+}
+
+extern "C" SAMPLEPD_EXPORT SimulationControllerInterface* getHrpSimulationControllerInterface()
+{
+  return &controllerInterface;
+}
@@ -12,13 +12,15 @@
 */
 
 #include "ColdetBody.h"
+#include <hrpUtil/ShapeChunk.h>
 #include <iostream>
+#include <algorithm>
 
 
 ColdetBody::ColdetBody(BodyInfo_ptr bodyInfo)
 {
     LinkInfoSequence_var links = bodyInfo->links();
-    ShapeInfoSequence_var shapes = bodyInfo->shapes();
+    ShapeInfoSequence_var shapes = getShapesByChunks(bodyInfo, defaultShapeChunkOption());
 
     int numLinks = links->length();
 
@@ -30,7 +32,10 @@ ColdetBody::ColdetBody(BodyInfo_ptr bodyInfo)
 			
         int totalNumTriangles = 0;
         int totalNumVertices = 0;
-        const TransformedShapeIndexSequence& shapeIndices = linkInfo.shapeIndices;
+        // the simplified collision shapes include the shapes of the sensors
+        const bool hasCollisionShapes = (linkInfo.collisionShapeIndices.length() > 0);
+        const TransformedShapeIndexSequence& shapeIndices =
+            hasCollisionShapes ? linkInfo.collisionShapeIndices : linkInfo.shapeIndices;
         short shapeIndex;
         double R[9], p[3];
         unsigned int nshape = shapeIndices.length();
@@ -46,7 +51,7 @@ ColdetBody::ColdetBody(BodyInfo_ptr bodyInfo)
         }
 
         const SensorInfoSequence& sensors = linkInfo.sensors;
-        for (unsigned int i=0; i<sensors.length(); i++){
+        for (unsigned int i=0; i<sensors.length() && !hasCollisionShapes; i++){
             const SensorInfo &sinfo = sensors[i];
             const TransformedShapeIndexSequence tsis = sinfo.shapeIndices;
             nshape += tsis.length();
@@ -82,6 +87,21 @@ ColdetBody::ColdetBody(BodyInfo_ptr bodyInfo)
 
         cout << linkInfo.name << " has "<< totalNumTriangles << " triangles." << endl;
     }
+
+    initLinkPoses();
+}
+
+
+void ColdetBody::initLinkPoses()
+{
+    // ColdetModel is initialized with the identity transform
+    const int numLinks = linkColdetModels.size();
+    linkPoses.resize(numLinks * 12);
+    for(int i=0; i < numLinks; ++i){
+        float* pose = &linkPoses[i * 12];
+        std::fill(pose, pose + 12, 0.0f);
+        pose[3] = pose[7] = pose[11] = 1.0f;
+    }
 }
 
 void ColdetBody::addLinkPrimitiveInfo(ColdetModelPtr& coldetModel, 
@@ -152,9 +172,19 @@ void ColdetBody::addLinkVerticesAndTriangles
     int vertexIndex = 0;
     int triangleIndex = 0;
 
+    Matrix44 E(Matrix44::Identity());
+
+    const TransformedShapeIndexSequence& collisionShapeIndices = linkInfo.collisionShapeIndices;
+    if(collisionShapeIndices.length() > 0){
+        for(unsigned int i=0; i < collisionShapeIndices.length(); i++){
+            addLinkVerticesAndTriangles(coldetModel, collisionShapeIndices[i], E, shapes,
+                                        vertexIndex, triangleIndex);
+        }
+        return;
+    }
+
     const TransformedShapeIndexSequence& shapeIndices = linkInfo.shapeIndices;
 
-    Matrix44 E(Matrix44::Identity());
     for(unsigned int i=0; i < shapeIndices.length(); i++){
         addLinkVerticesAndTriangles(coldetModel, shapeIndices[i], E, shapes,
                                     vertexIndex, triangleIndex);
@@ -183,6 +213,28 @@ ColdetBody::ColdetBody(const ColdetBody& org)
 {
     linkColdetModels = org.linkColdetModels;
     linkNameToColdetModelMap = org.linkNameToColdetModelMap;
+    linkPoses = org.linkPoses;
+}
+
+
+int ColdetBody::buildConvexHulls
+(const vector<string>& linkNames, const ConvexDecomposition& decomposition, const string& cacheDirectory)
+{
+    int numEnabledLinks = 0;
+    for(size_t i=0; i < linkColdetModels.size(); ++i){
+        ColdetModelPtr& model = linkColdetModels[i];
+        if(!model || model->getNumTriangles() == 0){
+            continue;
+        }
+        if(!linkNames.empty() && std::find(linkNames.begin(), linkNames.end(), model->name()) == linkNames.end()){
+            continue;
+        }
+        if(model->buildConvexHulls(decomposition, cacheDirectory) > 0){
+            model->enableConvexHulls(true);
+            ++numEnabledLinks;
+        }
+    }
+    return numEnabledLinks;
 }
 
 
@@ -192,8 +244,6 @@ void ColdetBody::setLinkPositions(const LinkPositionSequence& linkPositions)
     const int selfNumLinks = linkColdetModels.size();
     for(int i=0; i < srcNumLinks && i < selfNumLinks; ++i){
         const LinkPosition& linkPosition = linkPositions[i];
-        if(linkColdetModels[i]){
-            linkColdetModels[i]->setPosition(linkPosition.R, linkPosition.p);
-        }
+        setLinkPosition(i, linkPosition.R, linkPosition.p);
     }
 }
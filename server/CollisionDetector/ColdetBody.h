@@ -21,6 +21,7 @@
 #include <hrpUtil/Eigen4d.h>
 #include <hrpCorba/ModelLoader.hh>
 #include <hrpCollision/ColdetModel.h>
+#include <hrpCollision/ConvexDecomposition.h>
 
 using namespace std;
 using namespace boost;
@@ -55,6 +56,46 @@ public:
 
     void setLinkPositions(const LinkPositionSequence& linkPositions);
 
+    /**
+       approximates the meshes of the links by convex hulls, which are used for the
+       collision detection between the links which both have them
+       @param linkNames the names of the links to which the hulls are applied, or empty for all the links
+       @param cacheDirectory an existing directory where the hulls are cached, or empty for no cache
+       @return the number of the links whose hulls are enabled
+    */
+    int buildConvexHulls(const vector<string>& linkNames, const ConvexDecomposition& decomposition,
+                         const string& cacheDirectory);
+
+    /**
+       set the position of a link.
+       The transform of the ColdetModel is not updated when the position
+       is the same as the one set previously.
+       @param R orientation (length = 9, row major)
+       @param p position (length = 3)
+       @return true if the transform of the link has been updated
+    */
+    template <class Real>
+    bool setLinkPosition(unsigned int linkIndex, const Real* R, const Real* p) {
+        if(linkIndex >= linkColdetModels.size() || !linkColdetModels[linkIndex]){
+            return false;
+        }
+        float* pose = &linkPoses[linkIndex * 12];
+        bool changed = false;
+        for(int i=0; i < 3; ++i){
+            if(pose[i] != (float)p[i]){ pose[i] = (float)p[i]; changed = true; }
+        }
+        for(int i=0; i < 9; ++i){
+            if(pose[i+3] != (float)R[i]){ pose[i+3] = (float)R[i]; changed = true; }
+        }
+        if(changed){
+            double Rd[9], pd[3];
+            for(int i=0; i < 3; ++i){ pd[i] = pose[i]; }
+            for(int i=0; i < 9; ++i){ Rd[i] = pose[i+3]; }
+            linkColdetModels[linkIndex]->setPosition(Rd, pd);
+        }
+        return changed;
+    }
+
   private:
     void addLinkPrimitiveInfo(ColdetModelPtr& coldetModel, 
                               const double *R, const double *p,
@@ -64,7 +105,11 @@ public:
     void addLinkVerticesAndTriangles
         (ColdetModelPtr& coldetModel, const TransformedShapeIndex& tsi, const Matrix44& Tparent, ShapeInfoSequence_var& shapes, int& vertexIndex, int& triangleIndex);
     
+    void initLinkPoses();
+    
     vector<ColdetModelPtr> linkColdetModels;
+    // p[3] and R[9] of each link which have been set to the ColdetModel
+    vector<float> linkPoses;
     map<string, ColdetModelPtr> linkNameToColdetModelMap;
     string name_;
 };
@@ -61,6 +61,11 @@ void CollisionDetector_impl::registerCharacter(const char* name,	BodyInfo_ptr bo
     //} else {
         coldetBody = new ColdetBody(bodyInfo);
         coldetBody->setName(name);
+        if(convexHullSetting.isEnabled){
+            int n = coldetBody->buildConvexHulls(
+                convexHullSetting.linkNames, convexHullSetting.decomposition, convexHullSetting.cacheDirectory);
+            cout << n << " links of " << name << " use the convex hulls" << endl;
+        }
       //  bodyInfoToColdetBodyMap.insert(it, make_pair(bodyInfoId, coldetBody));
     //}
 
@@ -70,13 +75,48 @@ void CollisionDetector_impl::registerCharacter(const char* name,	BodyInfo_ptr bo
         cout << "The model of the name " << name;
         cout << " has already been registered. It is replaced." << endl;
         nameToColdetBodyMap[name] = coldetBody;
+        coldetBodies[nameToHandleMap[name]] = coldetBody;
     } else {
         nameToColdetBodyMap.insert(it, make_pair(name, coldetBody));
+        nameToHandleMap[name] = coldetBodies.size();
+        coldetBodies.push_back(coldetBody);
         cout << " is ok !" << endl;
     }
 }
 
 
+CORBA::Long CollisionDetector_impl::getCharacterHandle(const char* name)
+{
+    map<string, int>::iterator it = nameToHandleMap.find(name);
+    if(it == nameToHandleMap.end()){
+        cout << "CollisionDetector::getCharacterHandle : Body ";
+        cout << name << " is not found." << endl;
+        return -1;
+    }
+    return it->second;
+}
+
+
+void CollisionDetector_impl::updateLinkPositions
+(const LongSequence& linkIds, const FloatSequence& positions)
+{
+    const int numLinks = linkIds.length() / 2;
+    if(positions.length() < (CORBA::ULong)(numLinks * 12)){
+        cout << "CollisionDetector::updateLinkPositions : ";
+        cout << "the length of positions is too short." << endl;
+        return;
+    }
+    
+    for(int i=0; i < numLinks; ++i){
+        const CORBA::Long handle = linkIds[i*2];
+        if(handle >= 0 && handle < (CORBA::Long)coldetBodies.size()){
+            const CORBA::Float* pose = &positions[i*12];
+            coldetBodies[handle]->setLinkPosition(linkIds[i*2+1], pose + 3, pose);
+        }
+    }
+}
+
+
 void CollisionDetector_impl::addCollisionPair
 (const LinkPair& linkPair)
 {
@@ -454,6 +494,7 @@ CollisionDetectorFactory_impl::~CollisionDetectorFactory_impl()
 CollisionDetector_ptr CollisionDetectorFactory_impl::create()
 {
     CollisionDetector_impl* collisionDetector = new CollisionDetector_impl(orb);
+    collisionDetector->setConvexHullSetting(convexHullSetting);
     PortableServer::ServantBase_var collisionDetectorrServant = collisionDetector;
     PortableServer::POA_var poa = _default_POA();
     PortableServer::ObjectId_var id = poa->activate_object(collisionDetector);
@@ -29,6 +29,21 @@ using namespace std;
 using namespace OpenHRP;
 
 
+/**
+   The links of the registered bodies whose meshes are approximated by convex hulls
+*/
+struct ConvexHullSetting
+{
+    ConvexHullSetting() : isEnabled(false) { }
+    bool isEnabled;
+    /// the names of the links, or empty for all the links
+    vector<string> linkNames;
+    ConvexDecomposition decomposition;
+    /// an existing directory where the hulls are cached, or empty for no cache
+    string cacheDirectory;
+};
+
+
 class CollisionDetector_impl : virtual public POA_OpenHRP::CollisionDetector,
                                virtual public PortableServer::RefCountServantBase
 {
@@ -38,12 +53,17 @@ public:
 
     ~CollisionDetector_impl();
 
+    void setConvexHullSetting(const ConvexHullSetting& setting) { convexHullSetting = setting; }
+
     virtual void destroy();
 
     virtual void registerCharacter(const char* name,	BodyInfo_ptr bodyInfo);
 
     virtual void addCollisionPair(const LinkPair& colPair);
 
+    virtual CORBA::Long getCharacterHandle(const char* name);
+
+    virtual void updateLinkPositions(const LongSequence& linkIds, const FloatSequence& positions);
 
     virtual CORBA::Boolean queryIntersectionForDefinedPairs(
         CORBA::Boolean checkAll,
@@ -92,6 +112,8 @@ public:
 private:
 
     CORBA_ORB_var orb;
+
+    ConvexHullSetting convexHullSetting;
         
     typedef map<string, ColdetBodyPtr> StringToColdetBodyMap;
 
@@ -100,6 +122,10 @@ private:
 
     StringToColdetBodyMap nameToColdetBodyMap;
 
+    // registered bodies indexed by the handles given by getCharacterHandle()
+    vector<ColdetBodyPtr> coldetBodies;
+    map<string, int> nameToHandleMap;
+
     class ColdetModelPairEx : public ColdetModelPair
     {
     public:
@@ -146,8 +172,12 @@ public:
 
     void shutdown();
 
+    /// the setting is applied to the collision detectors created after this call
+    void setConvexHullSetting(const ConvexHullSetting& setting) { convexHullSetting = setting; }
+
 private:
     CORBA_ORB_var orb;
+    ConvexHullSetting convexHullSetting;
 };
 
 #endif
@@ -22,9 +22,56 @@
 #endif /* _WIN32 */
 
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 using namespace std;
 
+
+namespace {
+
+    /**
+       reads the options of the convex hulls.
+       --convex-hulls takes the comma separated names of the links or "all".
+    */
+    ConvexHullSetting readConvexHullOptions(int argc, char* argv[])
+    {
+        ConvexHullSetting setting;
+        const char* cacheDirectory = getenv("OPENHRP_CONVEX_HULL_CACHE_DIR");
+        for(int i=1; i < argc - 1; ++i){
+            if(strcmp(argv[i], "--convex-hulls") == 0){
+                setting.isEnabled = true;
+                setting.linkNames.clear();
+                string names(argv[i+1]);
+                if(names != "all"){
+                    string::size_type pos = 0;
+                    while(pos <= names.size()){
+                        string::size_type end = names.find(',', pos);
+                        if(end == string::npos){
+                            end = names.size();
+                        }
+                        if(end > pos){
+                            setting.linkNames.push_back(names.substr(pos, end - pos));
+                        }
+                        pos = end + 1;
+                    }
+                }
+            } else if(strcmp(argv[i], "--convex-hull-cache-dir") == 0){
+                cacheDirectory = argv[i+1];
+            } else if(strcmp(argv[i], "--max-convex-hulls") == 0){
+                setting.decomposition.setMaxNumHulls(atoi(argv[i+1]));
+            } else if(strcmp(argv[i], "--max-convex-hull-concavity") == 0){
+                setting.decomposition.setMaxConcavity(atof(argv[i+1]));
+            }
+        }
+        if(cacheDirectory){
+            setting.cacheDirectory = cacheDirectory;
+        }
+        return setting;
+    }
+}
+
+
 /**
  * サーバスタートアップ //
  *
@@ -73,6 +120,8 @@ int main(int argc, char* argv[]) {
 
     CORBA_Object_var cdFactory;
     CollisionDetectorFactory_impl* cdFactoryImpl = new CollisionDetectorFactory_impl(orb);
+    // the ORB options have been removed from argv by ORB_init()
+    cdFactoryImpl->setConvexHullSetting(readConvexHullOptions(argc, argv));
     cdFactory = cdFactoryImpl -> _this();
     CosNaming_Name nc;
     nc.length(1);
@@ -54,6 +54,7 @@ BridgeConf::BridgeConf(int argc, char* argv[]) :
   commandLineOptions("Allowed options")
 {
   isReady_ = false;
+  isConcurrentTickMode_ = false;
   initOptionsDescription();
   initLabelToDataTypeMap();
 
@@ -102,7 +103,12 @@ void BridgeConf::initOptionsDescription()
 
     ("periodic-rate",
      program_options::value<vector<string> >(), 
-     "Periodic rate of execution context (INSTANCE_NAME:TIME_RATE[<=1.0])");
+     "Periodic rate of execution context (INSTANCE_NAME:TIME_RATE[<=1.0])")
+
+    ("concurrent-tick",
+     program_options::value<bool>()->default_value(false),
+     "Tick the execution contexts of the controller RTCs concurrently. "
+     "Enable this only when the RTCs do not exchange data with each other in a step");
 
   commandLineOptions.add(options).add_options()
 
@@ -218,6 +224,8 @@ void BridgeConf::parseOptions()
       addTimeRateInfo(values[i]);
     }
   }
+
+  isConcurrentTickMode_ = vmap["concurrent-tick"].as<bool>();
 }
 
 
@@ -100,6 +100,7 @@ public:
     const char* getOpenHRPNameServerIdentifier();
     const char* getControllerName();
     const char* getVirtualRobotRtcTypeName();
+    bool isConcurrentTickMode() { return isConcurrentTickMode_; }
 
     void setupModules();
 
@@ -123,6 +124,7 @@ private:
       
     bool isReady_;
     bool isProcessingConfigFile;
+    bool isConcurrentTickMode_;
       
     std::string virtualRobotRtcTypeName;
     std::string controllerName;
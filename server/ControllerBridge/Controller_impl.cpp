@@ -16,11 +16,13 @@
 
 #include <string>
 #include <iostream>
+#include <memory>
 #include <rtm/Manager.h>
 #include <rtm/RTObject.h>
 #include <rtm/NVUtil.h>
 
 #include <hrpCorba/ORBwrap.h>
+#include <omnithread.h>
 
 #include "VirtualRobotRTC.h"
 
@@ -32,11 +34,103 @@ namespace {
 }
 
 
+/**
+   A thread which ticks the execution context of an RTC when it is requested.
+   This is used for ticking the RTCs concurrently so that the latency of a control step
+   becomes that of the slowest RTC instead of the sum of all the RTCs.
+*/
+class Controller_impl::TickThread : public omni_thread
+{
+public:
+    TickThread(ExtTrigExecutionContextService_Var_Type execContext)
+        : execContext(execContext),
+          condition(&mutex),
+          isTickRequested(false),
+          isExiting(false),
+          exception(0) {
+        start_undetached();
+    }
+
+    void requestTick() {
+        omni_mutex_lock lock(mutex);
+        isTickRequested = true;
+        condition.broadcast();
+    }
+
+    /**
+       @return the exception thrown by the tick, which must be deleted by the caller,
+       or null if the tick succeeded
+    */
+    CORBA::Exception* waitTick() {
+        omni_mutex_lock lock(mutex);
+        while(isTickRequested){
+            condition.wait();
+        }
+        CORBA::Exception* ex = exception;
+        exception = 0;
+        return ex;
+    }
+
+    /**
+       The object is deleted by this function.
+    */
+    void exit() {
+        mutex.lock();
+        isExiting = true;
+        condition.broadcast();
+        mutex.unlock();
+        join(0);
+    }
+
+protected:
+    virtual void* run_undetached(void* arg) {
+        mutex.lock();
+        while(true){
+            while(!isTickRequested && !isExiting){
+                condition.wait();
+            }
+            if(isExiting){
+                break;
+            }
+            mutex.unlock();
+            // the exception is rethrown by the thread which waits for the tick
+            CORBA::Exception* ex = 0;
+            try {
+                execContext->tick();
+            } catch(CORBA_SystemException& e){
+                ex = e._NP_duplicate();
+            } catch(...){
+                ex = new CORBA::UNKNOWN();
+            }
+            mutex.lock();
+            exception = ex;
+            isTickRequested = false;
+            condition.broadcast();
+        }
+        mutex.unlock();
+        return 0;
+    }
+
+private:
+    virtual ~TickThread() {
+        delete exception;
+    }
+
+    ExtTrigExecutionContextService_Var_Type execContext;
+    omni_mutex mutex;
+    omni_condition condition;
+    bool isTickRequested;
+    bool isExiting;
+    CORBA::Exception* exception;
+};
+
+
 Controller_impl::Controller_impl(RTC::Manager* rtcManager, BridgeConf* bridgeConf)
     :   rtcManager(rtcManager),
         bridgeConf(bridgeConf),
         modelName(""),
-        bRestart(false)
+        bRestart(false),
+        isConcurrentTickMode(bridgeConf->isConcurrentTickMode())
 {
     if(CONTROLLER_BRIDGE_DEBUG){
         cout << "Controller_impl::Controller_impl" << endl;
@@ -53,6 +147,8 @@ Controller_impl::~Controller_impl()
     if(CONTROLLER_BRIDGE_DEBUG){
         cout << "Controller_impl::~Controller_impl" << endl;
     }
+    exitTickThreads();
+
     delete naming;
 
     virtualRobotRTC->isOwnedByController = false;
@@ -172,6 +268,7 @@ Controller_impl::RtcInfoPtr Controller_impl::addRtcVectorWithConnection(RTC::RTO
 
     RtcInfoPtr rtcInfo(new RtcInfo());
     rtcInfo->rtcRef = new_rtcRef;
+    rtcInfo->tickThread = 0;
     makePortMap(rtcInfo);
     string rtcName = (string)rtcInfo->rtcRef->get_component_profile()->instance_name;
 
@@ -477,18 +574,69 @@ void Controller_impl::control()
         if(!CORBA::is_nil(rtcInfo->execContext)){
            	rtcInfo->timeRateCounter += rtcInfo->timeRate;
             if(rtcInfo->timeRateCounter + rtcInfo->timeRate/2.0 > 1.0){
-                rtcInfo->execContext->tick();
+                if(isConcurrentTickMode){
+                    requestTick(rtcInfo);
+                } else {
+                    rtcInfo->execContext->tick();
+                }
                 rtcInfo->timeRateCounter -= 1.0;
             }
         }
     }
 
+    if(isConcurrentTickMode){
+        waitTicks();
+    }
+
     virtualRobotRTC->readDataFromInPorts(this);
 
   controlTime += timeStep;
 }
 
 
+void Controller_impl::requestTick(RtcInfoPtr& rtcInfo)
+{
+    if(!rtcInfo->tickThread){
+        rtcInfo->tickThread = new TickThread(rtcInfo->execContext);
+    }
+    rtcInfo->tickThread->requestTick();
+}
+
+
+/**
+   The first exception thrown by the ticks is rethrown after all the ticks finish
+   as the sequential ticks in control() do.
+*/
+void Controller_impl::waitTicks()
+{
+    std::auto_ptr<CORBA::Exception> exception;
+    for(RtcInfoVector::iterator p = rtcInfoVector.begin(); p != rtcInfoVector.end(); ++p){
+        RtcInfoPtr& rtcInfo = *p;
+        if(rtcInfo->tickThread){
+            std::auto_ptr<CORBA::Exception> ex(rtcInfo->tickThread->waitTick());
+            if(!exception.get()){
+                exception = ex;
+            }
+        }
+    }
+    if(exception.get()){
+        exception->_raise();
+    }
+}
+
+
+void Controller_impl::exitTickThreads()
+{
+    for(RtcInfoVector::iterator p = rtcInfoVector.begin(); p != rtcInfoVector.end(); ++p){
+        RtcInfoPtr& rtcInfo = *p;
+        if(rtcInfo->tickThread){
+            rtcInfo->tickThread->exit();
+            rtcInfo->tickThread = 0;
+        }
+    }
+}
+
+
 void Controller_impl::stop()
 {
     deactiveComponents();
@@ -85,6 +85,8 @@ private:
 
 	typedef std::map<std::string, Port_Service_Var_Type> PortMap;
 
+	class TickThread;
+
 	struct RtcInfo
 	{
 		RTC::RTObject_var rtcRef;
@@ -92,6 +94,8 @@ private:
 		ExtTrigExecutionContextService_Var_Type execContext;
 		double timeRate;
 		double timeRateCounter;
+		/// used in the concurrent tick mode. created when the first tick is requested.
+		TickThread* tickThread;
 	};
 	typedef boost::shared_ptr<RtcInfo> RtcInfoPtr;
 
@@ -131,6 +135,11 @@ private:
     double timeStep;
     bool bRestart;
     void restart();
+
+    bool isConcurrentTickMode;
+    void requestTick(RtcInfoPtr& rtcInfo);
+    void waitTicks();
+    void exitTickThreads();
 };
 
 #endif
@@ -3352,6 +3352,9 @@ void BodyInfoCollada_impl::setParam(std::string param, int value)
     if(param == "AABBType") {
         AABBdataType_ = (OpenHRP::ModelLoader::AABBdataType)value;
     }
+    else if(param == "maxTextureSize") {
+        maxTextureSize = value;
+    }
 }
 
 void BodyInfoCollada_impl::setColdetModel(ColdetModelPtr& coldetModel, TransformedShapeIndexSequence shapeIndices, const Matrix44& Tparent, int& vertexIndex, int& triangleIndex){
@@ -3399,6 +3402,11 @@ void BodyInfoCollada_impl::changetoBoundingBox(unsigned int* inputData){
     createAppearanceInfo();
     std::vector<Vector3> boxSizeMap;
     std::vector<Vector3> boundingBoxData;
+
+    // the shapes are overwritten by the boxes
+    for(int i=0; i<links_.length(); i++){
+        links_[i].collisionShapeIndices.length(0);
+    }
     
     for(int i=0; i<links_.length(); i++){
         int _depth;
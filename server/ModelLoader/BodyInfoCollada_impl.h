@@ -50,6 +50,7 @@ class BodyInfoCollada_impl :
 	virtual ExtraJointInfoSequence* extraJoints();
 
     void loadModelFile(const std::string& filename);
+    void simplifyCollisionMeshes(const MeshSimplifier& simplifier) { setCollisionShapes(links_, simplifier); }
     void setLastUpdateTime(time_t time) { lastUpdate_ = time;};
     time_t getLastUpdateTime() { return lastUpdate_; }
     bool checkInlineFileUpdateTime();
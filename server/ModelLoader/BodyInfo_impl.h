@@ -19,6 +19,7 @@
 #include <hrpCorba/ORBwrap.h>
 #include <hrpCorba/ModelLoader.hh>
 #include <hrpModel/ModelNodeSet.h>
+#include <hrpModel/LinkInfoBuilder.h>
 #include <hrpCollision/ColdetModel.h>
 
 #include "ShapeSetInfo_impl.h"
@@ -28,7 +29,8 @@ using namespace hrp;
 
 class BodyInfo_impl :
     public virtual POA_OpenHRP::BodyInfo,
-    public virtual ShapeSetInfo_impl
+    public virtual ShapeSetInfo_impl,
+    protected LinkInfoBuilder
 {
   public:
 		
@@ -43,6 +45,9 @@ class BodyInfo_impl :
 	virtual ExtraJointInfoSequence* extraJoints();
 
     void loadModelFile(const std::string& filename);
+    void loadBinaryModelFile(const std::string& filename, const std::string& url = std::string());
+    void loadBinaryModelData(BinaryModelData& data, const std::string& url = std::string());
+    void simplifyCollisionMeshes(const MeshSimplifier& simplifier) { setCollisionShapes(links_, simplifier); }
 
     void setLastUpdateTime(time_t time) { lastUpdate_ = time;};
     time_t getLastUpdateTime() { return lastUpdate_; }
@@ -57,6 +62,8 @@ class BodyInfo_impl :
 protected:
 
     virtual const std::string& topUrl();
+    virtual void readShapeNodes(VrmlNode* node, const Matrix44& T, TransformedShapeIndexSequence& io_shapeIndices,
+                                DblArray12Sequence& io_inlinedShapeTransformMatrices);
 
 private:
         
@@ -70,20 +77,13 @@ private:
     LinkInfoSequence links_;
     AllLinkShapeIndexSequence linkShapeIndices_;
     AllLinkShapeIndexSequence originlinkShapeIndices_;
+    // collisionShapeIndices of the links before they are replaced by the bounding boxes
+    AllLinkShapeIndexSequence originCollisionShapeIndices_;
 	ExtraJointInfoSequence extraJoints_;
 
     std::vector<ColdetModelPtr> linkColdetModels;
 
-    int readJointNodeSet(JointNodeSetPtr jointNodeSet, int& currentIndex, int motherIndex);
-    void setJointParameters(int linkInfoIndex, VrmlProtoInstancePtr jointNode );
-    void setSegmentParameters(int linkInfoIndex, JointNodeSetPtr jointNodeSet);
-    void setSensors(int linkInfoIndex, JointNodeSetPtr jointNodeSet);
-    void setHwcs(int linkInfoIndex, JointNodeSetPtr jointNodeSet);
-    void setLights(int linkInfoIndex, JointNodeSetPtr jointNodeSet);
-    void readSensorNode(int linkInfoIndex, SensorInfo& sensorInfo, VrmlProtoInstancePtr sensorNode);
-    void readHwcNode(int linkInfoIndex, HwcInfo& hwcInfo, VrmlProtoInstancePtr hwcNode);
-    void readLightNode(int linkInfoIndex, LightInfo& LightInfo, 
-                       std::pair<Matrix44, VrmlNodePtr> &transformedLight);
+    void createLinkColdetModels();
 };
 
 #endif
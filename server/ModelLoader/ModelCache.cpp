@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ModelCache.cpp
+*/
+
+#include "ModelCache.h"
+#include "BodyInfo_impl.h"
+#include "SceneInfo_impl.h"
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <hrpUtil/UrlUtil.h>
+#include <hrpModel/BinaryModelFile.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace hrp;
+
+namespace {
+
+    const char* const entryMagic = "HRPMODELCACHE 2";
+
+    // FNV-1a, which gives the same value on every platform
+    boost::uint64_t hashString(const std::string& s)
+    {
+        boost::uint64_t h = 14695981039346656037ULL;
+        for(size_t i=0; i < s.size(); ++i){
+            h ^= static_cast<unsigned char>(s[i]);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    /**
+       A file is written to a temporary file and renamed so that another process
+       sharing the cache directory does not read a file being written.
+    */
+    string temporaryFilename(const std::string& path)
+    {
+        ostringstream os;
+        os << path << ".tmp" << getpid();
+        return os.str();
+    }
+
+    bool commitFile(const std::string& tmpPath, const std::string& path)
+    {
+        try {
+            boost::filesystem::rename(tmpPath, path);
+        } catch(const boost::filesystem::filesystem_error&){
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+
+void ModelCache::setDirectory(const std::string& directory)
+{
+    directory_ = directory;
+
+    if(!directory_.empty()){
+        try {
+            boost::filesystem::create_directories(directory_);
+        } catch(const boost::filesystem::filesystem_error& ex){
+            cout << "The model cache is disabled: " << ex.what() << endl;
+            directory_.clear();
+            return;
+        }
+        cout << "model cache: " << directory_ << endl;
+    }
+}
+
+
+bool ModelCache::isCacheable(const std::string& url, time_t mtime)
+{
+    // a remote file or a binary model file is not cached
+    return isEnabled() && mtime != 0 && !isBinaryModelFile(deleteURLScheme(url));
+}
+
+
+std::string ModelCache::entryPath(const std::string& key)
+{
+    ostringstream os;
+    os << hex;
+    os.width(16);
+    os.fill('0');
+    os << hashString(key);
+    return (boost::filesystem::path(directory_) / os.str()).string();
+}
+
+
+bool ModelCache::readEntry(const std::string& path, const std::string& key, time_t mtime,
+                           BinaryModelData& out_data, FileTimeMap& out_fileTimes)
+{
+    string binaryPath = path + ".hrpb";
+    if(!boost::filesystem::exists(binaryPath) || !readBinaryModelFile(binaryPath, out_data)){
+        return false;
+    }
+
+    istringstream is(out_data.userData);
+    string line;
+    if(!getline(is, line) || line != entryMagic){
+        return false;
+    }
+    // the key is compared in case the hash values collide
+    if(!getline(is, line) || line != "key " + key){
+        return false;
+    }
+    long long storedTime;
+    if(!getline(is, line) || sscanf(line.c_str(), "mtime %lld", &storedTime) != 1 || storedTime != mtime){
+        return false;
+    }
+    out_fileTimes.clear();
+    while(getline(is, line)){
+        long long inlineTime;
+        int pos = 0;
+        if(sscanf(line.c_str(), "inline %lld %n", &inlineTime, &pos) != 1 || pos == 0){
+            return false;
+        }
+        out_fileTimes.insert(make_pair(line.substr(pos), static_cast<time_t>(inlineTime)));
+    }
+
+    return ShapeSetInfo_impl::checkFileUpdateTime(out_fileTimes);
+}
+
+
+void ModelCache::writeEntry
+(const std::string& path, const std::string& key, time_t mtime, const FileTimeMap& fileTimes, BinaryModelData& data)
+{
+    // the validity of the entry is stored in the binary file so that the entry is committed by a single rename
+    ostringstream os;
+    os << entryMagic << "\n";
+    os << "key " << key << "\n";
+    os << "mtime " << static_cast<long long>(mtime) << "\n";
+    for(FileTimeMap::const_iterator p = fileTimes.begin(); p != fileTimes.end(); ++p){
+        os << "inline " << static_cast<long long>(p->second) << " " << p->first << "\n";
+    }
+    data.userData = os.str();
+
+    string binaryPath = path + ".hrpb";
+    string tmpPath = temporaryFilename(binaryPath);
+    if(!writeBinaryModelFile(tmpPath, data)){
+        std::remove(tmpPath.c_str());
+        return;
+    }
+    commitFile(tmpPath, binaryPath);
+}
+
+
+/**
+   The options which change the loaded data are a part of the key
+*/
+std::string ModelCache::bodyKey(const std::string& url, const OpenHRP::ModelLoader::ModelLoadOption& option)
+{
+    ostringstream os;
+    os << "body ";
+    if(option.readImage){
+        os << "readImage " << option.maxTextureSize << " ";
+    }
+    if(option.simplifyCollisionMesh){
+        os << "collisionMesh " << option.collisionWeldDistance << " "
+           << option.maxCollisionTriangles << " " << option.maxCollisionError << " ";
+    }
+    os << url;
+    return os.str();
+}
+
+
+bool ModelCache::load(const std::string& url, const OpenHRP::ModelLoader::ModelLoadOption& option, time_t mtime, BodyInfo_impl* bodyInfo)
+{
+    if(!isCacheable(url, mtime)){
+        return false;
+    }
+    string key = bodyKey(url, option);
+    string path = entryPath(key);
+    BinaryModelData data;
+    FileTimeMap fileTimes;
+    if(!readEntry(path, key, mtime, data, fileTimes)){
+        return false;
+    }
+    try {
+        bodyInfo->loadBinaryModelData(data);
+    } catch(OpenHRP::ModelLoader::ModelLoaderException& ex){
+        return false;
+    }
+    bodyInfo->setInlineFileTimes(fileTimes);
+
+    cout << "loaded from the model cache " << path << ".hrpb" << endl;
+    return true;
+}
+
+
+void ModelCache::save(const std::string& url, const OpenHRP::ModelLoader::ModelLoadOption& option, time_t mtime, BodyInfo_impl* bodyInfo)
+{
+    if(!isCacheable(url, mtime)){
+        return;
+    }
+    string key = bodyKey(url, option);
+
+    BinaryModelData data;
+    CORBA::String_var name = bodyInfo->name();
+    CORBA::String_var url2 = bodyInfo->url();
+    data.name = name.in();
+    data.url = url2.in();
+    data.info = bodyInfo->info();
+    data.links = bodyInfo->links();
+    data.linkShapeIndices = bodyInfo->linkShapeIndices();
+    data.extraJoints = bodyInfo->extraJoints();
+    data.shapes = bodyInfo->shapes();
+    data.appearances = bodyInfo->appearances();
+    data.materials = bodyInfo->materials();
+    data.textures = bodyInfo->textures();
+
+    writeEntry(entryPath(key), key, mtime, bodyInfo->inlineFileTimes(), data);
+}
+
+
+bool ModelCache::load(const std::string& url, time_t mtime, SceneInfo_impl* sceneInfo)
+{
+    if(!isCacheable(url, mtime)){
+        return false;
+    }
+    string key = "scene " + url;
+    string path = entryPath(key);
+    BinaryModelData data;
+    FileTimeMap fileTimes;
+    if(!readEntry(path, key, mtime, data, fileTimes)){
+        return false;
+    }
+    try {
+        sceneInfo->loadBinaryModelData(data);
+    } catch(OpenHRP::ModelLoader::ModelLoaderException& ex){
+        return false;
+    }
+    sceneInfo->setInlineFileTimes(fileTimes);
+
+    cout << "loaded from the model cache " << path << ".hrpb" << endl;
+    return true;
+}
+
+
+void ModelCache::save(const std::string& url, time_t mtime, SceneInfo_impl* sceneInfo)
+{
+    if(!isCacheable(url, mtime)){
+        return;
+    }
+    string key = "scene " + url;
+
+    BinaryModelData data;
+    CORBA::String_var url2 = sceneInfo->url();
+    data.url = url2.in();
+    data.info = new OpenHRP::StringSequence();
+    data.links = new OpenHRP::LinkInfoSequence();
+    data.linkShapeIndices = new OpenHRP::AllLinkShapeIndexSequence();
+    data.extraJoints = new OpenHRP::ExtraJointInfoSequence();
+    data.shapes = sceneInfo->shapes();
+    data.appearances = sceneInfo->appearances();
+    data.materials = sceneInfo->materials();
+    data.textures = sceneInfo->textures();
+    data.isScene = true;
+    data.sceneShapeIndices = sceneInfo->shapeIndices();
+
+    writeEntry(entryPath(key), key, mtime, sceneInfo->inlineFileTimes(), data);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ModelCache.h
+  @brief On-disk cache of the loaded models which is kept across the restarts of the model loader
+
+  Each entry is a binary model file (see hrpModel/BinaryModelFile.h) whose user data has the key
+  of the entry, the modification time of the model file and those of the inline files.
+  An entry is used only when all the modification times are the same as the current ones.
+*/
+
+#ifndef OPENHRP_MODEL_LOADER_MODEL_CACHE_H_INCLUDED
+#define OPENHRP_MODEL_LOADER_MODEL_CACHE_H_INCLUDED
+
+#include <string>
+#include <map>
+#include <ctime>
+#include <hrpCorba/ORBwrap.h>
+#include <hrpCorba/ModelLoader.hh>
+
+namespace hrp {
+    struct BinaryModelData;
+}
+
+class BodyInfo_impl;
+class SceneInfo_impl;
+
+class ModelCache
+{
+public:
+    /// The cache is disabled if the directory is empty
+    void setDirectory(const std::string& directory);
+    bool isEnabled() const { return !directory_.empty(); }
+
+    /**
+       @param mtime the current modification time of the model file
+       @return true if a valid entry is found and loaded into bodyInfo
+    */
+    bool load(const std::string& url, const OpenHRP::ModelLoader::ModelLoadOption& option, time_t mtime, BodyInfo_impl* bodyInfo);
+
+    /**
+       @param mtime the modification time of the model file when it was loaded
+    */
+    void save(const std::string& url, const OpenHRP::ModelLoader::ModelLoadOption& option, time_t mtime, BodyInfo_impl* bodyInfo);
+
+    bool load(const std::string& url, time_t mtime, SceneInfo_impl* sceneInfo);
+    void save(const std::string& url, time_t mtime, SceneInfo_impl* sceneInfo);
+
+    /// the key of a body, which includes the options that change the loaded data
+    static std::string bodyKey(const std::string& url, const OpenHRP::ModelLoader::ModelLoadOption& option);
+
+private:
+    typedef std::map<std::string, time_t> FileTimeMap;
+
+    std::string directory_;
+
+    bool isCacheable(const std::string& url, time_t mtime);
+    std::string entryPath(const std::string& key);
+    bool readEntry(const std::string& path, const std::string& key, time_t mtime,
+                   hrp::BinaryModelData& out_data, FileTimeMap& out_fileTimes);
+    void writeEntry(const std::string& path, const std::string& key, time_t mtime,
+                    const FileTimeMap& fileTimes, hrp::BinaryModelData& data);
+};
+
+#endif
@@ -45,6 +45,15 @@ static bool IsColladaFile(const std::string& filename)
 
 #endif
 
+static hrp::MeshSimplifier createMeshSimplifier(const OpenHRP::ModelLoader::ModelLoadOption& option)
+{
+    hrp::MeshSimplifier simplifier;
+    simplifier.setWeldDistance(option.collisionWeldDistance);
+    simplifier.setMaxNumTriangles(option.maxCollisionTriangles);
+    simplifier.setMaxError(option.maxCollisionError);
+    return simplifier;
+}
+
 ModelLoader_impl::ModelLoader_impl(CORBA::ORB_ptr orb, PortableServer::POA_ptr poa)
     :
     orb(CORBA::ORB::_duplicate(orb)),
@@ -185,6 +194,11 @@ BodyInfo_ptr ModelLoader_impl::loadBodyInfo(const char* url)
     option.readImage = false;
     option.AABBdata.length(0);
     option.AABBtype = OpenHRP::ModelLoader::AABB_NUM;
+    option.simplifyCollisionMesh = false;
+    option.collisionWeldDistance = 0.0;
+    option.maxCollisionTriangles = 0;
+    option.maxCollisionError = 0.0;
+    option.maxTextureSize = 0;
     POA_OpenHRP::BodyInfo* bodyInfo = loadBodyInfoFromModelFile(url, option);
     return bodyInfo->_this();
 }
@@ -220,7 +234,7 @@ BodyInfo_ptr ModelLoader_impl::getBodyInfoEx(const char* url0, const OpenHRP::Mo
         mtime = statbuff.st_mtime;
     }
 
-    UrlToBodyInfoMap::iterator p = urlToBodyInfoMap.find(url);
+    UrlToBodyInfoMap::iterator p = urlToBodyInfoMap.find(ModelCache::bodyKey(url, option));
     if(p != urlToBodyInfoMap.end() && mtime == getLastUpdateTime(p->second) && checkInlineFileUpdateTime(p->second)){
         bodyInfo = p->second->_this();
         cout << string("cache found for ") + url << endl;
@@ -245,6 +259,11 @@ BodyInfo_ptr ModelLoader_impl::getBodyInfo(const char* url)
     option.readImage = false;
     option.AABBdata.length(0);
     option.AABBtype = OpenHRP::ModelLoader::AABB_NUM;
+    option.simplifyCollisionMesh = false;
+    option.collisionWeldDistance = 0.0;
+    option.maxCollisionTriangles = 0;
+    option.maxCollisionError = 0.0;
+    option.maxTextureSize = 0;
     return getBodyInfoEx(url, option);
 }
 
@@ -252,12 +271,26 @@ POA_OpenHRP::BodyInfo* ModelLoader_impl::loadBodyInfoFromModelFile(const string
 {
     cout << "loading " << url << endl;
     POA_OpenHRP::BodyInfo* bodyInfo;
+
+    string filename(deleteURLScheme(url));
+    struct stat statbuff;
+    time_t mtime = 0;
+
+    // get a file modification time
+    if( stat( filename.c_str(), &statbuff ) == 0 ){
+        mtime = statbuff.st_mtime;
+    }
+
     try {
 #ifdef OPENHRP_COLLADA_FOUND
         if( IsColladaFile(url) ) {
             BodyInfoCollada_impl* p = new BodyInfoCollada_impl(poa);
             p->setParam("readImage", option.readImage);
+            p->setParam("maxTextureSize", (int)option.maxTextureSize);
             p->loadModelFile(url);
+            if(option.simplifyCollisionMesh){
+                p->simplifyCollisionMeshes(createMeshSimplifier(option));
+            }
             bodyInfo = p;
         }
         else
@@ -265,7 +298,14 @@ POA_OpenHRP::BodyInfo* ModelLoader_impl::loadBodyInfoFromModelFile(const string
         {
             BodyInfo_impl* p = new BodyInfo_impl(poa);
             p->setParam("readImage", option.readImage);
-            p->loadModelFile(url);
+            p->setParam("maxTextureSize", (int)option.maxTextureSize);
+            if(!modelCache.load(url, option, mtime, p)){
+                p->loadModelFile(url);
+                if(option.simplifyCollisionMesh){
+                    p->simplifyCollisionMeshes(createMeshSimplifier(option));
+                }
+                modelCache.save(url, option, mtime, p);
+            }
             bodyInfo = p;
         }
     }
@@ -286,16 +326,8 @@ POA_OpenHRP::BodyInfo* ModelLoader_impl::loadBodyInfoFromModelFile(const string
 #endif
 
     //poa->activate_object(bodyInfo);
-    urlToBodyInfoMap[url] = bodyInfo;
-
-    string filename(deleteURLScheme(url));
-    struct stat statbuff;
-    time_t mtime = 0;
+    urlToBodyInfoMap[ModelCache::bodyKey(url, option)] = bodyInfo;
 
-    // get a file modification time
-    if( stat( filename.c_str(), &statbuff ) == 0 ){
-        mtime = statbuff.st_mtime;
-    }
     setLastUpdateTime(bodyInfo, mtime );
 
     return bodyInfo;
@@ -319,8 +351,17 @@ SceneInfo_ptr ModelLoader_impl::loadSceneInfo(const char* url)
 	else
 #endif
 	{
+	    string filename(deleteURLScheme(url));
+	    struct stat statbuff;
+	    time_t mtime = 0;
+	    if( stat( filename.c_str(), &statbuff ) == 0 ){
+	        mtime = statbuff.st_mtime;
+	    }
 	    SceneInfo_impl* p = new SceneInfo_impl(poa);
-	    p->load(url);
+	    if(!modelCache.load(url, mtime, p)){
+	        p->load(url);
+	        modelCache.save(url, mtime, p);
+	    }
 	    sceneInfo = p;
 	}
     }
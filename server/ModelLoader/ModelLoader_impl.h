@@ -23,6 +23,7 @@
 #include "BodyInfo_impl.h"
 #include "BodyInfoCollada_impl.h"
 #include "SceneInfo_impl.h"
+#include "ModelCache.h"
 
 using namespace OpenHRP;
 
@@ -32,9 +33,12 @@ class ModelLoader_impl : public POA_OpenHRP::ModelLoader
     CORBA::ORB_var orb;
     PortableServer::POA_var poa;
 		
+    /// the key is ModelCache::bodyKey() so that a body loaded with different options is not shared
     typedef std::map<std::string, POA_OpenHRP::BodyInfo*> UrlToBodyInfoMap;
     UrlToBodyInfoMap urlToBodyInfoMap;
 
+    ModelCache modelCache;
+
     POA_OpenHRP::BodyInfo* loadBodyInfoFromModelFile(const std::string url, const OpenHRP::ModelLoader::ModelLoadOption option );
 		
   public:
@@ -62,6 +66,9 @@ class ModelLoader_impl : public POA_OpenHRP::ModelLoader
     virtual void clearData();
 		
     void shutdown();
+
+    /// enables the on-disk model cache which is kept across the restarts of the model loader
+    void setCacheDirectory(const std::string& directory) { modelCache.setDirectory(directory); }
 };
 
 
@@ -76,6 +76,7 @@ void SceneInfo_impl::load(const std::string& url)
 
     try {
         VrmlParser parser;
+        parser.setParallelInlineLoadingMode(true);
         parser.load(filename);
 
         Matrix44 E(Matrix44::Identity());
@@ -90,4 +91,20 @@ void SceneInfo_impl::load(const std::string& url)
         cout << ex.getFullMessage() << endl;
 	throw ModelLoader::ModelLoaderException(ex.getFullMessage().c_str());
     }
+
+    shareArrays();
+}
+
+
+/**
+   loads the scene which was written to a binary model file by the model cache
+*/
+void SceneInfo_impl::loadBinaryModelData(BinaryModelData& data)
+{
+    if(!data.isScene){
+        throw ModelLoader::ModelLoaderException("The binary model file cannot be loaded.");
+    }
+    url_ = data.url;
+    adoptSequence(shapeIndices_, data.sceneShapeIndices.inout());
+    adoptShapeSet(data);
 }
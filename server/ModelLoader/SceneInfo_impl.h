@@ -36,6 +36,7 @@ public:
     virtual TransformedShapeIndexSequence* shapeIndices();
 
     void load(const std::string& filename);
+    void loadBinaryModelData(BinaryModelData& data);
 
 protected:
 
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ShapeDataStore.cpp
+*/
+
+#include "ShapeDataStore.h"
+
+#include <map>
+#include <cstring>
+#include <boost/cstdint.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+using namespace std;
+using namespace boost;
+using namespace OpenHRP;
+
+
+namespace {
+
+    template <class Seq, class Element> class ArrayStore
+    {
+    public:
+        ArrayStore() : numSweptEntries(0) { }
+
+        ShapeDataStore::Reference share(Seq& seq){
+
+            const CORBA::ULong length = seq.length();
+            if(length == 0){
+                return ShapeDataStore::Reference();
+            }
+            const Element* elements = seq.get_buffer();
+            const size_t numBytes = length * sizeof(Element);
+            const boost::uint64_t hash = calcHash(elements, numBytes);
+
+            mutex::scoped_lock lock(entriesMutex);
+
+            std::pair<typename EntryMap::iterator, typename EntryMap::iterator> range = entries.equal_range(hash);
+            typename EntryMap::iterator p = range.first;
+            while(p != range.second){
+                shared_ptr<Entry> entry = p->second.lock();
+                if(!entry){
+                    entries.erase(p++);
+                    continue;
+                }
+                if(entry->length == length && memcmp(entry->buffer, elements, numBytes) == 0){
+                    if(entry->buffer != elements){
+                        // the previous buffer of the sequence is freed
+                        seq.replace(length, length, entry->buffer, false);
+                    }
+                    return entry;
+                }
+                ++p;
+            }
+
+            shared_ptr<Entry> entry(new Entry());
+            entry->length = length;
+            entry->buffer = Seq::allocbuf(length);
+            std::copy(elements, elements + length, entry->buffer);
+            seq.replace(length, length, entry->buffer, false);
+            entries.insert(std::make_pair(hash, weak_ptr<Entry>(entry)));
+
+            // removes the entries of the released buffers when the map has doubled since the last sweep
+            if(entries.size() > 2 * numSweptEntries + 64){
+                sweep();
+            }
+
+            return entry;
+        }
+
+    private:
+        struct Entry
+        {
+            Entry() : buffer(0), length(0) { }
+            ~Entry() { Seq::freebuf(buffer); }
+            Element* buffer;
+            CORBA::ULong length;
+        };
+
+        typedef std::multimap<boost::uint64_t, weak_ptr<Entry> > EntryMap;
+        EntryMap entries;
+        size_t numSweptEntries;
+        mutex entriesMutex;
+
+        // FNV-1a
+        static boost::uint64_t calcHash(const void* data, size_t size){
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            boost::uint64_t h = 14695981039346656037ULL;
+            for(size_t i=0; i < size; ++i){
+                h ^= bytes[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        void sweep(){
+            typename EntryMap::iterator p = entries.begin();
+            while(p != entries.end()){
+                if(p->second.expired()){
+                    entries.erase(p++);
+                } else {
+                    ++p;
+                }
+            }
+            numSweptEntries = entries.size();
+        }
+    };
+
+    ArrayStore<FloatSequence, CORBA::Float> floatArrayStore;
+    ArrayStore<LongSequence, CORBA::Long> longArrayStore;
+    ArrayStore<OctetSequence, CORBA::Octet> octetArrayStore;
+}
+
+
+ShapeDataStore::Reference ShapeDataStore::share(FloatSequence& seq)
+{
+    return floatArrayStore.share(seq);
+}
+
+
+ShapeDataStore::Reference ShapeDataStore::share(LongSequence& seq)
+{
+    return longArrayStore.share(seq);
+}
+
+
+ShapeDataStore::Reference ShapeDataStore::share(OctetSequence& seq)
+{
+    return octetArrayStore.share(seq);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+/*!
+  @file ShapeDataStore.h
+  @brief Process-wide content-addressed store of the large arrays of the shape sets
+
+  The vertex and triangle arrays of the shapes, the normal, color and texture coordinate
+  arrays of the appearances and the decoded images of the textures are registered to the
+  store after a body or a scene is loaded. The sequences which have the same contents are
+  changed to refer to one buffer owned by the store, so loading many identical objects
+  does not increase the memory of the model loader in proportion to the number of them.
+
+  A shared sequence does not own its buffer. It must be made private by detach() before its
+  elements are modified in place.
+*/
+
+#ifndef OPENHRP_MODEL_LOADER_SHAPE_DATA_STORE_H_INCLUDED
+#define OPENHRP_MODEL_LOADER_SHAPE_DATA_STORE_H_INCLUDED
+
+#include <boost/shared_ptr.hpp>
+#include <hrpCorba/ORBwrap.h>
+#include <hrpCorba/ModelLoader.hh>
+
+class ShapeDataStore
+{
+public:
+    /**
+       A sequence refers to a shared buffer only while a reference of the buffer is held.
+       The buffer is released when the last reference is destroyed.
+    */
+    typedef boost::shared_ptr<void> Reference;
+
+    /**
+       makes the sequence refer to the shared buffer which has the same contents.
+       @return the reference of the buffer, which is null if the sequence is empty
+    */
+    static Reference share(OpenHRP::FloatSequence& seq);
+    static Reference share(OpenHRP::LongSequence& seq);
+    static Reference share(OpenHRP::OctetSequence& seq);
+
+    /// makes the sequence own a copy of the elements
+    template <class Seq> static void detach(Seq& seq) {
+        if(!seq.release()){
+            Seq copy(seq);
+            CORBA::ULong max = copy.maximum();
+            CORBA::ULong length = copy.length();
+            seq.replace(max, length, copy.get_buffer(true), true);
+        }
+    }
+};
+
+#endif
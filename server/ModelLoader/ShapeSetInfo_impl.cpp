@@ -22,7 +22,7 @@
 
 #include <hrpCorba/ViewSimulator.hh>
 #include <hrpUtil/VrmlNodes.h>
-#include <hrpUtil/ImageConverter.h>
+#include <hrpUtil/ShapeChunk.h>
 
 #include "VrmlUtil.h"
 
@@ -31,12 +31,31 @@
 using namespace std;
 using namespace boost;
 
+namespace {
+
+    bool isSameMaterial(const MaterialInfo& m1, const MaterialInfo& m2)
+    {
+        if(m1.ambientIntensity != m2.ambientIntensity || m1.shininess != m2.shininess ||
+           m1.transparency != m2.transparency){
+            return false;
+        }
+        for(int i=0; i < 3; ++i){
+            if(m1.diffuseColor[i] != m2.diffuseColor[i] || m1.emissiveColor[i] != m2.emissiveColor[i] ||
+               m1.specularColor[i] != m2.specularColor[i]){
+                return false;
+            }
+        }
+        return true;
+    }
+}
     
 
 ShapeSetInfo_impl::ShapeSetInfo_impl(PortableServer::POA_ptr poa) :
     poa(PortableServer::POA::_duplicate(poa))
 {
+    maxTextureSize = 0;
     triangleMeshShaper.setNormalGenerationMode(true);
+    triangleMeshShaper.setParallelMode(true);
     triangleMeshShaper.sigMessage.connect(boost::bind(&putMessage, _1));
 }
 
@@ -55,6 +74,10 @@ PortableServer::POA_ptr ShapeSetInfo_impl::_default_POA()
 
 void ShapeSetInfo_impl::applyTriangleMeshShaper(VrmlNodePtr node)
 {
+    // the images are decoded by the worker threads while the meshes are converted
+    if(readImage){
+        prefetchTextures(node.get(), topUrl());
+    }
     triangleMeshShaper.apply(node);
 }
 
@@ -108,6 +131,32 @@ TextureInfoSequence* ShapeSetInfo_impl::textures()
 }
 
 
+CORBA::Long ShapeSetInfo_impl::numShapes()
+{
+    return shapes_.length();
+}
+
+
+CORBA::Long ShapeSetInfo_impl::numAppearances()
+{
+    return appearances_.length();
+}
+
+
+ShapeChunk* ShapeSetInfo_impl::getShapeChunk
+(CORBA::Long firstIndex, CORBA::Long maxCount, const ShapeChunkOption& option)
+{
+    return packShapeChunk(shapes_, firstIndex, maxCount, option);
+}
+
+
+ShapeChunk* ShapeSetInfo_impl::getAppearanceChunk
+(CORBA::Long firstIndex, CORBA::Long maxCount, const ShapeChunkOption& option)
+{
+    return packAppearanceChunk(appearances_, firstIndex, maxCount, option);
+}
+
+
 /*!
   @if jp
   Shape ノード探索のための再帰関数
@@ -529,6 +578,13 @@ int ShapeSetInfo_impl::createMaterialInfo(VrmlMaterialPtr& materialNode)
             material->specularColor[j] = materialNode->specularColor[j];
         }
 
+        // 同じ内容のMaterialInfoがあればそれを共有する //
+        for(CORBA::ULong i=0; i < materials_.length(); ++i){
+            if(isSameMaterial(materials_[i], material.in())){
+                return i;
+            }
+        }
+
         // materials_に追加する //
         materialInfoIndex = materials_.length();
         materials_.length(materialInfoIndex + 1 );
@@ -563,19 +619,29 @@ int ShapeSetInfo_impl::createTextureInfo(VrmlTexturePtr& textureNode, const SFSt
             VrmlImageTexturePtr imageTextureNode = dynamic_pointer_cast<VrmlImageTexture>(textureNode);
             if(imageTextureNode){
                 string url = setTexturefileUrl(getModelFileDirPath(*currentUrl), imageTextureNode->url);
+                // the image of the same file is not decoded again
+                if(!url.empty()){
+                    for(CORBA::ULong i=0; i < textures_.length(); ++i){
+                        const TextureInfo& t = textures_[i];
+                        if(url == static_cast<const char*>(t.url) &&
+                           t.repeatS == imageTextureNode->repeatS && t.repeatT == imageTextureNode->repeatT){
+                            return i;
+                        }
+                    }
+                }
                 texture->url = CORBA::string_dup(url.c_str());
                 texture->repeatS = imageTextureNode->repeatS;
                 texture->repeatT = imageTextureNode->repeatT;
                 if(readImage && !url.empty()){
-                    ImageConverter  converter;
-                    SFImage* image = converter.convert(url);          
-                    texture->height = image->height;
-                    texture->width = image->width;
-                    texture->numComponents = image->numComponents;
-                    unsigned long pixelsLength = image->pixels.size();
+                    TextureImagePtr textureImage = TextureCache::instance()->get(url, textureFormat());
+                    const SFImage& image = textureImage->image();
+                    texture->height = image.height;
+                    texture->width = image.width;
+                    texture->numComponents = image.numComponents;
+                    unsigned long pixelsLength = image.pixels.size();
                     texture->image.length( pixelsLength );
-                    for(unsigned long j = 0 ; j < pixelsLength ; j++ ){
-                        texture->image[j] = image->pixels[j];
+                    if(pixelsLength > 0){
+                        std::copy(image.pixels.begin(), image.pixels.end(), texture->image.get_buffer());
                     }
                 }else{
                     texture->height = 0;
@@ -606,6 +672,55 @@ int ShapeSetInfo_impl::createTextureInfo(VrmlTexturePtr& textureNode, const SFSt
 }
 
 
+TextureFormat ShapeSetInfo_impl::textureFormat() const
+{
+    TextureFormat format;
+    if(maxTextureSize > 0){
+        format.maxSize = maxTextureSize;
+        format.isPowerOfTwo = true;
+    }
+    return format;
+}
+
+
+/**
+   requests the texture cache to decode the images of the ImageTexture nodes under the node.
+   The urls of the images are resolved in the same way as traverseShapeNodes().
+*/
+void ShapeSetInfo_impl::prefetchTextures(VrmlNode* node, const std::string& url, bool isInInline)
+{
+    if(node->isCategoryOf(PROTO_INSTANCE_NODE)){
+        VrmlProtoInstance* protoInstance = static_cast<VrmlProtoInstance*>(node);
+        if(protoInstance->actualNode){
+            prefetchTextures(protoInstance->actualNode.get(), url, isInInline);
+        }
+
+    } else if(node->isCategoryOf(GROUPING_NODE)){
+        VrmlGroup* groupNode = static_cast<VrmlGroup*>(node);
+        VrmlInline* inlineNode = dynamic_cast<VrmlInline*>(groupNode);
+        // only the url of the outermost inline node is used as traverseShapeNodes() does
+        const bool isOutermostInline = inlineNode && !isInInline && !inlineNode->urls.empty();
+        const std::string& childUrl = isOutermostInline ? inlineNode->urls[0] : url;
+        for(size_t i=0; i < groupNode->countChildren(); ++i){
+            prefetchTextures(groupNode->getChild(i), childUrl, isInInline || inlineNode);
+        }
+
+    } else if(node->isCategoryOf(SHAPE_NODE)){
+        VrmlShape* shapeNode = static_cast<VrmlShape*>(node);
+        if(shapeNode->appearance){
+            VrmlImageTexturePtr imageTextureNode =
+                dynamic_pointer_cast<VrmlImageTexture>(shapeNode->appearance->texture);
+            if(imageTextureNode){
+                string textureUrl = setTexturefileUrl(getModelFileDirPath(url), imageTextureNode->url);
+                if(!textureUrl.empty()){
+                    TextureCache::instance()->prefetch(textureUrl, textureFormat());
+                }
+            }
+        }
+    }
+}
+
+
 /*!
   @if jp
   @note url_のパスからURLスキーム，ファイル名を除去したディレクトリパス文字列を返す。
@@ -672,6 +787,111 @@ void ShapeSetInfo_impl::setColdetModelTriangles
 
 }
 
+/*!
+  @brief creates the collision shape of each link by simplifying the meshes of the link and its sensors.
+  The shape is appended to the shapes in the link local coordinate and set to LinkInfo::collisionShapeIndices.
+  A link which has a single primitive shape or whose mesh is not changed keeps using the original shapes.
+*/
+void ShapeSetInfo_impl::setCollisionShapes(LinkInfoSequence& links, const MeshSimplifier& simplifier)
+{
+    for(CORBA::ULong linkIndex=0; linkIndex < links.length(); ++linkIndex){
+        LinkInfo& linkInfo = links[linkIndex];
+        linkInfo.collisionShapeIndices.length(0);
+
+        std::vector<Vector3> vertices;
+        std::vector<int> triangles;
+        std::vector<short> shapeIndices;
+
+        Matrix44 E(Matrix44::Identity());
+        for(CORBA::ULong i=0; i < linkInfo.shapeIndices.length(); ++i){
+            addCollisionMeshTriangles(linkInfo.shapeIndices[i], E, vertices, triangles);
+            shapeIndices.push_back(linkInfo.shapeIndices[i].shapeIndex);
+        }
+        Matrix44 T(Matrix44::Identity());
+        const SensorInfoSequence& sensors = linkInfo.sensors;
+        for(CORBA::ULong i=0; i < sensors.length(); ++i){
+            const SensorInfo& sensor = sensors[i];
+            calcRodrigues(T, Vector3(sensor.rotation[0], sensor.rotation[1], sensor.rotation[2]), sensor.rotation[3]);
+            T(0,3) = sensor.translation[0];
+            T(1,3) = sensor.translation[1];
+            T(2,3) = sensor.translation[2];
+            for(CORBA::ULong j=0; j < sensor.shapeIndices.length(); ++j){
+                addCollisionMeshTriangles(sensor.shapeIndices[j], T, vertices, triangles);
+                shapeIndices.push_back(sensor.shapeIndices[j].shapeIndex);
+            }
+        }
+
+        // the collision detection uses the primitive of a single primitive shape
+        if(triangles.empty() || (shapeIndices.size() == 1 && shapes_[shapeIndices[0]].primitiveType != SP_MESH)){
+            continue;
+        }
+
+        const size_t orgNumVertices = vertices.size();
+        const size_t orgNumTriangleIndices = triangles.size();
+        simplifier.apply(vertices, triangles);
+        if(triangles.empty() || (vertices.size() == orgNumVertices && triangles.size() == orgNumTriangleIndices)){
+            continue;
+        }
+
+        const CORBA::ULong shapeIndex = shapes_.length();
+        shapes_.length(shapeIndex + 1);
+        ShapeInfo& shapeInfo = shapes_[shapeIndex];
+        shapeInfo.primitiveType = SP_MESH;
+        shapeInfo.appearanceIndex = shapes_[shapeIndices[0]].appearanceIndex;
+        shapeInfo.vertices.length(vertices.size() * 3);
+        for(size_t i=0; i < vertices.size(); ++i){
+            shapeInfo.vertices[i*3]   = vertices[i][0];
+            shapeInfo.vertices[i*3+1] = vertices[i][1];
+            shapeInfo.vertices[i*3+2] = vertices[i][2];
+        }
+        shapeInfo.triangles.length(triangles.size());
+        std::copy(triangles.begin(), triangles.end(), shapeInfo.triangles.get_buffer());
+
+        linkInfo.collisionShapeIndices.length(1);
+        TransformedShapeIndex& tsi = linkInfo.collisionShapeIndices[0];
+        tsi.shapeIndex = shapeIndex;
+        tsi.inlinedShapeTransformMatrixIndex = -1;
+        for(int p=0, row=0; row < 3; ++row){
+            for(int col=0; col < 4; ++col){
+                tsi.transformMatrix[p++] = E(row, col);
+            }
+        }
+
+        cout << linkInfo.name << " has " << triangles.size() / 3 << " collision triangles instead of "
+             << orgNumTriangleIndices / 3 << "." << endl;
+    }
+
+    // the shared arrays have been copied by extending the sequence
+    shareArrays();
+}
+
+
+void ShapeSetInfo_impl::addCollisionMeshTriangles
+(const TransformedShapeIndex& tsi, const Matrix44& Tparent, std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles)
+{
+    const DblArray12& M = tsi.transformMatrix;
+    Matrix44 T, Tlocal;
+    Tlocal << M[0], M[1], M[2],  M[3],
+             M[4], M[5], M[6],  M[7],
+             M[8], M[9], M[10], M[11],
+             0.0,  0.0,  0.0,   1.0;
+    T = Tparent * Tlocal;
+
+    const ShapeInfo& shapeInfo = shapes_[tsi.shapeIndex];
+    const int vertexIndexBase = io_vertices.size();
+    const FloatSequence& vertices = shapeInfo.vertices;
+    const int numVertices = vertices.length() / 3;
+    for(int j=0; j < numVertices; ++j){
+        Vector4 v(T * Vector4(vertices[j*3], vertices[j*3+1], vertices[j*3+2], 1.0));
+        io_vertices.push_back(Vector3(v[0], v[1], v[2]));
+    }
+    const LongSequence& triangles = shapeInfo.triangles;
+    for(CORBA::ULong j=0; j < triangles.length(); ++j){
+        io_triangles.push_back(triangles[j] + vertexIndexBase);
+    }
+}
+
+
 void ShapeSetInfo_impl::saveOriginalData(){
     originShapes_ = shapes_;
     originAppearances_ = appearances_;
@@ -690,6 +910,9 @@ void ShapeSetInfo_impl::setBoundingBoxData(const Vector3& boxSize, int shapeInde
        
     shapes_.length(shapeIndex+1);
     ShapeInfo& shapeInfo = shapes_[shapeIndex];
+    // the arrays may refer to the buffers shared with other bodies
+    ShapeDataStore::detach(shapeInfo.vertices);
+    ShapeDataStore::detach(shapeInfo.triangles);
     VrmlIndexedFaceSet* faceSet = triangleMesh.get();
     setTriangleMesh(shapeInfo, faceSet);
     shapeInfo.primitiveType = SP_BOX;
@@ -730,14 +953,23 @@ void ShapeSetInfo_impl::createAppearanceInfo(){
 }
 
 void ShapeSetInfo_impl::restoreOriginalData(){
-    shapes_ = originShapes_;
-    appearances_ = originAppearances_;
+    // The sequences are replaced instead of being assigned because the assignment
+    // overwrites the elements of the shared buffers
+    ShapeInfoSequence shapes(originShapes_);
+    AppearanceInfoSequence appearances(originAppearances_);
+    adoptSequence(shapes_, shapes);
+    adoptSequence(appearances_, appearances);
     materials_ = originMaterials_;
+    shareArrays();
 }
 
 bool ShapeSetInfo_impl::checkFileUpdateTime(){
+    return checkFileUpdateTime(fileTimeMap);
+}
+
+bool ShapeSetInfo_impl::checkFileUpdateTime(const FileTimeMap& fileTimeMap){
     bool ret=true;
-    for( map<std::string, time_t>::iterator it=fileTimeMap.begin(); it != fileTimeMap.end(); ++it){
+    for( FileTimeMap::const_iterator it=fileTimeMap.begin(); it != fileTimeMap.end(); ++it){
         struct stat statbuff;
         time_t mtime = 0;
         if( stat( it->first.c_str(), &statbuff ) == 0 ){
@@ -750,3 +982,50 @@ bool ShapeSetInfo_impl::checkFileUpdateTime(){
     }
     return ret;
 }
+
+
+/**
+   The shape set is taken from the data without copying the elements
+*/
+void ShapeSetInfo_impl::adoptShapeSet(BinaryModelData& data)
+{
+    adoptSequence(shapes_, data.shapes.inout());
+    adoptSequence(appearances_, data.appearances.inout());
+    adoptSequence(materials_, data.materials.inout());
+    adoptSequence(textures_, data.textures.inout());
+    shareArrays();
+}
+
+
+/**
+   makes the large arrays of the shape set refer to the buffers of ShapeDataStore,
+   which are shared with the other bodies and scenes having the same contents.
+   This must be called after all the shapes are created because extending the sequences
+   of the structures copies the arrays into private buffers.
+*/
+void ShapeSetInfo_impl::shareArrays()
+{
+    std::vector<ShapeDataStore::Reference> references;
+    ShapeDataStore::Reference ref;
+
+    for(CORBA::ULong i=0; i < shapes_.length(); ++i){
+        ShapeInfo& shape = shapes_[i];
+        if((ref = ShapeDataStore::share(shape.vertices))) references.push_back(ref);
+        if((ref = ShapeDataStore::share(shape.triangles))) references.push_back(ref);
+    }
+    for(CORBA::ULong i=0; i < appearances_.length(); ++i){
+        AppearanceInfo& appearance = appearances_[i];
+        if((ref = ShapeDataStore::share(appearance.normals))) references.push_back(ref);
+        if((ref = ShapeDataStore::share(appearance.normalIndices))) references.push_back(ref);
+        if((ref = ShapeDataStore::share(appearance.colors))) references.push_back(ref);
+        if((ref = ShapeDataStore::share(appearance.colorIndices))) references.push_back(ref);
+        if((ref = ShapeDataStore::share(appearance.textureCoordinate))) references.push_back(ref);
+        if((ref = ShapeDataStore::share(appearance.textureCoordIndices))) references.push_back(ref);
+    }
+    for(CORBA::ULong i=0; i < textures_.length(); ++i){
+        if((ref = ShapeDataStore::share(textures_[i].image))) references.push_back(ref);
+    }
+
+    // the previous references are released after the sequences refer to the new ones
+    sharedArrays.swap(references);
+}
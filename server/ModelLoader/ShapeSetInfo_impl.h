@@ -16,13 +16,18 @@
 #define OPENHRP_MODEL_LOADER_SHAPE_SET_INFO_INPL_H_INCLUDED
 
 #include <string>
+#include <vector>
 #include <hrpCorba/ORBwrap.h>
 #include <hrpCorba/ModelLoader.hh>
 #include <hrpUtil/TriangleMeshShaper.h>
 #include <hrpUtil/VrmlNodes.h>
 #include <hrpUtil/Eigen3d.h>
 #include <hrpUtil/Eigen4d.h>
+#include <hrpUtil/MeshSimplifier.h>
+#include <hrpUtil/TextureCache.h>
 #include <hrpCollision/ColdetModel.h>
+#include <hrpModel/BinaryModelFile.h>
+#include "ShapeDataStore.h"
 
 using namespace OpenHRP;
 using namespace hrp;
@@ -40,6 +45,17 @@ public:
     virtual AppearanceInfoSequence* appearances();
     virtual MaterialInfoSequence* materials();
     virtual TextureInfoSequence* textures();
+    virtual CORBA::Long numShapes();
+    virtual CORBA::Long numAppearances();
+    virtual ShapeChunk* getShapeChunk(CORBA::Long firstIndex, CORBA::Long maxCount, const ShapeChunkOption& option);
+    virtual ShapeChunk* getAppearanceChunk(CORBA::Long firstIndex, CORBA::Long maxCount, const ShapeChunkOption& option);
+
+    typedef std::map<std::string, time_t> FileTimeMap;
+
+    /// modification times of the inline files which the shapes were loaded from
+    const FileTimeMap& inlineFileTimes() const { return fileTimeMap; }
+    void setInlineFileTimes(const FileTimeMap& fileTimes) { fileTimeMap = fileTimes; }
+    static bool checkFileUpdateTime(const FileTimeMap& fileTimeMap);
 
 protected:
 
@@ -54,11 +70,26 @@ protected:
     void createAppearanceInfo();
     void setBoundingBoxData(const Vector3& boxSize, int shapeIndex);
     bool checkFileUpdateTime();
+    void adoptShapeSet(BinaryModelData& data);
+    void shareArrays();
+    void setCollisionShapes(LinkInfoSequence& links, const MeshSimplifier& simplifier);
     bool readImage;
+    /// the images of the textures are downscaled to this size if it is positive
+    int maxTextureSize;
+
+    /// moves the buffer of a sequence to another one without copying the elements
+    template <class Seq> static void adoptSequence(Seq& to, Seq& from) {
+        CORBA::ULong max = from.maximum();
+        CORBA::ULong length = from.length();
+        to.replace(max, length, from.get_buffer(true), true);
+    }
 
 private:
         
     PortableServer::POA_var poa;
+
+    // declared before the sequences so that the shared buffers outlive them
+    std::vector<ShapeDataStore::Reference> sharedArrays;
 		
     ShapeInfoSequence  shapes_;
     AppearanceInfoSequence appearances_;
@@ -74,7 +105,7 @@ private:
     typedef std::map<VrmlShapePtr, int> ShapeNodeToShapeInfoIndexMap;
     ShapeNodeToShapeInfoIndexMap shapeInfoIndexMap;
 
-    std::map<std::string, time_t> fileTimeMap;
+    FileTimeMap fileTimeMap;
 
     int createShapeInfo(VrmlShape* shapeNode, const SFString* url);
     void setTriangleMesh(ShapeInfo& shapeInfo, VrmlIndexedFaceSet* triangleMesh);
@@ -85,9 +116,12 @@ private:
     void setTexCoords(AppearanceInfo& appInfo, VrmlIndexedFaceSet* triangleMesh);
     int createMaterialInfo(VrmlMaterialPtr& materialNode);
     int createTextureInfo(VrmlTexturePtr& textureNode, const SFString *url);
+    void prefetchTextures(VrmlNode* node, const std::string& url, bool isInInline = false);
+    TextureFormat textureFormat() const;
     void createTextureTransformMatrix(AppearanceInfo& appInfo, VrmlTextureTransformPtr& textureTransform );
     std::string getModelFileDirPath(const std::string& url);
     void setColdetModelTriangles(ColdetModelPtr& coldetModel, const TransformedShapeIndex& tsi, const Matrix44& Tparent, int& vertexIndex, int& triangleIndex);
+    void addCollisionMeshTriangles(const TransformedShapeIndex& tsi, const Matrix44& Tparent, std::vector<Vector3>& io_vertices, std::vector<int>& io_triangles);
 
     friend class BodyInfo_impl;
     friend class SceneInfo_impl;
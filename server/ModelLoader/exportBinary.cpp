@@ -0,0 +1,45 @@
+#include <iostream>
+#include <cstring>
+#include <hrpModel/ModelLoaderUtil.h>
+#include <hrpModel/BinaryModelFile.h>
+
+using namespace std;
+using namespace hrp;
+using namespace OpenHRP;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3){
+        cerr << "Usage:" << argv[0] << " URL of the original file, output file [--coldet]"
+             << std::endl;
+        cerr << "  --coldet : stores the meshes for the collision detection" << std::endl;
+        return 1;
+    }
+
+    bool storeCollisionMeshes = false;
+    for(int i=3; i < argc; ++i){
+        if(strcmp(argv[i], "--coldet") == 0){
+            storeCollisionMeshes = true;
+        }
+    }
+
+    CORBA::ORB_var orb;
+  
+    try {
+        orb = CORBA::ORB_init(argc, argv);
+        ModelLoader_var ml = getModelLoader(orb);
+        BodyInfo_var binfo;
+        binfo = ml->getBodyInfo(argv[1]);
+
+        if(!writeBinaryModelFile(argv[2], binfo, storeCollisionMeshes)){
+            return 1;
+        }
+    }catch(ModelLoader::ModelLoaderException ex){
+        std::cerr << ex.description << std::endl;
+        return 1;
+    }catch (CORBA::SystemException& ex){ 
+        cerr << ex._rep_id() << endl;
+        return 1;
+    }
+    return 0;
+}
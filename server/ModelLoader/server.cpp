@@ -8,6 +8,8 @@
 #endif /* _WIN32 */
 
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 using namespace std;
 
@@ -35,6 +37,18 @@ int main(int argc, char* argv[])
 	}
 	
 	ModelLoader_impl* modelLoaderImpl = new ModelLoader_impl(orb, poa);
+
+	// the ORB options have been removed from argv by ORB_init()
+	const char* cacheDirectory = getenv("OPENHRP_MODEL_CACHE_DIR");
+	for(int i=1; i < argc - 1; ++i){
+	    if(strcmp(argv[i], "--cache-dir") == 0){
+	        cacheDirectory = argv[i+1];
+	    }
+	}
+	if(cacheDirectory){
+	    modelLoaderImpl->setCacheDirectory(cacheDirectory);
+	}
+
 	poa->activate_object(modelLoaderImpl);
 	ModelLoader_var modelLoader = modelLoaderImpl->_this();
 	modelLoaderImpl->_remove_ref();
@@ -1,4 +1,5 @@
 #include "ODE_ModelLoaderUtil.h"
+#include <hrpUtil/ShapeChunk.h>
 #include <stack>
 
 using namespace hrp;
@@ -44,7 +45,7 @@ bool ModelLoaderHelper::createBody(BodyPtr body, ODE_World* world, BodyInfo_ptr
 
     int n = bodyInfo->links()->length();
     linkInfoSeq = bodyInfo->links();
-    shapeInfoSeq = bodyInfo->shapes();
+    shapeInfoSeq = getShapesByChunks(bodyInfo, defaultShapeChunkOption());
 
     int rootIndex = -1;
 
@@ -189,6 +189,8 @@ void OpenHRP_PathPlannerSVC_impl::setProperties(const OpenHRP::PathPlanner::Prop
 {
     std::cout << "setProperties()" << std::endl;
     std::map<std::string, std::string> prop;
+    int cacheSize = -1;
+    double cacheResolution = 1e-6;
     for (unsigned int i=0; i<properites.length(); i++) {
         std::string name(properites[i][0]);
         std::string value(properites[i][1]);
@@ -209,11 +211,16 @@ void OpenHRP_PathPlannerSVC_impl::setProperties(const OpenHRP::PathPlanner::Prop
             cspace->weight(1) = atof(value.c_str());
         }else if (name == "weight-theta"){
             cspace->weight(2) = atof(value.c_str());
+        }else if (name == "collision-cache-size"){
+            cacheSize = atoi(value.c_str());
+        }else if (name == "collision-cache-resolution"){
+            cacheResolution = atof(value.c_str());
         }else{
             prop.insert(std::map<std::string, std::string>::value_type(name, value));
         }
     }
     path_->setProperties(prop);
+    if (cacheSize >= 0) path_->enableCollisionCache(cacheSize, cacheResolution);
 
     std::cout << "fin. " << std::endl;
 }
@@ -232,6 +239,8 @@ CORBA::Boolean OpenHRP_PathPlannerSVC_impl::calcPath()
               << path_->timeForwardKinematics() << "[s]" << std::endl;
     std::cout << "collision check function was called " 
               << path_->countCollisionCheck() << " times" << std::endl;
+    std::cout << "collision check cache hit " << path_->countCollisionCacheHit()
+              << " times, missed " << path_->countCollisionCacheMiss() << " times" << std::endl;
     return status;
 }
 
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+#include "Project.h"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+
+using namespace std;
+using namespace hrp;
+using namespace boost;
+using boost::property_tree::ptree;
+
+
+bool ProjectItem::has(const std::string& key) const
+{
+    return properties.find(key) != properties.end();
+}
+
+
+std::string ProjectItem::getString(const std::string& key, const std::string& defaultValue) const
+{
+    PropertyMap::const_iterator p = properties.find(key);
+    if(p == properties.end()){
+        return defaultValue;
+    }
+    return algorithm::trim_copy(p->second);
+}
+
+
+double ProjectItem::getDouble(const std::string& key, double defaultValue) const
+{
+    PropertyMap::const_iterator p = properties.find(key);
+    if(p != properties.end()){
+        istringstream is(p->second);
+        double value;
+        if(is >> value){
+            return value;
+        }
+    }
+    return defaultValue;
+}
+
+
+bool ProjectItem::getBool(const std::string& key, bool defaultValue) const
+{
+    string value = getString(key);
+    if(value == "true"){
+        return true;
+    } else if(value == "false"){
+        return false;
+    }
+    return defaultValue;
+}
+
+
+std::vector<double> ProjectItem::getDoubles(const std::string& key) const
+{
+    vector<double> values;
+    PropertyMap::const_iterator p = properties.find(key);
+    if(p != properties.end()){
+        istringstream is(p->second);
+        double value;
+        while(is >> value){
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+
+std::vector<std::string> ProjectItem::getAll(const std::string& key) const
+{
+    vector<string> values;
+    pair<PropertyMap::const_iterator, PropertyMap::const_iterator> range = properties.equal_range(key);
+    for(PropertyMap::const_iterator p = range.first; p != range.second; ++p){
+        values.push_back(algorithm::trim_copy(p->second));
+    }
+    return values;
+}
+
+
+void ProjectItem::add(const std::string& key, const std::string& value)
+{
+    properties.insert(make_pair(key, value));
+}
+
+
+bool Project::load(const std::string& filename, const std::string& modeName)
+{
+    items_.clear();
+
+    ptree pt;
+    try {
+        property_tree::read_xml(filename, pt);
+    } catch(const property_tree::xml_parser_error& ex){
+        cerr << ex.what() << endl;
+        return false;
+    }
+
+    boost::filesystem::path path(boost::filesystem::system_complete(boost::filesystem::path(filename)));
+    directory_ = path.parent_path().string();
+
+    const ptree* mode = 0;
+    ptree::const_assoc_iterator top = pt.find("grxui");
+    if(top == pt.not_found()){
+        cerr << filename << " is not a project file." << endl;
+        return false;
+    }
+    for(ptree::const_iterator p = top->second.begin(); p != top->second.end(); ++p){
+        if(p->first == "mode"){
+            if(!mode){
+                mode = &p->second;
+            }
+            if(p->second.get<string>("<xmlattr>.name", "") == modeName){
+                mode = &p->second;
+                break;
+            }
+        }
+    }
+    if(!mode){
+        cerr << filename << " does not have any mode." << endl;
+        return false;
+    }
+
+    for(ptree::const_iterator p = mode->begin(); p != mode->end(); ++p){
+        if(p->first != "item"){
+            continue;
+        }
+        const ptree& itemTree = p->second;
+        if(itemTree.get<string>("<xmlattr>.select", "true") != "true"){
+            continue;
+        }
+        ProjectItem item;
+        item.className = itemTree.get<string>("<xmlattr>.class", "");
+        item.name = itemTree.get<string>("<xmlattr>.name", "");
+        item.url = expandPath(itemTree.get<string>("<xmlattr>.url", ""));
+        for(ptree::const_iterator q = itemTree.begin(); q != itemTree.end(); ++q){
+            if(q->first == "property"){
+                item.add(q->second.get<string>("<xmlattr>.name", ""),
+                         q->second.get<string>("<xmlattr>.value", ""));
+            }
+        }
+        items_.push_back(item);
+    }
+
+    return true;
+}
+
+
+std::vector<const ProjectItem*> Project::items(const std::string& className) const
+{
+    vector<const ProjectItem*> selected;
+    for(size_t i=0; i < items_.size(); ++i){
+        const string& name = items_[i].className;
+        if(name == className ||
+           (name.size() > className.size() &&
+            algorithm::ends_with(name, "." + className))){
+            selected.push_back(&items_[i]);
+        }
+    }
+    return selected;
+}
+
+
+const ProjectItem* Project::item(const std::string& className) const
+{
+    vector<const ProjectItem*> selected = items(className);
+    return selected.empty() ? 0 : selected.front();
+}
+
+
+std::string Project::expandPath(const std::string& path) const
+{
+    string expanded;
+    string::size_type pos = 0;
+    while(true){
+        string::size_type begin = path.find("$(", pos);
+        if(begin == string::npos){
+            expanded += path.substr(pos);
+            break;
+        }
+        string::size_type end = path.find(")", begin);
+        if(end == string::npos){
+            expanded += path.substr(pos);
+            break;
+        }
+        expanded += path.substr(pos, begin - pos);
+        string name = path.substr(begin + 2, end - begin - 2);
+        if(name == "PROJECT_DIR" || name == "CURRENT_DIR"){
+            expanded += directory_;
+        } else if(const char* value = getenv(name.c_str())){
+            expanded += value;
+        }
+        pos = end + 1;
+    }
+    return expanded;
+}
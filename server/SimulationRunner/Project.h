@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief Reader of the project files (sample/project/*.xml) of GrxUI
+*/
+
+#ifndef OPENHRP_SIMULATION_RUNNER_PROJECT_H_INCLUDED
+#define OPENHRP_SIMULATION_RUNNER_PROJECT_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace hrp {
+
+    /**
+       Properties of an item in a project file.
+       Values are kept as strings and converted when they are read.
+    */
+    class ProjectItem
+    {
+    public:
+        std::string className;
+        std::string name;
+        std::string url;
+
+        bool has(const std::string& key) const;
+        std::string getString(const std::string& key, const std::string& defaultValue = "") const;
+        double getDouble(const std::string& key, double defaultValue) const;
+        bool getBool(const std::string& key, bool defaultValue) const;
+        std::vector<double> getDoubles(const std::string& key) const;
+
+        /// all the values of a property which appears several times (e.g. "connection")
+        std::vector<std::string> getAll(const std::string& key) const;
+
+        void add(const std::string& key, const std::string& value);
+
+    private:
+        typedef std::multimap<std::string, std::string> PropertyMap;
+        PropertyMap properties;
+    };
+
+    class Project
+    {
+    public:
+        /**
+           @param modeName name of the mode to read. The first mode is read if the mode is not found.
+           @return false if the file cannot be read
+        */
+        bool load(const std::string& filename, const std::string& modeName = "Simulation");
+
+        const std::string& directory() const { return directory_; }
+
+        /// selected items of the class. The class name can be given without the package name.
+        std::vector<const ProjectItem*> items(const std::string& className) const;
+        const ProjectItem* item(const std::string& className) const;
+
+        /**
+           expands $(PROJECT_DIR), $(CURRENT_DIR) and environment variables in a path
+        */
+        std::string expandPath(const std::string& path) const;
+
+    private:
+        std::string directory_;
+        std::vector<ProjectItem> items_;
+    };
+}
+
+#endif
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+
+#include "SimulationRunner.h"
+#include <iostream>
+#include <hrpModel/Body.h>
+#include <hrpModel/Link.h>
+#include <hrpModel/LinkTraverse.h>
+#include <hrpModel/ModelNodeSetUtil.h>
+#include <hrpUtil/Eigen3d.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+using namespace hrp;
+
+namespace {
+
+#ifdef _WIN32
+    typedef HINSTANCE DllHandle;
+    inline DllHandle loadDll(const char* filename) { return LoadLibrary(filename); }
+    inline void* resolveDllSymbol(DllHandle handle, const char* symbol) { return GetProcAddress(handle, symbol); }
+    inline void unloadDll(DllHandle handle) { FreeLibrary(handle); }
+#else
+    typedef void* DllHandle;
+    inline DllHandle loadDll(const char* filename) { return dlopen(filename, RTLD_LAZY); }
+    inline void* resolveDllSymbol(DllHandle handle, const char* symbol) { return dlsym(handle, symbol); }
+    inline void unloadDll(DllHandle handle) { dlclose(handle); }
+#endif
+
+    SimulationControllerInterface* loadControllerLibrary(const std::string& filename)
+    {
+        typedef std::map<std::string, SimulationControllerInterface*> InterfaceMap;
+        static InterfaceMap loadedInterfaces;
+
+        InterfaceMap::iterator p = loadedInterfaces.find(filename);
+        if(p != loadedInterfaces.end()){
+            return p->second;
+        }
+
+        SimulationControllerInterface* controllerInterface = 0;
+        DllHandle dll = loadDll(filename.c_str());
+        if(!dll){
+            cerr << "Controller library \"" << filename << "\" cannot be loaded." << endl;
+        } else {
+            GetSimulationControllerInterfaceFunc getInterface =
+                (GetSimulationControllerInterfaceFunc)resolveDllSymbol(dll, "getHrpSimulationControllerInterface");
+            if(getInterface){
+                controllerInterface = getInterface();
+            }
+            if(!controllerInterface ||
+               controllerInterface->version != SIMULATION_CONTROLLER_INTERFACE_VERSION ||
+               !controllerInterface->create || !controllerInterface->destroy || !controllerInterface->control){
+                cerr << "Controller library \"" << filename << "\" is incompatible and cannot be loaded." << endl;
+                controllerInterface = 0;
+                unloadDll(dll);
+            }
+        }
+        loadedInterfaces[filename] = controllerInterface;
+        return controllerInterface;
+    }
+}
+
+
+SimulationRunner::SimulationRunner()
+{
+    totalTime = 0.0;
+    totalTimeOverride = -1.0;
+    logTimeStep = 0.0;
+}
+
+
+SimulationRunner::~SimulationRunner()
+{
+    for(size_t i=0; i < controllers.size(); ++i){
+        controllers[i].api->destroy(controllers[i].handle);
+    }
+}
+
+
+void SimulationRunner::setControllerLibrary(const std::string& name, const std::string& filename)
+{
+    controllerLibraries[name] = filename;
+}
+
+
+bool SimulationRunner::setupWorld(const Project& project)
+{
+    const ProjectItem* simulationItem = project.item("GrxSimulationItem");
+    if(!simulationItem){
+        cerr << "The project does not have a simulation item." << endl;
+        return false;
+    }
+
+    double timeStep = simulationItem->getDouble("timeStep", 0.001);
+    totalTime = (totalTimeOverride > 0.0) ? totalTimeOverride : simulationItem->getDouble("totalTime", 20.0);
+    bool integrate = simulationItem->getBool("integrate", true);
+
+    world.setTimeStep(timeStep);
+    world.setCurrentTime(0.0);
+    if(simulationItem->getString("method") == "EULER"){
+        world.setEulerMethod();
+    } else {
+        world.setRungeKuttaMethod();
+    }
+    world.enableSensors(true);
+    world.setGravityAcceleration(Vector3(0.0, 0.0, simulationItem->getDouble("gravity", 9.8)));
+
+    const ProjectItem* worldStateItem = project.item("GrxWorldStateItem");
+    logTimeStep = worldStateItem ? worldStateItem->getDouble("logTimeStep", timeStep) : timeStep;
+
+    vector<const ProjectItem*> modelItems = project.items("GrxModelItem");
+    for(size_t i=0; i < modelItems.size(); ++i){
+        if(!loadModel(*modelItems[i], project)){
+            return false;
+        }
+    }
+    for(size_t i=0; i < modelItems.size(); ++i){
+        BodyPtr body = world.body(modelItems[i]->name);
+        setInitialState(body, *modelItems[i], integrate);
+    }
+
+    vector<const ProjectItem*> pairItems = project.items("GrxCollisionPairItem");
+    for(size_t i=0; i < pairItems.size(); ++i){
+        setCollisionPair(*pairItems[i]);
+    }
+    vector<const ProjectItem*> extraJointItems = project.items("GrxExtraJointItem");
+    for(size_t i=0; i < extraJointItems.size(); ++i){
+        setExtraJoint(*extraJointItems[i]);
+    }
+
+    world.constraintForceSolver.useBuiltinCollisionDetector(true);
+    world.initialize();
+    world.constraintForceSolver.clearExternalForces();
+
+    for(size_t i=0; i < modelItems.size(); ++i){
+        BodyPtr body = world.body(modelItems[i]->name);
+        if(modelItems[i]->getBool("isRobot", false) && !createController(body, *modelItems[i])){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool SimulationRunner::loadModel(const ProjectItem& item, const Project& project)
+{
+    BodyPtr body(new Body());
+
+    cout << "Loading " << item.name << " (" << item.url << ")" << endl;
+
+    if(!loadBodyFromModelFile(body, item.url, true)){
+        cerr << "Model \"" << item.name << "\" cannot be loaded." << endl;
+        return false;
+    }
+    body->setName(item.name);
+    world.addBody(body);
+
+    return true;
+}
+
+
+void SimulationRunner::setInitialState(BodyPtr body, const ProjectItem& item, bool integrate)
+{
+    body->initializeConfiguration();
+
+    Link* root = body->rootLink();
+    vector<double> p = item.getDoubles(root->name + ".translation");
+    if(p.size() == 3){
+        root->p = Vector3(p[0], p[1], p[2]);
+    }
+    vector<double> r = item.getDoubles(root->name + ".rotation");
+    if(r.size() == 4){
+        root->setSegmentAttitude(rodrigues(Vector3(r[0], r[1], r[2]), r[3]));
+    }
+    vector<double> v = item.getDoubles(root->name + ".velocity");
+    if(v.size() == 3){
+        root->v = Vector3(v[0], v[1], v[2]);
+    }
+    vector<double> w = item.getDoubles(root->name + ".angularVelocity");
+    if(w.size() == 3){
+        root->w = Vector3(w[0], w[1], w[2]);
+    }
+    root->vo = root->v - root->w.cross(root->p);
+
+    for(int i=1; i < body->numLinks(); ++i){
+        Link* link = body->link(i);
+        if(integrate){
+            link->isHighGainMode = (item.getString(link->name + ".mode", "Torque") == "HighGain");
+        } else {
+            link->isHighGainMode = true;
+        }
+        if(link->jointType != Link::FIXED_JOINT){
+            link->q = item.getDouble(link->name + ".angle", link->q);
+            link->dq = item.getDouble(link->name + ".jointVelocity", 0.0);
+        }
+    }
+
+    body->calcForwardKinematics(true, true);
+}
+
+
+bool SimulationRunner::createController(BodyPtr body, const ProjectItem& item)
+{
+    string controllerName = item.getString("controller");
+
+    std::map<std::string, std::string>::iterator p = controllerLibraries.find(controllerName);
+    if(p == controllerLibraries.end()){
+        p = controllerLibraries.find(item.name);
+    }
+    if(p == controllerLibraries.end()){
+        if(!controllerName.empty()){
+            cerr << "Warning: no controller library is given for " << controllerName
+                 << " of " << item.name << ". The model runs without the controller." << endl;
+        }
+        return true;
+    }
+
+    SimulationControllerInterface* api = loadControllerLibrary(p->second);
+    if(!api){
+        return false;
+    }
+
+    Controller controller;
+    controller.api = api;
+    controller.timeStep = item.getDouble("controlTime", world.timeStep());
+    controller.nextTime = 0.0;
+    controller.handle = api->create(body.get(), body->modelName().c_str(), controller.timeStep);
+    if(!controller.handle){
+        cerr << "Controller \"" << p->second << "\" cannot be created for " << item.name << "." << endl;
+        return false;
+    }
+    if(api->initialize){
+        api->initialize(controller.handle);
+    }
+    controllers.push_back(controller);
+
+    return true;
+}
+
+
+void SimulationRunner::setCollisionPair(const ProjectItem& item)
+{
+    const double epsilon = 0.0;
+
+    int bodyIndex[2];
+    vector<Link*> links[2];
+    for(int i=0; i < 2; ++i){
+        string objectName = item.getString(i == 0 ? "objectName1" : "objectName2");
+        string jointName = item.getString(i == 0 ? "jointName1" : "jointName2");
+        bodyIndex[i] = world.bodyIndex(objectName);
+        if(bodyIndex[i] < 0){
+            cerr << "Warning: collision pair " << item.name << " refers to an unknown object "
+                 << objectName << "." << endl;
+            return;
+        }
+        BodyPtr body = world.body(bodyIndex[i]);
+        if(jointName.empty()){
+            const LinkTraverse& traverse = body->linkTraverse();
+            links[i].assign(traverse.begin(), traverse.end());
+        } else {
+            links[i].push_back(body->link(jointName));
+        }
+    }
+
+    double staticFriction = item.getDouble("staticFriction", 0.5);
+    double slidingFriction = item.getDouble("slidingFriction", 0.5);
+    double cullingThresh = item.getDouble("cullingThresh", 0.01);
+    double restitution = item.getDouble("Restitution", 0.0);
+
+    // each pair of links of the same body is registered only once
+    const bool isSameBody = (bodyIndex[0] == bodyIndex[1]) && (links[0] == links[1]);
+
+    for(size_t i=0; i < links[0].size(); ++i){
+        for(size_t j = isSameBody ? i + 1 : 0; j < links[1].size(); ++j){
+            Link* link1 = links[0][i];
+            Link* link2 = links[1][j];
+            if(link1 && link2 && link1 != link2){
+                world.constraintForceSolver.addCollisionCheckLinkPair
+                    (bodyIndex[0], link1, bodyIndex[1], link2,
+                     staticFriction, slidingFriction, cullingThresh, restitution, epsilon);
+            }
+        }
+    }
+}
+
+
+void SimulationRunner::setExtraJoint(const ProjectItem& item)
+{
+    int bodyIndex1 = world.bodyIndex(item.getString("object1Name"));
+    int bodyIndex2 = world.bodyIndex(item.getString("object2Name"));
+    if(bodyIndex1 < 0 || bodyIndex2 < 0){
+        cerr << "Warning: extra joint " << item.name << " refers to an unknown object." << endl;
+        return;
+    }
+    Link* link1 = world.body(bodyIndex1)->link(item.getString("link1Name"));
+    Link* link2 = world.body(bodyIndex2)->link(item.getString("link2Name"));
+    if(!link1 || !link2){
+        cerr << "Warning: extra joint " << item.name << " refers to an unknown link." << endl;
+        return;
+    }
+
+    string type = item.getString("jointType");
+    short jointType = OpenHRP::EJ_XYZ;
+    if(type == "xy"){
+        jointType = OpenHRP::EJ_XY;
+    } else if(type == "z"){
+        jointType = OpenHRP::EJ_Z;
+    }
+
+    double pos1[3] = { 0.0, 0.0, 0.0 };
+    double pos2[3] = { 0.0, 0.0, 0.0 };
+    double axis[3] = { 0.0, 0.0, 0.0 };
+    vector<double> v;
+    v = item.getDoubles("link1LocalPos"); if(v.size() == 3) std::copy(v.begin(), v.end(), pos1);
+    v = item.getDoubles("link2LocalPos"); if(v.size() == 3) std::copy(v.begin(), v.end(), pos2);
+    v = item.getDoubles("jointAxis");     if(v.size() == 3) std::copy(v.begin(), v.end(), axis);
+
+    world.constraintForceSolver.addExtraJoint(bodyIndex1, link1, bodyIndex2, link2, pos1, pos2, jointType, axis);
+}
+
+
+bool SimulationRunner::run()
+{
+    if(!logFilename.empty() && !log.open(logFilename, world, logTimeStep)){
+        return false;
+    }
+
+    const double timeStep = world.timeStep();
+    // the last step is included when the total time is a multiple of the time step
+    const double endTime = totalTime - timeStep * 0.5;
+    double nextLogTime = 0.0;
+    int numSteps = 0;
+
+    while(world.currentTime() < endTime){
+
+        const double time = world.currentTime();
+
+        if(log.isOpen() && time >= nextLogTime - timeStep * 0.5){
+            log.put(world, collisions);
+            nextLogTime += logTimeStep;
+        }
+
+        for(size_t i=0; i < controllers.size(); ++i){
+            Controller& controller = controllers[i];
+            if(time >= controller.nextTime - timeStep * 0.5){
+                controller.api->control(controller.handle, time);
+                controller.nextTime += controller.timeStep;
+            }
+        }
+
+        world.calcNextState(collisions);
+        world.constraintForceSolver.clearExternalForces();
+        ++numSteps;
+    }
+
+    if(log.isOpen()){
+        log.put(world, collisions);
+        log.close();
+    }
+
+    cout << "Simulated " << world.currentTime() << " [s] in " << numSteps << " steps." << endl;
+
+    return true;
+}
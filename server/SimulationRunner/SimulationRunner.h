@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief Runs the simulation of a project in the current process without CORBA servers
+*/
+
+#ifndef OPENHRP_SIMULATION_RUNNER_H_INCLUDED
+#define OPENHRP_SIMULATION_RUNNER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <hrpModel/World.h>
+#include <hrpModel/ConstraintForceSolver.h>
+#include <hrpModel/SimulationControllerInterface.h>
+#include <hrpModel/WorldStateLog.h>
+#include <hrpCorba/OpenHRPCommon.hh>
+#include "Project.h"
+
+namespace hrp {
+
+    class SimulationRunner
+    {
+    public:
+        SimulationRunner();
+        ~SimulationRunner();
+
+        /**
+           @param name the value of the "controller" property of a model item or the name of the model item
+           @param filename path to the shared library of the controller
+        */
+        void setControllerLibrary(const std::string& name, const std::string& filename);
+
+        /// The log is not written if the filename is empty
+        void setLogFile(const std::string& filename) { logFilename = filename; }
+
+        /// overrides the "totalTime" property of the project if the value is positive
+        void setTotalTime(double time) { totalTimeOverride = time; }
+
+        bool setupWorld(const Project& project);
+        bool run();
+
+    private:
+        World<ConstraintForceSolver> world;
+        OpenHRP::CollisionSequence collisions;
+
+        double totalTime;
+        double totalTimeOverride;
+        double logTimeStep;
+
+        std::map<std::string, std::string> controllerLibraries;
+
+        struct Controller
+        {
+            SimulationControllerInterface* api;
+            SimulationControllerHandle handle;
+            double timeStep;
+            double nextTime;
+        };
+        std::vector<Controller> controllers;
+
+        std::string logFilename;
+        WorldStateLogWriter log;
+
+        bool loadModel(const ProjectItem& item, const Project& project);
+        void setInitialState(BodyPtr body, const ProjectItem& item, bool integrate);
+        bool createController(BodyPtr body, const ProjectItem& item);
+        void setCollisionPair(const ProjectItem& item);
+        void setExtraJoint(const ProjectItem& item);
+    };
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2008, AIST, the University of Tokyo and General Robotix Inc.
+ * All rights reserved. This program is made available under the terms of the
+ * Eclipse Public License v1.0 which accompanies this distribution, and is
+ * available at http://www.eclipse.org/legal/epl-v10.html
+ * Contributors:
+ * National Institute of Advanced Industrial Science and Technology (AIST)
+ */
+/**
+   \file
+   \brief openhrp-simulation-runner: runs the simulation of a project file without GrxUI,
+   the naming service and the CORBA servers.
+
+   The following runs the SamplePD project with the controller library
+   built from sample/controller/SamplePD/SamplePDInProcess.cpp, which reads
+   its data files from the etc directory of the current directory.
+
+   \code
+   cd sample/controller/SamplePD
+   openhrp-simulation-runner ../../project/SamplePD.xml \
+       --controller SamplePDController=./libSamplePDInProcess.so --log SamplePD.log
+   \endcode
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+#include "Project.h"
+#include "SimulationRunner.h"
+
+using namespace std;
+using namespace hrp;
+using namespace boost;
+
+
+int main(int argc, char* argv[])
+{
+    program_options::options_description options("Allowed options");
+    options.add_options()
+        ("help,h", "produce help message")
+        ("project", program_options::value<string>(), "project file")
+        ("mode", program_options::value<string>()->default_value("Simulation"), "mode of the project to run")
+        ("controller", program_options::value<vector<string> >(),
+         "controller library given as NAME=FILE where NAME is the \"controller\" property or the name of a model item")
+        ("log", program_options::value<string>(), "binary world state log file (see hrpModel/WorldStateLog.h)")
+        ("total-time", program_options::value<double>(), "overrides the total time of the project");
+
+    program_options::positional_options_description positional;
+    positional.add("project", 1);
+
+    program_options::variables_map vmap;
+    try {
+        program_options::store(program_options::command_line_parser(argc, argv).
+                               options(options).positional(positional).run(), vmap);
+        program_options::notify(vmap);
+    } catch(std::exception& ex){
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    if(vmap.count("help") || !vmap.count("project")){
+        cout << "Usage: " << argv[0] << " [options] project-file\n" << options << endl;
+        return vmap.count("help") ? 0 : 1;
+    }
+
+    Project project;
+    if(!project.load(vmap["project"].as<string>(), vmap["mode"].as<string>())){
+        return 1;
+    }
+
+    SimulationRunner runner;
+
+    if(vmap.count("controller")){
+        const vector<string>& controllers = vmap["controller"].as<vector<string> >();
+        for(size_t i=0; i < controllers.size(); ++i){
+            string::size_type pos = controllers[i].find('=');
+            if(pos == string::npos){
+                cerr << "Illegal controller option: " << controllers[i] << endl;
+                return 1;
+            }
+            runner.setControllerLibrary(controllers[i].substr(0, pos), controllers[i].substr(pos + 1));
+        }
+    }
+    if(vmap.count("log")){
+        runner.setLogFile(vmap["log"].as<string>());
+    }
+    if(vmap.count("total-time")){
+        runner.setTotalTime(vmap["total-time"].as<double>());
+    }
+
+    if(!runner.setupWorld(project)){
+        return 1;
+    }
+
+    return runner.run() ? 0 : 1;
+}